@@ -25,21 +25,22 @@
 #endif
 
 #include <gst/gst.h>
+#include <glib/gstdio.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#ifdef HAVE_SYS_EVENTFD_H
+#include <sys/eventfd.h>
+#endif
 
 #include "gstomx.h"
-#include "gstomxmjpegdec.h"
-#include "gstomxmpeg2videodec.h"
-#include "gstomxmpeg4videodec.h"
-#include "gstomxh264dec.h"
-#include "gstomxh263dec.h"
-#include "gstomxvp8dec.h"
-#include "gstomxtheoradec.h"
-#include "gstomxwmvdec.h"
-#include "gstomxmpeg4videoenc.h"
-#include "gstomxh264enc.h"
-#include "gstomxh263enc.h"
-#include "gstomxaacenc.h"
+#include "gstomxlatencytracer.h"
+#include "gstomxmemorytracer.h"
 
 GST_DEBUG_CATEGORY (gstomx_debug);
 #define GST_CAT_DEFAULT gstomx_debug
@@ -47,6 +48,135 @@ GST_DEBUG_CATEGORY (gstomx_debug);
 G_LOCK_DEFINE_STATIC (core_handles);
 static GHashTable *core_handles;
 
+static const gchar *memory_kind_names[GST_OMX_MEMORY_N_KINDS] = {
+  "omx-buffers", "wrappers", "pool-buffers", "codec-data", "pending-frames"
+};
+
+/* Protects the memory usage of all components and memory_total */
+G_LOCK_DEFINE_STATIC (memory_usage);
+static GstOMXMemoryUsage memory_total;
+
+/* NOTE: Must be called with the memory_usage lock */
+static void
+gst_omx_memory_usage_add (GstOMXMemoryUsage * usage, GstOMXMemoryKind kind,
+    gint64 count, gint64 bytes)
+{
+  usage->count[kind] += count;
+  usage->bytes[kind] += bytes;
+  usage->peak[kind] = MAX (usage->peak[kind], usage->bytes[kind]);
+}
+
+/* Returns the maximum of the integer setting key of all elements
+ * that use the core and, if not NULL, the component. Elements
+ * without the setting count as 0 and negative values as -1 */
+static gint
+gst_omx_config_get_max_integer (const gchar * core_name,
+    const gchar * component_name, const gchar * key)
+{
+  GKeyFile *config = gst_omx_get_configuration ();
+  gchar **elements;
+  gsize i, n_elements;
+  gint max = 0;
+
+  if (!config)
+    return 0;
+
+  elements = g_key_file_get_groups (config, &n_elements);
+  for (i = 0; i < n_elements && max >= 0; i++) {
+    gchar *name;
+    gboolean match;
+    gint value;
+
+    if (!g_key_file_has_key (config, elements[i], key, NULL))
+      continue;
+
+    name = g_key_file_get_string (config, elements[i], "core-name", NULL);
+    match = g_strcmp0 (name, core_name) == 0;
+    g_free (name);
+    if (match && component_name) {
+      name = g_key_file_get_string (config, elements[i], "component-name",
+          NULL);
+      match = g_strcmp0 (name, component_name) == 0;
+      g_free (name);
+    }
+
+    if (match) {
+      value = g_key_file_get_integer (config, elements[i], key, NULL);
+      max = value < 0 ? -1 : MAX (max, value);
+    }
+  }
+  g_strfreev (elements);
+
+  return max;
+}
+
+/* Returns TRUE if any element that uses the core and, if not NULL,
+ * the component sets the boolean setting key to false */
+static gboolean
+gst_omx_config_get_any_false (const gchar * core_name,
+    const gchar * component_name, const gchar * key)
+{
+  GKeyFile *config = gst_omx_get_configuration ();
+  gchar **elements;
+  gsize i, n_elements;
+  gboolean ret = FALSE;
+
+  if (!config)
+    return FALSE;
+
+  elements = g_key_file_get_groups (config, &n_elements);
+  for (i = 0; i < n_elements && !ret; i++) {
+    gchar *name;
+    gboolean match;
+    GError *err = NULL;
+
+    if (!g_key_file_has_key (config, elements[i], key, NULL))
+      continue;
+
+    name = g_key_file_get_string (config, elements[i], "core-name", NULL);
+    match = g_strcmp0 (name, core_name) == 0;
+    g_free (name);
+    if (match && component_name) {
+      name = g_key_file_get_string (config, elements[i], "component-name",
+          NULL);
+      match = g_strcmp0 (name, component_name) == 0;
+      g_free (name);
+    }
+
+    if (match && !g_key_file_get_boolean (config, elements[i], key, &err)
+        && !err)
+      ret = TRUE;
+    g_clear_error (&err);
+  }
+  g_strfreev (elements);
+
+  return ret;
+}
+
+/* Deinits the core once it was unused for its linger time */
+static gpointer
+gst_omx_core_linger_func (gpointer data)
+{
+  GstOMXCore *core = data;
+
+  g_mutex_lock (&core->lock);
+  while (core->user_count == 0 && core->initialized) {
+    if (g_get_monotonic_time () >= core->linger_deadline) {
+      GST_DEBUG ("Deinit core %p after lingering %d ms", core, core->linger);
+      core->deinit ();
+      core->initialized = FALSE;
+      break;
+    }
+    g_cond_wait_until (&core->linger_cond, &core->lock,
+        core->linger_deadline);
+  }
+  g_thread_unref (core->linger_thread);
+  core->linger_thread = NULL;
+  g_mutex_unlock (&core->lock);
+
+  return NULL;
+}
+
 GstOMXCore *
 gst_omx_core_acquire (const gchar * filename)
 {
@@ -61,7 +191,12 @@ gst_omx_core_acquire (const gchar * filename)
   if (!core) {
     core = g_slice_new0 (GstOMXCore);
     g_mutex_init (&core->lock);
+    g_cond_init (&core->linger_cond);
     core->user_count = 0;
+    /* In ms, negative for forever */
+    core->linger =
+        gst_omx_config_get_max_integer (filename, NULL, "core-linger");
+    core->initialized = FALSE;
     g_hash_table_insert (core_handles, g_strdup (filename), core);
 
     /* Hack for the Broadcom OpenMAX IL implementation */
@@ -131,17 +266,23 @@ gst_omx_core_acquire (const gchar * filename)
 
   g_mutex_lock (&core->lock);
   core->user_count++;
-  if (core->user_count == 1) {
+  if (!core->initialized) {
     OMX_ERRORTYPE err;
 
     err = core->init ();
     if (err != OMX_ErrorNone) {
       GST_ERROR ("Failed to initialize core '%s': 0x%08x", filename, err);
+      core->user_count--;
       g_mutex_unlock (&core->lock);
       goto error;
     }
+    core->initialized = TRUE;
 
     GST_DEBUG ("Successfully initialized core '%s'", filename);
+  } else if (core->user_count == 1) {
+    GST_DEBUG ("Reusing lingering core '%s'", filename);
+    if (core->linger_thread)
+      g_cond_signal (&core->linger_cond);
   }
 
   g_mutex_unlock (&core->lock);
@@ -166,6 +307,7 @@ error:
   {
     g_hash_table_remove (core_handles, filename);
     g_mutex_clear (&core->lock);
+    g_cond_clear (&core->linger_cond);
     g_slice_free (GstOMXCore, core);
 
     G_UNLOCK (core_handles);
@@ -187,8 +329,22 @@ gst_omx_core_release (GstOMXCore * core)
 
   core->user_count--;
   if (core->user_count == 0) {
-    GST_DEBUG ("Deinit core %p", core);
-    core->deinit ();
+    if (core->linger == 0) {
+      GST_DEBUG ("Deinit core %p", core);
+      core->deinit ();
+      core->initialized = FALSE;
+    } else if (core->linger > 0) {
+      GST_DEBUG ("Core %p lingers for %d ms", core, core->linger);
+      core->linger_deadline = g_get_monotonic_time () +
+          (gint64) core->linger * G_TIME_SPAN_MILLISECOND;
+      if (core->linger_thread)
+        g_cond_signal (&core->linger_cond);
+      else
+        core->linger_thread =
+            g_thread_new ("omxcorelinger", gst_omx_core_linger_func, core);
+    } else {
+      GST_DEBUG ("Keeping core %p initialized", core);
+    }
   }
 
   g_mutex_unlock (&core->lock);
@@ -196,438 +352,2160 @@ gst_omx_core_release (GstOMXCore * core)
   G_UNLOCK (core_handles);
 }
 
-/* NOTE: comp->messages_lock will be used */
-static void
-gst_omx_component_flush_messages (GstOMXComponent * comp)
+struct _GstOMXRingSlot
 {
-  GstOMXMessage *msg;
+  volatile gint sequence;
+  gpointer data;
+};
 
-  g_mutex_lock (&comp->messages_lock);
-  while ((msg = g_queue_pop_head (&comp->messages))) {
-    g_slice_free (GstOMXMessage, msg);
+/* Bounded multi-producer/multi-consumer ring as described by
+ * Dmitry Vyukov. Every slot carries a sequence number that tells
+ * producers and consumers if the slot is free or filled for their
+ * current position, so only the head/tail positions need a CAS.
+ *
+ * Positions wrap around at 2^32, which is fine as long as the
+ * ring is much smaller than that.
+ */
+void
+gst_omx_ring_init (GstOMXRing * ring, guint size)
+{
+  guint i;
+
+  /* Must be a power of two */
+  g_assert (size > 0 && (size & (size - 1)) == 0);
+
+  ring->slots = g_new (GstOMXRingSlot, size);
+  ring->mask = size - 1;
+  for (i = 0; i < size; i++) {
+    ring->slots[i].sequence = i;
+    ring->slots[i].data = NULL;
   }
-  g_mutex_unlock (&comp->messages_lock);
+  ring->head = 0;
+  ring->tail = 0;
 }
 
-/* NOTE: Call with comp->lock, comp->messages_lock will be used */
-static void
-gst_omx_component_handle_messages (GstOMXComponent * comp)
+void
+gst_omx_ring_clear (GstOMXRing * ring)
 {
-  GstOMXMessage *msg;
+  g_free (ring->slots);
+  ring->slots = NULL;
+  ring->mask = 0;
+}
 
-  g_mutex_lock (&comp->messages_lock);
-  while ((msg = g_queue_pop_head (&comp->messages))) {
-    g_mutex_unlock (&comp->messages_lock);
+/* Returns FALSE if the ring is full */
+gboolean
+gst_omx_ring_push (GstOMXRing * ring, gpointer data)
+{
+  GstOMXRingSlot *slot;
+  guint pos;
+  gint diff;
 
-    switch (msg->type) {
-      case GST_OMX_MESSAGE_STATE_SET:{
-        GST_INFO_OBJECT (comp->parent, "%s state change to %s finished",
-            comp->name, gst_omx_state_to_string (msg->content.state_set.state));
-        comp->state = msg->content.state_set.state;
-        if (comp->state == comp->pending_state)
-          comp->pending_state = OMX_StateInvalid;
-        break;
-      }
-      case GST_OMX_MESSAGE_FLUSH:{
-        GstOMXPort *port = NULL;
-        OMX_U32 index = msg->content.flush.port;
+  pos = g_atomic_int_get (&ring->tail);
+  for (;;) {
+    slot = &ring->slots[pos & ring->mask];
+    diff = (gint) ((guint) g_atomic_int_get (&slot->sequence) - pos);
 
-        port = gst_omx_component_get_port (comp, index);
-        if (!port)
-          break;
+    if (diff == 0) {
+      if (g_atomic_int_compare_and_exchange (&ring->tail, pos, pos + 1))
+        break;
+    } else if (diff < 0) {
+      /* The consumer did not free this slot yet */
+      return FALSE;
+    }
+    pos = g_atomic_int_get (&ring->tail);
+  }
 
-        GST_DEBUG_OBJECT (comp->parent, "%s port %u flushed", comp->name,
-            port->index);
+  slot->data = data;
+  /* Publish the slot to consumers */
+  g_atomic_int_set (&slot->sequence, pos + 1);
 
-        if (port->flushing) {
-          port->flushed = TRUE;
-        } else {
-          GST_ERROR_OBJECT (comp->parent, "%s port %u was not flushing",
-              comp->name, port->index);
-        }
+  return TRUE;
+}
 
+/* Returns NULL if the ring is empty */
+gpointer
+gst_omx_ring_pop (GstOMXRing * ring)
+{
+  GstOMXRingSlot *slot;
+  gpointer data;
+  guint pos;
+  gint diff;
+
+  pos = g_atomic_int_get (&ring->head);
+  for (;;) {
+    slot = &ring->slots[pos & ring->mask];
+    diff = (gint) ((guint) g_atomic_int_get (&slot->sequence) - (pos + 1));
+
+    if (diff == 0) {
+      if (g_atomic_int_compare_and_exchange (&ring->head, pos, pos + 1))
         break;
-      }
-      case GST_OMX_MESSAGE_ERROR:{
-        OMX_ERRORTYPE error = msg->content.error.error;
-
-        if (error == OMX_ErrorNone)
-          break;
-
-        GST_ERROR_OBJECT (comp->parent, "%s got error: %s (0x%08x)", comp->name,
-            gst_omx_error_to_string (error), error);
+    } else if (diff < 0) {
+      /* No producer published this slot yet */
+      return NULL;
+    }
+    pos = g_atomic_int_get (&ring->head);
+  }
 
-        /* We only set the first error ever from which
-         * we can't recover anymore.
-         */
-        if (comp->last_error == OMX_ErrorNone)
-          comp->last_error = error;
-        g_cond_broadcast (&comp->messages_cond);
+  data = slot->data;
+  slot->data = NULL;
+  /* Hand the slot back to producers for the next round */
+  g_atomic_int_set (&slot->sequence, pos + ring->mask + 1);
 
-        break;
-      }
-      case GST_OMX_MESSAGE_PORT_ENABLE:{
-        GstOMXPort *port = NULL;
-        OMX_U32 index = msg->content.port_enable.port;
-        OMX_BOOL enable = msg->content.port_enable.enable;
+  return data;
+}
 
-        port = gst_omx_component_get_port (comp, index);
-        if (!port)
-          break;
+static gboolean
+gst_omx_ring_is_empty (GstOMXRing * ring)
+{
+  guint pos = g_atomic_int_get (&ring->head);
+  GstOMXRingSlot *slot = &ring->slots[pos & ring->mask];
 
-        GST_DEBUG_OBJECT (comp->parent, "%s port %u %s", comp->name,
-            port->index, (enable ? "enabled" : "disabled"));
+  return (gint) ((guint) g_atomic_int_get (&slot->sequence) - (pos + 1)) < 0;
+}
 
-        if (enable)
-          port->enabled_pending = FALSE;
-        else
-          port->disabled_pending = FALSE;
-        break;
-      }
-      case GST_OMX_MESSAGE_PORT_SETTINGS_CHANGED:{
-        gint i, n;
-        OMX_U32 index = msg->content.port_settings_changed.port;
-        GList *outports = NULL, *l, *k;
+#if GST_CHECK_VERSION(1,8,0)
+static GstTracerRecord *lock_stats_record = NULL;
 
-        GST_DEBUG_OBJECT (comp->parent, "%s settings changed (port %u)",
-            comp->name, (guint) index);
+#define LOCK_STATS_RECORD_FIELD(type, desc) \
+    GST_TYPE_STRUCTURE, gst_structure_new ("value", \
+        "type", G_TYPE_GTYPE, type, \
+        "description", G_TYPE_STRING, desc, \
+        NULL)
+#endif
 
-        /* FIXME: This probably can be done better */
+static gpointer
+gst_omx_lock_stats_init (gpointer data)
+{
+  const gchar *env = g_getenv (GST_OMX_LOCK_STATS_ENV);
 
-        /* Now update the ports' states */
-        n = (comp->ports ? comp->ports->len : 0);
-        for (i = 0; i < n; i++) {
-          GstOMXPort *port = g_ptr_array_index (comp->ports, i);
+  if (!env || *env == '\0' || strcmp (env, "0") == 0)
+    return NULL;
 
-          if (index == OMX_ALL || index == port->index) {
-            port->settings_cookie++;
-            gst_omx_port_update_port_definition (port, NULL);
-            if (port->port_def.eDir == OMX_DirOutput && !port->tunneled)
-              outports = g_list_prepend (outports, port);
-          }
-        }
+#if GST_CHECK_VERSION(1,8,0)
+  lock_stats_record = gst_tracer_record_new ("omx-lock-stats.class",
+      "element", GST_TYPE_STRUCTURE, gst_structure_new ("value",
+          "type", G_TYPE_GTYPE, G_TYPE_STRING,
+          "related", GST_TYPE_TRACER_VALUE_SCOPE,
+          GST_TRACER_VALUE_SCOPE_ELEMENT, NULL),
+      "lock", LOCK_STATS_RECORD_FIELD (G_TYPE_STRING, "name of the lock"),
+      "acquisitions", LOCK_STATS_RECORD_FIELD (G_TYPE_UINT64,
+          "number of times the lock was taken"),
+      "contended", LOCK_STATS_RECORD_FIELD (G_TYPE_UINT64,
+          "number of times the lock was held by another thread"),
+      "wait-total", LOCK_STATS_RECORD_FIELD (G_TYPE_UINT64,
+          "time spent waiting for the lock in ns"),
+      "wait-max", LOCK_STATS_RECORD_FIELD (G_TYPE_UINT64,
+          "longest wait for the lock in ns"),
+      "hold-total", LOCK_STATS_RECORD_FIELD (G_TYPE_UINT64,
+          "time the lock was held in ns"),
+      "hold-max", LOCK_STATS_RECORD_FIELD (G_TYPE_UINT64,
+          "longest time the lock was held in ns"), NULL);
+#endif
 
-        for (k = outports; k; k = k->next) {
-          gboolean found = FALSE;
+  GST_INFO ("Lock statistics enabled");
 
-          for (l = comp->pending_reconfigure_outports; l; l = l->next) {
-            if (l->data == k->data) {
-              found = TRUE;
-              break;
-            }
-          }
+  return GINT_TO_POINTER (TRUE);
+}
 
-          if (!found)
-            comp->pending_reconfigure_outports =
-                g_list_prepend (comp->pending_reconfigure_outports, k->data);
-        }
+/* TRUE if new components should record lock statistics,
+ * decided once per process */
+static gboolean
+gst_omx_lock_stats_enabled (void)
+{
+  static GOnce once = G_ONCE_INIT;
 
-        g_list_free (outports);
+  return g_once (&once, gst_omx_lock_stats_init, NULL) != NULL;
+}
 
-        break;
-      }
-      case GST_OMX_MESSAGE_BUFFER_FLAG:{
-        GstOMXPort *port = NULL;
-        OMX_U32 index = msg->content.buffer_flag.port;
-        OMX_U32 flags = msg->content.buffer_flag.flags;
+static guint
+gst_omx_lock_stats_bucket (guint64 ns)
+{
+  guint bucket = g_bit_storage ((gulong) MIN (ns >> 10, G_MAXUINT32));
 
-        port = gst_omx_component_get_port (comp, index);
-        if (!port)
-          break;
+  return MIN (bucket, GST_OMX_LOCK_STATS_N_BUCKETS - 1);
+}
 
-        GST_DEBUG_OBJECT (comp->parent, "%s port %u got buffer flags 0x%08x",
-            comp->name, port->index, (guint) flags);
-        if ((flags & OMX_BUFFERFLAG_EOS)
-            && port->port_def.eDir == OMX_DirOutput)
-          port->eos = TRUE;
+/* NOTE: Must be called right after the lock of stats was taken,
+ * wait_start is GST_CLOCK_TIME_NONE if it was not contended */
+static void
+gst_omx_lock_stats_locked (GstOMXLockStats * stats, GstClockTime wait_start)
+{
+  GstClockTime now = gst_util_get_timestamp ();
 
-        break;
-      }
-      case GST_OMX_MESSAGE_BUFFER_DONE:{
-        GstOMXBuffer *buf = msg->content.buffer_done.buffer->pAppPrivate;
-        GstOMXPort *port;
-
-        port = buf->port;
-
-        if (msg->content.buffer_done.empty) {
-          /* Input buffer is empty again and can be used to contain new input */
-          GST_LOG_OBJECT (port->comp->parent,
-              "%s port %u emptied buffer %p (%p)", port->comp->name,
-              port->index, buf, buf->omx_buf->pBuffer);
-
-          /* Reset offset and filled length */
-          buf->omx_buf->nOffset = 0;
-          buf->omx_buf->nFilledLen = 0;
-
-          /* Reset all flags, some implementations don't
-           * reset them themselves and the flags are not
-           * valid anymore after the buffer was consumed
-           */
-          buf->omx_buf->nFlags = 0;
-        } else {
-          /* Output buffer contains output now or
-           * the port was flushed */
-          GST_LOG_OBJECT (port->comp->parent,
-              "%s port %u filled buffer %p (%p)", port->comp->name, port->index,
-              buf, buf->omx_buf->pBuffer);
-
-          if ((buf->omx_buf->nFlags & OMX_BUFFERFLAG_EOS)
-              && port->port_def.eDir == OMX_DirOutput)
-            port->eos = TRUE;
-        }
+  if (GST_CLOCK_TIME_IS_VALID (wait_start)) {
+    guint64 wait = now - wait_start;
 
-        buf->used = FALSE;
+    stats->contended++;
+    stats->wait_total += wait;
+    stats->wait_max = MAX (stats->wait_max, wait);
+    stats->wait_hist[gst_omx_lock_stats_bucket (wait)]++;
+  }
+  stats->acquisitions++;
+  stats->locked_at = now;
+}
 
-        g_queue_push_tail (&port->pending_buffers, buf);
+/* NOTE: Must be called right before the lock of stats is released */
+static void
+gst_omx_lock_stats_unlocking (GstOMXLockStats * stats)
+{
+  guint64 hold = gst_util_get_timestamp () - stats->locked_at;
 
-        break;
-      }
-      default:{
-        g_assert_not_reached ();
-        break;
-      }
-    }
+  stats->hold_total += hold;
+  stats->hold_max = MAX (stats->hold_max, hold);
+  stats->hold_hist[gst_omx_lock_stats_bucket (hold)]++;
+}
 
-    g_slice_free (GstOMXMessage, msg);
+/* Wrappers around g_mutex_lock()/g_mutex_unlock() that record
+ * statistics if stats is not NULL. Uncontended acquisitions
+ * only cost a trylock and a timestamp */
+static inline void
+gst_omx_mutex_lock (GMutex * mutex, GstOMXLockStats * stats)
+{
+  if (G_LIKELY (stats == NULL)) {
+    g_mutex_lock (mutex);
+  } else if (g_mutex_trylock (mutex)) {
+    gst_omx_lock_stats_locked (stats, GST_CLOCK_TIME_NONE);
+  } else {
+    GstClockTime wait_start = gst_util_get_timestamp ();
 
-    g_mutex_lock (&comp->messages_lock);
+    g_mutex_lock (mutex);
+    gst_omx_lock_stats_locked (stats, wait_start);
   }
-
-  g_mutex_unlock (&comp->messages_lock);
 }
 
-/* NOTE: comp->messages_lock will be used */
-static void
-gst_omx_component_send_message (GstOMXComponent * comp, GstOMXMessage * msg)
+static inline void
+gst_omx_mutex_unlock (GMutex * mutex, GstOMXLockStats * stats)
 {
-  g_mutex_lock (&comp->messages_lock);
-  if (msg)
-    g_queue_push_tail (&comp->messages, msg);
-  g_cond_broadcast (&comp->messages_cond);
-  g_mutex_unlock (&comp->messages_lock);
+  if (G_UNLIKELY (stats != NULL))
+    gst_omx_lock_stats_unlocking (stats);
+  g_mutex_unlock (mutex);
 }
 
-static OMX_ERRORTYPE
-EventHandler (OMX_HANDLETYPE hComponent, OMX_PTR pAppData, OMX_EVENTTYPE eEvent,
-    OMX_U32 nData1, OMX_U32 nData2, OMX_PTR pEventData)
+/* Copy of a flight recorder, written to a file later */
+struct _GstOMXFlightDump
 {
-  GstOMXComponent *comp = (GstOMXComponent *) pAppData;
+  GstOMXFlightEvent *events;
+  guint size;
+  guint pos;                    /* Number of events recorded */
+  gchar *element;
+  gchar *component;
+  const gchar *reason;
+  gint seq;
+};
 
-  switch (eEvent) {
-    case OMX_EventCmdComplete:
-    {
-      OMX_COMMANDTYPE cmd = (OMX_COMMANDTYPE) nData1;
+static GstOMXFlightDump *gst_omx_flight_dump_new (GstOMXComponent * comp,
+    const gchar * reason);
+static gchar *gst_omx_flight_dump_write (GstOMXFlightDump * dump);
 
-      GST_DEBUG_OBJECT (comp->parent, "%s %s command complete (%d)",
-          comp->name, gst_omx_command_to_string (cmd), cmd);
+/* Releases comp->lock and then writes the flight
+ * recorder dump taken while it was held, if any */
+static inline void
+gst_omx_component_unlock (GstOMXComponent * comp)
+{
+  GstOMXFlightDump *dump = comp->flight_dump;
 
-      switch (cmd) {
-        case OMX_CommandStateSet:{
-          GstOMXMessage *msg = g_slice_new (GstOMXMessage);
+  comp->flight_dump = NULL;
+  gst_omx_mutex_unlock (&comp->lock, comp->lock_stats);
 
-          msg->type = GST_OMX_MESSAGE_STATE_SET;
-          msg->content.state_set.state = nData2;
+  if (G_UNLIKELY (dump != NULL))
+    g_free (gst_omx_flight_dump_write (dump));
+}
 
-          GST_DEBUG_OBJECT (comp->parent, "%s state change to %s finished",
-              comp->name,
-              gst_omx_state_to_string (msg->content.state_set.state));
+/* NOTE: Must be called with comp->lock
+ *
+ * Copies the flight recorder, it is written once the lock is released
+ * to not do any file I/O under it */
+static void
+gst_omx_component_queue_flight_dump (GstOMXComponent * comp,
+    const gchar * reason)
+{
+  if (comp->flight_events && !comp->flight_dump)
+    comp->flight_dump = gst_omx_flight_dump_new (comp, reason);
+}
 
-          gst_omx_component_send_message (comp, msg);
-          break;
-        }
-        case OMX_CommandFlush:{
-          GstOMXMessage *msg = g_slice_new (GstOMXMessage);
+#define GST_OMX_COMPONENT_LOCK(comp) \
+    gst_omx_mutex_lock (&(comp)->lock, (comp)->lock_stats)
+#define GST_OMX_COMPONENT_UNLOCK(comp) \
+    gst_omx_component_unlock (comp)
+#define GST_OMX_COMPONENT_MESSAGES_LOCK(comp) \
+    gst_omx_mutex_lock (&(comp)->messages_lock, (comp)->messages_lock_stats)
+#define GST_OMX_COMPONENT_MESSAGES_UNLOCK(comp) \
+    gst_omx_mutex_unlock (&(comp)->messages_lock, (comp)->messages_lock_stats)
 
-          msg->type = GST_OMX_MESSAGE_FLUSH;
-          msg->content.flush.port = nData2;
-          GST_DEBUG_OBJECT (comp->parent, "%s port %u flushed", comp->name,
-              (guint) msg->content.flush.port);
+/* Incremented by the SIGUSR2 handler, every component dumps its
+ * flight recorder when it notices a new value */
+static volatile gint flight_signal_seq = 0;
 
-          gst_omx_component_send_message (comp, msg);
-          break;
-        }
+static void
+gst_omx_flight_recorder_signal_handler (gint signum)
+{
+  g_atomic_int_inc (&flight_signal_seq);
+}
+
+static gpointer
+gst_omx_flight_recorder_init (gpointer data)
+{
+  const gchar *env;
+  gint size = 0;
+
+  env = g_getenv (GST_OMX_FLIGHT_RECORDER_ENV);
+  if (env && *env != '\0')
+    size = atoi (env);
+  if (size <= 0)
+    return GINT_TO_POINTER (0);
+  size = MIN (size, 1 << 20);
+
+  env = g_getenv (GST_OMX_FLIGHT_RECORDER_SIGNAL_ENV);
+  if (env && *env != '\0' && strcmp (env, "0") != 0) {
+    struct sigaction sa;
+
+    memset (&sa, 0, sizeof (sa));
+    sa.sa_handler = gst_omx_flight_recorder_signal_handler;
+    sa.sa_flags = SA_RESTART;
+    sigemptyset (&sa.sa_mask);
+    if (sigaction (SIGUSR2, &sa, NULL) == -1)
+      GST_ERROR ("Failed to install SIGUSR2 handler: %s", g_strerror (errno));
+  }
+
+  /* Round up to a power of two */
+  return GINT_TO_POINTER (1 << g_bit_storage (size - 1));
+}
+
+/* Number of events per flight recorder, 0 if disabled.
+ * Decided once per process */
+static guint
+gst_omx_flight_recorder_size (void)
+{
+  static GOnce once = G_ONCE_INIT;
+
+  return GPOINTER_TO_INT (g_once (&once, gst_omx_flight_recorder_init, NULL));
+}
+
+/* Number of events a trace writer can hold before it drops
+ * events, must be a power of two */
+#define GST_OMX_TRACE_RING_SIZE (4096)
+/* How often the writer thread drains the ring, in microseconds */
+#define GST_OMX_TRACE_WRITE_INTERVAL (10 * G_TIME_SPAN_MILLISECOND)
+
+/* Events are recorded from the OMX callbacks and the streaming
+ * threads, so they are only copied into a preallocated arena and
+ * queued without locks. A thread per component writes them out */
+struct _GstOMXTraceWriter
+{
+  FILE *file;
+  gchar *filename;
+
+  GstOMXFlightEvent *arena;
+  GstOMXRing free_events;       /* Unused events of arena */
+  GstOMXRing events;            /* Recorded events, in order */
+  volatile gint dropped;        /* Events lost because arena was empty */
+
+  GThread *thread;
+  GMutex lock;
+  GCond cond;
+  gboolean running;             /* Protected by lock */
+};
+
+static void
+gst_omx_trace_writer_drain (GstOMXTraceWriter * trace)
+{
+  GstOMXFlightEvent *ev;
+
+  while ((ev = gst_omx_ring_pop (&trace->events))) {
+    fwrite (ev, sizeof (*ev), 1, trace->file);
+    /* Can't fail, the ring has space for the complete arena */
+    gst_omx_ring_push (&trace->free_events, ev);
+  }
+}
+
+static gpointer
+gst_omx_trace_writer_func (gpointer data)
+{
+  GstOMXTraceWriter *trace = data;
+
+  g_mutex_lock (&trace->lock);
+  while (trace->running) {
+    g_mutex_unlock (&trace->lock);
+    gst_omx_trace_writer_drain (trace);
+    g_mutex_lock (&trace->lock);
+
+    if (trace->running)
+      g_cond_wait_until (&trace->cond, &trace->lock,
+          g_get_monotonic_time () + GST_OMX_TRACE_WRITE_INTERVAL);
+  }
+  g_mutex_unlock (&trace->lock);
+
+  /* Everything that was recorded before the writer was stopped */
+  gst_omx_trace_writer_drain (trace);
+
+  return NULL;
+}
+
+/* Opens the trace file of a new component in GST_OMX_TRACE_DIR,
+ * writes the header and starts the writer thread. NULL if tracing
+ * is disabled or failed */
+static GstOMXTraceWriter *
+gst_omx_trace_writer_new (GstOMXComponent * comp,
+    const gchar * component_name, const gchar * component_role)
+{
+  static volatile gint seq = 0;
+  GstOMXTraceWriter *trace;
+  GstOMXTraceHeader header;
+  const gchar *dir;
+  gchar *basename, *filename;
+  FILE *f;
+  guint i;
+
+  dir = g_getenv (GST_OMX_TRACE_DIR_ENV);
+  if (!dir || *dir == '\0')
+    return NULL;
+
+  basename = g_strdup_printf ("gst-omx-trace-%d-%s-%d.bin", (gint) getpid (),
+      comp->name, g_atomic_int_add (&seq, 1));
+  filename = g_build_filename (dir, basename, NULL);
+  g_free (basename);
+
+  f = fopen (filename, "wb");
+  if (!f) {
+    GST_ERROR_OBJECT (comp->parent, "Failed to open trace file '%s': %s",
+        filename, g_strerror (errno));
+    g_free (filename);
+    return NULL;
+  }
+  /* Events are small, only write in large blocks */
+  setvbuf (f, NULL, _IOFBF, 64 * 1024);
+
+  memset (&header, 0, sizeof (header));
+  memcpy (header.magic, GST_OMX_TRACE_MAGIC, sizeof (header.magic));
+  header.version = GST_OMX_TRACE_VERSION;
+  header.event_size = sizeof (GstOMXFlightEvent);
+  header.start_time = gst_util_get_timestamp ();
+  g_strlcpy (header.component_name, component_name,
+      sizeof (header.component_name));
+  if (component_role)
+    g_strlcpy (header.component_role, component_role,
+        sizeof (header.component_role));
+
+  if (fwrite (&header, sizeof (header), 1, f) != 1) {
+    GST_ERROR_OBJECT (comp->parent, "Failed to write trace file '%s'",
+        filename);
+    fclose (f);
+    g_free (filename);
+    return NULL;
+  }
+
+  trace = g_slice_new0 (GstOMXTraceWriter);
+  trace->file = f;
+  trace->filename = filename;
+  trace->arena = g_new (GstOMXFlightEvent, GST_OMX_TRACE_RING_SIZE);
+  gst_omx_ring_init (&trace->free_events, GST_OMX_TRACE_RING_SIZE);
+  gst_omx_ring_init (&trace->events, GST_OMX_TRACE_RING_SIZE);
+  for (i = 0; i < GST_OMX_TRACE_RING_SIZE; i++)
+    gst_omx_ring_push (&trace->free_events, &trace->arena[i]);
+  trace->dropped = 0;
+
+  g_mutex_init (&trace->lock);
+  g_cond_init (&trace->cond);
+  trace->running = TRUE;
+  trace->thread =
+      g_thread_new ("omxtracewriter", gst_omx_trace_writer_func, trace);
+
+  GST_INFO_OBJECT (comp->parent, "Tracing %s to '%s'", comp->name, filename);
+
+  return trace;
+}
+
+/* Stops the writer thread after it wrote all recorded
+ * events and closes the file */
+static void
+gst_omx_trace_writer_free (GstOMXComponent * comp, GstOMXTraceWriter * trace)
+{
+  gint dropped;
+
+  if (!trace)
+    return;
+
+  g_mutex_lock (&trace->lock);
+  trace->running = FALSE;
+  g_cond_signal (&trace->cond);
+  g_mutex_unlock (&trace->lock);
+  g_thread_join (trace->thread);
+
+  if (fclose (trace->file) != 0)
+    GST_ERROR_OBJECT (comp->parent, "Failed to write trace file '%s': %s",
+        trace->filename, g_strerror (errno));
+
+  dropped = g_atomic_int_get (&trace->dropped);
+  if (dropped > 0)
+    GST_WARNING_OBJECT (comp->parent, "Trace '%s' of %s lost %d events, "
+        "they were recorded faster than they could be written",
+        trace->filename, comp->name, dropped);
+
+  gst_omx_ring_clear (&trace->events);
+  gst_omx_ring_clear (&trace->free_events);
+  g_free (trace->arena);
+  g_free (trace->filename);
+  g_mutex_clear (&trace->lock);
+  g_cond_clear (&trace->cond);
+  g_slice_free (GstOMXTraceWriter, trace);
+}
+
+/* NOTE: Does not take any lock, safe to call from the OMX callbacks */
+static inline void
+gst_omx_trace_writer_push (GstOMXTraceWriter * trace,
+    const GstOMXFlightEvent * ev)
+{
+  GstOMXFlightEvent *slot;
+
+  if (!(slot = gst_omx_ring_pop (&trace->free_events))) {
+    g_atomic_int_inc (&trace->dropped);
+    return;
+  }
+
+  *slot = *ev;
+  /* Can't fail, the ring has space for the complete arena */
+  gst_omx_ring_push (&trace->events, slot);
+}
+
+/* NOTE: Does not take any lock, safe to call from the OMX callbacks
+ *
+ * Costs an atomic increment and a timestamp, and a few more atomic
+ * operations to queue the event if tracing is enabled */
+static inline void
+gst_omx_component_record (GstOMXComponent * comp, GstOMXFlightEventType type,
+    OMX_BUFFERHEADERTYPE * buffer, guint32 data1, guint32 data2, guint32 data3)
+{
+  GstOMXFlightEvent ev;
+
+  if (G_LIKELY (comp->flight_events == NULL && comp->trace == NULL))
+    return;
+
+  ev.time = gst_util_get_timestamp ();
+  ev.buffer = (guint64) (gsize) buffer;
+  ev.type = type;
+  ev.data1 = data1;
+  ev.data2 = data2;
+  ev.data3 = data3;
+
+  if (comp->flight_events) {
+    guint pos = (guint) g_atomic_int_add (&comp->flight_pos, 1);
+
+    comp->flight_events[pos & comp->flight_mask] = ev;
+  }
+
+  if (G_UNLIKELY (comp->trace != NULL))
+    gst_omx_trace_writer_push (comp->trace, &ev);
+}
+
+/* NOTE: Does not take any lock */
+static OMX_ERRORTYPE
+gst_omx_component_send_command (GstOMXComponent * comp, OMX_COMMANDTYPE cmd,
+    OMX_U32 param)
+{
+  OMX_ERRORTYPE err;
+
+  gst_omx_component_record (comp, GST_OMX_FLIGHT_EVENT_COMMAND, NULL, cmd,
+      param, 0);
+  err = OMX_SendCommand (comp->handle, cmd, param, NULL);
+  if (err != OMX_ErrorNone)
+    gst_omx_component_record (comp, GST_OMX_FLIGHT_EVENT_CALL_FAILED, NULL,
+        GST_OMX_FLIGHT_EVENT_COMMAND, err, param);
+
+  return err;
+}
+
+/* NOTE: Does not take any lock */
+static OMX_ERRORTYPE
+gst_omx_port_pass_buffer (GstOMXPort * port, GstOMXBuffer * buf)
+{
+  GstOMXComponent *comp = port->comp;
+  GstOMXFlightEventType type;
+  OMX_ERRORTYPE err;
+
+  type = (port->port_def.eDir == OMX_DirInput ?
+      GST_OMX_FLIGHT_EVENT_EMPTY_THIS_BUFFER :
+      GST_OMX_FLIGHT_EVENT_FILL_THIS_BUFFER);
+  gst_omx_component_record (comp, type, buf->omx_buf, port->index,
+      buf->omx_buf->nFlags, buf->omx_buf->nFilledLen);
+
+  if (port->port_def.eDir == OMX_DirInput)
+    err = OMX_EmptyThisBuffer (comp->handle, buf->omx_buf);
+  else
+    err = OMX_FillThisBuffer (comp->handle, buf->omx_buf);
+
+  if (err != OMX_ErrorNone)
+    gst_omx_component_record (comp, GST_OMX_FLIGHT_EVENT_CALL_FAILED,
+        buf->omx_buf, type, err, port->index);
+
+  return err;
+}
+
+/* NOTE: Does not take any lock */
+static gboolean
+gst_omx_component_has_messages (GstOMXComponent * comp)
+{
+  return !gst_omx_ring_is_empty (&comp->messages)
+      || g_atomic_int_get (&comp->n_messages_overflow) > 0;
+}
+
+/* NOTE: comp->messages_lock will be used if the ring overflowed */
+static GstOMXMessage *
+gst_omx_component_pop_message (GstOMXComponent * comp)
+{
+  GstOMXMessage *msg;
+
+  if ((msg = gst_omx_ring_pop (&comp->messages)))
+    return msg;
+
+  if (g_atomic_int_get (&comp->n_messages_overflow) == 0)
+    return NULL;
+
+  /* While messages are headed for the overflow queue all new
+   * messages go there too, so everything in the ring is older than
+   * them. The queue can still be empty if the producer didn't get
+   * messages_lock yet, it wakes up the waiters afterwards */
+  GST_OMX_COMPONENT_MESSAGES_LOCK (comp);
+  msg = g_queue_pop_head (&comp->messages_overflow);
+  if (msg)
+    g_atomic_int_add (&comp->n_messages_overflow, -1);
+  GST_OMX_COMPONENT_MESSAGES_UNLOCK (comp);
+
+  return msg;
+}
+
+/* NOTE: Does not take any lock */
+static void
+gst_omx_port_signal_notify_fd (GstOMXPort * port)
+{
+  gint fd = g_atomic_int_get (&port->notify_write_fd);
+#ifdef HAVE_SYS_EVENTFD_H
+  guint64 v = 1;
+#else
+  guint8 v = 1;
+#endif
+
+  if (fd == -1)
+    return;
+
+  /* Only fails if the counter or pipe is full, but
+   * then it's readable already */
+  while (write (fd, &v, sizeof (v)) == -1 && errno == EINTR);
+}
+
+/* NOTE: Does not take any lock, only called by the consumer */
+static void
+gst_omx_port_drain_notify_fd (GstOMXPort * port)
+{
+#ifdef HAVE_SYS_EVENTFD_H
+  guint64 v;
+
+  while (read (port->notify_fd, &v, sizeof (v)) == -1 && errno == EINTR);
+#else
+  guint8 v[64];
+
+  while (read (port->notify_fd, v, sizeof (v)) > 0 || errno == EINTR);
+#endif
+}
+
+/* NOTE: Does not take any lock
+ *
+ * Tells everybody not waiting on the port's cond */
+static void
+gst_omx_port_notify (GstOMXPort * port)
+{
+  GstOMXPortNotifyFunc func;
+
+  gst_omx_port_signal_notify_fd (port);
+
+  /* Keeps gst_omx_port_set_notify_func() from returning
+   * while the previous function might still be called */
+  g_atomic_int_inc (&port->notify_users);
+  func = (GstOMXPortNotifyFunc) g_atomic_pointer_get (&port->notify_func);
+  if (func)
+    func (port, g_atomic_pointer_get (&port->notify_data));
+  g_atomic_int_add (&port->notify_users, -1);
+}
+
+/* NOTE: comp->messages_lock will be used if somebody is waiting */
+static void
+gst_omx_port_wake_waiters (GstOMXPort * port)
+{
+  GstOMXComponent *comp = port->comp;
+
+  /* Waiters increase the counter before checking for new messages,
+   * so either they see the message or we see them */
+  g_atomic_int_inc (&port->messages_seq);
+  if (g_atomic_int_get (&port->messages_waiters) > 0) {
+    GST_OMX_COMPONENT_MESSAGES_LOCK (comp);
+    g_cond_broadcast (&port->messages_cond);
+    GST_OMX_COMPONENT_MESSAGES_UNLOCK (comp);
+  }
+
+  gst_omx_port_notify (port);
+}
+
+/* NOTE: comp->messages_lock will be used if somebody is waiting
+ *
+ * Wakes up everybody, waiting for the component or any port */
+static void
+gst_omx_component_wake_waiters (GstOMXComponent * comp)
+{
+  gboolean locked = FALSE;
+  gint i, n;
+
+  if (g_atomic_int_get (&comp->messages_waiters) > 0) {
+    GST_OMX_COMPONENT_MESSAGES_LOCK (comp);
+    locked = TRUE;
+    g_cond_broadcast (&comp->messages_cond);
+  }
+
+  n = (comp->ports ? comp->ports->len : 0);
+  for (i = 0; i < n; i++) {
+    GstOMXPort *port = g_ptr_array_index (comp->ports, i);
+
+    gst_omx_port_notify (port);
+
+    if (g_atomic_int_get (&port->messages_waiters) > 0) {
+      if (!locked) {
+        GST_OMX_COMPONENT_MESSAGES_LOCK (comp);
+        locked = TRUE;
+      }
+      g_cond_broadcast (&port->messages_cond);
+    }
+  }
+
+  if (locked)
+    GST_OMX_COMPONENT_MESSAGES_UNLOCK (comp);
+}
+
+/* NOTE: Must be called while holding comp->lock, uses comp->messages_lock.
+ * comp->lock is released while waiting. Returns FALSE if wait_until
+ * passed without being signalled, -1 waits forever.
+ *
+ * If port is not NULL only messages for this port or the complete
+ * component wake up the caller */
+static gboolean
+gst_omx_component_wait_message (GstOMXComponent * comp, GstOMXPort * port,
+    gint64 wait_until)
+{
+  GCond *cond = (port ? &port->messages_cond : &comp->messages_cond);
+  volatile gint *waiters =
+      (port ? &port->messages_waiters : &comp->messages_waiters);
+  gint handled_seq = (port ? port->handled_seq : 0);
+  gboolean signalled = TRUE;
+
+  GST_OMX_COMPONENT_MESSAGES_LOCK (comp);
+  g_atomic_int_inc (waiters);
+  /* Not GST_OMX_COMPONENT_UNLOCK(), a pending flight recorder
+   * dump must not be written with messages_lock. It's written
+   * when the lock is released the next time */
+  gst_omx_mutex_unlock (&comp->lock, comp->lock_stats);
+  /* Buffers are returned to the port without a message, but
+   * they increase its sequence number. The overflow queue itself
+   * is checked, a message on its way there is only queued with
+   * messages_lock and wakes us up afterwards */
+  if (gst_omx_ring_is_empty (&comp->messages)
+      && g_queue_is_empty (&comp->messages_overflow)
+      && (!port || g_atomic_int_get (&port->messages_seq) == handled_seq)) {
+    /* Time spent waiting for the cond does not count as holding
+     * or waiting for the lock */
+    if (comp->messages_lock_stats)
+      gst_omx_lock_stats_unlocking (comp->messages_lock_stats);
+    if (wait_until == -1)
+      g_cond_wait (cond, &comp->messages_lock);
+    else
+      signalled = g_cond_wait_until (cond, &comp->messages_lock, wait_until);
+    if (comp->messages_lock_stats)
+      gst_omx_lock_stats_locked (comp->messages_lock_stats,
+          GST_CLOCK_TIME_NONE);
+  }
+  g_atomic_int_add (waiters, -1);
+  GST_OMX_COMPONENT_MESSAGES_UNLOCK (comp);
+  GST_OMX_COMPONENT_LOCK (comp);
+
+  return signalled;
+}
+
+/* NOTE: Never blocks, safe to call from the OMX callbacks */
+static GstOMXMessage *
+gst_omx_component_alloc_message (GstOMXComponent * comp)
+{
+  GstOMXMessage *msg;
+
+  if ((msg = gst_omx_ring_pop (&comp->free_messages)))
+    return msg;
+
+  if (g_atomic_int_add (&comp->n_heap_messages, 1) == 0)
+    GST_DEBUG_OBJECT (comp->parent, "%s message arena of %u messages "
+        "exhausted, allocating from the heap", comp->name,
+        GST_OMX_MESSAGE_ARENA_SIZE);
+
+  msg = g_slice_new (GstOMXMessage);
+  msg->from_arena = FALSE;
+
+  return msg;
+}
+
+static void
+gst_omx_component_free_message (GstOMXComponent * comp, GstOMXMessage * msg)
+{
+  if (msg->from_arena) {
+    /* Can't fail, the ring has space for the complete arena */
+    gst_omx_ring_push (&comp->free_messages, msg);
+  } else {
+    g_slice_free (GstOMXMessage, msg);
+  }
+}
+
+/* NOTE: Does not take any lock. The ring always has
+ * space for all buffers of the port */
+static void
+gst_omx_port_push_pending_buffer (GstOMXPort * port, GstOMXBuffer * buf)
+{
+  if (!gst_omx_ring_push (&port->pending_buffers, buf))
+    g_assert_not_reached ();
+  g_atomic_int_inc (&port->n_pending_buffers);
+}
+
+/* NOTE: Does not take any lock */
+static GstOMXBuffer *
+gst_omx_port_pop_pending_buffer (GstOMXPort * port)
+{
+  GstOMXBuffer *buf;
+
+  if ((buf = gst_omx_ring_pop (&port->pending_buffers)))
+    g_atomic_int_add (&port->n_pending_buffers, -1);
+
+  return buf;
+}
+
+/* NOTE: Does not take any lock
+ *
+ * TRUE if the component still owns some buffers of the port */
+static gboolean
+gst_omx_port_has_buffers_in_use (GstOMXPort * port)
+{
+  return port->buffers
+      && (gint) port->buffers->len >
+      g_atomic_int_get (&port->n_pending_buffers);
+}
+
+/* NOTE: Only call if GST_OMX_LATENCY_TRACING()
+ *
+ * Passes the time since *since to the latency tracer, if set, and
+ * stores the current time in *now */
+static void
+gst_omx_buffer_trace_latency (GstOMXBuffer * buf, GstClockTime * since,
+    GstOMXLatencyKind kind, GstClockTime * now)
+{
+  GstClockTime ts = gst_util_get_timestamp ();
+
+  if (since && GST_CLOCK_TIME_IS_VALID (*since)) {
+    gst_omx_latency_tracer_port_sample (buf->port, kind, ts - *since);
+    *since = GST_CLOCK_TIME_NONE;
+  }
+  *now = ts;
+}
+
+/* NOTE: Called from the OMX callbacks, does not block */
+static void
+gst_omx_port_buffer_done (GstOMXPort * port, GstOMXBuffer * buf)
+{
+  if (GST_OMX_LATENCY_TRACING ())
+    gst_omx_buffer_trace_latency (buf, &buf->sent_at,
+        GST_OMX_LATENCY_COMPONENT, &buf->done_at);
+
+  buf->used = FALSE;
+  gst_omx_port_push_pending_buffer (port, buf);
+  gst_omx_port_wake_waiters (port);
+}
+
+/* NOTE: comp->messages_lock will be used */
+static void
+gst_omx_component_flush_messages (GstOMXComponent * comp)
+{
+  GstOMXMessage *msg;
+
+  while ((msg = gst_omx_component_pop_message (comp))) {
+    gst_omx_component_free_message (comp, msg);
+  }
+}
+
+/* NOTE: Call with comp->lock, comp->messages_lock will be used */
+static void
+gst_omx_component_handle_messages (GstOMXComponent * comp)
+{
+  GstOMXMessage *msg;
+  gint i, n;
+
+  /* Everything that happened to the ports until now is seen
+   * by the caller after this */
+  n = (comp->ports ? comp->ports->len : 0);
+  for (i = 0; i < n; i++) {
+    GstOMXPort *port = g_ptr_array_index (comp->ports, i);
+
+    port->handled_seq = g_atomic_int_get (&port->messages_seq);
+  }
+
+  if (G_UNLIKELY (comp->flight_signal_seq !=
+          g_atomic_int_get (&flight_signal_seq))) {
+    comp->flight_signal_seq = g_atomic_int_get (&flight_signal_seq);
+    gst_omx_component_queue_flight_dump (comp, "signal");
+  }
+
+  while ((msg = gst_omx_component_pop_message (comp))) {
+    switch (msg->type) {
+      case GST_OMX_MESSAGE_STATE_SET:{
+        GST_INFO_OBJECT (comp->parent, "%s state change to %s finished",
+            comp->name, gst_omx_state_to_string (msg->content.state_set.state));
+        comp->state = msg->content.state_set.state;
+        if (comp->state == comp->pending_state)
+          comp->pending_state = OMX_StateInvalid;
+        if (comp->state_notify_func)
+          comp->state_notify_func (comp, comp->state, comp->state_notify_data);
+        break;
+      }
+      case GST_OMX_MESSAGE_FLUSH:{
+        GstOMXPort *port = NULL;
+        OMX_U32 index = msg->content.flush.port;
+
+        port = gst_omx_component_get_port (comp, index);
+        if (!port)
+          break;
+
+        GST_DEBUG_OBJECT (comp->parent, "%s port %u flushed", comp->name,
+            port->index);
+
+        if (port->flushing) {
+          port->flushed = TRUE;
+        } else {
+          GST_ERROR_OBJECT (comp->parent, "%s port %u was not flushing",
+              comp->name, port->index);
+        }
+
+        break;
+      }
+      case GST_OMX_MESSAGE_ERROR:{
+        OMX_ERRORTYPE error = msg->content.error.error;
+
+        if (error == OMX_ErrorNone)
+          break;
+
+        GST_ERROR_OBJECT (comp->parent, "%s got error: %s (0x%08x)", comp->name,
+            gst_omx_error_to_string (error), error);
+
+        /* We only set the first error ever from which
+         * we can't recover anymore.
+         */
+        if (comp->last_error == OMX_ErrorNone) {
+          g_atomic_int_set (&comp->last_error, error);
+          gst_omx_component_queue_flight_dump (comp, "error");
+        }
+        if (comp->state_notify_func)
+          comp->state_notify_func (comp, OMX_StateInvalid,
+              comp->state_notify_data);
+        gst_omx_component_wake_waiters (comp);
+
+        break;
+      }
+      case GST_OMX_MESSAGE_PORT_ENABLE:{
+        GstOMXPort *port = NULL;
+        OMX_U32 index = msg->content.port_enable.port;
+        OMX_BOOL enable = msg->content.port_enable.enable;
+
+        port = gst_omx_component_get_port (comp, index);
+        if (!port)
+          break;
+
+        GST_DEBUG_OBJECT (comp->parent, "%s port %u %s", comp->name,
+            port->index, (enable ? "enabled" : "disabled"));
+
+        if (enable)
+          port->enabled_pending = FALSE;
+        else
+          port->disabled_pending = FALSE;
+        break;
+      }
+      case GST_OMX_MESSAGE_PORT_SETTINGS_CHANGED:{
+        gint i, n;
+        OMX_U32 index = msg->content.port_settings_changed.port;
+        GList *outports = NULL, *l, *k;
+
+        GST_DEBUG_OBJECT (comp->parent, "%s settings changed (port %u)",
+            comp->name, (guint) index);
+
+        /* FIXME: This probably can be done better */
+
+        /* Now update the ports' states */
+        n = (comp->ports ? comp->ports->len : 0);
+        for (i = 0; i < n; i++) {
+          GstOMXPort *port = g_ptr_array_index (comp->ports, i);
+
+          if (index == OMX_ALL || index == port->index) {
+            g_atomic_int_inc (&port->settings_cookie);
+            gst_omx_port_update_port_definition (port, NULL);
+            if (port->port_def.eDir == OMX_DirOutput && !port->tunneled)
+              outports = g_list_prepend (outports, port);
+          }
+        }
+
+        for (k = outports; k; k = k->next) {
+          gboolean found = FALSE;
+
+          for (l = comp->pending_reconfigure_outports; l; l = l->next) {
+            if (l->data == k->data) {
+              found = TRUE;
+              break;
+            }
+          }
+
+          if (!found)
+            g_atomic_pointer_set (&comp->pending_reconfigure_outports,
+                g_list_prepend (comp->pending_reconfigure_outports, k->data));
+        }
+
+        g_list_free (outports);
+
+        break;
+      }
+      case GST_OMX_MESSAGE_BUFFER_FLAG:{
+        GstOMXPort *port = NULL;
+        OMX_U32 index = msg->content.buffer_flag.port;
+        OMX_U32 flags = msg->content.buffer_flag.flags;
+
+        port = gst_omx_component_get_port (comp, index);
+        if (!port)
+          break;
+
+        GST_DEBUG_OBJECT (comp->parent, "%s port %u got buffer flags 0x%08x",
+            comp->name, port->index, (guint) flags);
+        if ((flags & OMX_BUFFERFLAG_EOS)
+            && port->port_def.eDir == OMX_DirOutput)
+          g_atomic_int_set (&port->eos, TRUE);
+
+        break;
+      }
+      default:{
+        g_assert_not_reached ();
+        break;
+      }
+    }
+
+    gst_omx_component_free_message (comp, msg);
+  }
+}
+
+/* NOTE: Never blocks, comp->messages_lock will only be used
+ * if the ring is full or somebody is waiting
+ *
+ * If port is NULL everybody is woken up, otherwise only
+ * the waiters of this port */
+static void
+gst_omx_component_send_message (GstOMXComponent * comp, GstOMXPort * port,
+    GstOMXMessage * msg)
+{
+  if (msg) {
+    /* Once a message is headed for the overflow queue all following
+     * ones have to go there too until it is drained, to keep the
+     * order. The counter is raised before the message is queued so
+     * that other producers switch over right away, and only lowered
+     * by the consumer for every message it took out of the queue */
+    if (g_atomic_int_get (&comp->n_messages_overflow) > 0
+        || !gst_omx_ring_push (&comp->messages, msg)) {
+      g_atomic_int_inc (&comp->n_messages_overflow);
+      GST_OMX_COMPONENT_MESSAGES_LOCK (comp);
+      g_queue_push_tail (&comp->messages_overflow, msg);
+      GST_OMX_COMPONENT_MESSAGES_UNLOCK (comp);
+    }
+  }
+
+  if (port)
+    gst_omx_port_wake_waiters (port);
+  else
+    gst_omx_component_wake_waiters (comp);
+}
+
+static OMX_ERRORTYPE
+EventHandler (OMX_HANDLETYPE hComponent, OMX_PTR pAppData, OMX_EVENTTYPE eEvent,
+    OMX_U32 nData1, OMX_U32 nData2, OMX_PTR pEventData)
+{
+  GstOMXComponent *comp = (GstOMXComponent *) pAppData;
+
+  gst_omx_component_record (comp, GST_OMX_FLIGHT_EVENT_CALLBACK, NULL, eEvent,
+      nData1, nData2);
+
+  switch (eEvent) {
+    case OMX_EventCmdComplete:
+    {
+      OMX_COMMANDTYPE cmd = (OMX_COMMANDTYPE) nData1;
+
+      GST_DEBUG_OBJECT (comp->parent, "%s %s command complete (%d)",
+          comp->name, gst_omx_command_to_string (cmd), cmd);
+
+      switch (cmd) {
+        case OMX_CommandStateSet:{
+          GstOMXMessage *msg = gst_omx_component_alloc_message (comp);
+
+          msg->type = GST_OMX_MESSAGE_STATE_SET;
+          msg->content.state_set.state = nData2;
+
+          GST_DEBUG_OBJECT (comp->parent, "%s state change to %s finished",
+              comp->name,
+              gst_omx_state_to_string (msg->content.state_set.state));
+
+          gst_omx_component_send_message (comp, NULL, msg);
+          break;
+        }
+        case OMX_CommandFlush:{
+          GstOMXMessage *msg = gst_omx_component_alloc_message (comp);
+
+          msg->type = GST_OMX_MESSAGE_FLUSH;
+          msg->content.flush.port = nData2;
+          GST_DEBUG_OBJECT (comp->parent, "%s port %u flushed", comp->name,
+              (guint) msg->content.flush.port);
+
+          gst_omx_component_send_message (comp,
+              gst_omx_component_get_port (comp, nData2), msg);
+          break;
+        }
         case OMX_CommandPortEnable:
         case OMX_CommandPortDisable:{
-          GstOMXMessage *msg = g_slice_new (GstOMXMessage);
+          GstOMXMessage *msg = gst_omx_component_alloc_message (comp);
+
+          msg->type = GST_OMX_MESSAGE_PORT_ENABLE;
+          msg->content.port_enable.port = nData2;
+          msg->content.port_enable.enable = (cmd == OMX_CommandPortEnable);
+          GST_DEBUG_OBJECT (comp->parent, "%s port %u %s", comp->name,
+              (guint) msg->content.port_enable.port,
+              (msg->content.port_enable.enable ? "enabled" : "disabled"));
+
+          gst_omx_component_send_message (comp,
+              gst_omx_component_get_port (comp, nData2), msg);
+          break;
+        }
+        default:
+          break;
+      }
+      break;
+    }
+    case OMX_EventError:
+    {
+      GstOMXMessage *msg;
+
+      /* Yes, this really happens... */
+      if (nData1 == OMX_ErrorNone)
+        break;
+
+      msg = gst_omx_component_alloc_message (comp);
+
+      msg->type = GST_OMX_MESSAGE_ERROR;
+      msg->content.error.error = nData1;
+      GST_ERROR_OBJECT (comp->parent, "%s got error: %s (0x%08x)", comp->name,
+          gst_omx_error_to_string (msg->content.error.error),
+          msg->content.error.error);
+
+      gst_omx_component_send_message (comp, NULL, msg);
+      break;
+    }
+    case OMX_EventPortSettingsChanged:
+    {
+      GstOMXMessage *msg = gst_omx_component_alloc_message (comp);
+      OMX_U32 index;
+
+      if (!(comp->hacks &
+              GST_OMX_HACK_EVENT_PORT_SETTINGS_CHANGED_NDATA_PARAMETER_SWAP)) {
+        index = nData1;
+      } else {
+        index = nData2;
+      }
+
+
+      if (index == 0
+          && (comp->hacks &
+              GST_OMX_HACK_EVENT_PORT_SETTINGS_CHANGED_PORT_0_TO_1))
+        index = 1;
+
+
+      msg->type = GST_OMX_MESSAGE_PORT_SETTINGS_CHANGED;
+      msg->content.port_settings_changed.port = index;
+      GST_DEBUG_OBJECT (comp->parent, "%s settings changed (port index: %u)",
+          comp->name, (guint) msg->content.port_settings_changed.port);
+
+      gst_omx_component_send_message (comp, NULL, msg);
+      break;
+    }
+    case OMX_EventBufferFlag:{
+      GstOMXMessage *msg;
+
+      msg = gst_omx_component_alloc_message (comp);
+
+      msg->type = GST_OMX_MESSAGE_BUFFER_FLAG;
+      msg->content.buffer_flag.port = nData1;
+      msg->content.buffer_flag.flags = nData2;
+      GST_DEBUG_OBJECT (comp->parent, "%s port %u got buffer flags 0x%08x",
+          comp->name, (guint) msg->content.buffer_flag.port,
+          (guint) msg->content.buffer_flag.flags);
+
+      gst_omx_component_send_message (comp,
+          gst_omx_component_get_port (comp, nData1), msg);
+      break;
+    }
+    case OMX_EventPortFormatDetected:
+    default:
+      GST_DEBUG_OBJECT (comp->parent, "%s unknown event 0x%08x", comp->name,
+          eEvent);
+      break;
+  }
+
+  return OMX_ErrorNone;
+}
+
+static OMX_ERRORTYPE
+EmptyBufferDone (OMX_HANDLETYPE hComponent, OMX_PTR pAppData,
+    OMX_BUFFERHEADERTYPE * pBuffer)
+{
+  GstOMXBuffer *buf;
+  GstOMXComponent *comp;
+
+  buf = pBuffer->pAppPrivate;
+  if (!buf) {
+    GST_ERROR ("Have unknown or deallocated buffer %p", pBuffer);
+    return OMX_ErrorNone;
+  }
+
+  g_assert (buf->omx_buf == pBuffer);
+
+  if (buf->port->tunneled) {
+    GST_ERROR ("EmptyBufferDone on tunneled port");
+    return OMX_ErrorBadParameter;
+  }
+
+  comp = buf->port->comp;
+
+  gst_omx_component_record (comp, GST_OMX_FLIGHT_EVENT_EMPTY_BUFFER_DONE,
+      pBuffer, buf->port->index, pBuffer->nFlags, pBuffer->nFilledLen);
+
+  /* Input buffer is empty again and can be used to contain new input */
+  GST_LOG_OBJECT (comp->parent, "%s port %u emptied buffer %p (%p)",
+      comp->name, buf->port->index, buf, buf->omx_buf->pBuffer);
+
+  /* Reset offset and filled length */
+  buf->omx_buf->nOffset = 0;
+  buf->omx_buf->nFilledLen = 0;
+
+  /* Reset all flags, some implementations don't
+   * reset them themselves and the flags are not
+   * valid anymore after the buffer was consumed
+   */
+  buf->omx_buf->nFlags = 0;
+
+  gst_omx_port_buffer_done (buf->port, buf);
+
+  return OMX_ErrorNone;
+}
+
+static OMX_ERRORTYPE
+FillBufferDone (OMX_HANDLETYPE hComponent, OMX_PTR pAppData,
+    OMX_BUFFERHEADERTYPE * pBuffer)
+{
+  GstOMXBuffer *buf;
+  GstOMXComponent *comp;
+
+  buf = pBuffer->pAppPrivate;
+  if (!buf) {
+    GST_ERROR ("Have unknown or deallocated buffer %p", pBuffer);
+    return OMX_ErrorNone;
+  }
+
+  g_assert (buf->omx_buf == pBuffer);
+
+  if (buf->port->tunneled) {
+    GST_ERROR ("FillBufferDone on tunneled port");
+    return OMX_ErrorBadParameter;
+  }
+
+  comp = buf->port->comp;
+
+  gst_omx_component_record (comp, GST_OMX_FLIGHT_EVENT_FILL_BUFFER_DONE,
+      pBuffer, buf->port->index, pBuffer->nFlags, pBuffer->nFilledLen);
+
+  /* Output buffer contains output now or the port was flushed.
+   * EOS is noticed when the buffer is acquired */
+  GST_LOG_OBJECT (comp->parent, "%s port %u filled buffer %p (%p)", comp->name,
+      buf->port->index, buf, buf->omx_buf->pBuffer);
+
+  gst_omx_port_buffer_done (buf->port, buf);
+
+  return OMX_ErrorNone;
+}
+
+static OMX_CALLBACKTYPE callbacks =
+    { EventHandler, EmptyBufferDone, FillBufferDone };
+
+static gchar *
+gst_omx_lock_stats_hist_to_string (const guint64 * hist)
+{
+  GString *str = g_string_new (NULL);
+  gint i;
+
+  for (i = 0; i < GST_OMX_LOCK_STATS_N_BUCKETS; i++)
+    g_string_append_printf (str, "%s%" G_GUINT64_FORMAT, (i > 0 ? "," : ""),
+        hist[i]);
+
+  return g_string_free (str, FALSE);
+}
+
+/* NOTE: stats must be a snapshot or the component must not be
+ * used by any other thread anymore */
+static void
+gst_omx_component_log_lock_stats (GstOMXComponent * comp,
+    const gchar * lock_name, const GstOMXLockStats * stats)
+{
+  gchar *wait_hist, *hold_hist;
+
+  wait_hist = gst_omx_lock_stats_hist_to_string (stats->wait_hist);
+  hold_hist = gst_omx_lock_stats_hist_to_string (stats->hold_hist);
+  GST_INFO_OBJECT (comp->parent, "%s %s: %" G_GUINT64_FORMAT
+      " acquisitions, %" G_GUINT64_FORMAT " contended, waited %"
+      GST_TIME_FORMAT " (max %" GST_TIME_FORMAT "), held %" GST_TIME_FORMAT
+      " (max %" GST_TIME_FORMAT "), wait histogram %s, hold histogram %s",
+      comp->name, lock_name, stats->acquisitions, stats->contended,
+      GST_TIME_ARGS (stats->wait_total), GST_TIME_ARGS (stats->wait_max),
+      GST_TIME_ARGS (stats->hold_total), GST_TIME_ARGS (stats->hold_max),
+      wait_hist, hold_hist);
+  g_free (wait_hist);
+  g_free (hold_hist);
+
+#if GST_CHECK_VERSION(1,8,0)
+  gst_tracer_record_log (lock_stats_record,
+      comp->parent ? GST_OBJECT_NAME (comp->parent) : "(pooled)",
+      lock_name, stats->acquisitions, stats->contended, stats->wait_total,
+      stats->wait_max, stats->hold_total, stats->hold_max);
+#endif
+}
+
+static void
+gst_omx_lock_stats_set_uint64 (GstStructure * s, const gchar * prefix,
+    const gchar * name, guint64 value)
+{
+  gchar *field = g_strdup_printf ("%s-%s", prefix, name);
+
+  gst_structure_set (s, field, G_TYPE_UINT64, value, NULL);
+  g_free (field);
+}
+
+static void
+gst_omx_lock_stats_set_hist (GstStructure * s, const gchar * prefix,
+    const gchar * name, const guint64 * hist)
+{
+  GValue arr = G_VALUE_INIT;
+  GValue v = G_VALUE_INIT;
+  gchar *field;
+  gint i;
+
+  g_value_init (&arr, GST_TYPE_ARRAY);
+  g_value_init (&v, G_TYPE_UINT64);
+  for (i = 0; i < GST_OMX_LOCK_STATS_N_BUCKETS; i++) {
+    g_value_set_uint64 (&v, hist[i]);
+    gst_value_array_append_value (&arr, &v);
+  }
+  g_value_unset (&v);
+
+  field = g_strdup_printf ("%s-%s", prefix, name);
+  gst_structure_take_value (s, field, &arr);
+  g_free (field);
+}
+
+static void
+gst_omx_lock_stats_to_structure (const GstOMXLockStats * stats,
+    GstStructure * s, const gchar * prefix)
+{
+  gst_omx_lock_stats_set_uint64 (s, prefix, "acquisitions",
+      stats->acquisitions);
+  gst_omx_lock_stats_set_uint64 (s, prefix, "contended", stats->contended);
+  gst_omx_lock_stats_set_uint64 (s, prefix, "wait-total", stats->wait_total);
+  gst_omx_lock_stats_set_uint64 (s, prefix, "wait-max", stats->wait_max);
+  gst_omx_lock_stats_set_hist (s, prefix, "wait-histogram", stats->wait_hist);
+  gst_omx_lock_stats_set_uint64 (s, prefix, "hold-total", stats->hold_total);
+  gst_omx_lock_stats_set_uint64 (s, prefix, "hold-max", stats->hold_max);
+  gst_omx_lock_stats_set_hist (s, prefix, "hold-histogram", stats->hold_hist);
+}
+
+/* Budget of the instances and macroblocks per second of all components
+ * of the same core and name. Waiters are queued by priority and then
+ * by arrival and only the first one in the queue is admitted, so that
+ * small requests can't starve larger ones. Everything is protected by
+ * admission_lock, budgets are never freed */
+struct _GstOMXAdmissionBudget
+{
+  gint max_instances;           /* 0 for no limit */
+  gint64 max_load;              /* 0 for no limit */
+
+  gint instances;
+  gint64 load;
+
+  GList *waiters;               /* GstOMXAdmissionWaiter */
+};
+
+typedef struct
+{
+  gint priority;
+  guint64 seq;
+} GstOMXAdmissionWaiter;
+
+static GMutex admission_lock;
+static GCond admission_cond;
+static GHashTable *admission_budgets = NULL;
+static guint64 admission_seq = 0;
+
+/* Maximum time in ms to wait for the admission of a changed load,
+ * the caller holds the stream lock */
+#define GST_OMX_ADMISSION_MAX_LOAD_TIMEOUT (1000)
+
+static gboolean gst_omx_component_pool_evict (GstOMXAdmissionBudget * budget);
+
+/* Returns NULL if neither the instances nor the load are limited */
+static GstOMXAdmissionBudget *
+gst_omx_admission_budget_get (const gchar * core_name,
+    const gchar * component_name)
+{
+  GstOMXAdmissionBudget *budget;
+  gint max_instances, max_load;
+  gchar *key;
+
+  max_instances =
+      gst_omx_config_get_max_integer (core_name, component_name,
+      "max-instances");
+  max_load =
+      gst_omx_config_get_max_integer (core_name, component_name,
+      "max-macroblocks-per-second");
+  if (max_instances <= 0 && max_load <= 0)
+    return NULL;
+
+  key = g_strdup_printf ("%s:%s", core_name, component_name);
+
+  g_mutex_lock (&admission_lock);
+  if (!admission_budgets)
+    admission_budgets =
+        g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  budget = g_hash_table_lookup (admission_budgets, key);
+  if (!budget) {
+    budget = g_slice_new0 (GstOMXAdmissionBudget);
+    budget->max_instances = MAX (max_instances, 0);
+    budget->max_load = MAX (max_load, 0);
+    g_hash_table_insert (admission_budgets, key, budget);
+  } else {
+    g_free (key);
+  }
+  g_mutex_unlock (&admission_lock);
+
+  return budget;
+}
+
+/* Priority and timeout from the configuration of the parent's element */
+static void
+gst_omx_admission_get_settings (GstObject * parent, gint * priority,
+    gint * timeout)
+{
+  GKeyFile *config = gst_omx_get_configuration ();
+  GstElementFactory *factory = NULL;
+  const gchar *element_name;
+
+  *priority = 0;
+  *timeout = 0;
+
+  if (GST_IS_ELEMENT (parent))
+    factory = gst_element_get_factory (GST_ELEMENT_CAST (parent));
+  if (!config || !factory)
+    return;
+
+  element_name = gst_plugin_feature_get_name (GST_PLUGIN_FEATURE (factory));
+  *priority =
+      g_key_file_get_integer (config, element_name, "admission-priority",
+      NULL);
+  *timeout =
+      g_key_file_get_integer (config, element_name, "admission-timeout", NULL);
+}
+
+static gint
+gst_omx_admission_waiter_compare (gconstpointer a, gconstpointer b)
+{
+  const GstOMXAdmissionWaiter *wa = a, *wb = b;
+
+  if (wa->priority != wb->priority)
+    return wa->priority > wb->priority ? -1 : 1;
+  return wa->seq < wb->seq ? -1 : 1;
+}
+
+/* NOTE: Must be called with admission_lock */
+static gboolean
+gst_omx_admission_fits (GstOMXAdmissionBudget * budget, gint instances,
+    gint64 load)
+{
+  return (budget->max_instances == 0
+      || budget->instances + instances <= budget->max_instances)
+      && (budget->max_load == 0 || budget->load + load <= budget->max_load);
+}
+
+/* NOTE: Must be called with admission_lock, releases it meanwhile
+ *
+ * Idle pooled components keep their instance. Frees one of them if
+ * the instances don't fit, returns TRUE if it did */
+static gboolean
+gst_omx_admission_evict_pooled (GstOMXAdmissionBudget * budget,
+    gint instances)
+{
+  gboolean evicted;
+
+  if (instances == 0 || budget->max_instances == 0
+      || budget->instances + instances <= budget->max_instances)
+    return FALSE;
+
+  g_mutex_unlock (&admission_lock);
+  evicted = gst_omx_component_pool_evict (budget);
+  g_mutex_lock (&admission_lock);
+
+  return evicted;
+}
+
+/* NOTE: Uses admission_lock
+ *
+ * Reserves instances and load of the budget, waits up to timeout ms
+ * for them if they are not available. Returns FALSE if rejected */
+static gboolean
+gst_omx_admission_acquire (GstObject * parent, GstOMXAdmissionBudget * budget,
+    gint priority, gint timeout, gint instances, gint64 load)
+{
+  GstOMXAdmissionWaiter waiter;
+  gboolean admitted, timed_out = FALSE;
+  gint64 deadline;
+
+  g_mutex_lock (&admission_lock);
+  while (!budget->waiters && !gst_omx_admission_fits (budget, instances, load)
+      && gst_omx_admission_evict_pooled (budget, instances));
+  if (!budget->waiters && gst_omx_admission_fits (budget, instances, load)) {
+    admitted = TRUE;
+    goto done;
+  }
+
+  /* Requests larger than the whole budget can never be admitted */
+  if (timeout == 0
+      || (budget->max_instances != 0 && instances > budget->max_instances)
+      || (budget->max_load != 0 && load > budget->max_load)) {
+    admitted = FALSE;
+    goto done;
+  }
+
+  GST_INFO_OBJECT (parent, "Waiting for admission with priority %d, "
+      "%d of %d instances and %" G_GINT64_FORMAT " of %" G_GINT64_FORMAT
+      " macroblocks per second in use", priority, budget->instances,
+      budget->max_instances, budget->load, budget->max_load);
+
+  waiter.priority = priority;
+  waiter.seq = admission_seq++;
+  budget->waiters =
+      g_list_insert_sorted (budget->waiters, &waiter,
+      gst_omx_admission_waiter_compare);
+
+  deadline = timeout < 0 ? -1 :
+      g_get_monotonic_time () + timeout * G_TIME_SPAN_MILLISECOND;
+  while (TRUE) {
+    admitted = budget->waiters->data == &waiter
+        && gst_omx_admission_fits (budget, instances, load);
+    if (admitted || timed_out)
+      break;
+
+    if (budget->waiters->data == &waiter
+        && gst_omx_admission_evict_pooled (budget, instances))
+      continue;
+
+    if (deadline == -1)
+      g_cond_wait (&admission_cond, &admission_lock);
+    else
+      timed_out =
+          !g_cond_wait_until (&admission_cond, &admission_lock, deadline);
+  }
+
+  budget->waiters = g_list_remove (budget->waiters, &waiter);
+  /* Another waiter is first in the queue now */
+  g_cond_broadcast (&admission_cond);
+
+done:
+  if (admitted) {
+    budget->instances += instances;
+    budget->load += load;
+  } else {
+    GST_WARNING_OBJECT (parent, "Admission rejected, %d of %d instances and %"
+        G_GINT64_FORMAT " of %" G_GINT64_FORMAT " macroblocks per second "
+        "in use, %" G_GINT64_FORMAT " requested", budget->instances,
+        budget->max_instances, budget->load, budget->max_load, load);
+  }
+  g_mutex_unlock (&admission_lock);
+
+  return admitted;
+}
+
+/* NOTE: Uses admission_lock */
+static void
+gst_omx_admission_release (GstOMXAdmissionBudget * budget, gint instances,
+    gint64 load)
+{
+  g_mutex_lock (&admission_lock);
+  budget->instances -= instances;
+  budget->load -= load;
+  g_cond_broadcast (&admission_cond);
+  g_mutex_unlock (&admission_lock);
+}
+
+/* Time in ms idle components stay in the pool if
+ * "pool-idle-timeout" is not set */
+#define GST_OMX_POOL_DEFAULT_IDLE_TIMEOUT (10000)
+
+/* Key -> GQueue of idle GstOMXComponents in Loaded state, protected
+ * by pool_lock. pool_thread frees them once their deadline passed
+ * and only runs while any of them has a deadline */
+static GMutex pool_lock;
+static GCond pool_cond;
+static GThread *pool_thread = NULL;
+static GHashTable *component_pool = NULL;
+
+static void gst_omx_component_unload (GstOMXComponent * comp);
+
+/* Original value of a parameter or configuration */
+typedef struct
+{
+  OMX_INDEXTYPE index;
+  OMX_U32 port;
+  gboolean config;
+  gpointer data;                /* nSize bytes */
+} GstOMXSavedSetting;
+
+static void
+gst_omx_saved_setting_free (gpointer data)
+{
+  GstOMXSavedSetting *saved = data;
+
+  g_free (saved->data);
+  g_slice_free (GstOMXSavedSetting, saved);
+}
+
+/* NOTE: Must be called with comp->lock */
+static gboolean
+gst_omx_component_has_saved_setting (GstOMXComponent * comp,
+    OMX_INDEXTYPE index, OMX_U32 port, gboolean config)
+{
+  GList *l;
+
+  for (l = comp->pool_saved_settings; l; l = l->next) {
+    GstOMXSavedSetting *saved = l->data;
+
+    if (saved->index == index && saved->port == port
+        && saved->config == config)
+      return TRUE;
+  }
+
+  return FALSE;
+}
+
+/* NOTE: Uses comp->lock, must be called without it
+ *
+ * Saves the current value of a parameter or configuration of a pooled
+ * component before it is changed the first time, so that the next
+ * element gets the component with the settings it had when loaded */
+static void
+gst_omx_component_save_setting (GstOMXComponent * comp, OMX_INDEXTYPE index,
+    gpointer param, gboolean config)
+{
+  GstOMXSavedSetting *saved;
+  OMX_U32 size = *(OMX_U32 *) param;
+  OMX_U32 port;
+  OMX_ERRORTYPE err;
+  gboolean found;
+
+  /* nSize, nVersion and nPortIndex for the structures of a port.
+   * For all others it's part of the value, that's only a bit more
+   * than necessary */
+  port = size >= 3 * sizeof (OMX_U32) ? ((OMX_U32 *) param)[2] : 0;
+
+  GST_OMX_COMPONENT_LOCK (comp);
+  found = gst_omx_component_has_saved_setting (comp, index, port, config);
+  GST_OMX_COMPONENT_UNLOCK (comp);
+  if (found)
+    return;
+
+  saved = g_slice_new (GstOMXSavedSetting);
+  saved->index = index;
+  saved->port = port;
+  saved->config = config;
+  saved->data = g_malloc (size);
+  memcpy (saved->data, param, size);
+  if (config)
+    err = OMX_GetConfig (comp->handle, index, saved->data);
+  else
+    err = OMX_GetParameter (comp->handle, index, saved->data);
+
+  GST_OMX_COMPONENT_LOCK (comp);
+  if (err != OMX_ErrorNone) {
+    GST_DEBUG_OBJECT (comp->parent, "Can't save %s value at index 0x%08x, "
+        "not pooling it: %s (0x%08x)", comp->name, index,
+        gst_omx_error_to_string (err), err);
+    comp->pool_unrestorable = TRUE;
+    gst_omx_saved_setting_free (saved);
+  } else if (gst_omx_component_has_saved_setting (comp, index, port, config)) {
+    gst_omx_saved_setting_free (saved);
+  } else {
+    /* Newest first, they're restored in reverse order */
+    comp->pool_saved_settings =
+        g_list_prepend (comp->pool_saved_settings, saved);
+  }
+  GST_OMX_COMPONENT_UNLOCK (comp);
+}
+
+/* NOTE: Uses comp->lock, must be called without it
+ *
+ * Restores and forgets the saved settings. Returns FALSE if the
+ * component could not be brought back to its original settings */
+static gboolean
+gst_omx_component_restore_settings (GstOMXComponent * comp)
+{
+  GList *saved_settings, *l;
+  gboolean ret;
+
+  GST_OMX_COMPONENT_LOCK (comp);
+  saved_settings = comp->pool_saved_settings;
+  comp->pool_saved_settings = NULL;
+  ret = !comp->pool_unrestorable;
+  comp->pool_unrestorable = FALSE;
+  GST_OMX_COMPONENT_UNLOCK (comp);
+
+  for (l = saved_settings; l && ret; l = l->next) {
+    GstOMXSavedSetting *saved = l->data;
+    OMX_ERRORTYPE err;
+
+    if (saved->config)
+      err = OMX_SetConfig (comp->handle, saved->index, saved->data);
+    else
+      err = OMX_SetParameter (comp->handle, saved->index, saved->data);
+
+    if (err != OMX_ErrorNone) {
+      GST_DEBUG_OBJECT (comp->parent, "Failed to restore %s value at index "
+          "0x%08x: %s (0x%08x)", comp->name, saved->index,
+          gst_omx_error_to_string (err), err);
+      ret = FALSE;
+    }
+  }
+  g_list_free_full (saved_settings, gst_omx_saved_setting_free);
 
-          msg->type = GST_OMX_MESSAGE_PORT_ENABLE;
-          msg->content.port_enable.port = nData2;
-          msg->content.port_enable.enable = (cmd == OMX_CommandPortEnable);
-          GST_DEBUG_OBJECT (comp->parent, "%s port %u %s", comp->name,
-              (guint) msg->content.port_enable.port,
-              (msg->content.port_enable.enable ? "enabled" : "disabled"));
+  return ret;
+}
 
-          gst_omx_component_send_message (comp, msg);
-          break;
+/* Frees pooled components once their deadline passed */
+static gpointer
+gst_omx_component_pool_func (gpointer data)
+{
+  g_mutex_lock (&pool_lock);
+  while (TRUE) {
+    GHashTableIter iter;
+    gpointer value;
+    GList *expired = NULL, *l;
+    gint64 now = g_get_monotonic_time (), next = -1;
+
+    g_hash_table_iter_init (&iter, component_pool);
+    while (g_hash_table_iter_next (&iter, NULL, &value)) {
+      GQueue *queue = value;
+      GList *link = queue->head;
+
+      while (link) {
+        GstOMXComponent *comp = link->data;
+        GList *next_link = link->next;
+
+        if (comp->pool_deadline == -1) {
+          /* Stays */
+        } else if (comp->pool_deadline <= now) {
+          g_queue_delete_link (queue, link);
+          expired = g_list_prepend (expired, comp);
+        } else if (next == -1 || comp->pool_deadline < next) {
+          next = comp->pool_deadline;
         }
-        default:
-          break;
+        link = next_link;
       }
-      break;
     }
-    case OMX_EventError:
-    {
-      GstOMXMessage *msg;
 
-      /* Yes, this really happens... */
-      if (nData1 == OMX_ErrorNone)
-        break;
+    if (expired) {
+      g_mutex_unlock (&pool_lock);
+      for (l = expired; l; l = l->next)
+        gst_omx_component_unload (l->data);
+      g_list_free (expired);
+      g_mutex_lock (&pool_lock);
+      continue;
+    }
 
-      msg = g_slice_new (GstOMXMessage);
+    if (next == -1)
+      break;
+    g_cond_wait_until (&pool_cond, &pool_lock, next);
+  }
+  g_thread_unref (pool_thread);
+  pool_thread = NULL;
+  g_mutex_unlock (&pool_lock);
 
-      msg->type = GST_OMX_MESSAGE_ERROR;
-      msg->content.error.error = nData1;
-      GST_ERROR_OBJECT (comp->parent, "%s got error: %s (0x%08x)", comp->name,
-          gst_omx_error_to_string (msg->content.error.error),
-          msg->content.error.error);
+  return NULL;
+}
 
-      gst_omx_component_send_message (comp, msg);
-      break;
-    }
-    case OMX_EventPortSettingsChanged:
-    {
-      GstOMXMessage *msg = g_slice_new (GstOMXMessage);
-      OMX_U32 index;
+/* NOTE: Must be called with pool_lock
+ *
+ * Makes pool_thread notice changed deadlines */
+static void
+gst_omx_component_pool_wake (void)
+{
+  if (pool_thread)
+    g_cond_signal (&pool_cond);
+  else
+    pool_thread =
+        g_thread_new ("omxcomponentpool", gst_omx_component_pool_func, NULL);
+}
 
-      if (!(comp->hacks &
-              GST_OMX_HACK_EVENT_PORT_SETTINGS_CHANGED_NDATA_PARAMETER_SWAP)) {
-        index = nData1;
-      } else {
-        index = nData2;
+/* NOTE: Uses pool_lock
+ *
+ * Frees one idle pooled component that counts against the budget.
+ * Returns FALSE if there is none */
+static gboolean
+gst_omx_component_pool_evict (GstOMXAdmissionBudget * budget)
+{
+  GHashTableIter iter;
+  gpointer value;
+  GstOMXComponent *comp = NULL;
+
+  g_mutex_lock (&pool_lock);
+  if (component_pool) {
+    g_hash_table_iter_init (&iter, component_pool);
+    while (!comp && g_hash_table_iter_next (&iter, NULL, &value)) {
+      GQueue *queue = value;
+      GList *l;
+
+      for (l = queue->head; l; l = l->next) {
+        if (((GstOMXComponent *) l->data)->budget == budget) {
+          comp = l->data;
+          g_queue_delete_link (queue, l);
+          break;
+        }
       }
+    }
+  }
+  g_mutex_unlock (&pool_lock);
 
+  if (!comp)
+    return FALSE;
 
-      if (index == 0
-          && (comp->hacks &
-              GST_OMX_HACK_EVENT_PORT_SETTINGS_CHANGED_PORT_0_TO_1))
-        index = 1;
+  GST_DEBUG ("Evicting pooled component %p %s for admission", comp,
+      comp->name);
+  gst_omx_component_unload (comp);
 
+  return TRUE;
+}
 
-      msg->type = GST_OMX_MESSAGE_PORT_SETTINGS_CHANGED;
-      msg->content.port_settings_changed.port = index;
-      GST_DEBUG_OBJECT (comp->parent, "%s settings changed (port index: %u)",
-          comp->name, (guint) msg->content.port_settings_changed.port);
+/* NOTE: Uses pool_lock and core->lock
+ *
+ * Pooled components don't count as users of their core. Once it has
+ * no other users they're freed after its linger time, so that the
+ * core can be deinitialized as configured */
+static void
+gst_omx_component_pool_check_core (GstOMXCore * core)
+{
+  GHashTableIter iter;
+  gpointer value;
+  GList *l;
+  gint n_pooled = 0;
+  gboolean unused;
+  gint linger;
+
+  g_mutex_lock (&pool_lock);
+  if (!component_pool) {
+    g_mutex_unlock (&pool_lock);
+    return;
+  }
 
-      gst_omx_component_send_message (comp, msg);
-      break;
+  g_hash_table_iter_init (&iter, component_pool);
+  while (g_hash_table_iter_next (&iter, NULL, &value)) {
+    for (l = ((GQueue *) value)->head; l; l = l->next) {
+      if (((GstOMXComponent *) l->data)->core == core)
+        n_pooled++;
     }
-    case OMX_EventBufferFlag:{
-      GstOMXMessage *msg;
+  }
 
-      msg = g_slice_new (GstOMXMessage);
+  g_mutex_lock (&core->lock);
+  unused = n_pooled > 0 && core->user_count == n_pooled;
+  linger = core->linger;
+  g_mutex_unlock (&core->lock);
 
-      msg->type = GST_OMX_MESSAGE_BUFFER_FLAG;
-      msg->content.buffer_flag.port = nData1;
-      msg->content.buffer_flag.flags = nData2;
-      GST_DEBUG_OBJECT (comp->parent, "%s port %u got buffer flags 0x%08x",
-          comp->name, (guint) msg->content.buffer_flag.port,
-          (guint) msg->content.buffer_flag.flags);
+  if (unused && linger >= 0) {
+    gint64 deadline =
+        g_get_monotonic_time () + (gint64) linger * G_TIME_SPAN_MILLISECOND;
 
-      gst_omx_component_send_message (comp, msg);
-      break;
+    GST_DEBUG ("Core %p only used by %d pooled components, freeing them in "
+        "%d ms", core, n_pooled, linger);
+    g_hash_table_iter_init (&iter, component_pool);
+    while (g_hash_table_iter_next (&iter, NULL, &value)) {
+      for (l = ((GQueue *) value)->head; l; l = l->next) {
+        GstOMXComponent *comp = l->data;
+
+        if (comp->core == core && (comp->pool_deadline == -1
+                || comp->pool_deadline > deadline))
+          comp->pool_deadline = deadline;
+      }
     }
-    case OMX_EventPortFormatDetected:
-    default:
-      GST_DEBUG_OBJECT (comp->parent, "%s unknown event 0x%08x", comp->name,
-          eEvent);
-      break;
+    gst_omx_component_pool_wake ();
   }
+  g_mutex_unlock (&pool_lock);
+}
 
-  return OMX_ErrorNone;
+static gchar *
+gst_omx_component_pool_key (const gchar * core_name,
+    const gchar * component_name, const gchar * component_role, guint64 hacks)
+{
+  return g_strdup_printf ("%s:%s:%s:%" G_GINT64_MODIFIER "x", core_name,
+      component_name, GST_STR_NULL (component_role), hacks);
 }
 
-static OMX_ERRORTYPE
-EmptyBufferDone (OMX_HANDLETYPE hComponent, OMX_PTR pAppData,
-    OMX_BUFFERHEADERTYPE * pBuffer)
+/* Returns an idle component of the key or NULL */
+static GstOMXComponent *
+gst_omx_component_pool_take (const gchar * key)
 {
-  GstOMXBuffer *buf;
-  GstOMXComponent *comp;
-  GstOMXMessage *msg;
+  GstOMXComponent *comp = NULL;
+  GQueue *queue;
 
-  buf = pBuffer->pAppPrivate;
-  if (!buf) {
-    GST_ERROR ("Have unknown or deallocated buffer %p", pBuffer);
-    return OMX_ErrorNone;
-  }
+  g_mutex_lock (&pool_lock);
+  if (component_pool && (queue = g_hash_table_lookup (component_pool, key)))
+    comp = g_queue_pop_head (queue);
+  g_mutex_unlock (&pool_lock);
 
-  g_assert (buf->omx_buf == pBuffer);
+  return comp;
+}
 
-  if (buf->port->tunneled) {
-    GST_ERROR ("EmptyBufferDone on tunneled port");
-    return OMX_ErrorBadParameter;
+/* Capabilities of the components that were queried once, as integer
+ * lists in a GKeyFile with one group per core, component, role and
+ * modification time of the core. Protected by the caps_cache lock.
+ * Changes are only written to the file when a component is freed,
+ * the caps_cache_file lock serializes the writes and is taken before
+ * the caps_cache lock */
+G_LOCK_DEFINE_STATIC (caps_cache);
+G_LOCK_DEFINE_STATIC (caps_cache_file);
+static GKeyFile *caps_cache = NULL;
+static gchar *caps_cache_filename = NULL;
+static gboolean caps_cache_dirty = FALSE;
+
+/* NOTE: Must be called with the caps_cache lock
+ *
+ * Returns FALSE if the cache is disabled */
+static gboolean
+gst_omx_caps_cache_load (void)
+{
+  static gboolean loaded = FALSE;
+  const gchar *env;
+  GError *err = NULL;
+
+  if (loaded)
+    return caps_cache != NULL;
+  loaded = TRUE;
+
+  env = g_getenv (GST_OMX_CAPS_CACHE_ENV);
+  if (env && *env == '\0')
+    return FALSE;
+  if (env)
+    caps_cache_filename = g_strdup (env);
+  else
+    caps_cache_filename =
+        g_build_filename (g_get_user_cache_dir (), "gstreamer-1.0",
+        "gst-omx-caps.cache", NULL);
+
+  caps_cache = g_key_file_new ();
+  if (!g_key_file_load_from_file (caps_cache, caps_cache_filename,
+          G_KEY_FILE_NONE, &err)) {
+    if (!g_error_matches (err, G_FILE_ERROR, G_FILE_ERROR_NOENT))
+      GST_WARNING ("Failed to load capability cache '%s': %s",
+          caps_cache_filename, err->message);
+    g_clear_error (&err);
   }
 
-  comp = buf->port->comp;
+  return TRUE;
+}
 
-  msg = g_slice_new (GstOMXMessage);
-  msg->type = GST_OMX_MESSAGE_BUFFER_DONE;
-  msg->content.buffer_done.component = hComponent;
-  msg->content.buffer_done.app_data = pAppData;
-  msg->content.buffer_done.buffer = pBuffer;
-  msg->content.buffer_done.empty = OMX_TRUE;
+/* NOTE: Uses the caps_cache_file and caps_cache locks
+ *
+ * Writes the cache file if anything was added since it was last
+ * written. The file is written without the caps_cache lock */
+static void
+gst_omx_caps_cache_save (void)
+{
+  GError *err = NULL;
+  gchar *dir, *data;
+  gsize length;
+
+  G_LOCK (caps_cache_file);
+  G_LOCK (caps_cache);
+  if (!caps_cache_dirty) {
+    G_UNLOCK (caps_cache);
+    G_UNLOCK (caps_cache_file);
+    return;
+  }
+  caps_cache_dirty = FALSE;
+  data = g_key_file_to_data (caps_cache, &length, NULL);
+  G_UNLOCK (caps_cache);
+
+  dir = g_path_get_dirname (caps_cache_filename);
+  g_mkdir_with_parents (dir, 0755);
+  g_free (dir);
+
+  if (!g_file_set_contents (caps_cache_filename, data, length, &err)) {
+    GST_WARNING ("Failed to save capability cache '%s': %s",
+        caps_cache_filename, err->message);
+    g_clear_error (&err);
+  }
+  g_free (data);
+  G_UNLOCK (caps_cache_file);
+}
 
-  GST_LOG_OBJECT (comp->parent, "%s port %u emptied buffer %p (%p)",
-      comp->name, buf->port->index, buf, buf->omx_buf->pBuffer);
+/* Returns the cache group of the component, NULL if the cache is
+ * disabled, globally or with caps-cache=false for any element using
+ * the component, or the core can't be found. Entries are invalidated
+ * by a different modification time of the core */
+static gchar *
+gst_omx_caps_cache_group (const gchar * core_name,
+    const gchar * component_name, const gchar * component_role)
+{
+  GStatBuf st;
+  gboolean enabled;
 
-  gst_omx_component_send_message (comp, msg);
+  G_LOCK (caps_cache);
+  enabled = gst_omx_caps_cache_load ();
+  G_UNLOCK (caps_cache);
 
-  return OMX_ErrorNone;
+  if (!enabled || g_stat (core_name, &st) != 0
+      || gst_omx_config_get_any_false (core_name, component_name,
+          "caps-cache"))
+    return NULL;
+
+  return g_strdup_printf ("%s %s %s %" G_GINT64_FORMAT, core_name,
+      component_name, GST_STR_NULL (component_role), (gint64) st.st_mtime);
 }
 
-static OMX_ERRORTYPE
-FillBufferDone (OMX_HANDLETYPE hComponent, OMX_PTR pAppData,
-    OMX_BUFFERHEADERTYPE * pBuffer)
+/* Returns a copy of the integers cached for the component under key
+ * or NULL if there are none. Free with g_free() */
+gint *
+gst_omx_component_get_cached_integers (GstOMXComponent * comp,
+    const gchar * key, gsize * length)
 {
-  GstOMXBuffer *buf;
-  GstOMXComponent *comp;
-  GstOMXMessage *msg;
+  gint *values = NULL;
 
-  buf = pBuffer->pAppPrivate;
-  if (!buf) {
-    GST_ERROR ("Have unknown or deallocated buffer %p", pBuffer);
-    return OMX_ErrorNone;
-  }
+  g_return_val_if_fail (comp != NULL, NULL);
+  g_return_val_if_fail (key != NULL, NULL);
+  g_return_val_if_fail (length != NULL, NULL);
 
-  g_assert (buf->omx_buf == pBuffer);
+  *length = 0;
+  if (!comp->cache_group)
+    return NULL;
 
-  if (buf->port->tunneled) {
-    GST_ERROR ("FillBufferDone on tunneled port");
-    return OMX_ErrorBadParameter;
-  }
+  G_LOCK (caps_cache);
+  if (g_key_file_has_key (caps_cache, comp->cache_group, key, NULL))
+    values =
+        g_key_file_get_integer_list (caps_cache, comp->cache_group, key,
+        length, NULL);
+  G_UNLOCK (caps_cache);
 
-  comp = buf->port->comp;
+  return values;
+}
 
-  msg = g_slice_new (GstOMXMessage);
-  msg->type = GST_OMX_MESSAGE_BUFFER_DONE;
-  msg->content.buffer_done.component = hComponent;
-  msg->content.buffer_done.app_data = pAppData;
-  msg->content.buffer_done.buffer = pBuffer;
-  msg->content.buffer_done.empty = OMX_FALSE;
+/* Stores the integers for the component under key, the cache file
+ * is written when the component is freed. Groups of older versions of
+ * the core are removed, empty lists are not stored as they can't be
+ * told apart from errors */
+void
+gst_omx_component_set_cached_integers (GstOMXComponent * comp,
+    const gchar * key, const gint * values, gsize length)
+{
+  gchar **groups, *prefix;
+  gsize i;
 
-  GST_LOG_OBJECT (comp->parent, "%s port %u filled buffer %p (%p)", comp->name,
-      buf->port->index, buf, buf->omx_buf->pBuffer);
+  g_return_if_fail (comp != NULL);
+  g_return_if_fail (key != NULL);
 
-  gst_omx_component_send_message (comp, msg);
+  if (!comp->cache_group || length == 0)
+    return;
 
-  return OMX_ErrorNone;
-}
+  /* Everything but the modification time */
+  prefix = g_strndup (comp->cache_group,
+      strrchr (comp->cache_group, ' ') - comp->cache_group + 1);
 
-static OMX_CALLBACKTYPE callbacks =
-    { EventHandler, EmptyBufferDone, FillBufferDone };
+  G_LOCK (caps_cache);
+  groups = g_key_file_get_groups (caps_cache, NULL);
+  for (i = 0; groups[i]; i++) {
+    if (g_str_has_prefix (groups[i], prefix)
+        && strcmp (groups[i], comp->cache_group) != 0)
+      g_key_file_remove_group (caps_cache, groups[i], NULL);
+  }
+  g_strfreev (groups);
 
-/* NOTE: Uses comp->lock and comp->messages_lock */
-GstOMXComponent *
-gst_omx_component_new (GstObject * parent, const gchar * core_name,
-    const gchar * component_name, const gchar * component_role, guint64 hacks)
+  g_key_file_set_integer_list (caps_cache, comp->cache_group, key,
+      (gint *) values, length);
+  caps_cache_dirty = TRUE;
+  G_UNLOCK (caps_cache);
+
+  g_free (prefix);
+}
+
+/* NOTE: Uses comp->lock and comp->messages_lock
+ *
+ * Managed components go through the pool and the admission budget */
+static GstOMXComponent *
+gst_omx_component_new_internal (GstObject * parent, const gchar * core_name,
+    const gchar * component_name, const gchar * component_role, guint64 hacks,
+    gboolean managed)
 {
   OMX_ERRORTYPE err;
   GstOMXCore *core;
   GstOMXComponent *comp;
   const gchar *dot;
+  GstOMXAdmissionBudget *budget;
+  gchar *pool_key;
+  gint priority, timeout;
+  guint size;
+  gint i;
+
+  gst_omx_admission_get_settings (parent, &priority, &timeout);
+
+  pool_key =
+      gst_omx_component_pool_key (core_name, component_name, component_role,
+      hacks);
+  if (managed && (comp = gst_omx_component_pool_take (pool_key))) {
+    g_free (pool_key);
+    GST_INFO_OBJECT (parent, "Reusing pooled component %p %s", comp,
+        comp->name);
+    comp->parent = gst_object_ref (parent);
+    comp->admission_priority = priority;
+    comp->admission_timeout = timeout;
+
+    GST_OMX_COMPONENT_LOCK (comp);
+    gst_omx_component_handle_messages (comp);
+    GST_OMX_COMPONENT_UNLOCK (comp);
+
+    return comp;
+  }
+
+  /* Pooled components already hold their instance */
+  budget =
+      managed ? gst_omx_admission_budget_get (core_name, component_name) : NULL;
+  if (budget
+      && !gst_omx_admission_acquire (parent, budget, priority, timeout, 1, 0)) {
+    g_free (pool_key);
+    return NULL;
+  }
 
   core = gst_omx_core_acquire (core_name);
-  if (!core)
+  if (!core) {
+    g_free (pool_key);
+    if (budget)
+      gst_omx_admission_release (budget, 1, 0);
     return NULL;
+  }
 
   comp = g_slice_new0 (GstOMXComponent);
   comp->core = core;
@@ -644,8 +2522,11 @@ gst_omx_component_new (GstObject * parent, const gchar * core_name,
     GST_ERROR_OBJECT (parent,
         "Failed to get component handle '%s' from core '%s': 0x%08x",
         component_name, core_name, err);
+    g_free (pool_key);
     gst_omx_core_release (core);
     g_slice_free (GstOMXComponent, comp);
+    if (budget)
+      gst_omx_admission_release (budget, 1, 0);
     return NULL;
   }
   GST_DEBUG_OBJECT (parent,
@@ -653,6 +2534,24 @@ gst_omx_component_new (GstObject * parent, const gchar * core_name,
       component_name, core_name);
   comp->parent = gst_object_ref (parent);
   comp->hacks = hacks;
+  comp->budget = budget;
+  comp->admission_priority = priority;
+  comp->admission_timeout = timeout;
+  comp->admitted_load = 0;
+
+  if ((size = gst_omx_flight_recorder_size ()) > 0) {
+    comp->flight_events = g_new0 (GstOMXFlightEvent, size);
+    comp->flight_mask = size - 1;
+  }
+  comp->flight_pos = 0;
+  comp->flight_signal_seq = g_atomic_int_get (&flight_signal_seq);
+  comp->flight_dumps = 0;
+
+  if (GST_OMX_LATENCY_TRACING ())
+    comp->latency_samples = gst_omx_latency_buffer_new ();
+
+  comp->trace =
+      gst_omx_trace_writer_new (comp, component_name, component_role);
 
   comp->ports = g_ptr_array_new ();
   comp->n_in_ports = 0;
@@ -661,8 +2560,23 @@ gst_omx_component_new (GstObject * parent, const gchar * core_name,
   g_mutex_init (&comp->lock);
   g_mutex_init (&comp->messages_lock);
   g_cond_init (&comp->messages_cond);
+  if (gst_omx_lock_stats_enabled ()) {
+    comp->lock_stats = g_slice_new0 (GstOMXLockStats);
+    comp->messages_lock_stats = g_slice_new0 (GstOMXLockStats);
+  }
+
+  gst_omx_ring_init (&comp->messages, GST_OMX_MESSAGE_RING_SIZE);
+  g_queue_init (&comp->messages_overflow);
+  comp->n_messages_overflow = 0;
+  comp->messages_waiters = 0;
 
-  g_queue_init (&comp->messages);
+  gst_omx_ring_init (&comp->free_messages, GST_OMX_MESSAGE_ARENA_SIZE);
+  comp->message_arena = g_new (GstOMXMessage, GST_OMX_MESSAGE_ARENA_SIZE);
+  for (i = 0; i < GST_OMX_MESSAGE_ARENA_SIZE; i++) {
+    comp->message_arena[i].from_arena = TRUE;
+    gst_omx_ring_push (&comp->free_messages, &comp->message_arena[i]);
+  }
+  comp->n_heap_messages = 0;
   comp->pending_state = OMX_StateInvalid;
   comp->last_error = OMX_ErrorNone;
 
@@ -682,63 +2596,303 @@ gst_omx_component_new (GstObject * parent, const gchar * core_name,
 
     /* If setting the role failed this component is unusable */
     if (err != OMX_ErrorNone) {
+      g_free (pool_key);
       gst_omx_component_free (comp);
       return NULL;
     }
   }
 
-  OMX_GetState (comp->handle, &comp->state);
+  OMX_GetState (comp->handle, &comp->state);
+
+  comp->pool_key = pool_key;
+  comp->cache_group =
+      gst_omx_caps_cache_group (core_name, component_name, component_role);
+  comp->pool_size = !managed ? 0 :
+      MAX (gst_omx_config_get_max_integer (core_name, component_name,
+          "component-pool-size"), 0);
+  comp->pool_idle_timeout =
+      gst_omx_config_get_max_integer (core_name, component_name,
+      "pool-idle-timeout");
+  if (comp->pool_idle_timeout == 0)
+    comp->pool_idle_timeout = GST_OMX_POOL_DEFAULT_IDLE_TIMEOUT;
+  comp->pool_deadline = -1;
+
+  GST_OMX_COMPONENT_LOCK (comp);
+  gst_omx_component_handle_messages (comp);
+  GST_OMX_COMPONENT_UNLOCK (comp);
+
+  return comp;
+}
+
+/* NOTE: Uses comp->lock and comp->messages_lock */
+GstOMXComponent *
+gst_omx_component_new (GstObject * parent, const gchar * core_name,
+    const gchar * component_name, const gchar * component_role, guint64 hacks)
+{
+  return gst_omx_component_new_internal (parent, core_name, component_name,
+      component_role, hacks, TRUE);
+}
+
+/* NOTE: Uses comp->lock and comp->messages_lock
+ *
+ * Like gst_omx_component_new() but never takes a pooled component,
+ * never returns to the pool and doesn't count against the admission
+ * budget. For short-lived instances outside of any pipeline */
+GstOMXComponent *
+gst_omx_component_new_unmanaged (GstObject * parent, const gchar * core_name,
+    const gchar * component_name, const gchar * component_role, guint64 hacks)
+{
+  return gst_omx_component_new_internal (parent, core_name, component_name,
+      component_role, hacks, FALSE);
+}
+
+static void
+gst_omx_component_free_ports (GstOMXComponent * comp)
+{
+  gint i, n;
+
+  if (!comp->ports)
+    return;
+
+  n = comp->ports->len;
+  for (i = 0; i < n; i++) {
+    GstOMXPort *port = g_ptr_array_index (comp->ports, i);
+
+    gst_omx_port_deallocate_buffers (port);
+    g_assert (port->buffers == NULL);
+    g_assert (port->n_pending_buffers == 0);
+    gst_omx_ring_clear (&port->pending_buffers);
+
+    g_cond_clear (&port->messages_cond);
+    if (port->notify_write_fd != -1 && port->notify_write_fd != port->notify_fd)
+      close (port->notify_write_fd);
+    if (port->notify_fd != -1)
+      close (port->notify_fd);
+    g_slice_free (GstOMXPort, port);
+  }
+  g_ptr_array_unref (comp->ports);
+  comp->ports = NULL;
+  comp->n_in_ports = 0;
+  comp->n_out_ports = 0;
+}
+
+/* Reports the statistics of the element's use of the component
+ * to the tracers and forgets everything it did not reset */
+static void
+gst_omx_component_finish_stats (GstOMXComponent * comp)
+{
+  gint i;
+
+  if (GST_OMX_LATENCY_TRACING ())
+    gst_omx_latency_tracer_component_freed (comp);
+
+  G_LOCK (memory_usage);
+  for (i = 0; i < GST_OMX_MEMORY_N_KINDS; i++)
+    gst_omx_memory_usage_add (&memory_total, i, -comp->memory.count[i],
+        -comp->memory.bytes[i]);
+  G_UNLOCK (memory_usage);
+  if (GST_OMX_MEMORY_TRACING ())
+    gst_omx_memory_tracer_component_freed (comp);
+  G_LOCK (memory_usage);
+  memset (&comp->memory, 0, sizeof (GstOMXMemoryUsage));
+  G_UNLOCK (memory_usage);
+
+  if (comp->lock_stats) {
+    gst_omx_component_log_lock_stats (comp, "lock", comp->lock_stats);
+    gst_omx_component_log_lock_stats (comp, "messages-lock",
+        comp->messages_lock_stats);
+    memset (comp->lock_stats, 0, sizeof (GstOMXLockStats));
+    memset (comp->messages_lock_stats, 0, sizeof (GstOMXLockStats));
+  }
+
+  /* The events of this element don't belong into the next one's dumps */
+  if (comp->flight_events) {
+    memset (comp->flight_events, 0,
+        (comp->flight_mask + 1) * sizeof (GstOMXFlightEvent));
+    g_atomic_int_set (&comp->flight_pos, 0);
+  }
+}
+
+/* Puts the component into the pool instead of freeing it if it is
+ * pooled, there is space left and it is still usable, i.e. in Loaded
+ * state without errors, with all ports enabled and with the settings
+ * it had when loaded. Returns FALSE if the component has to be freed */
+static gboolean
+gst_omx_component_pool_put (GstOMXComponent * comp)
+{
+  GstOMXAdmissionBudget *budget = comp->budget;
+  GstOMXCore *core = comp->core;
+  gint64 load;
+  GQueue *queue;
+  gboolean usable;
+  gint i;
+
+  if (comp->pool_size == 0)
+    return FALSE;
+
+  GST_OMX_COMPONENT_LOCK (comp);
+  gst_omx_component_handle_messages (comp);
+  usable = comp->state == OMX_StateLoaded
+      && comp->pending_state == OMX_StateInvalid
+      && comp->last_error == OMX_ErrorNone
+      && !comp->pending_reconfigure_outports;
+  GST_OMX_COMPONENT_UNLOCK (comp);
+
+  for (i = 0; usable && i < comp->ports->len; i++) {
+    GstOMXPort *port = g_ptr_array_index (comp->ports, i);
+
+    usable = !port->buffers && gst_omx_port_is_enabled (port);
+  }
+
+  if (usable)
+    usable = gst_omx_component_restore_settings (comp);
+
+  if (!usable) {
+    GST_DEBUG_OBJECT (comp->parent, "Not pooling unusable component %s",
+        comp->name);
+    return FALSE;
+  }
+
+  g_mutex_lock (&pool_lock);
+  if (!component_pool)
+    component_pool =
+        g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  queue = g_hash_table_lookup (component_pool, comp->pool_key);
+  if (!queue) {
+    queue = g_queue_new ();
+    g_hash_table_insert (component_pool, g_strdup (comp->pool_key), queue);
+  }
+  if (queue->length >= comp->pool_size) {
+    g_mutex_unlock (&pool_lock);
+    return FALSE;
+  }
+
+  GST_INFO_OBJECT (comp->parent, "Returning component %p %s to the pool",
+      comp, comp->name);
+
+  gst_omx_component_free_ports (comp);
+  comp->ports = g_ptr_array_new ();
+  gst_omx_component_finish_stats (comp);
+
+  /* Idle components only keep their instance */
+  load = comp->admitted_load;
+  comp->admitted_load = 0;
+
+  GST_OMX_COMPONENT_LOCK (comp);
+  comp->state_notify_func = NULL;
+  comp->state_notify_data = NULL;
+  GST_OMX_COMPONENT_UNLOCK (comp);
 
-  g_mutex_lock (&comp->lock);
-  gst_omx_component_handle_messages (comp);
-  g_mutex_unlock (&comp->lock);
+  gst_object_unref (comp->parent);
+  comp->parent = NULL;
 
-  return comp;
+  g_queue_push_tail (queue, comp);
+  if (comp->pool_idle_timeout >= 0) {
+    comp->pool_deadline = g_get_monotonic_time () +
+        (gint64) comp->pool_idle_timeout * G_TIME_SPAN_MILLISECOND;
+    gst_omx_component_pool_wake ();
+  } else {
+    comp->pool_deadline = -1;
+  }
+  g_mutex_unlock (&pool_lock);
+
+  /* The component may be freed by now. Wakes up waiters in any case,
+   * they can evict it */
+  if (budget)
+    gst_omx_admission_release (budget, 0, load);
+  gst_omx_component_pool_check_core (core);
+
+  return TRUE;
 }
 
-/* NOTE: Uses comp->messages_lock */
+/* NOTE: Uses comp->lock and comp->messages_lock */
 void
 gst_omx_component_free (GstOMXComponent * comp)
 {
-  gint i, n;
+  GstOMXCore *core;
 
   g_return_if_fail (comp != NULL);
 
-  GST_INFO_OBJECT (comp->parent, "Unloading component %p %s", comp, comp->name);
+  if (comp->cache_group)
+    gst_omx_caps_cache_save ();
+
+  if (gst_omx_component_pool_put (comp))
+    return;
 
-  if (comp->ports) {
-    n = comp->ports->len;
-    for (i = 0; i < n; i++) {
-      GstOMXPort *port = g_ptr_array_index (comp->ports, i);
+  core = comp->core;
+  gst_omx_component_unload (comp);
+  gst_omx_component_pool_check_core (core);
+}
 
-      gst_omx_port_deallocate_buffers (port);
-      g_assert (port->buffers == NULL);
-      g_assert (g_queue_get_length (&port->pending_buffers) == 0);
+/* Frees the component and its handle, comp->parent is NULL
+ * for components that were pooled */
+static void
+gst_omx_component_unload (GstOMXComponent * comp)
+{
+  GST_INFO_OBJECT (comp->parent, "Unloading component %p %s", comp, comp->name);
 
-      g_slice_free (GstOMXPort, port);
-    }
-    g_ptr_array_unref (comp->ports);
-    comp->ports = NULL;
-  }
+  gst_omx_component_free_ports (comp);
 
   comp->core->free_handle (comp->handle);
   gst_omx_core_release (comp->core);
 
+  if (comp->budget)
+    gst_omx_admission_release (comp->budget, 1, comp->admitted_load);
+  comp->admitted_load = 0;
+
+  gst_omx_component_finish_stats (comp);
+
   gst_omx_component_flush_messages (comp);
+  gst_omx_ring_clear (&comp->messages);
+
+  GST_INFO_OBJECT (comp->parent, "%s had %u arena messages, %d messages "
+      "were allocated from the heap", comp->name, GST_OMX_MESSAGE_ARENA_SIZE,
+      comp->n_heap_messages);
+  g_free (comp->message_arena);
+  comp->message_arena = NULL;
+  gst_omx_ring_clear (&comp->free_messages);
+
+  if (comp->lock_stats) {
+    g_slice_free (GstOMXLockStats, comp->lock_stats);
+    g_slice_free (GstOMXLockStats, comp->messages_lock_stats);
+    comp->lock_stats = NULL;
+    comp->messages_lock_stats = NULL;
+  }
 
   g_cond_clear (&comp->messages_cond);
   g_mutex_clear (&comp->messages_lock);
   g_mutex_clear (&comp->lock);
 
-  gst_object_unref (comp->parent);
+  if (comp->parent)
+    gst_object_unref (comp->parent);
+
+  g_list_free_full (comp->pool_saved_settings, gst_omx_saved_setting_free);
+  comp->pool_saved_settings = NULL;
+
+  g_free (comp->flight_events);
+  comp->flight_events = NULL;
+
+  gst_omx_latency_buffer_free (comp->latency_samples);
+  comp->latency_samples = NULL;
+
+  gst_omx_trace_writer_free (comp, comp->trace);
+  comp->trace = NULL;
 
   g_free (comp->name);
   comp->name = NULL;
+  g_free (comp->pool_key);
+  comp->pool_key = NULL;
+  g_free (comp->cache_group);
+  comp->cache_group = NULL;
 
   g_slice_free (GstOMXComponent, comp);
 }
 
-/* NOTE: Uses comp->lock and comp->messages_lock */
+/* NOTE: Uses comp->lock and comp->messages_lock
+ *
+ * Only starts the state change, use gst_omx_component_get_state(),
+ * gst_omx_component_wait_states() or a state notify func to know
+ * when it finished */
 OMX_ERRORTYPE
 gst_omx_component_set_state (GstOMXComponent * comp, OMX_STATETYPE state)
 {
@@ -747,7 +2901,7 @@ gst_omx_component_set_state (GstOMXComponent * comp, OMX_STATETYPE state)
 
   g_return_val_if_fail (comp != NULL, OMX_ErrorUndefined);
 
-  g_mutex_lock (&comp->lock);
+  GST_OMX_COMPONENT_LOCK (comp);
 
   gst_omx_component_handle_messages (comp);
 
@@ -773,18 +2927,18 @@ gst_omx_component_set_state (GstOMXComponent * comp, OMX_STATETYPE state)
   if ((old_state == OMX_StateExecuting || old_state == OMX_StatePause)
       && state < old_state) {
     g_list_free (comp->pending_reconfigure_outports);
-    comp->pending_reconfigure_outports = NULL;
+    g_atomic_pointer_set (&comp->pending_reconfigure_outports, NULL);
     /* Notify all inports that are still waiting */
-    gst_omx_component_send_message (comp, NULL);
+    gst_omx_component_send_message (comp, NULL, NULL);
   }
 
-  err = OMX_SendCommand (comp->handle, OMX_CommandStateSet, state, NULL);
+  err = gst_omx_component_send_command (comp, OMX_CommandStateSet, state);
   /* No need to check if anything has changed here */
 
 done:
 
   gst_omx_component_handle_messages (comp);
-  g_mutex_unlock (&comp->lock);
+  GST_OMX_COMPONENT_UNLOCK (comp);
 
   if (err != OMX_ErrorNone) {
     GST_ERROR_OBJECT (comp->parent,
@@ -794,19 +2948,19 @@ done:
   return err;
 }
 
-/* NOTE: Uses comp->lock and comp->messages_lock */
-OMX_STATETYPE
-gst_omx_component_get_state (GstOMXComponent * comp, GstClockTime timeout)
+/* NOTE: Uses comp->lock and comp->messages_lock
+ *
+ * wait_until is the monotonic time to wait for a pending state
+ * change until, -1 to wait forever and 0 to not wait at all */
+static OMX_STATETYPE
+gst_omx_component_get_state_until (GstOMXComponent * comp, gint64 wait_until)
 {
   OMX_STATETYPE ret;
-  gint64 wait_until = -1;
   gboolean signalled = TRUE;
 
-  g_return_val_if_fail (comp != NULL, OMX_StateInvalid);
-
   GST_DEBUG_OBJECT (comp->parent, "Getting state of %s", comp->name);
 
-  g_mutex_lock (&comp->lock);
+  GST_OMX_COMPONENT_LOCK (comp);
 
   gst_omx_component_handle_messages (comp);
 
@@ -822,15 +2976,11 @@ gst_omx_component_get_state (GstOMXComponent * comp, GstClockTime timeout)
     goto done;
   }
 
-  if (timeout != GST_CLOCK_TIME_NONE) {
-    gint64 add = timeout / (GST_SECOND / G_TIME_SPAN_SECOND);
-
-    if (add == 0)
-      goto done;
-
-    wait_until = g_get_monotonic_time () + add;
+  if (wait_until == 0) {
+    goto done;
+  } else if (wait_until != -1) {
     GST_DEBUG_OBJECT (comp->parent, "%s waiting for %" G_GINT64_FORMAT "us",
-        comp->name, add);
+        comp->name, wait_until - g_get_monotonic_time ());
   } else {
     GST_DEBUG_OBJECT (comp->parent, "%s waiting for signal", comp->name);
   }
@@ -838,21 +2988,7 @@ gst_omx_component_get_state (GstOMXComponent * comp, GstClockTime timeout)
   gst_omx_component_handle_messages (comp);
   while (signalled && comp->last_error == OMX_ErrorNone
       && comp->pending_state != OMX_StateInvalid) {
-    g_mutex_lock (&comp->messages_lock);
-    g_mutex_unlock (&comp->lock);
-    if (!g_queue_is_empty (&comp->messages)) {
-      signalled = TRUE;
-    }
-    if (timeout == GST_CLOCK_TIME_NONE) {
-      g_cond_wait (&comp->messages_cond, &comp->messages_lock);
-      signalled = TRUE;
-    } else {
-      signalled =
-          g_cond_wait_until (&comp->messages_cond, &comp->messages_lock,
-          wait_until);
-    }
-    g_mutex_unlock (&comp->messages_lock);
-    g_mutex_lock (&comp->lock);
+    signalled = gst_omx_component_wait_message (comp, NULL, wait_until);
     if (signalled)
       gst_omx_component_handle_messages (comp);
   };
@@ -878,7 +3014,7 @@ gst_omx_component_get_state (GstOMXComponent * comp, GstClockTime timeout)
   }
 
 done:
-  g_mutex_unlock (&comp->lock);
+  GST_OMX_COMPONENT_UNLOCK (comp);
 
   GST_DEBUG_OBJECT (comp->parent, "%s returning state %s", comp->name,
       gst_omx_state_to_string (ret));
@@ -886,6 +3022,121 @@ done:
   return ret;
 }
 
+/* NOTE: Uses comp->lock and comp->messages_lock */
+OMX_STATETYPE
+gst_omx_component_get_state (GstOMXComponent * comp, GstClockTime timeout)
+{
+  gint64 wait_until = -1;
+
+  g_return_val_if_fail (comp != NULL, OMX_StateInvalid);
+
+  if (timeout != GST_CLOCK_TIME_NONE) {
+    gint64 add = timeout / (GST_SECOND / G_TIME_SPAN_SECOND);
+
+    wait_until = (add == 0 ? 0 : g_get_monotonic_time () + add);
+  }
+
+  return gst_omx_component_get_state_until (comp, wait_until);
+}
+
+/* NOTE: Uses comp->lock and comp->messages_lock of all components
+ *
+ * Waits until the pending state changes of all components, started
+ * with gst_omx_component_set_state() before, finished. The timeout
+ * is for all of them together, so components that change their
+ * state in parallel are only waited for as long as the slowest one.
+ * NULL components are skipped. Returns FALSE if any state change
+ * failed or did not finish in time */
+gboolean
+gst_omx_component_wait_states (GstOMXComponent ** comps, guint n_comps,
+    GstClockTime timeout)
+{
+  gint64 wait_until = -1;
+  gboolean ret = TRUE;
+  guint i;
+
+  g_return_val_if_fail (comps != NULL || n_comps == 0, FALSE);
+
+  if (timeout != GST_CLOCK_TIME_NONE)
+    wait_until = g_get_monotonic_time () +
+        timeout / (GST_SECOND / G_TIME_SPAN_SECOND);
+
+  for (i = 0; i < n_comps; i++) {
+    if (!comps[i])
+      continue;
+    if (gst_omx_component_get_state_until (comps[i],
+            wait_until) == OMX_StateInvalid)
+      ret = FALSE;
+  }
+
+  return ret;
+}
+
+/* NOTE: Uses admission_lock, may wait up to the admission timeout but
+ * at most GST_OMX_ADMISSION_MAX_LOAD_TIMEOUT ms
+ *
+ * Replaces the macroblocks per second reserved by the component with
+ * the load of the video format, with an unknown framerate counting
+ * as 30fps. Returns FALSE if the budget rejected it, the previous
+ * reservation is kept then */
+gboolean
+gst_omx_component_admit_video_load (GstOMXComponent * comp, gint width,
+    gint height, gint fps_n, gint fps_d)
+{
+  gint64 load;
+  gint timeout;
+
+  g_return_val_if_fail (comp != NULL, FALSE);
+
+  if (!comp->budget)
+    return TRUE;
+
+  /* Called from set_format() with the stream lock, which must not be
+   * held forever */
+  timeout = comp->admission_timeout;
+  if (timeout < 0 || timeout > GST_OMX_ADMISSION_MAX_LOAD_TIMEOUT)
+    timeout = GST_OMX_ADMISSION_MAX_LOAD_TIMEOUT;
+
+  load = (gint64) ((width + 15) / 16) * ((height + 15) / 16);
+  if (fps_n > 0 && fps_d > 0)
+    load = gst_util_uint64_scale_ceil (load, fps_n, fps_d);
+  else
+    load *= 30;
+
+  GST_DEBUG_OBJECT (comp->parent, "Admitting %" G_GINT64_FORMAT
+      " macroblocks per second for %s, holding %" G_GINT64_FORMAT, load,
+      comp->name, comp->admitted_load);
+
+  if (load <= comp->admitted_load) {
+    gst_omx_admission_release (comp->budget, 0, comp->admitted_load - load);
+  } else if (!gst_omx_admission_acquire (comp->parent, comp->budget,
+          comp->admission_priority, timeout, 0, load - comp->admitted_load)) {
+    return FALSE;
+  }
+  comp->admitted_load = load;
+
+  return TRUE;
+}
+
+/* NOTE: Uses comp->lock
+ *
+ * func is called whenever a state change of the component finished or
+ * it got an error, with OMX_StateInvalid then. It's called with
+ * comp->lock held by whatever thread handles the component's messages,
+ * so it must not block or call into the component. It can be used to
+ * keep track of the state without polling the component */
+void
+gst_omx_component_set_state_notify_func (GstOMXComponent * comp,
+    GstOMXComponentStateNotifyFunc func, gpointer user_data)
+{
+  g_return_if_fail (comp != NULL);
+
+  GST_OMX_COMPONENT_LOCK (comp);
+  comp->state_notify_func = func;
+  comp->state_notify_data = user_data;
+  GST_OMX_COMPONENT_UNLOCK (comp);
+}
+
 GstOMXPort *
 gst_omx_component_add_port (GstOMXComponent * comp, guint32 index)
 {
@@ -924,12 +3175,20 @@ gst_omx_component_add_port (GstOMXComponent * comp, guint32 index)
 
   port->port_def = port_def;
 
-  g_queue_init (&port->pending_buffers);
-  port->flushing = TRUE;
+  gst_omx_ring_init (&port->pending_buffers, GST_OMX_PORT_PENDING_RING_SIZE);
+  port->n_pending_buffers = 0;
+  g_atomic_int_set (&port->flushing, TRUE);
   port->flushed = FALSE;
   port->enabled_pending = FALSE;
   port->disabled_pending = FALSE;
-  port->eos = FALSE;
+  g_atomic_int_set (&port->eos, FALSE);
+
+  g_cond_init (&port->messages_cond);
+  port->messages_waiters = 0;
+  port->messages_seq = 0;
+  port->handled_seq = 0;
+  port->notify_fd = -1;
+  port->notify_write_fd = -1;
 
   if (port->port_def.eDir == OMX_DirInput)
     comp->n_in_ports++;
@@ -964,10 +3223,10 @@ gst_omx_component_get_last_error (GstOMXComponent * comp)
 
   g_return_val_if_fail (comp != NULL, OMX_ErrorUndefined);
 
-  g_mutex_lock (&comp->lock);
+  GST_OMX_COMPONENT_LOCK (comp);
   gst_omx_component_handle_messages (comp);
   err = comp->last_error;
-  g_mutex_unlock (&comp->lock);
+  GST_OMX_COMPONENT_UNLOCK (comp);
 
   GST_DEBUG_OBJECT (comp->parent, "Returning last %s error: %s (0x%08x)",
       comp->name, gst_omx_error_to_string (err), err);
@@ -983,6 +3242,166 @@ gst_omx_component_get_last_error_string (GstOMXComponent * comp)
   return gst_omx_error_to_string (gst_omx_component_get_last_error (comp));
 }
 
+/* NOTE: Uses comp->lock and comp->messages_lock
+ *
+ * Returns a snapshot of the lock statistics or NULL if they are not
+ * enabled. All times are in ns, bucket i of the histograms counts
+ * times below 2^(i+10) ns */
+GstStructure *
+gst_omx_component_get_lock_stats (GstOMXComponent * comp)
+{
+  GstOMXLockStats lock_stats, messages_lock_stats;
+  GstStructure *s;
+
+  g_return_val_if_fail (comp != NULL, NULL);
+
+  if (!comp->lock_stats)
+    return NULL;
+
+  /* Taken without the wrappers, reading the statistics
+   * should not change them */
+  g_mutex_lock (&comp->lock);
+  lock_stats = *comp->lock_stats;
+  g_mutex_lock (&comp->messages_lock);
+  messages_lock_stats = *comp->messages_lock_stats;
+  g_mutex_unlock (&comp->messages_lock);
+  g_mutex_unlock (&comp->lock);
+
+  gst_omx_component_log_lock_stats (comp, "lock", &lock_stats);
+  gst_omx_component_log_lock_stats (comp, "messages-lock",
+      &messages_lock_stats);
+
+  s = gst_structure_new ("omx-lock-stats", "component", G_TYPE_STRING,
+      comp->name, "histogram-base", G_TYPE_UINT64, G_GUINT64_CONSTANT (1024),
+      NULL);
+  gst_omx_lock_stats_to_structure (&lock_stats, s, "lock");
+  gst_omx_lock_stats_to_structure (&messages_lock_stats, s, "messages-lock");
+
+  return s;
+}
+
+const gchar *
+gst_omx_memory_kind_to_string (GstOMXMemoryKind kind)
+{
+  g_return_val_if_fail (kind < GST_OMX_MEMORY_N_KINDS, NULL);
+
+  return memory_kind_names[kind];
+}
+
+/* Adds count objects of bytes size to the memory held by comp,
+ * both can be negative when the memory is freed again */
+void
+gst_omx_component_account_memory (GstOMXComponent * comp,
+    GstOMXMemoryKind kind, gint count, gssize bytes)
+{
+  g_return_if_fail (comp != NULL);
+  g_return_if_fail (kind < GST_OMX_MEMORY_N_KINDS);
+
+  G_LOCK (memory_usage);
+  gst_omx_memory_usage_add (&comp->memory, kind, count, bytes);
+  gst_omx_memory_usage_add (&memory_total, kind, count, bytes);
+  G_UNLOCK (memory_usage);
+
+  if (GST_OMX_MEMORY_TRACING ())
+    gst_omx_memory_tracer_changed (comp);
+}
+
+/* Like gst_omx_component_account_memory() but replaces the
+ * previous value, for memory that is only counted from time
+ * to time like the pending frames */
+void
+gst_omx_component_set_memory (GstOMXComponent * comp, GstOMXMemoryKind kind,
+    guint count, gsize bytes)
+{
+  g_return_if_fail (comp != NULL);
+  g_return_if_fail (kind < GST_OMX_MEMORY_N_KINDS);
+
+  G_LOCK (memory_usage);
+  gst_omx_memory_usage_add (&memory_total, kind,
+      (gint64) count - comp->memory.count[kind],
+      (gint64) bytes - comp->memory.bytes[kind]);
+  comp->memory.count[kind] = 0;
+  comp->memory.bytes[kind] = 0;
+  gst_omx_memory_usage_add (&comp->memory, kind, count, bytes);
+  G_UNLOCK (memory_usage);
+
+  if (GST_OMX_MEMORY_TRACING ())
+    gst_omx_memory_tracer_changed (comp);
+}
+
+void
+gst_omx_component_get_memory_usage (GstOMXComponent * comp,
+    GstOMXMemoryUsage * usage)
+{
+  g_return_if_fail (comp != NULL);
+  g_return_if_fail (usage != NULL);
+
+  G_LOCK (memory_usage);
+  *usage = comp->memory;
+  G_UNLOCK (memory_usage);
+}
+
+/* Memory held by all components of the process */
+void
+gst_omx_get_memory_usage (GstOMXMemoryUsage * usage)
+{
+  g_return_if_fail (usage != NULL);
+
+  G_LOCK (memory_usage);
+  *usage = memory_total;
+  G_UNLOCK (memory_usage);
+}
+
+static void
+gst_omx_memory_usage_to_structure (const GstOMXMemoryUsage * usage,
+    GstStructure * s, const gchar * prefix)
+{
+  gint64 bytes = 0;
+  gchar *field;
+  gint i;
+
+  for (i = 0; i < GST_OMX_MEMORY_N_KINDS; i++) {
+    field = g_strdup_printf ("%s%s-count", prefix, memory_kind_names[i]);
+    gst_structure_set (s, field, G_TYPE_INT64, usage->count[i], NULL);
+    g_free (field);
+    field = g_strdup_printf ("%s%s-bytes", prefix, memory_kind_names[i]);
+    gst_structure_set (s, field, G_TYPE_INT64, usage->bytes[i], NULL);
+    g_free (field);
+    field = g_strdup_printf ("%s%s-peak-bytes", prefix, memory_kind_names[i]);
+    gst_structure_set (s, field, G_TYPE_INT64, usage->peak[i], NULL);
+    g_free (field);
+
+    bytes += usage->bytes[i];
+  }
+
+  field = g_strdup_printf ("%stotal-bytes", prefix);
+  gst_structure_set (s, field, G_TYPE_INT64, bytes, NULL);
+  g_free (field);
+}
+
+/* Returns the memory held by comp and, with the "process-" prefix,
+ * by all components of the process */
+GstStructure *
+gst_omx_component_get_memory_stats (GstOMXComponent * comp)
+{
+  GstOMXMemoryUsage usage, total;
+  GstStructure *s;
+
+  g_return_val_if_fail (comp != NULL, NULL);
+
+  G_LOCK (memory_usage);
+  usage = comp->memory;
+  total = memory_total;
+  G_UNLOCK (memory_usage);
+
+  s = gst_structure_new ("omx-memory-stats", "component", G_TYPE_STRING,
+      comp->name, NULL);
+  gst_omx_memory_usage_to_structure (&usage, s, "");
+  gst_omx_memory_usage_to_structure (&total, s, "process-");
+
+  return s;
+}
+
 /* comp->lock must be unlocked while calling this */
 OMX_ERRORTYPE
 gst_omx_component_get_parameter (GstOMXComponent * comp, OMX_INDEXTYPE index,
@@ -1012,6 +3431,9 @@ gst_omx_component_set_parameter (GstOMXComponent * comp, OMX_INDEXTYPE index,
   g_return_val_if_fail (comp != NULL, OMX_ErrorUndefined);
   g_return_val_if_fail (param != NULL, OMX_ErrorUndefined);
 
+  if (comp->pool_size > 0)
+    gst_omx_component_save_setting (comp, index, param, FALSE);
+
   GST_DEBUG_OBJECT (comp->parent, "Setting %s parameter at index 0x%08x",
       comp->name, index);
   err = OMX_SetParameter (comp->handle, index, param);
@@ -1050,6 +3472,9 @@ gst_omx_component_set_config (GstOMXComponent * comp, OMX_INDEXTYPE index,
   g_return_val_if_fail (comp != NULL, OMX_ErrorUndefined);
   g_return_val_if_fail (config != NULL, OMX_ErrorUndefined);
 
+  if (comp->pool_size > 0)
+    gst_omx_component_save_setting (comp, index, config, TRUE);
+
   GST_DEBUG_OBJECT (comp->parent, "Setting %s configuration at index 0x%08x",
       comp->name, index);
   err = OMX_SetConfig (comp->handle, index, config);
@@ -1075,8 +3500,8 @@ gst_omx_component_setup_tunnel (GstOMXComponent * comp1, GstOMXPort * port1,
       OMX_ErrorUndefined);
   g_return_val_if_fail (comp1->core == comp2->core, OMX_ErrorUndefined);
 
-  g_mutex_lock (&comp1->lock);
-  g_mutex_lock (&comp2->lock);
+  GST_OMX_COMPONENT_LOCK (comp1);
+  GST_OMX_COMPONENT_LOCK (comp2);
   GST_DEBUG_OBJECT (comp1->parent,
       "Setup tunnel between %s port %u and %s port %u",
       comp1->name, port1->index, comp2->name, port2->index);
@@ -1094,8 +3519,8 @@ gst_omx_component_setup_tunnel (GstOMXComponent * comp1, GstOMXPort * port1,
       comp1->name, port1->index,
       comp2->name, port2->index, gst_omx_error_to_string (err), err);
 
-  g_mutex_unlock (&comp2->lock);
-  g_mutex_unlock (&comp1->lock);
+  GST_OMX_COMPONENT_UNLOCK (comp2);
+  GST_OMX_COMPONENT_UNLOCK (comp1);
 
   return err;
 }
@@ -1117,8 +3542,8 @@ gst_omx_component_close_tunnel (GstOMXComponent * comp1, GstOMXPort * port1,
   g_return_val_if_fail (comp1->core == comp2->core, OMX_ErrorUndefined);
   g_return_val_if_fail (port1->tunneled && port2->tunneled, OMX_ErrorUndefined);
 
-  g_mutex_lock (&comp1->lock);
-  g_mutex_lock (&comp2->lock);
+  GST_OMX_COMPONENT_LOCK (comp1);
+  GST_OMX_COMPONENT_LOCK (comp2);
   GST_DEBUG_OBJECT (comp1->parent,
       "Closing tunnel between %s port %u and %s port %u",
       comp1->name, port1->index, comp2->name, port2->index);
@@ -1143,8 +3568,8 @@ gst_omx_component_close_tunnel (GstOMXComponent * comp1, GstOMXPort * port1,
       "Closed tunnel between %s port %u and %s port %u",
       comp1->name, port1->index, comp2->name, port2->index);
 
-  g_mutex_unlock (&comp2->lock);
-  g_mutex_unlock (&comp1->lock);
+  GST_OMX_COMPONENT_UNLOCK (comp2);
+  GST_OMX_COMPONENT_UNLOCK (comp1);
 
   return err;
 }
@@ -1193,24 +3618,101 @@ gst_omx_port_update_port_definition (GstOMXPort * port,
   return err;
 }
 
-/* NOTE: Uses comp->lock and comp->messages_lock */
-GstOMXAcquireBufferReturn
-gst_omx_port_acquire_buffer (GstOMXPort * port, GstOMXBuffer ** buf)
+/* NOTE: Does not take any lock
+ *
+ * Stores first and up to max_bufs - 1 further pending buffers in bufs.
+ * Stops after an output buffer with the EOS flag, eos is set to TRUE
+ * then. Returns the number of buffers stored */
+static guint
+gst_omx_port_collect_pending_buffers (GstOMXPort * port, GstOMXBuffer * first,
+    GstOMXBuffer ** bufs, guint max_bufs, gboolean * eos)
+{
+  GstOMXBuffer *buf = first;
+  guint n = 0;
+
+  *eos = FALSE;
+  while (buf) {
+    g_assert (buf == buf->omx_buf->pAppPrivate);
+    bufs[n++] = buf;
+
+    if (GST_OMX_LATENCY_TRACING ())
+      gst_omx_buffer_trace_latency (buf, &buf->done_at,
+          GST_OMX_LATENCY_QUEUED, &buf->acquired_at);
+
+    if ((buf->omx_buf->nFlags & OMX_BUFFERFLAG_EOS)
+        && port->port_def.eDir == OMX_DirOutput) {
+      *eos = TRUE;
+      break;
+    }
+
+    if (n == max_bufs)
+      break;
+    buf = gst_omx_port_pop_pending_buffer (port);
+  }
+
+  return n;
+}
+
+/* NOTE: Uses comp->lock and comp->messages_lock
+ *
+ * Waits for the first buffer until wait_until, -1 waits forever. Up to
+ * max_bufs - 1 further buffers that are already pending are taken too,
+ * without waiting for them. Everything is done with a single lock
+ * acquisition. n_bufs is set to the number of buffers stored in bufs,
+ * it's at least 1 if GST_OMX_ACQUIRE_BUFFER_OK is returned */
+static GstOMXAcquireBufferReturn
+gst_omx_port_acquire_buffers_until (GstOMXPort * port, GstOMXBuffer ** bufs,
+    guint max_bufs, guint * n_bufs, gint64 wait_until)
 {
   GstOMXAcquireBufferReturn ret = GST_OMX_ACQUIRE_BUFFER_ERROR;
   GstOMXComponent *comp;
   OMX_ERRORTYPE err;
   GstOMXBuffer *_buf = NULL;
+  gboolean eos = FALSE, drained = FALSE;
+  guint n = 0;
 
+  g_return_val_if_fail (n_bufs != NULL, GST_OMX_ACQUIRE_BUFFER_ERROR);
+  *n_bufs = 0;
   g_return_val_if_fail (port != NULL, GST_OMX_ACQUIRE_BUFFER_ERROR);
   g_return_val_if_fail (!port->tunneled, GST_OMX_ACQUIRE_BUFFER_ERROR);
-  g_return_val_if_fail (buf != NULL, GST_OMX_ACQUIRE_BUFFER_ERROR);
+  g_return_val_if_fail (bufs != NULL, GST_OMX_ACQUIRE_BUFFER_ERROR);
+  g_return_val_if_fail (max_bufs > 0, GST_OMX_ACQUIRE_BUFFER_ERROR);
 
-  *buf = NULL;
+  bufs[0] = NULL;
 
   comp = port->comp;
 
-  g_mutex_lock (&comp->lock);
+  /* Fast path: If there is nothing that has to be handled under
+   * comp->lock take a returned buffer directly. The port state is
+   * read atomically without the lock, if it changes right afterwards
+   * that's the same as if the buffer was acquired just before. A
+   * flush waits for fast_acquirers to drop to 0 after it set flushing,
+   * so it sees every buffer taken here as acquired */
+  g_atomic_int_inc (&port->fast_acquirers);
+  if (!gst_omx_component_has_messages (comp)
+      && g_atomic_int_get (&comp->last_error) == OMX_ErrorNone
+      && !g_atomic_int_get (&port->flushing)
+      && !g_atomic_int_get (&port->eos)
+      && g_atomic_int_get (&port->settings_cookie) ==
+      g_atomic_int_get (&port->configured_settings_cookie)
+      && (port->port_def.eDir == OMX_DirOutput
+          || !g_atomic_pointer_get (&comp->pending_reconfigure_outports))
+      && (_buf = gst_omx_port_pop_pending_buffer (port))) {
+    ret = GST_OMX_ACQUIRE_BUFFER_OK;
+    n = gst_omx_port_collect_pending_buffers (port, _buf, bufs, max_bufs,
+        &eos);
+    if (eos) {
+      /* The port becomes EOS with the last buffer */
+      GST_DEBUG_OBJECT (comp->parent, "%s output port %u is EOS", comp->name,
+          port->index);
+      g_atomic_int_set (&port->eos, TRUE);
+    }
+    g_atomic_int_add (&port->fast_acquirers, -1);
+    goto out;
+  }
+  g_atomic_int_add (&port->fast_acquirers, -1);
+
+  GST_OMX_COMPONENT_LOCK (comp);
   GST_DEBUG_OBJECT (comp->parent, "Acquiring %s buffer from port %u",
       comp->name, port->index);
 
@@ -1243,12 +3745,10 @@ retry:
           (err = comp->last_error) == OMX_ErrorNone && !port->flushing) {
         GST_DEBUG_OBJECT (comp->parent,
             "Waiting for %s output ports to reconfigure", comp->name);
-        g_mutex_lock (&comp->messages_lock);
-        g_mutex_unlock (&comp->lock);
-        if (g_queue_is_empty (&comp->messages))
-          g_cond_wait (&comp->messages_cond, &comp->messages_lock);
-        g_mutex_unlock (&comp->messages_lock);
-        g_mutex_lock (&comp->lock);
+        if (!gst_omx_component_wait_message (comp, port, wait_until)) {
+          ret = GST_OMX_ACQUIRE_BUFFER_NO_AVAILABLE;
+          goto done;
+        }
         gst_omx_component_handle_messages (comp);
       }
       goto retry;
@@ -1269,11 +3769,10 @@ retry:
    * we have to drop them... */
   if (port->port_def.eDir == OMX_DirOutput &&
       port->settings_cookie != port->configured_settings_cookie) {
-    if (!g_queue_is_empty (&port->pending_buffers)) {
+    if ((_buf = gst_omx_port_pop_pending_buffer (port))) {
       GST_DEBUG_OBJECT (comp->parent,
           "%s output port %u needs reconfiguration but has buffers pending",
           comp->name, port->index);
-      _buf = g_queue_pop_head (&port->pending_buffers);
 
       ret = GST_OMX_ACQUIRE_BUFFER_OK;
       goto done;
@@ -1284,10 +3783,9 @@ retry:
   }
 
   if (port->port_def.eDir == OMX_DirOutput && port->eos) {
-    if (!g_queue_is_empty (&port->pending_buffers)) {
+    if ((_buf = gst_omx_port_pop_pending_buffer (port))) {
       GST_DEBUG_OBJECT (comp->parent, "%s output port %u is EOS but has "
           "buffers pending", comp->name, port->index);
-      _buf = g_queue_pop_head (&port->pending_buffers);
 
       ret = GST_OMX_ACQUIRE_BUFFER_OK;
       goto done;
@@ -1308,15 +3806,21 @@ retry:
    * or the port needs to be reconfigured.
    */
   gst_omx_component_handle_messages (comp);
-  if (g_queue_is_empty (&port->pending_buffers)) {
+  if (!(_buf = gst_omx_port_pop_pending_buffer (port))) {
     GST_DEBUG_OBJECT (comp->parent, "Queue of %s port %u is empty",
         comp->name, port->index);
-    g_mutex_lock (&comp->messages_lock);
-    g_mutex_unlock (&comp->lock);
-    if (g_queue_is_empty (&comp->messages))
-      g_cond_wait (&comp->messages_cond, &comp->messages_lock);
-    g_mutex_unlock (&comp->messages_lock);
-    g_mutex_lock (&comp->lock);
+    if (wait_until != -1 && g_get_monotonic_time () >= wait_until) {
+      /* Buffers that arrived before the notification fd was drained
+       * must be seen, the ones after it make it readable again */
+      if (!drained && port->notify_fd != -1) {
+        gst_omx_port_drain_notify_fd (port);
+        drained = TRUE;
+        goto retry;
+      }
+      ret = GST_OMX_ACQUIRE_BUFFER_NO_AVAILABLE;
+      goto done;
+    }
+    gst_omx_component_wait_message (comp, port, wait_until);
     gst_omx_component_handle_messages (comp);
 
     /* And now check everything again and maybe get a buffer */
@@ -1324,100 +3828,315 @@ retry:
   } else {
     GST_DEBUG_OBJECT (comp->parent, "%s port %u has pending buffers",
         comp->name, port->index);
-    _buf = g_queue_pop_head (&port->pending_buffers);
     ret = GST_OMX_ACQUIRE_BUFFER_OK;
     goto done;
   }
 
-  g_assert_not_reached ();
-  goto retry;
+  g_assert_not_reached ();
+  goto retry;
+
+done:
+  /* Output buffers with the EOS flag make the port EOS, all following
+   * acquire calls only return the remaining pending buffers */
+  if (_buf) {
+    n = gst_omx_port_collect_pending_buffers (port, _buf, bufs, max_bufs,
+        &eos);
+    if (eos) {
+      GST_DEBUG_OBJECT (comp->parent, "%s output port %u is EOS", comp->name,
+          port->index);
+      g_atomic_int_set (&port->eos, TRUE);
+    }
+  }
+  GST_OMX_COMPONENT_UNLOCK (comp);
+
+out:
+  *n_bufs = n;
+
+  if (GST_OMX_LATENCY_TRACING ())
+    gst_omx_latency_tracer_collect (comp);
+
+  GST_DEBUG_OBJECT (comp->parent, "Acquired %u buffers, first %p (%p), from "
+      "%s port %u: %d", n, _buf, (_buf ? _buf->omx_buf->pBuffer : NULL),
+      comp->name, port->index, ret);
+
+  return ret;
+}
+
+/* NOTE: Uses comp->lock and comp->messages_lock */
+GstOMXAcquireBufferReturn
+gst_omx_port_acquire_buffer (GstOMXPort * port, GstOMXBuffer ** buf)
+{
+  guint n_bufs;
+
+  g_return_val_if_fail (buf != NULL, GST_OMX_ACQUIRE_BUFFER_ERROR);
+
+  return gst_omx_port_acquire_buffers_until (port, buf, 1, &n_bufs, -1);
+}
+
+/* NOTE: Uses comp->lock and comp->messages_lock
+ *
+ * Like gst_omx_port_acquire_buffer() but also takes up to
+ * max_bufs - 1 further buffers that are already pending, without
+ * waiting for them. Everything is done with a single lock
+ * acquisition. n_bufs is set to the number of buffers stored in
+ * bufs, it's at least 1 if GST_OMX_ACQUIRE_BUFFER_OK is returned */
+GstOMXAcquireBufferReturn
+gst_omx_port_acquire_buffers (GstOMXPort * port, GstOMXBuffer ** bufs,
+    guint max_bufs, guint * n_bufs)
+{
+  return gst_omx_port_acquire_buffers_until (port, bufs, max_bufs, n_bufs,
+      -1);
+}
+
+/* NOTE: Uses comp->lock and comp->messages_lock
+ *
+ * Like gst_omx_port_acquire_buffer() but never waits, returns
+ * GST_OMX_ACQUIRE_BUFFER_NO_AVAILABLE if no buffer is pending */
+GstOMXAcquireBufferReturn
+gst_omx_port_try_acquire_buffer (GstOMXPort * port, GstOMXBuffer ** buf)
+{
+  guint n_bufs;
+
+  g_return_val_if_fail (buf != NULL, GST_OMX_ACQUIRE_BUFFER_ERROR);
+
+  return gst_omx_port_acquire_buffers_until (port, buf, 1, &n_bufs, 0);
+}
+
+/* NOTE: Uses comp->lock and comp->messages_lock
+ *
+ * Like gst_omx_port_acquire_buffer() but waits at most until end_time,
+ * in g_get_monotonic_time() units. Returns
+ * GST_OMX_ACQUIRE_BUFFER_NO_AVAILABLE if no buffer arrived until then */
+GstOMXAcquireBufferReturn
+gst_omx_port_acquire_buffer_until (GstOMXPort * port, GstOMXBuffer ** buf,
+    gint64 end_time)
+{
+  guint n_bufs;
+
+  g_return_val_if_fail (buf != NULL, GST_OMX_ACQUIRE_BUFFER_ERROR);
+  g_return_val_if_fail (end_time >= 0, GST_OMX_ACQUIRE_BUFFER_ERROR);
+
+  return gst_omx_port_acquire_buffers_until (port, buf, 1, &n_bufs, end_time);
+}
+
+/* NOTE: Uses comp->lock
+ *
+ * Sets a function that is called whenever something happens that
+ * concerns the port, see gst_omx_port_get_notify_fd(). The previous
+ * function is not called anymore once this returns */
+void
+gst_omx_port_set_notify_func (GstOMXPort * port, GstOMXPortNotifyFunc func,
+    gpointer user_data)
+{
+  g_return_if_fail (port != NULL);
+
+  GST_OMX_COMPONENT_LOCK (port->comp);
+  g_atomic_pointer_set (&port->notify_func, NULL);
+  /* Notifications don't block, this only takes a moment */
+  while (g_atomic_int_get (&port->notify_users) > 0)
+    g_thread_yield ();
+  g_atomic_pointer_set (&port->notify_data, user_data);
+  g_atomic_pointer_set (&port->notify_func, func);
+  GST_OMX_COMPONENT_UNLOCK (port->comp);
+}
+
+/* NOTE: Uses comp->lock
+ *
+ * Returns a file descriptor that becomes readable whenever a buffer
+ * arrives or something else happens that concerns the port, or -1
+ * if it can't be created. It is created on the first call and owned
+ * by the port.
+ *
+ * Callers poll it and then call gst_omx_port_try_acquire_buffer()
+ * until GST_OMX_ACQUIRE_BUFFER_NO_AVAILABLE is returned, which drains
+ * it again. This allows a single thread to service many ports */
+gint
+gst_omx_port_get_notify_fd (GstOMXPort * port)
+{
+  GstOMXComponent *comp;
+  gint fds[2] = { -1, -1 };
+
+  g_return_val_if_fail (port != NULL, -1);
+
+  comp = port->comp;
+
+  GST_OMX_COMPONENT_LOCK (comp);
+  if (port->notify_fd != -1)
+    goto done;
+
+#ifdef HAVE_SYS_EVENTFD_H
+  fds[0] = fds[1] = eventfd (0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (fds[0] == -1)
+    goto error;
+#else
+  if (pipe (fds) == -1)
+    goto error;
+  fcntl (fds[0], F_SETFL, fcntl (fds[0], F_GETFL) | O_NONBLOCK);
+  fcntl (fds[1], F_SETFL, fcntl (fds[1], F_GETFL) | O_NONBLOCK);
+  fcntl (fds[0], F_SETFD, FD_CLOEXEC);
+  fcntl (fds[1], F_SETFD, FD_CLOEXEC);
+#endif
+
+  port->notify_fd = fds[0];
+  /* The callbacks only look at the write end */
+  g_atomic_int_set (&port->notify_write_fd, fds[1]);
 
-done:
-  g_mutex_unlock (&comp->lock);
+  /* Something might be pending already */
+  gst_omx_port_signal_notify_fd (port);
 
-  if (_buf) {
-    g_assert (_buf == _buf->omx_buf->pAppPrivate);
-    *buf = _buf;
-  }
+done:
+  GST_OMX_COMPONENT_UNLOCK (comp);
 
-  GST_DEBUG_OBJECT (comp->parent, "Acquired buffer %p (%p) from %s port %u: %d",
-      _buf, (_buf ? _buf->omx_buf->pBuffer : NULL), comp->name, port->index,
-      ret);
+  return port->notify_fd;
 
-  return ret;
+error:
+  {
+    GST_ERROR_OBJECT (comp->parent, "Failed to create notification fd for "
+        "%s port %u: %s", comp->name, port->index, g_strerror (errno));
+    GST_OMX_COMPONENT_UNLOCK (comp);
+    return -1;
+  }
 }
 
 /* NOTE: Uses comp->lock and comp->messages_lock */
 OMX_ERRORTYPE
 gst_omx_port_release_buffer (GstOMXPort * port, GstOMXBuffer * buf)
+{
+  g_return_val_if_fail (buf != NULL, OMX_ErrorUndefined);
+
+  return gst_omx_port_release_buffers (port, &buf, 1);
+}
+
+/* NOTE: Uses comp->lock and comp->messages_lock
+ *
+ * Releases n_bufs buffers in the given order with a single lock
+ * acquisition. Returns the first error, all buffers are handled
+ * as if they were released one by one nonetheless */
+OMX_ERRORTYPE
+gst_omx_port_release_buffers (GstOMXPort * port, GstOMXBuffer ** bufs,
+    guint n_bufs)
 {
   GstOMXComponent *comp;
-  OMX_ERRORTYPE err = OMX_ErrorNone;
+  OMX_ERRORTYPE err = OMX_ErrorNone, tmp;
+  gboolean wake = FALSE;
+  guint i;
 
   g_return_val_if_fail (port != NULL, OMX_ErrorUndefined);
   g_return_val_if_fail (!port->tunneled, GST_OMX_ACQUIRE_BUFFER_ERROR);
-  g_return_val_if_fail (buf != NULL, OMX_ErrorUndefined);
-  g_return_val_if_fail (buf->port == port, OMX_ErrorUndefined);
+  g_return_val_if_fail (bufs != NULL || n_bufs == 0, OMX_ErrorUndefined);
+  for (i = 0; i < n_bufs; i++) {
+    g_return_val_if_fail (bufs[i] != NULL, OMX_ErrorUndefined);
+    g_return_val_if_fail (bufs[i]->port == port, OMX_ErrorUndefined);
+  }
 
   comp = port->comp;
 
-  g_mutex_lock (&comp->lock);
+  GST_OMX_COMPONENT_LOCK (comp);
 
-  GST_DEBUG_OBJECT (comp->parent, "Releasing buffer %p (%p) to %s port %u",
-      buf, buf->omx_buf->pBuffer, comp->name, port->index);
+  GST_DEBUG_OBJECT (comp->parent, "Releasing %u buffers to %s port %u",
+      n_bufs, comp->name, port->index);
 
   gst_omx_component_handle_messages (comp);
 
-  if (port->port_def.eDir == OMX_DirOutput) {
-    /* Reset all flags, some implementations don't
-     * reset them themselves and the flags are not
-     * valid anymore after the buffer was consumed
-     */
-    buf->omx_buf->nFlags = 0;
+  for (i = 0; i < n_bufs; i++) {
+    GstOMXBuffer *buf = bufs[i];
 
-    /* Reset offset and filled length */
-    buf->omx_buf->nOffset = 0;
-    buf->omx_buf->nFilledLen = 0;
-  }
+    GST_DEBUG_OBJECT (comp->parent, "Releasing buffer %p (%p) to %s port %u",
+        buf, buf->omx_buf->pBuffer, comp->name, port->index);
 
-  if ((err = comp->last_error) != OMX_ErrorNone) {
-    GST_ERROR_OBJECT (comp->parent, "Component %s is in error state: %s "
-        "(0x%08x)", comp->name, gst_omx_error_to_string (err), err);
-    g_queue_push_tail (&port->pending_buffers, buf);
-    gst_omx_component_send_message (comp, NULL);
-    goto done;
-  }
+    if (port->port_def.eDir == OMX_DirOutput) {
+      /* Reset all flags, some implementations don't
+       * reset them themselves and the flags are not
+       * valid anymore after the buffer was consumed
+       */
+      buf->omx_buf->nFlags = 0;
 
-  if (port->flushing) {
-    GST_DEBUG_OBJECT (comp->parent, "%s port %u is flushing, not releasing "
-        "buffer", comp->name, port->index);
-    g_queue_push_tail (&port->pending_buffers, buf);
-    gst_omx_component_send_message (comp, NULL);
-    goto done;
-  }
+      /* Reset offset and filled length */
+      buf->omx_buf->nOffset = 0;
+      buf->omx_buf->nFilledLen = 0;
+    }
 
-  g_assert (buf == buf->omx_buf->pAppPrivate);
+    if ((tmp = comp->last_error) != OMX_ErrorNone) {
+      GST_ERROR_OBJECT (comp->parent, "Component %s is in error state: %s "
+          "(0x%08x)", comp->name, gst_omx_error_to_string (tmp), tmp);
+      gst_omx_port_push_pending_buffer (port, buf);
+      wake = TRUE;
+      if (err == OMX_ErrorNone)
+        err = tmp;
+      continue;
+    }
 
-  /* FIXME: What if the settings cookies don't match? */
+    if (port->flushing) {
+      GST_DEBUG_OBJECT (comp->parent, "%s port %u is flushing, not releasing "
+          "buffer", comp->name, port->index);
+      gst_omx_port_push_pending_buffer (port, buf);
+      wake = TRUE;
+      continue;
+    }
 
-  buf->used = TRUE;
+    g_assert (buf == buf->omx_buf->pAppPrivate);
 
-  if (port->port_def.eDir == OMX_DirInput) {
-    err = OMX_EmptyThisBuffer (comp->handle, buf->omx_buf);
-  } else {
-    err = OMX_FillThisBuffer (comp->handle, buf->omx_buf);
+    /* FIXME: What if the settings cookies don't match? */
+
+    buf->used = TRUE;
+
+    if (GST_OMX_LATENCY_TRACING ())
+      gst_omx_buffer_trace_latency (buf, &buf->acquired_at,
+          GST_OMX_LATENCY_HELD, &buf->sent_at);
+
+    tmp = gst_omx_port_pass_buffer (port, buf);
+    GST_DEBUG_OBJECT (comp->parent, "Released buffer %p to %s port %u: %s "
+        "(0x%08x)", buf, comp->name, port->index, gst_omx_error_to_string (tmp),
+        tmp);
+    if (err == OMX_ErrorNone)
+      err = tmp;
   }
-  GST_DEBUG_OBJECT (comp->parent, "Released buffer %p to %s port %u: %s "
-      "(0x%08x)", buf, comp->name, port->index, gst_omx_error_to_string (err),
-      err);
 
-done:
+  if (wake)
+    gst_omx_component_send_message (comp, port, NULL);
+
   gst_omx_component_handle_messages (comp);
-  g_mutex_unlock (&comp->lock);
+  GST_OMX_COMPONENT_UNLOCK (comp);
 
   return err;
 }
 
+/* NOTE: Uses comp->lock and comp->messages_lock
+ *
+ * Marks an output port as EOS, as if the component returned
+ * a buffer with the EOS flag. For components that don't
+ * handle empty EOS buffers */
+void
+gst_omx_port_signal_eos (GstOMXPort * port)
+{
+  GstOMXComponent *comp;
+
+  g_return_if_fail (port != NULL);
+  g_return_if_fail (port->port_def.eDir == OMX_DirOutput);
+
+  comp = port->comp;
+
+  GST_OMX_COMPONENT_LOCK (comp);
+  GST_DEBUG_OBJECT (comp->parent, "Signalling EOS on %s port %u", comp->name,
+      port->index);
+  g_atomic_int_set (&port->eos, TRUE);
+  gst_omx_component_send_message (comp, port, NULL);
+  GST_OMX_COMPONENT_UNLOCK (comp);
+}
+
+/* NOTE: Must be called with comp->lock
+ *
+ * Sets the port to flushing. Acquirers on the fast path that didn't
+ * see the flag yet only take buffers from the ring, once they are
+ * done every buffer is either pending or acquired */
+static void
+gst_omx_port_start_flushing (GstOMXPort * port)
+{
+  g_atomic_int_set (&port->flushing, TRUE);
+  while (g_atomic_int_get (&port->fast_acquirers) > 0)
+    g_thread_yield ();
+}
+
 /* NOTE: Uses comp->lock and comp->messages_lock */
 OMX_ERRORTYPE
 gst_omx_port_set_flushing (GstOMXPort * port, GstClockTime timeout,
@@ -1430,7 +4149,7 @@ gst_omx_port_set_flushing (GstOMXPort * port, GstClockTime timeout,
 
   comp = port->comp;
 
-  g_mutex_lock (&comp->lock);
+  GST_OMX_COMPONENT_LOCK (comp);
 
   GST_DEBUG_OBJECT (comp->parent, "Setting %s port %d to %sflushing",
       comp->name, port->index, (flush ? "" : "not "));
@@ -1449,18 +4168,19 @@ gst_omx_port_set_flushing (GstOMXPort * port, GstClockTime timeout,
     goto done;
   }
 
-  port->flushing = flush;
   if (flush) {
     gint64 wait_until = -1;
     gboolean signalled;
     OMX_ERRORTYPE last_error;
 
-    gst_omx_component_send_message (comp, NULL);
+    gst_omx_port_start_flushing (port);
+
+    gst_omx_component_send_message (comp, port, NULL);
 
     /* Now flush the port */
     port->flushed = FALSE;
 
-    err = OMX_SendCommand (comp->handle, OMX_CommandFlush, port->index, NULL);
+    err = gst_omx_component_send_command (comp, OMX_CommandFlush, port->index);
 
     if (err != OMX_ErrorNone) {
       GST_ERROR_OBJECT (comp->parent,
@@ -1486,9 +4206,7 @@ gst_omx_port_set_flushing (GstOMXPort * port, GstClockTime timeout,
       gint64 add = timeout / (GST_SECOND / G_TIME_SPAN_SECOND);
 
       if (add == 0) {
-        if (!port->flushed || (port->buffers
-                && port->buffers->len >
-                g_queue_get_length (&port->pending_buffers)))
+        if (!port->flushed || gst_omx_port_has_buffers_in_use (port))
           err = OMX_ErrorTimeout;
         goto done;
       }
@@ -1507,25 +4225,8 @@ gst_omx_port_set_flushing (GstOMXPort * port, GstClockTime timeout,
     last_error = OMX_ErrorNone;
     gst_omx_component_handle_messages (comp);
     while (signalled && last_error == OMX_ErrorNone && !port->flushed
-        && port->buffers
-        && port->buffers->len > g_queue_get_length (&port->pending_buffers)) {
-      g_mutex_lock (&comp->messages_lock);
-      g_mutex_unlock (&comp->lock);
-
-      if (!g_queue_is_empty (&comp->messages)) {
-        signalled = TRUE;
-      }
-      if (timeout == GST_CLOCK_TIME_NONE) {
-        g_cond_wait (&comp->messages_cond, &comp->messages_lock);
-        signalled = TRUE;
-      } else {
-        signalled =
-            g_cond_wait_until (&comp->messages_cond, &comp->messages_lock,
-            wait_until);
-      }
-
-      g_mutex_unlock (&comp->messages_lock);
-      g_mutex_lock (&comp->lock);
+        && gst_omx_port_has_buffers_in_use (port)) {
+      signalled = gst_omx_component_wait_message (comp, port, wait_until);
 
       if (signalled)
         gst_omx_component_handle_messages (comp);
@@ -1548,10 +4249,12 @@ gst_omx_port_set_flushing (GstOMXPort * port, GstClockTime timeout,
       err = OMX_ErrorTimeout;
       goto done;
     }
+  } else {
+    g_atomic_int_set (&port->flushing, FALSE);
   }
 
   /* Reset EOS flag */
-  port->eos = FALSE;
+  g_atomic_int_set (&port->eos, FALSE);
 
 done:
   gst_omx_port_update_port_definition (port, NULL);
@@ -1560,7 +4263,7 @@ done:
       comp->name, port->index, (flush ? "" : "not "),
       gst_omx_error_to_string (err), err);
   gst_omx_component_handle_messages (comp);
-  g_mutex_unlock (&comp->lock);
+  GST_OMX_COMPONENT_UNLOCK (comp);
 
   return err;
 }
@@ -1576,10 +4279,10 @@ gst_omx_port_is_flushing (GstOMXPort * port)
 
   comp = port->comp;
 
-  g_mutex_lock (&comp->lock);
+  GST_OMX_COMPONENT_LOCK (comp);
   gst_omx_component_handle_messages (port->comp);
   flushing = port->flushing;
-  g_mutex_unlock (&comp->lock);
+  GST_OMX_COMPONENT_UNLOCK (comp);
 
   GST_DEBUG_OBJECT (comp->parent, "%s port %u is flushing: %d", comp->name,
       port->index, flushing);
@@ -1635,6 +4338,13 @@ gst_omx_port_allocate_buffers_unlocked (GstOMXPort * port,
   if (!port->buffers)
     port->buffers = g_ptr_array_sized_new (n);
 
+  /* All buffers must fit into the ring of pending buffers. It's
+   * empty here, the callbacks don't touch it without buffers */
+  if (n > port->pending_buffers.mask + 1) {
+    gst_omx_ring_clear (&port->pending_buffers);
+    gst_omx_ring_init (&port->pending_buffers, 1 << g_bit_storage (n - 1));
+  }
+
   l = (buffers ? buffers : images);
   for (i = 0; i < n; i++) {
     GstOMXBuffer *buf;
@@ -1643,7 +4353,10 @@ gst_omx_port_allocate_buffers_unlocked (GstOMXPort * port,
     buf->port = port;
     buf->used = FALSE;
     buf->settings_cookie = port->settings_cookie;
+    buf->sent_at = buf->done_at = buf->acquired_at = GST_CLOCK_TIME_NONE;
     g_ptr_array_add (port->buffers, buf);
+    gst_omx_component_account_memory (comp, GST_OMX_MEMORY_WRAPPERS, 1,
+        sizeof (GstOMXBuffer));
 
     if (buffers) {
       err =
@@ -1675,8 +4388,14 @@ gst_omx_port_allocate_buffers_unlocked (GstOMXPort * port,
 
     g_assert (buf->omx_buf->pAppPrivate == buf);
 
+    if (!buffers && !images) {
+      buf->allocated_size = buf->omx_buf->nAllocLen;
+      gst_omx_component_account_memory (comp, GST_OMX_MEMORY_OMX_BUFFERS, 1,
+          buf->allocated_size);
+    }
+
     /* In the beginning all buffers are not owned by the component */
-    g_queue_push_tail (&port->pending_buffers, buf);
+    gst_omx_port_push_pending_buffer (port, buf);
     if (buffers || images)
       l = l->next;
   }
@@ -1700,9 +4419,9 @@ gst_omx_port_allocate_buffers (GstOMXPort * port)
 
   g_return_val_if_fail (port != NULL, OMX_ErrorUndefined);
 
-  g_mutex_lock (&port->comp->lock);
+  GST_OMX_COMPONENT_LOCK (port->comp);
   err = gst_omx_port_allocate_buffers_unlocked (port, NULL, NULL, -1);
-  g_mutex_unlock (&port->comp->lock);
+  GST_OMX_COMPONENT_UNLOCK (port->comp);
 
   return err;
 }
@@ -1716,10 +4435,10 @@ gst_omx_port_use_buffers (GstOMXPort * port, const GList * buffers)
 
   g_return_val_if_fail (port != NULL, OMX_ErrorUndefined);
 
-  g_mutex_lock (&port->comp->lock);
+  GST_OMX_COMPONENT_LOCK (port->comp);
   n = g_list_length ((GList *) buffers);
   err = gst_omx_port_allocate_buffers_unlocked (port, buffers, NULL, n);
-  g_mutex_unlock (&port->comp->lock);
+  GST_OMX_COMPONENT_UNLOCK (port->comp);
 
   return err;
 }
@@ -1733,10 +4452,10 @@ gst_omx_port_use_eglimages (GstOMXPort * port, const GList * images)
 
   g_return_val_if_fail (port != NULL, OMX_ErrorUndefined);
 
-  g_mutex_lock (&port->comp->lock);
+  GST_OMX_COMPONENT_LOCK (port->comp);
   n = g_list_length ((GList *) images);
   err = gst_omx_port_allocate_buffers_unlocked (port, NULL, images, n);
-  g_mutex_unlock (&port->comp->lock);
+  GST_OMX_COMPONENT_UNLOCK (port->comp);
 
   return err;
 }
@@ -1806,9 +4525,14 @@ gst_omx_port_deallocate_buffers_unlocked (GstOMXPort * port)
           err = tmp;
       }
     }
+    if (buf->allocated_size > 0)
+      gst_omx_component_account_memory (comp, GST_OMX_MEMORY_OMX_BUFFERS, -1,
+          -(gssize) buf->allocated_size);
+    gst_omx_component_account_memory (comp, GST_OMX_MEMORY_WRAPPERS, -1,
+        -(gssize) sizeof (GstOMXBuffer));
     g_slice_free (GstOMXBuffer, buf);
   }
-  g_queue_clear (&port->pending_buffers);
+  while (gst_omx_port_pop_pending_buffer (port));
   g_ptr_array_unref (port->buffers);
   port->buffers = NULL;
 
@@ -1831,9 +4555,9 @@ gst_omx_port_deallocate_buffers (GstOMXPort * port)
 
   g_return_val_if_fail (port != NULL, OMX_ErrorUndefined);
 
-  g_mutex_lock (&port->comp->lock);
+  GST_OMX_COMPONENT_LOCK (port->comp);
   err = gst_omx_port_deallocate_buffers_unlocked (port);
-  g_mutex_unlock (&port->comp->lock);
+  GST_OMX_COMPONENT_UNLOCK (port->comp);
 
   return err;
 }
@@ -1879,17 +4603,17 @@ gst_omx_port_set_enabled_unlocked (GstOMXPort * port, gboolean enabled)
     /* This is also like flushing, i.e. all buffers are returned
      * by the component and no new buffers should be passed to
      * the component anymore */
-    port->flushing = TRUE;
+    gst_omx_port_start_flushing (port);
   }
 
   if (enabled)
     err =
-        OMX_SendCommand (comp->handle, OMX_CommandPortEnable, port->index,
-        NULL);
+        gst_omx_component_send_command (comp, OMX_CommandPortEnable,
+        port->index);
   else
     err =
-        OMX_SendCommand (comp->handle, OMX_CommandPortDisable,
-        port->index, NULL);
+        gst_omx_component_send_command (comp, OMX_CommandPortDisable,
+        port->index);
 
   if (err != OMX_ErrorNone) {
     GST_ERROR_OBJECT (comp->parent,
@@ -1943,8 +4667,7 @@ gst_omx_port_wait_buffers_released_unlocked (GstOMXPort * port,
     gint64 add = timeout / (GST_SECOND / G_TIME_SPAN_SECOND);
 
     if (add == 0) {
-      if (port->buffers
-          && port->buffers->len > g_queue_get_length (&port->pending_buffers))
+      if (gst_omx_port_has_buffers_in_use (port))
         err = OMX_ErrorTimeout;
       goto done;
     }
@@ -1960,23 +4683,9 @@ gst_omx_port_wait_buffers_released_unlocked (GstOMXPort * port,
   signalled = TRUE;
   last_error = OMX_ErrorNone;
   gst_omx_component_handle_messages (comp);
-  while (signalled && last_error == OMX_ErrorNone && (port->buffers
-          && port->buffers->len >
-          g_queue_get_length (&port->pending_buffers))) {
-    g_mutex_lock (&comp->messages_lock);
-    g_mutex_unlock (&comp->lock);
-    if (!g_queue_is_empty (&comp->messages)) {
-      signalled = TRUE;
-    } else if (timeout != GST_CLOCK_TIME_NONE) {
-      signalled =
-          g_cond_wait_until (&comp->messages_cond, &comp->messages_lock,
-          wait_until);
-    } else {
-      signalled = TRUE;
-      g_cond_wait (&comp->messages_cond, &comp->messages_lock);
-    }
-    g_mutex_unlock (&comp->messages_lock);
-    g_mutex_lock (&comp->lock);
+  while (signalled && last_error == OMX_ErrorNone
+      && gst_omx_port_has_buffers_in_use (port)) {
+    signalled = gst_omx_component_wait_message (comp, port, wait_until);
     if (signalled)
       gst_omx_component_handle_messages (comp);
     last_error = comp->last_error;
@@ -2016,9 +4725,9 @@ gst_omx_port_wait_buffers_released (GstOMXPort * port, GstClockTime timeout)
 
   g_return_val_if_fail (port != NULL, OMX_ErrorUndefined);
 
-  g_mutex_lock (&port->comp->lock);
+  GST_OMX_COMPONENT_LOCK (port->comp);
   err = gst_omx_port_wait_buffers_released_unlocked (port, timeout);
-  g_mutex_unlock (&port->comp->lock);
+  GST_OMX_COMPONENT_UNLOCK (port->comp);
 
   return err;
 }
@@ -2031,9 +4740,9 @@ gst_omx_port_set_enabled (GstOMXPort * port, gboolean enabled)
 
   g_return_val_if_fail (port != NULL, OMX_ErrorUndefined);
 
-  g_mutex_lock (&port->comp->lock);
+  GST_OMX_COMPONENT_LOCK (port->comp);
   err = gst_omx_port_set_enabled_unlocked (port, enabled);
-  g_mutex_unlock (&port->comp->lock);
+  GST_OMX_COMPONENT_UNLOCK (port->comp);
 
   return err;
 }
@@ -2044,6 +4753,7 @@ gst_omx_port_populate_unlocked (GstOMXPort * port)
   GstOMXComponent *comp;
   OMX_ERRORTYPE err = OMX_ErrorNone;
   GstOMXBuffer *buf;
+  gint i, n;
 
   g_return_val_if_fail (port != NULL, OMX_ErrorUndefined);
 
@@ -2068,11 +4778,10 @@ gst_omx_port_populate_unlocked (GstOMXPort * port)
   }
 
   if (port->port_def.eDir == OMX_DirOutput && port->buffers && !port->tunneled) {
-    /* Enqueue all buffers for the component to fill */
-    while ((buf = g_queue_pop_head (&port->pending_buffers))) {
-      if (!buf)
-        continue;
-
+    /* Enqueue all buffers for the component to fill. Only the ones
+     * pending now, the component could return some immediately */
+    n = g_atomic_int_get (&port->n_pending_buffers);
+    for (i = 0; i < n && (buf = gst_omx_port_pop_pending_buffer (port)); i++) {
       g_assert (!buf->used);
 
       /* Reset all flags, some implementations don't
@@ -2081,7 +4790,11 @@ gst_omx_port_populate_unlocked (GstOMXPort * port)
        */
       buf->omx_buf->nFlags = 0;
 
-      err = OMX_FillThisBuffer (comp->handle, buf->omx_buf);
+      if (GST_OMX_LATENCY_TRACING ())
+        gst_omx_buffer_trace_latency (buf, NULL, GST_OMX_LATENCY_COMPONENT,
+            &buf->sent_at);
+
+      err = gst_omx_port_pass_buffer (port, buf);
 
       if (err != OMX_ErrorNone) {
         GST_ERROR_OBJECT (comp->parent,
@@ -2113,9 +4826,9 @@ gst_omx_port_populate (GstOMXPort * port)
 
   g_return_val_if_fail (port != NULL, OMX_ErrorUndefined);
 
-  g_mutex_lock (&port->comp->lock);
+  GST_OMX_COMPONENT_LOCK (port->comp);
   err = gst_omx_port_populate_unlocked (port);
-  g_mutex_unlock (&port->comp->lock);
+  GST_OMX_COMPONENT_UNLOCK (port->comp);
 
   return err;
 }
@@ -2178,20 +4891,7 @@ gst_omx_port_wait_enabled_unlocked (GstOMXPort * port, GstClockTime timeout)
   while (signalled && last_error == OMX_ErrorNone &&
       (! !port->port_def.bEnabled != ! !enabled || port->enabled_pending
           || port->disabled_pending)) {
-    g_mutex_lock (&comp->messages_lock);
-    g_mutex_unlock (&comp->lock);
-    if (!g_queue_is_empty (&comp->messages)) {
-      signalled = TRUE;
-    } else if (timeout != GST_CLOCK_TIME_NONE) {
-      signalled =
-          g_cond_wait_until (&comp->messages_cond, &comp->messages_lock,
-          wait_until);
-    } else {
-      signalled = TRUE;
-      g_cond_wait (&comp->messages_cond, &comp->messages_lock);
-    }
-    g_mutex_unlock (&comp->messages_lock);
-    g_mutex_lock (&comp->lock);
+    signalled = gst_omx_component_wait_message (comp, port, wait_until);
     if (signalled)
       gst_omx_component_handle_messages (comp);
     last_error = comp->last_error;
@@ -2214,9 +4914,9 @@ gst_omx_port_wait_enabled_unlocked (GstOMXPort * port, GstClockTime timeout)
     err = last_error;
   } else {
     if (enabled) {
-      port->flushing = FALSE;
+      g_atomic_int_set (&port->flushing, FALSE);
       /* Reset EOS flag */
-      port->eos = FALSE;
+      g_atomic_int_set (&port->eos, FALSE);
     }
   }
 
@@ -2240,9 +4940,9 @@ gst_omx_port_wait_enabled (GstOMXPort * port, GstClockTime timeout)
 
   g_return_val_if_fail (port != NULL, OMX_ErrorUndefined);
 
-  g_mutex_lock (&port->comp->lock);
+  GST_OMX_COMPONENT_LOCK (port->comp);
   err = gst_omx_port_wait_enabled_unlocked (port, timeout);
-  g_mutex_unlock (&port->comp->lock);
+  GST_OMX_COMPONENT_UNLOCK (port->comp);
 
   return err;
 }
@@ -2263,6 +4963,74 @@ gst_omx_port_is_enabled (GstOMXPort * port)
   return enabled;
 }
 
+/* Returns the OMX_COLOR_FORMATTYPEs the video port supports at
+ * framerate, in the order of OMX_IndexParamVideoPortFormat. They're
+ * taken from the capability cache if possible, otherwise the component
+ * is queried and the cache updated. Free with g_free() */
+gint *
+gst_omx_port_get_video_color_formats (GstOMXPort * port, OMX_U32 framerate,
+    gsize * n_formats)
+{
+  GstOMXComponent *comp;
+  OMX_VIDEO_PARAM_PORTFORMATTYPE param;
+  OMX_ERRORTYPE err;
+  GArray *formats;
+  gchar *key;
+  gint *cached;
+  gint old_index;
+
+  g_return_val_if_fail (port != NULL, NULL);
+  g_return_val_if_fail (n_formats != NULL, NULL);
+
+  comp = port->comp;
+
+  key = g_strdup_printf ("video-color-formats-%u-%u", (guint) port->index,
+      (guint) framerate);
+  cached = gst_omx_component_get_cached_integers (comp, key, n_formats);
+  if (cached) {
+    GST_DEBUG_OBJECT (comp->parent, "Using %" G_GSIZE_FORMAT " cached color "
+        "formats of %s port %u", *n_formats, comp->name, port->index);
+    g_free (key);
+    return cached;
+  }
+
+  formats = g_array_new (FALSE, FALSE, sizeof (gint));
+
+  GST_OMX_INIT_STRUCT (&param);
+  param.nPortIndex = port->index;
+  param.nIndex = 0;
+  param.xFramerate = framerate;
+
+  old_index = -1;
+  do {
+    gint format;
+
+    err =
+        gst_omx_component_get_parameter (comp,
+        OMX_IndexParamVideoPortFormat, &param);
+
+    /* FIXME: Workaround for Bellagio that simply always
+     * returns the same value regardless of nIndex and
+     * never returns OMX_ErrorNoMore
+     */
+    if (old_index == param.nIndex)
+      break;
+
+    if (err == OMX_ErrorNone || err == OMX_ErrorNoMore) {
+      format = param.eColorFormat;
+      g_array_append_val (formats, format);
+    }
+    old_index = param.nIndex++;
+  } while (err == OMX_ErrorNone);
+
+  gst_omx_component_set_cached_integers (comp, key,
+      (const gint *) formats->data, formats->len);
+  g_free (key);
+
+  *n_formats = formats->len;
+  return (gint *) g_array_free (formats, FALSE);
+}
+
 /* NOTE: Uses comp->lock and comp->messages_lock */
 OMX_ERRORTYPE
 gst_omx_port_mark_reconfigured (GstOMXPort * port)
@@ -2274,7 +5042,7 @@ gst_omx_port_mark_reconfigured (GstOMXPort * port)
 
   comp = port->comp;
 
-  g_mutex_lock (&comp->lock);
+  GST_OMX_COMPONENT_LOCK (comp);
   GST_INFO_OBJECT (comp->parent, "Marking %s port %u is reconfigured",
       comp->name, port->index);
 
@@ -2283,20 +5051,21 @@ gst_omx_port_mark_reconfigured (GstOMXPort * port)
   if ((err = comp->last_error) != OMX_ErrorNone)
     goto done;
 
-  port->configured_settings_cookie = port->settings_cookie;
+  g_atomic_int_set (&port->configured_settings_cookie,
+      port->settings_cookie);
 
   if (port->port_def.eDir == OMX_DirOutput) {
     GList *l;
 
     for (l = comp->pending_reconfigure_outports; l; l = l->next) {
       if (l->data == (gpointer) port) {
-        comp->pending_reconfigure_outports =
-            g_list_delete_link (comp->pending_reconfigure_outports, l);
+        g_atomic_pointer_set (&comp->pending_reconfigure_outports,
+            g_list_delete_link (comp->pending_reconfigure_outports, l));
         break;
       }
     }
     if (!comp->pending_reconfigure_outports)
-      gst_omx_component_send_message (comp, NULL);
+      gst_omx_component_send_message (comp, NULL, NULL);
   }
 
 done:
@@ -2305,39 +5074,11 @@ done:
   GST_INFO_OBJECT (comp->parent, "Marked %s port %u as reconfigured: %s "
       "(0x%08x)", comp->name, port->index, gst_omx_error_to_string (err), err);
 
-  g_mutex_unlock (&comp->lock);
+  GST_OMX_COMPONENT_UNLOCK (comp);
 
   return err;
 }
 
-typedef GType (*GGetTypeFunction) (void);
-
-static const GGetTypeFunction types[] = {
-  gst_omx_mpeg2_video_dec_get_type, gst_omx_mpeg4_video_dec_get_type,
-  gst_omx_h264_dec_get_type, gst_omx_h263_dec_get_type,
-  gst_omx_wmv_dec_get_type, gst_omx_mpeg4_video_enc_get_type,
-  gst_omx_h264_enc_get_type, gst_omx_h263_enc_get_type,
-  gst_omx_aac_enc_get_type, gst_omx_mjpeg_dec_get_type
-#ifdef HAVE_VP8
-      , gst_omx_vp8_dec_get_type
-#endif
-#ifdef HAVE_THEORA
-      , gst_omx_theora_dec_get_type
-#endif
-};
-
-struct TypeOffest
-{
-  GType (*get_type) (void);
-  glong offset;
-};
-
-static const struct TypeOffest base_types[] = {
-  {gst_omx_video_dec_get_type, G_STRUCT_OFFSET (GstOMXVideoDecClass, cdata)},
-  {gst_omx_video_enc_get_type, G_STRUCT_OFFSET (GstOMXVideoEncClass, cdata)},
-  {gst_omx_audio_enc_get_type, G_STRUCT_OFFSET (GstOMXAudioEncClass, cdata)},
-};
-
 static GKeyFile *config = NULL;
 GKeyFile *
 gst_omx_get_configuration (void)
@@ -2345,6 +5086,13 @@ gst_omx_get_configuration (void)
   return config;
 }
 
+/* Called once from plugin_init, takes ownership of the configuration */
+void
+gst_omx_set_configuration (GKeyFile * new_config)
+{
+  config = new_config;
+}
+
 const gchar *
 gst_omx_error_to_string (OMX_ERRORTYPE err)
 {
@@ -2488,6 +5236,225 @@ gst_omx_command_to_string (OMX_COMMANDTYPE cmd)
   return "Unknown command";
 }
 
+static const gchar *
+gst_omx_event_to_string (OMX_EVENTTYPE event)
+{
+  switch (event) {
+    case OMX_EventCmdComplete:
+      return "CmdComplete";
+    case OMX_EventError:
+      return "Error";
+    case OMX_EventMark:
+      return "Mark";
+    case OMX_EventPortSettingsChanged:
+      return "PortSettingsChanged";
+    case OMX_EventBufferFlag:
+      return "BufferFlag";
+    case OMX_EventResourcesAcquired:
+      return "ResourcesAcquired";
+    case OMX_EventComponentResumed:
+      return "ComponentResumed";
+    case OMX_EventDynamicResourcesAvailable:
+      return "DynamicResourcesAvailable";
+    case OMX_EventPortFormatDetected:
+      return "PortFormatDetected";
+    default:
+      if (event >= OMX_EventVendorStartUnused)
+        return "VendorExtensionEvent";
+      else if (event >= OMX_EventKhronosExtensions)
+        return "KhronosExtensionEvent";
+      break;
+  }
+  return "Unknown event";
+}
+
+static const gchar *
+gst_omx_flight_event_type_to_string (GstOMXFlightEventType type)
+{
+  switch (type) {
+    case GST_OMX_FLIGHT_EVENT_COMMAND:
+      return "SendCommand";
+    case GST_OMX_FLIGHT_EVENT_CALLBACK:
+      return "EventHandler";
+    case GST_OMX_FLIGHT_EVENT_EMPTY_THIS_BUFFER:
+      return "EmptyThisBuffer";
+    case GST_OMX_FLIGHT_EVENT_FILL_THIS_BUFFER:
+      return "FillThisBuffer";
+    case GST_OMX_FLIGHT_EVENT_EMPTY_BUFFER_DONE:
+      return "EmptyBufferDone";
+    case GST_OMX_FLIGHT_EVENT_FILL_BUFFER_DONE:
+      return "FillBufferDone";
+    case GST_OMX_FLIGHT_EVENT_CALL_FAILED:
+      return "CallFailed";
+    default:
+      break;
+  }
+  return "Unknown";
+}
+
+static void
+gst_omx_flight_event_write (FILE * f, const GstOMXFlightEvent * ev)
+{
+  const gchar *name = gst_omx_flight_event_type_to_string (ev->type);
+
+  switch (ev->type) {
+    case GST_OMX_FLIGHT_EVENT_COMMAND:
+      if (ev->data1 == OMX_CommandStateSet)
+        fprintf (f, "%s %s %s\n", name,
+            gst_omx_command_to_string (ev->data1),
+            gst_omx_state_to_string (ev->data2));
+      else
+        fprintf (f, "%s %s %u\n", name,
+            gst_omx_command_to_string (ev->data1), ev->data2);
+      break;
+    case GST_OMX_FLIGHT_EVENT_CALLBACK:
+      if (ev->data1 == OMX_EventError)
+        fprintf (f, "%s %s %s (0x%08x)\n", name,
+            gst_omx_event_to_string (ev->data1),
+            gst_omx_error_to_string (ev->data2), ev->data2);
+      else if (ev->data1 == OMX_EventCmdComplete)
+        fprintf (f, "%s %s %s %u\n", name,
+            gst_omx_event_to_string (ev->data1),
+            gst_omx_command_to_string (ev->data2), ev->data3);
+      else
+        fprintf (f, "%s %s 0x%08x 0x%08x\n", name,
+            gst_omx_event_to_string (ev->data1), ev->data2, ev->data3);
+      break;
+    case GST_OMX_FLIGHT_EVENT_EMPTY_THIS_BUFFER:
+    case GST_OMX_FLIGHT_EVENT_FILL_THIS_BUFFER:
+    case GST_OMX_FLIGHT_EVENT_EMPTY_BUFFER_DONE:
+    case GST_OMX_FLIGHT_EVENT_FILL_BUFFER_DONE:
+      fprintf (f, "%s port %u buffer 0x%" G_GINT64_MODIFIER "x flags 0x%08x "
+          "filled %u\n", name, ev->data1, ev->buffer, ev->data2, ev->data3);
+      break;
+    case GST_OMX_FLIGHT_EVENT_CALL_FAILED:
+      fprintf (f, "%s %s %u: %s (0x%08x)\n", name,
+          gst_omx_flight_event_type_to_string (ev->data1), ev->data3,
+          gst_omx_error_to_string (ev->data2), ev->data2);
+      break;
+    default:
+      fprintf (f, "%s %u 0x%08x 0x%08x 0x%08x\n", name, ev->type, ev->data1,
+          ev->data2, ev->data3);
+      break;
+  }
+}
+
+/* NOTE: Does not take any lock
+ *
+ * Copies the events of the flight recorder, NULL if it is disabled.
+ * reason must be a static string. Events that are recorded while
+ * copying might be garbled */
+static GstOMXFlightDump *
+gst_omx_flight_dump_new (GstOMXComponent * comp, const gchar * reason)
+{
+  GstOMXFlightDump *dump;
+
+  if (!comp->flight_events)
+    return NULL;
+
+  dump = g_slice_new (GstOMXFlightDump);
+  dump->size = comp->flight_mask + 1;
+  dump->pos = (guint) g_atomic_int_get (&comp->flight_pos);
+  dump->events = g_new (GstOMXFlightEvent, dump->size);
+  memcpy (dump->events, comp->flight_events,
+      dump->size * sizeof (GstOMXFlightEvent));
+  dump->element =
+      g_strdup (comp->parent ? GST_OBJECT_NAME (comp->parent) : "(pooled)");
+  dump->component = g_strdup (comp->name);
+  dump->reason = reason;
+  dump->seq = g_atomic_int_add (&comp->flight_dumps, 1);
+
+  return dump;
+}
+
+/* Writes the dump in readable form to a new file in the
+ * GST_OMX_FLIGHT_RECORDER_DIR or tmp directory and frees it. Returns
+ * the name of the file or NULL if it could not be written */
+static gchar *
+gst_omx_flight_dump_write (GstOMXFlightDump * dump)
+{
+  GstClockTime first = GST_CLOCK_TIME_NONE, prev = 0;
+  const gchar *dir;
+  gchar *basename, *filename;
+  guint i;
+  FILE *f;
+
+  dir = g_getenv (GST_OMX_FLIGHT_RECORDER_DIR_ENV);
+  if (!dir || *dir == '\0')
+    dir = g_get_tmp_dir ();
+  basename = g_strdup_printf ("gst-omx-flight-%d-%s-%s-%d.log",
+      (gint) getpid (), dump->element, dump->component, dump->seq);
+  filename = g_build_filename (dir, basename, NULL);
+  g_free (basename);
+
+  f = fopen (filename, "w");
+  if (!f) {
+    GST_ERROR ("Failed to open '%s' for the flight recorder of %s (%s): %s",
+        filename, dump->component, dump->element, g_strerror (errno));
+    g_free (filename);
+    filename = NULL;
+    goto done;
+  }
+
+  fprintf (f, "# Flight recorder of %s (%s), reason: %s\n", dump->component,
+      dump->element, dump->reason);
+  fprintf (f, "# %u events recorded, showing the last %u\n", dump->pos,
+      MIN (dump->pos, dump->size));
+
+  for (i = (dump->pos > dump->size ? dump->pos - dump->size : 0);
+      i != dump->pos; i++) {
+    const GstOMXFlightEvent *ev = &dump->events[i & (dump->size - 1)];
+
+    if (ev->type == 0)
+      continue;
+
+    if (!GST_CLOCK_TIME_IS_VALID (first))
+      first = prev = ev->time;
+    fprintf (f, "%" GST_TIME_FORMAT " (+%" G_GUINT64_FORMAT " ns) ",
+        GST_TIME_ARGS (ev->time - first), ev->time - prev);
+    prev = ev->time;
+    gst_omx_flight_event_write (f, ev);
+  }
+
+  if (fclose (f) != 0) {
+    GST_ERROR ("Failed to write '%s': %s", filename, g_strerror (errno));
+    g_free (filename);
+    filename = NULL;
+  } else {
+    GST_WARNING ("Dumped flight recorder of %s (%s) to '%s' (%s)",
+        dump->component, dump->element, filename, dump->reason);
+  }
+
+done:
+  g_free (dump->events);
+  g_free (dump->element);
+  g_free (dump->component);
+  g_slice_free (GstOMXFlightDump, dump);
+
+  return filename;
+}
+
+/* NOTE: Does not take any lock
+ *
+ * Writes the events of the flight recorder in readable form to a new
+ * file in the GST_OMX_FLIGHT_RECORDER_DIR or tmp directory. Returns the
+ * name of the file or NULL if the flight recorder is disabled or the
+ * file could not be written. reason must be a static string */
+gchar *
+gst_omx_component_dump_flight_recorder (GstOMXComponent * comp,
+    const gchar * reason)
+{
+  GstOMXFlightDump *dump;
+
+  g_return_val_if_fail (comp != NULL, NULL);
+  g_return_val_if_fail (reason != NULL, NULL);
+
+  if (!(dump = gst_omx_flight_dump_new (comp, reason)))
+    return NULL;
+
+  return gst_omx_flight_dump_write (dump);
+}
+
 #if defined(USE_OMX_TARGET_RPI)
 #define DEFAULT_HACKS (GST_OMX_HACK_NO_COMPONENT_ROLE)
 #else
@@ -2537,314 +5504,3 @@ gst_omx_set_default_role (GstOMXClassData * class_data,
   if (!class_data->component_role)
     class_data->component_role = default_role;
 }
-
-static void
-_class_init (gpointer g_class, gpointer data)
-{
-  GstElementClass *element_class = GST_ELEMENT_CLASS (g_class);
-  GstOMXClassData *class_data = NULL;
-  GKeyFile *config;
-  const gchar *element_name = data;
-  GError *err;
-  gchar *core_name, *component_name, *component_role;
-  gint in_port_index, out_port_index;
-  gchar *template_caps;
-  GstPadTemplate *templ;
-  GstCaps *caps;
-  gchar **hacks;
-  int i;
-
-  if (!element_name)
-    return;
-
-  /* Find the GstOMXClassData for this class */
-  for (i = 0; i < G_N_ELEMENTS (base_types); i++) {
-    GType gtype = base_types[i].get_type ();
-
-    if (G_TYPE_CHECK_CLASS_TYPE (g_class, gtype)) {
-      class_data = (GstOMXClassData *)
-          (((guint8 *) g_class) + base_types[i].offset);
-      break;
-    }
-  }
-
-  g_assert (class_data != NULL);
-
-  config = gst_omx_get_configuration ();
-
-  /* This will alwaxys succeed, see check in plugin_init */
-  core_name = g_key_file_get_string (config, element_name, "core-name", NULL);
-  g_assert (core_name != NULL);
-  class_data->core_name = core_name;
-  component_name =
-      g_key_file_get_string (config, element_name, "component-name", NULL);
-  g_assert (component_name != NULL);
-  class_data->component_name = component_name;
-
-  /* If this fails we simply don't set a role */
-  if ((component_role =
-          g_key_file_get_string (config, element_name, "component-role",
-              NULL))) {
-    GST_DEBUG ("Using component-role '%s' for element '%s'", component_role,
-        element_name);
-    class_data->component_role = component_role;
-  }
-
-
-  /* Now set the inport/outport indizes and assume sane defaults */
-  err = NULL;
-  in_port_index =
-      g_key_file_get_integer (config, element_name, "in-port-index", &err);
-  if (err != NULL) {
-    GST_DEBUG ("No 'in-port-index' set for element '%s', auto-detecting: %s",
-        element_name, err->message);
-    in_port_index = -1;
-    g_error_free (err);
-  }
-  class_data->in_port_index = in_port_index;
-
-  err = NULL;
-  out_port_index =
-      g_key_file_get_integer (config, element_name, "out-port-index", &err);
-  if (err != NULL) {
-    GST_DEBUG ("No 'out-port-index' set for element '%s', auto-detecting: %s",
-        element_name, err->message);
-    out_port_index = -1;
-    g_error_free (err);
-  }
-  class_data->out_port_index = out_port_index;
-
-  /* Add pad templates */
-  err = NULL;
-  if (class_data->type != GST_OMX_COMPONENT_TYPE_SOURCE) {
-    if (!(template_caps =
-            g_key_file_get_string (config, element_name, "sink-template-caps",
-                &err))) {
-      GST_DEBUG
-          ("No sink template caps specified for element '%s', using default '%s'",
-          element_name, class_data->default_sink_template_caps);
-      caps = gst_caps_from_string (class_data->default_sink_template_caps);
-      g_assert (caps != NULL);
-      g_error_free (err);
-    } else {
-      caps = gst_caps_from_string (template_caps);
-      if (!caps) {
-        GST_DEBUG
-            ("Could not parse sink template caps '%s' for element '%s', using default '%s'",
-            template_caps, element_name,
-            class_data->default_sink_template_caps);
-        caps = gst_caps_from_string (class_data->default_sink_template_caps);
-        g_assert (caps != NULL);
-      }
-    }
-    templ = gst_pad_template_new ("sink", GST_PAD_SINK, GST_PAD_ALWAYS, caps);
-    g_free (template_caps);
-    gst_element_class_add_pad_template (element_class, templ);
-  }
-
-  err = NULL;
-  if (class_data->type != GST_OMX_COMPONENT_TYPE_SINK) {
-    if (!(template_caps =
-            g_key_file_get_string (config, element_name, "src-template-caps",
-                &err))) {
-      GST_DEBUG
-          ("No src template caps specified for element '%s', using default '%s'",
-          element_name, class_data->default_src_template_caps);
-      caps = gst_caps_from_string (class_data->default_src_template_caps);
-      g_assert (caps != NULL);
-      g_error_free (err);
-    } else {
-      caps = gst_caps_from_string (template_caps);
-      if (!caps) {
-        GST_DEBUG
-            ("Could not parse src template caps '%s' for element '%s', using default '%s'",
-            template_caps, element_name, class_data->default_src_template_caps);
-        caps = gst_caps_from_string (class_data->default_src_template_caps);
-        g_assert (caps != NULL);
-      }
-    }
-    templ = gst_pad_template_new ("src", GST_PAD_SRC, GST_PAD_ALWAYS, caps);
-    g_free (template_caps);
-    gst_element_class_add_pad_template (element_class, templ);
-  }
-
-  if ((hacks =
-          g_key_file_get_string_list (config, element_name, "hacks", NULL,
-              NULL))) {
-#ifndef GST_DISABLE_GST_DEBUG
-    gchar **walk = hacks;
-
-    while (*walk) {
-      GST_DEBUG ("Using hack: %s", *walk);
-      walk++;
-    }
-#endif
-
-    class_data->hacks = gst_omx_parse_hacks (hacks);
-  }
-}
-
-static gboolean
-plugin_init (GstPlugin * plugin)
-{
-  gboolean ret = FALSE;
-  GError *err = NULL;
-  gchar **config_dirs;
-  gchar **elements;
-  gchar *env_config_dir;
-  const gchar *user_config_dir;
-  const gchar *const *system_config_dirs;
-  gint i, j;
-  gsize n_elements;
-  static const gchar *config_name[] = { "gstomx.conf", NULL };
-  static const gchar *env_config_name[] = { "GST_OMX_CONFIG_DIR", NULL };
-
-  GST_DEBUG_CATEGORY_INIT (gstomx_debug, "omx", 0, "gst-omx");
-
-  /* Read configuration file gstomx.conf from the preferred
-   * configuration directories */
-  env_config_dir = g_strdup (g_getenv (*env_config_name));
-  user_config_dir = g_get_user_config_dir ();
-  system_config_dirs = g_get_system_config_dirs ();
-  config_dirs =
-      g_new (gchar *, g_strv_length ((gchar **) system_config_dirs) + 3);
-
-  i = 0;
-  j = 0;
-  if (env_config_dir)
-    config_dirs[i++] = (gchar *) env_config_dir;
-  config_dirs[i++] = (gchar *) user_config_dir;
-  while (system_config_dirs[j])
-    config_dirs[i++] = (gchar *) system_config_dirs[j++];
-  config_dirs[i++] = NULL;
-
-  gst_plugin_add_dependency (plugin, env_config_name,
-      (const gchar **) (config_dirs + (env_config_dir ? 1 : 0)), config_name,
-      GST_PLUGIN_DEPENDENCY_FLAG_NONE);
-
-  config = g_key_file_new ();
-  if (!g_key_file_load_from_dirs (config, *config_name,
-          (const gchar **) config_dirs, NULL, G_KEY_FILE_NONE, &err)) {
-    gchar *paths;
-
-    paths = g_strjoinv (":", config_dirs);
-    GST_ERROR ("Failed to load configuration file: %s (searched in: %s as per "
-        "GST_OMX_CONFIG_DIR environment variable, the xdg user config "
-        "directory (or XDG_CONFIG_HOME) and the system config directory "
-        "(or XDG_CONFIG_DIRS)", err->message, paths);
-    g_free (paths);
-    g_error_free (err);
-    goto done;
-  }
-
-  /* Initialize all types */
-  for (i = 0; i < G_N_ELEMENTS (types); i++)
-    types[i] ();
-
-  elements = g_key_file_get_groups (config, &n_elements);
-  for (i = 0; i < n_elements; i++) {
-    GTypeQuery type_query;
-    GTypeInfo type_info = { 0, };
-    GType type, subtype;
-    gchar *type_name, *core_name, *component_name;
-    gint rank;
-
-    GST_DEBUG ("Registering element '%s'", elements[i]);
-
-    err = NULL;
-    if (!(type_name =
-            g_key_file_get_string (config, elements[i], "type-name", &err))) {
-      GST_ERROR
-          ("Unable to read 'type-name' configuration for element '%s': %s",
-          elements[i], err->message);
-      g_error_free (err);
-      continue;
-    }
-
-    type = g_type_from_name (type_name);
-    if (type == G_TYPE_INVALID) {
-      GST_ERROR ("Invalid type name '%s' for element '%s'", type_name,
-          elements[i]);
-      g_free (type_name);
-      continue;
-    }
-    if (!g_type_is_a (type, GST_TYPE_ELEMENT)) {
-      GST_ERROR ("Type '%s' is no GstElement subtype for element '%s'",
-          type_name, elements[i]);
-      g_free (type_name);
-      continue;
-    }
-    g_free (type_name);
-
-    /* And now some sanity checking */
-    err = NULL;
-    if (!(core_name =
-            g_key_file_get_string (config, elements[i], "core-name", &err))) {
-      GST_ERROR
-          ("Unable to read 'core-name' configuration for element '%s': %s",
-          elements[i], err->message);
-      g_error_free (err);
-      continue;
-    }
-    if (!g_file_test (core_name, G_FILE_TEST_IS_REGULAR)) {
-      GST_ERROR ("Core '%s' does not exist for element '%s'", core_name,
-          elements[i]);
-      g_free (core_name);
-      continue;
-    }
-    g_free (core_name);
-
-    err = NULL;
-    if (!(component_name =
-            g_key_file_get_string (config, elements[i], "component-name",
-                &err))) {
-      GST_ERROR
-          ("Unable to read 'component-name' configuration for element '%s': %s",
-          elements[i], err->message);
-      g_error_free (err);
-      continue;
-    }
-    g_free (component_name);
-
-    err = NULL;
-    rank = g_key_file_get_integer (config, elements[i], "rank", &err);
-    if (err != NULL) {
-      GST_ERROR ("No rank set for element '%s': %s", elements[i], err->message);
-      g_error_free (err);
-      continue;
-    }
-
-    /* And now register the type, all other configuration will
-     * be handled by the type itself */
-    g_type_query (type, &type_query);
-    memset (&type_info, 0, sizeof (type_info));
-    type_info.class_size = type_query.class_size;
-    type_info.instance_size = type_query.instance_size;
-    type_info.class_init = _class_init;
-    type_info.class_data = g_strdup (elements[i]);
-    type_name = g_strdup_printf ("%s-%s", g_type_name (type), elements[i]);
-    if (g_type_from_name (type_name) != G_TYPE_INVALID) {
-      GST_ERROR ("Type '%s' already exists for element '%s'", type_name,
-          elements[i]);
-      g_free (type_name);
-      continue;
-    }
-    subtype = g_type_register_static (type, type_name, &type_info, 0);
-    g_free (type_name);
-    ret |= gst_element_register (plugin, elements[i], rank, subtype);
-  }
-  g_strfreev (elements);
-
-done:
-  g_free (env_config_dir);
-  g_free (config_dirs);
-
-  return ret;
-}
-
-GST_PLUGIN_DEFINE (GST_VERSION_MAJOR,
-    GST_VERSION_MINOR,
-    omx,
-    "GStreamer OpenMAX Plug-ins",
-    plugin_init,
-    PACKAGE_VERSION, GST_LICENSE, GST_PACKAGE_NAME, GST_PACKAGE_ORIGIN)
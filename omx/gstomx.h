@@ -25,6 +25,7 @@
 
 #include <gmodule.h>
 #include <gst/gst.h>
+#include <stdio.h>
 #include <string.h>
 
 #ifdef HAVE_CONFIG_H
@@ -56,6 +57,8 @@
 #pragma pack()
 #endif
 
+#include "gstomxtrace.h"
+
 G_BEGIN_DECLS
 
 #define GST_OMX_INIT_STRUCT(st) G_STMT_START { \
@@ -114,6 +117,17 @@ typedef struct _GstOMXComponent GstOMXComponent;
 typedef struct _GstOMXBuffer GstOMXBuffer;
 typedef struct _GstOMXClassData GstOMXClassData;
 typedef struct _GstOMXMessage GstOMXMessage;
+typedef struct _GstOMXRing GstOMXRing;
+typedef struct _GstOMXLockStats GstOMXLockStats;
+typedef struct _GstOMXMemoryUsage GstOMXMemoryUsage;
+typedef struct _GstOMXAdmissionBudget GstOMXAdmissionBudget;
+typedef struct _GstOMXLatencyBuffer GstOMXLatencyBuffer;
+typedef struct _GstOMXFlightDump GstOMXFlightDump;
+typedef struct _GstOMXTraceWriter GstOMXTraceWriter;
+
+typedef void (*GstOMXPortNotifyFunc) (GstOMXPort *port, gpointer user_data);
+typedef void (*GstOMXComponentStateNotifyFunc) (GstOMXComponent *comp, OMX_STATETYPE state, gpointer user_data);
+typedef struct _GstOMXRingSlot GstOMXRingSlot;
 
 typedef enum {
   /* Everything good and the buffer is valid */
@@ -125,7 +139,9 @@ typedef enum {
   /* The port is EOS */
   GST_OMX_ACQUIRE_BUFFER_EOS,
   /* A fatal error happened */
-  GST_OMX_ACQUIRE_BUFFER_ERROR
+  GST_OMX_ACQUIRE_BUFFER_ERROR,
+  /* No buffer is available before the deadline */
+  GST_OMX_ACQUIRE_BUFFER_NO_AVAILABLE
 } GstOMXAcquireBufferReturn;
 
 struct _GstOMXCore {
@@ -133,10 +149,22 @@ struct _GstOMXCore {
   GModule *module;
 
   /* Current number of users, transitions from/to 0
-   * call init/deinit */
+   * call init/deinit unless the core lingers */
   GMutex lock;
   gint user_count; /* LOCK */
 
+  /* Time in ms the core stays initialized without users, -1 for
+   * as long as the process runs. From the "core-linger" setting,
+   * set once when the core is loaded */
+  gint linger;
+  /* TRUE between init and deinit, protected with LOCK */
+  gboolean initialized;
+  /* Running while the core lingers, deinits it once linger_deadline
+   * (monotonic time) passed without users. Protected with LOCK */
+  GThread *linger_thread;
+  GCond linger_cond;
+  gint64 linger_deadline;
+
   /* OpenMAX core library functions, protected with LOCK */
   OMX_ERRORTYPE (*init) (void);
   OMX_ERRORTYPE (*deinit) (void);
@@ -153,9 +181,100 @@ typedef enum {
   GST_OMX_MESSAGE_PORT_ENABLE,
   GST_OMX_MESSAGE_PORT_SETTINGS_CHANGED,
   GST_OMX_MESSAGE_BUFFER_FLAG,
-  GST_OMX_MESSAGE_BUFFER_DONE,
 } GstOMXMessageType;
 
+/* Bounded lock-free ring of pointers. Pushing and popping never
+ * blocks and is safe from any number of threads */
+struct _GstOMXRing {
+  GstOMXRingSlot *slots;
+  guint mask; /* Number of slots - 1, always a power of two */
+
+  volatile gint head; /* Next position to pop from */
+  volatile gint tail; /* Next position to push to */
+};
+
+/* Number of messages that fit into a component's message ring
+ * before they go to the overflow queue */
+#define GST_OMX_MESSAGE_RING_SIZE (256)
+
+/* Number of preallocated messages per component, everything
+ * above is allocated from the heap. Returned buffers don't
+ * need messages, so this only has to cover events and command
+ * completions */
+#define GST_OMX_MESSAGE_ARENA_SIZE (32)
+
+/* Initial size of a port's ring of pending buffers, it grows
+ * if more buffers are allocated */
+#define GST_OMX_PORT_PENDING_RING_SIZE (32)
+
+/* Maximum number of buffers the base classes pass to
+ * the component with a single release call */
+#define GST_OMX_PORT_MAX_BATCH_SIZE (16)
+
+/* Environment variable that enables the lock statistics of all
+ * components if set to anything but "0" */
+#define GST_OMX_LOCK_STATS_ENV "GST_OMX_LOCK_STATS"
+
+/* Number of buckets of the lock wait/hold time histograms. Bucket i
+ * counts times below 2^(i+10) ns, the last one everything above */
+#define GST_OMX_LOCK_STATS_N_BUCKETS (20)
+
+/* Contention statistics of a single lock. Only changed
+ * while holding the lock itself, times are in ns */
+struct _GstOMXLockStats {
+  guint64 acquisitions;
+  /* Number of acquisitions that had to wait for another thread */
+  guint64 contended;
+
+  guint64 wait_total, wait_max;
+  guint64 wait_hist[GST_OMX_LOCK_STATS_N_BUCKETS];
+  guint64 hold_total, hold_max;
+  guint64 hold_hist[GST_OMX_LOCK_STATS_N_BUCKETS];
+
+  GstClockTime locked_at;
+};
+
+typedef enum {
+  /* Payload of the buffers allocated by the component with
+   * OMX_AllocateBuffer(), nBufferSize per buffer */
+  GST_OMX_MEMORY_OMX_BUFFERS = 0,
+  /* GstOMXBuffers and the GstOMXMemory wrapping them */
+  GST_OMX_MEMORY_WRAPPERS,
+  /* Buffers of a GstOMXBufferPool that are not allocated by the
+   * component, i.e. passed to it with OMX_UseBuffer() */
+  GST_OMX_MEMORY_POOL_BUFFERS,
+  /* codec_data kept to be passed to the component */
+  GST_OMX_MEMORY_CODEC_DATA,
+  /* Input of the GstVideoCodecFrames that wait for their output */
+  GST_OMX_MEMORY_PENDING_FRAMES,
+  GST_OMX_MEMORY_N_KINDS
+} GstOMXMemoryKind;
+
+/* Memory held by a component or the whole process, in bytes and
+ * number of objects. peak is the maximum of bytes ever reached */
+struct _GstOMXMemoryUsage {
+  gint64 count[GST_OMX_MEMORY_N_KINDS];
+  gint64 bytes[GST_OMX_MEMORY_N_KINDS];
+  gint64 peak[GST_OMX_MEMORY_N_KINDS];
+};
+
+/* Environment variable with the file the capabilities queried from
+ * the components are cached in, an empty value disables the cache.
+ * The default is gst-omx-caps.cache in the user's cache directory.
+ * caps-cache=false in gstomx.conf disables it for a component */
+#define GST_OMX_CAPS_CACHE_ENV "GST_OMX_CAPS_CACHE"
+
+/* Environment variable with the number of events every component's
+ * flight recorder keeps. The flight recorder is disabled if it is
+ * not set or 0 */
+#define GST_OMX_FLIGHT_RECORDER_ENV "GST_OMX_FLIGHT_RECORDER"
+/* Environment variable with the directory the flight
+ * recorder is dumped to, the tmp directory by default */
+#define GST_OMX_FLIGHT_RECORDER_DIR_ENV "GST_OMX_FLIGHT_RECORDER_DIR"
+/* Environment variable that makes SIGUSR2 dump the flight
+ * recorders of all components if set to anything but "0" */
+#define GST_OMX_FLIGHT_RECORDER_SIGNAL_ENV "GST_OMX_FLIGHT_RECORDER_SIGNAL"
+
 typedef enum {
   GST_OMX_COMPONENT_TYPE_SINK,
   GST_OMX_COMPONENT_TYPE_SOURCE,
@@ -165,6 +284,9 @@ typedef enum {
 struct _GstOMXMessage {
   GstOMXMessageType type;
 
+  /* TRUE if this message belongs to the component's arena */
+  gboolean from_arena;
+
   union {
     struct {
       OMX_STATETYPE state;
@@ -186,12 +308,6 @@ struct _GstOMXMessage {
       OMX_U32 port;
       OMX_U32 flags;
     } buffer_flag;
-    struct {
-      OMX_HANDLETYPE component;
-      OMX_PTR app_data;
-      OMX_BUFFERHEADERTYPE *buffer;
-      OMX_BOOL empty;
-    } buffer_done;
   } content;
 };
 
@@ -203,19 +319,54 @@ struct _GstOMXPort {
 
   OMX_PARAM_PORTDEFINITIONTYPE port_def;
   GPtrArray *buffers; /* Contains GstOMXBuffer* */
-  GQueue pending_buffers; /* Contains GstOMXBuffer* */
-  gboolean flushing;
+  /* Buffers not owned by the component, returned buffers are pushed
+   * here directly from the OMX callbacks. n_pending_buffers is only
+   * increased after a buffer was pushed, so it never counts buffers
+   * that can't be popped yet */
+  GstOMXRing pending_buffers; /* Contains GstOMXBuffer* */
+  volatile gint n_pending_buffers;
+  volatile gboolean flushing;
+  /* Acquirers on the lock-free fast path right now */
+  volatile gint fast_acquirers;
   gboolean flushed; /* TRUE after OMX_CommandFlush was done */
   gboolean enabled_pending;  /* TRUE after OMX_Command{En,Dis}able */
   gboolean disabled_pending; /* was done until it took effect */
-  gboolean eos; /* TRUE after a buffer with EOS flag was received */
+  /* TRUE after a buffer with EOS flag was received. Set atomically,
+   * read without comp->lock by the fast path of acquiring buffers */
+  volatile gboolean eos;
 
   /* Increased whenever the settings of these port change.
    * If settings_cookie != configured_settings_cookie
    * the port has to be reconfigured.
    */
-  gint settings_cookie;
-  gint configured_settings_cookie;
+  volatile gint settings_cookie;
+  volatile gint configured_settings_cookie;
+
+  /* Signalled for everything that only concerns this port,
+   * i.e. returned buffers, flushes and enabling/disabling,
+   * and together with comp->messages_cond for everything else.
+   * Protected by comp->messages_lock */
+  GCond messages_cond;
+  volatile gint messages_waiters;
+  /* Increased whenever the port's waiters are woken up. handled_seq
+   * is its value when the messages were handled the last time,
+   * protected by comp->lock. Waiting only happens if nothing new
+   * happened since then */
+  volatile gint messages_seq;
+  gint handled_seq;
+
+  /* Becomes readable whenever the port's waiters are woken up, created
+   * by gst_omx_port_get_notify_fd(). notify_write_fd is the write end,
+   * the same fd for an eventfd. -1 if not used */
+  gint notify_fd;
+  volatile gint notify_write_fd;
+
+  /* Called whenever the port's waiters are woken up, from any thread
+   * including the OMX callbacks, so it must not block. Accessed
+   * atomically, notify_users counts the running calls */
+  volatile gpointer notify_func;
+  volatile gpointer notify_data;
+  volatile gint notify_users;
 };
 
 struct _GstOMXComponent {
@@ -238,17 +389,116 @@ struct _GstOMXComponent {
    * Always check that messages is empty before waiting */
   GMutex lock;
 
-  GQueue messages; /* Queue of GstOMXMessages */
+  /* Ring of GstOMXMessages, filled from the OMX callbacks without
+   * taking any lock. Once the ring is full the messages go to
+   * messages_overflow, which is protected by messages_lock, and all
+   * later ones follow them until it is drained */
+  GstOMXRing messages;
+  GQueue messages_overflow; /* Queue of GstOMXMessages */
+  /* Messages in or on their way to messages_overflow, > 0
+   * routes all new messages to it */
+  volatile gint n_messages_overflow;
+
   GMutex messages_lock;
+  /* Signalled for state changes, errors and everything else
+   * that concerns the complete component. Ports have their
+   * own condition for port specific messages */
   GCond messages_cond;
+  /* Number of threads waiting on messages_cond, only
+   * if this is not zero messages_cond is signalled */
+  volatile gint messages_waiters;
+
+  /* Preallocated GstOMXMessages, unused ones are in free_messages */
+  GstOMXMessage *message_arena;
+  GstOMXRing free_messages;
+  /* Number of messages that had to be allocated from the
+   * heap because the arena was empty */
+  volatile gint n_heap_messages;
+
+  /* NULL unless enabled with GST_OMX_LOCK_STATS, set once
+   * when the component is created */
+  GstOMXLockStats *lock_stats; /* For lock */
+  GstOMXLockStats *messages_lock_stats; /* For messages_lock */
+
+  /* Ring of the last OMX calls and callbacks, NULL if disabled.
+   * Written from any thread without locks, set once when the
+   * component is created */
+  GstOMXFlightEvent *flight_events;
+  guint flight_mask; /* Number of events - 1, a power of two */
+  volatile gint flight_pos; /* Next event to write */
+  /* Last SIGUSR2 the recorder was dumped for, protected by lock */
+  gint flight_signal_seq;
+  volatile gint flight_dumps;
+  /* Copy of the recorder taken under lock, written to the file
+   * when lock is released. Protected by lock */
+  GstOMXFlightDump *flight_dump;
+
+  /* Samples of the omxlatency tracer, written from the OMX callbacks
+   * without locks. NULL unless the tracer was enabled when the
+   * component was created, set once */
+  GstOMXLatencyBuffer *latency_samples;
+
+  /* Writes all events to a file in addition, NULL unless
+   * enabled with GST_OMX_TRACE_DIR. Set once when the component
+   * is created, events are queued to it without locks */
+  GstOMXTraceWriter *trace;
+
+  /* Protected by a global lock, also used for the
+   * process-wide usage */
+  GstOMXMemoryUsage memory;
+
+  /* Called whenever a state change finished, see
+   * gst_omx_component_set_state_notify_func().
+   * Protected by lock */
+  GstOMXComponentStateNotifyFunc state_notify_func;
+  gpointer state_notify_data;
 
   OMX_STATETYPE state;
   /* OMX_StateInvalid if no pending state */
   OMX_STATETYPE pending_state;
-  /* OMX_ErrorNone usually, if different nothing will work */
-  OMX_ERRORTYPE last_error;
-
-  GList *pending_reconfigure_outports;
+  /* OMX_ErrorNone usually, if different nothing will work. Set
+   * atomically, the fast path of acquiring buffers reads it without
+   * comp->lock like the list pointer below */
+  volatile OMX_ERRORTYPE last_error;
+
+  GList *volatile pending_reconfigure_outports;
+
+  /* Components of the same core, name, role and hacks are kept in
+   * a process-wide pool in Loaded state when freed, up to pool_size
+   * of them, and reused by gst_omx_component_new(). From the
+   * "component-pool-size" setting, set once when created */
+  gchar *pool_key;
+  guint pool_size;
+  /* Time in ms a component stays in the pool without being reused,
+   * -1 for forever. From the "pool-idle-timeout" setting, set once
+   * when created */
+  gint pool_idle_timeout;
+  /* Monotonic time at which the component is freed while it is in
+   * the pool, -1 for never. Protected by the pool lock */
+  gint64 pool_deadline;
+  /* Original values of the parameters and configurations that were
+   * changed, restored before the component goes back to the pool.
+   * Only recorded for pooled components. Protected by lock */
+  GList *pool_saved_settings;
+  /* Set if an original value could not be saved, the component
+   * is not pooled then. Protected by lock */
+  gboolean pool_unrestorable;
+
+  /* Group of the component in the capability cache, NULL if the
+   * cache is disabled. Set once when created */
+  gchar *cache_group;
+
+  /* Process-wide budget of all components of the same core and name
+   * from the "max-instances" and "max-macroblocks-per-second" settings,
+   * NULL if unlimited. The priority and timeout in ms (-1 waits forever,
+   * 0 rejects immediately) are the "admission-priority" and
+   * "admission-timeout" settings of the element that created it.
+   * admitted_load are the macroblocks per second reserved by the
+   * component and only changed by the element */
+  GstOMXAdmissionBudget *budget;
+  gint admission_priority;
+  gint admission_timeout;
+  gint64 admitted_load;
 };
 
 struct _GstOMXBuffer {
@@ -265,6 +515,16 @@ struct _GstOMXBuffer {
 
   /* TRUE if this is an EGLImage */
   gboolean eglimage;
+
+  /* Size accounted as GST_OMX_MEMORY_OMX_BUFFERS, 0 unless
+   * the buffer was allocated by the component */
+  gsize allocated_size;
+
+  /* Only set while the omxlatency tracer is enabled,
+   * GST_CLOCK_TIME_NONE otherwise */
+  GstClockTime sent_at; /* Passed to the component */
+  GstClockTime done_at; /* Returned by the component */
+  GstClockTime acquired_at; /* Acquired by the element */
 };
 
 struct _GstOMXClassData {
@@ -283,6 +543,12 @@ struct _GstOMXClassData {
 };
 
 GKeyFile *        gst_omx_get_configuration (void);
+void              gst_omx_set_configuration (GKeyFile * config);
+
+void              gst_omx_ring_init (GstOMXRing * ring, guint size);
+void              gst_omx_ring_clear (GstOMXRing * ring);
+gboolean          gst_omx_ring_push (GstOMXRing * ring, gpointer data);
+gpointer          gst_omx_ring_pop (GstOMXRing * ring);
 
 const gchar *     gst_omx_error_to_string (OMX_ERRORTYPE err);
 const gchar *     gst_omx_state_to_string (OMX_STATETYPE state);
@@ -295,14 +561,29 @@ void              gst_omx_core_release (GstOMXCore * core);
 
 
 GstOMXComponent * gst_omx_component_new (GstObject * parent, const gchar *core_name, const gchar *component_name, const gchar * component_role, guint64 hacks);
+GstOMXComponent * gst_omx_component_new_unmanaged (GstObject * parent, const gchar *core_name, const gchar *component_name, const gchar * component_role, guint64 hacks);
 void              gst_omx_component_free (GstOMXComponent * comp);
 
 OMX_ERRORTYPE     gst_omx_component_set_state (GstOMXComponent * comp, OMX_STATETYPE state);
 OMX_STATETYPE     gst_omx_component_get_state (GstOMXComponent * comp, GstClockTime timeout);
+gboolean          gst_omx_component_wait_states (GstOMXComponent ** comps, guint n_comps, GstClockTime timeout);
+gint *            gst_omx_component_get_cached_integers (GstOMXComponent * comp, const gchar * key, gsize * length);
+void              gst_omx_component_set_cached_integers (GstOMXComponent * comp, const gchar * key, const gint * values, gsize length);
+gboolean          gst_omx_component_admit_video_load (GstOMXComponent * comp, gint width, gint height, gint fps_n, gint fps_d);
+void              gst_omx_component_set_state_notify_func (GstOMXComponent * comp, GstOMXComponentStateNotifyFunc func, gpointer user_data);
 
 OMX_ERRORTYPE     gst_omx_component_get_last_error (GstOMXComponent * comp);
 const gchar *     gst_omx_component_get_last_error_string (GstOMXComponent * comp);
 
+GstStructure *    gst_omx_component_get_lock_stats (GstOMXComponent * comp);
+GstStructure *    gst_omx_component_get_memory_stats (GstOMXComponent * comp);
+void              gst_omx_component_get_memory_usage (GstOMXComponent * comp, GstOMXMemoryUsage * usage);
+void              gst_omx_component_account_memory (GstOMXComponent * comp, GstOMXMemoryKind kind, gint count, gssize bytes);
+void              gst_omx_component_set_memory (GstOMXComponent * comp, GstOMXMemoryKind kind, guint count, gsize bytes);
+void              gst_omx_get_memory_usage (GstOMXMemoryUsage * usage);
+const gchar *     gst_omx_memory_kind_to_string (GstOMXMemoryKind kind);
+gchar *           gst_omx_component_dump_flight_recorder (GstOMXComponent * comp, const gchar * reason);
+
 GstOMXPort *      gst_omx_component_add_port (GstOMXComponent * comp, guint32 index);
 GstOMXPort *      gst_omx_component_get_port (GstOMXComponent * comp, guint32 index);
 
@@ -319,7 +600,14 @@ OMX_ERRORTYPE     gst_omx_port_get_port_definition (GstOMXPort * port, OMX_PARAM
 OMX_ERRORTYPE     gst_omx_port_update_port_definition (GstOMXPort *port, OMX_PARAM_PORTDEFINITIONTYPE *port_definition);
 
 GstOMXAcquireBufferReturn gst_omx_port_acquire_buffer (GstOMXPort *port, GstOMXBuffer **buf);
+GstOMXAcquireBufferReturn gst_omx_port_acquire_buffers (GstOMXPort *port, GstOMXBuffer **bufs, guint max_bufs, guint *n_bufs);
+GstOMXAcquireBufferReturn gst_omx_port_try_acquire_buffer (GstOMXPort *port, GstOMXBuffer **buf);
+GstOMXAcquireBufferReturn gst_omx_port_acquire_buffer_until (GstOMXPort *port, GstOMXBuffer **buf, gint64 end_time);
+gint              gst_omx_port_get_notify_fd (GstOMXPort *port);
+void              gst_omx_port_set_notify_func (GstOMXPort *port, GstOMXPortNotifyFunc func, gpointer user_data);
 OMX_ERRORTYPE     gst_omx_port_release_buffer (GstOMXPort *port, GstOMXBuffer *buf);
+OMX_ERRORTYPE     gst_omx_port_release_buffers (GstOMXPort *port, GstOMXBuffer **bufs, guint n_bufs);
+void              gst_omx_port_signal_eos (GstOMXPort *port);
 
 OMX_ERRORTYPE     gst_omx_port_set_flushing (GstOMXPort *port, GstClockTime timeout, gboolean flush);
 gboolean          gst_omx_port_is_flushing (GstOMXPort *port);
@@ -336,6 +624,7 @@ OMX_ERRORTYPE     gst_omx_port_mark_reconfigured (GstOMXPort * port);
 OMX_ERRORTYPE     gst_omx_port_set_enabled (GstOMXPort * port, gboolean enabled);
 OMX_ERRORTYPE     gst_omx_port_wait_enabled (GstOMXPort * port, GstClockTime timeout);
 gboolean          gst_omx_port_is_enabled (GstOMXPort * port);
+gint *            gst_omx_port_get_video_color_formats (GstOMXPort * port, OMX_U32 framerate, gsize * n_formats);
 
 
 void              gst_omx_set_default_role (GstOMXClassData *class_data, const gchar *default_role);
@@ -32,6 +32,13 @@ GST_DEBUG_CATEGORY_STATIC (gst_omx_audio_enc_debug_category);
 
 /* prototypes */
 static void gst_omx_audio_enc_finalize (GObject * object);
+static gchar *gst_omx_audio_enc_dump_flight_recorder (GstOMXAudioEnc * self);
+static void gst_omx_audio_enc_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec);
+static void gst_omx_audio_enc_loop (GstOMXAudioEnc * self);
+static void gst_omx_audio_enc_start_loop (GstOMXAudioEnc * self);
+static void gst_omx_audio_enc_pause_loop (GstOMXAudioEnc * self);
+static void gst_omx_audio_enc_stop_loop (GstOMXAudioEnc * self);
 
 static GstStateChangeReturn
 gst_omx_audio_enc_change_state (GstElement * element,
@@ -51,9 +58,19 @@ static GstFlowReturn gst_omx_audio_enc_drain (GstOMXAudioEnc * self);
 
 enum
 {
-  PROP_0
+  PROP_0,
+  PROP_LOCK_STATS,
+  PROP_MEMORY_STATS
 };
 
+enum
+{
+  SIGNAL_DUMP_FLIGHT_RECORDER,
+  LAST_SIGNAL
+};
+
+static guint gst_omx_audio_enc_signals[LAST_SIGNAL] = { 0 };
+
 /* class initialization */
 
 #define DEBUG_INIT \
@@ -71,6 +88,29 @@ gst_omx_audio_enc_class_init (GstOMXAudioEncClass * klass)
   GstAudioEncoderClass *audio_encoder_class = GST_AUDIO_ENCODER_CLASS (klass);
 
   gobject_class->finalize = gst_omx_audio_enc_finalize;
+  gobject_class->get_property = gst_omx_audio_enc_get_property;
+
+  g_object_class_install_property (gobject_class, PROP_LOCK_STATS,
+      g_param_spec_boxed ("lock-stats", "Lock Statistics",
+          "Contention statistics of the component's locks, only "
+          "available if enabled with the " GST_OMX_LOCK_STATS_ENV
+          " environment variable", GST_TYPE_STRUCTURE,
+          G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_MEMORY_STATS,
+      g_param_spec_boxed ("memory-stats", "Memory Statistics",
+          "Memory held by the component and, with the \"process-\" "
+          "prefix, by all components of the process", GST_TYPE_STRUCTURE,
+          G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  /* Writes the flight recorder of the OMX component to a file and
+   * returns its name, or NULL if the flight recorder is disabled or
+   * the component is not opened */
+  gst_omx_audio_enc_signals[SIGNAL_DUMP_FLIGHT_RECORDER] =
+      g_signal_new ("dump-flight-recorder", G_TYPE_FROM_CLASS (klass),
+      G_SIGNAL_RUN_LAST | G_SIGNAL_ACTION,
+      G_STRUCT_OFFSET (GstOMXAudioEncClass, dump_flight_recorder), NULL, NULL,
+      g_cclosure_marshal_generic, G_TYPE_STRING, 0);
 
   element_class->change_state =
       GST_DEBUG_FUNCPTR (gst_omx_audio_enc_change_state);
@@ -91,25 +131,43 @@ gst_omx_audio_enc_class_init (GstOMXAudioEncClass * klass)
       "channels = (int) [ 1, " G_STRINGIFY (OMX_AUDIO_MAXCHANNELS) " ], "
       "format = (string) { S8, U8, S16LE, S16BE, U16LE, U16BE, "
       "S24LE, S24BE, U24LE, U24BE, S32LE, S32BE, U32LE, U32BE }";
+
+  klass->dump_flight_recorder =
+      GST_DEBUG_FUNCPTR (gst_omx_audio_enc_dump_flight_recorder);
 }
 
 static void
 gst_omx_audio_enc_init (GstOMXAudioEnc * self)
 {
+  g_mutex_init (&self->comp_lock);
   g_mutex_init (&self->drain_lock);
   g_cond_init (&self->drain_cond);
 }
 
+/* Called with the component's lock */
+static void
+gst_omx_audio_enc_state_notify (GstOMXComponent * comp, OMX_STATETYPE state,
+    gpointer user_data)
+{
+  GstOMXAudioEnc *self = GST_OMX_AUDIO_ENC (user_data);
+
+  g_atomic_int_set (&self->executing, state == OMX_StateExecuting);
+}
+
 static gboolean
 gst_omx_audio_enc_open (GstOMXAudioEnc * self)
 {
   GstOMXAudioEncClass *klass = GST_OMX_AUDIO_ENC_GET_CLASS (self);
   gint in_port_index, out_port_index;
+  GstOMXComponent *comp;
 
-  self->enc =
+  comp =
       gst_omx_component_new (GST_OBJECT_CAST (self), klass->cdata.core_name,
       klass->cdata.component_name, klass->cdata.component_role,
       klass->cdata.hacks);
+  g_mutex_lock (&self->comp_lock);
+  self->enc = comp;
+  g_mutex_unlock (&self->comp_lock);
   self->started = FALSE;
 
   if (!self->enc)
@@ -119,6 +177,10 @@ gst_omx_audio_enc_open (GstOMXAudioEnc * self)
           GST_CLOCK_TIME_NONE) != OMX_StateLoaded)
     return FALSE;
 
+  g_atomic_int_set (&self->executing, FALSE);
+  gst_omx_component_set_state_notify_func (self->enc,
+      gst_omx_audio_enc_state_notify, self);
+
   in_port_index = klass->cdata.in_port_index;
   out_port_index = klass->cdata.out_port_index;
 
@@ -181,6 +243,8 @@ gst_omx_audio_enc_shutdown (GstOMXAudioEnc * self)
 static gboolean
 gst_omx_audio_enc_close (GstOMXAudioEnc * self)
 {
+  GstOMXComponent *comp;
+
   GST_DEBUG_OBJECT (self, "Closing encoder");
 
   if (!gst_omx_audio_enc_shutdown (self))
@@ -188,9 +252,12 @@ gst_omx_audio_enc_close (GstOMXAudioEnc * self)
 
   self->enc_in_port = NULL;
   self->enc_out_port = NULL;
-  if (self->enc)
-    gst_omx_component_free (self->enc);
+  g_mutex_lock (&self->comp_lock);
+  comp = self->enc;
   self->enc = NULL;
+  g_mutex_unlock (&self->comp_lock);
+  if (comp)
+    gst_omx_component_free (comp);
 
   return TRUE;
 }
@@ -200,12 +267,54 @@ gst_omx_audio_enc_finalize (GObject * object)
 {
   GstOMXAudioEnc *self = GST_OMX_AUDIO_ENC (object);
 
+  g_mutex_clear (&self->comp_lock);
   g_mutex_clear (&self->drain_lock);
   g_cond_clear (&self->drain_cond);
 
   G_OBJECT_CLASS (gst_omx_audio_enc_parent_class)->finalize (object);
 }
 
+static void
+gst_omx_audio_enc_get_property (GObject * object, guint prop_id, GValue * value,
+    GParamSpec * pspec)
+{
+  GstOMXAudioEnc *self = GST_OMX_AUDIO_ENC (object);
+
+  switch (prop_id) {
+    case PROP_LOCK_STATS:
+      g_mutex_lock (&self->comp_lock);
+      if (self->enc)
+        g_value_take_boxed (value,
+            gst_omx_component_get_lock_stats (self->enc));
+      g_mutex_unlock (&self->comp_lock);
+      break;
+    case PROP_MEMORY_STATS:
+      g_mutex_lock (&self->comp_lock);
+      if (self->enc)
+        g_value_take_boxed (value,
+            gst_omx_component_get_memory_stats (self->enc));
+      g_mutex_unlock (&self->comp_lock);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+static gchar *
+gst_omx_audio_enc_dump_flight_recorder (GstOMXAudioEnc * self)
+{
+  gchar *filename = NULL;
+
+  g_mutex_lock (&self->comp_lock);
+  if (self->enc)
+    filename =
+        gst_omx_component_dump_flight_recorder (self->enc, "action signal");
+  g_mutex_unlock (&self->comp_lock);
+
+  return filename;
+}
+
 static GstStateChangeReturn
 gst_omx_audio_enc_change_state (GstElement * element, GstStateChange transition)
 {
@@ -287,7 +396,20 @@ gst_omx_audio_enc_loop (GstOMXAudioEnc * self)
 
   klass = GST_OMX_AUDIO_ENC_GET_CLASS (self);
 
-  acq_return = gst_omx_port_acquire_buffer (port, &buf);
+  if (self->worker_task)
+    acq_return = gst_omx_port_try_acquire_buffer (port, &buf);
+  else
+    acq_return = gst_omx_port_acquire_buffer (port, &buf);
+  if (acq_return == GST_OMX_ACQUIRE_BUFFER_NO_AVAILABLE) {
+    /* Called again once the port is notified */
+    gst_omx_worker_task_wait_notify (self->worker_task);
+    return;
+  }
+
+  /* Everything from here on can block downstream */
+  if (self->worker_task)
+    gst_omx_worker_task_enter_blocking (self->worker_task);
+
   if (acq_return == GST_OMX_ACQUIRE_BUFFER_ERROR) {
     goto component_error;
   } else if (acq_return == GST_OMX_ACQUIRE_BUFFER_FLUSHING) {
@@ -375,12 +497,7 @@ gst_omx_audio_enc_loop (GstOMXAudioEnc * self)
     }
   }
 
-  g_assert (acq_return == GST_OMX_ACQUIRE_BUFFER_OK);
-  if (!buf) {
-    g_assert ((klass->cdata.hacks & GST_OMX_HACK_NO_EMPTY_EOS_BUFFER));
-    GST_AUDIO_ENCODER_STREAM_LOCK (self);
-    goto eos;
-  }
+  g_assert (acq_return == GST_OMX_ACQUIRE_BUFFER_OK && buf != NULL);
 
   GST_DEBUG_OBJECT (self, "Handling buffer: 0x%08x %" G_GUINT64_FORMAT,
       (guint) buf->omx_buf->nFlags, (guint64) buf->omx_buf->nTimeStamp);
@@ -487,7 +604,7 @@ component_error:
             gst_omx_component_get_last_error_string (self->enc),
             gst_omx_component_get_last_error (self->enc)));
     gst_pad_push_event (GST_AUDIO_ENCODER_SRC_PAD (self), gst_event_new_eos ());
-    gst_pad_pause_task (GST_AUDIO_ENCODER_SRC_PAD (self));
+    gst_omx_audio_enc_pause_loop (self);
     self->downstream_flow_ret = GST_FLOW_ERROR;
     self->started = FALSE;
     return;
@@ -495,7 +612,7 @@ component_error:
 flushing:
   {
     GST_DEBUG_OBJECT (self, "Flushing -- stopping task");
-    gst_pad_pause_task (GST_AUDIO_ENCODER_SRC_PAD (self));
+    gst_omx_audio_enc_pause_loop (self);
     self->downstream_flow_ret = GST_FLOW_FLUSHING;
     self->started = FALSE;
     return;
@@ -508,7 +625,7 @@ eos:
       self->draining = FALSE;
       g_cond_broadcast (&self->drain_cond);
       flow_ret = GST_FLOW_OK;
-      gst_pad_pause_task (GST_AUDIO_ENCODER_SRC_PAD (self));
+      gst_omx_audio_enc_pause_loop (self);
     } else {
       GST_DEBUG_OBJECT (self, "Component signalled EOS");
       flow_ret = GST_FLOW_EOS;
@@ -533,14 +650,14 @@ flow_error:
 
       gst_pad_push_event (GST_AUDIO_ENCODER_SRC_PAD (self),
           gst_event_new_eos ());
-      gst_pad_pause_task (GST_AUDIO_ENCODER_SRC_PAD (self));
+      gst_omx_audio_enc_pause_loop (self);
     } else if (flow_ret == GST_FLOW_NOT_LINKED || flow_ret < GST_FLOW_EOS) {
       GST_ELEMENT_ERROR (self, STREAM, FAILED, ("Internal data stream error."),
           ("stream stopped, reason %s", gst_flow_get_name (flow_ret)));
 
       gst_pad_push_event (GST_AUDIO_ENCODER_SRC_PAD (self),
           gst_event_new_eos ());
-      gst_pad_pause_task (GST_AUDIO_ENCODER_SRC_PAD (self));
+      gst_omx_audio_enc_pause_loop (self);
     }
     self->started = FALSE;
     GST_AUDIO_ENCODER_STREAM_UNLOCK (self);
@@ -551,7 +668,7 @@ reconfigure_error:
     GST_ELEMENT_ERROR (self, LIBRARY, SETTINGS, (NULL),
         ("Unable to reconfigure output port"));
     gst_pad_push_event (GST_AUDIO_ENCODER_SRC_PAD (self), gst_event_new_eos ());
-    gst_pad_pause_task (GST_AUDIO_ENCODER_SRC_PAD (self));
+    gst_omx_audio_enc_pause_loop (self);
     self->downstream_flow_ret = GST_FLOW_NOT_NEGOTIATED;
     self->started = FALSE;
     return;
@@ -560,7 +677,7 @@ caps_failed:
   {
     GST_ELEMENT_ERROR (self, LIBRARY, SETTINGS, (NULL), ("Failed to set caps"));
     gst_pad_push_event (GST_AUDIO_ENCODER_SRC_PAD (self), gst_event_new_eos ());
-    gst_pad_pause_task (GST_AUDIO_ENCODER_SRC_PAD (self));
+    gst_omx_audio_enc_pause_loop (self);
     self->downstream_flow_ret = GST_FLOW_NOT_NEGOTIATED;
     self->started = FALSE;
     return;
@@ -571,7 +688,7 @@ release_error:
         ("Failed to relase output buffer to component: %s (0x%08x)",
             gst_omx_error_to_string (err), err));
     gst_pad_push_event (GST_AUDIO_ENCODER_SRC_PAD (self), gst_event_new_eos ());
-    gst_pad_pause_task (GST_AUDIO_ENCODER_SRC_PAD (self));
+    gst_omx_audio_enc_pause_loop (self);
     self->downstream_flow_ret = GST_FLOW_ERROR;
     self->started = FALSE;
     GST_AUDIO_ENCODER_STREAM_UNLOCK (self);
@@ -579,6 +696,34 @@ release_error:
   }
 }
 
+static void
+gst_omx_audio_enc_start_loop (GstOMXAudioEnc * self)
+{
+  if (self->worker_task)
+    gst_omx_worker_task_start (self->worker_task);
+  else
+    gst_pad_start_task (GST_AUDIO_ENCODER_SRC_PAD (self),
+        (GstTaskFunction) gst_omx_audio_enc_loop, self, NULL);
+}
+
+static void
+gst_omx_audio_enc_pause_loop (GstOMXAudioEnc * self)
+{
+  if (self->worker_task)
+    gst_omx_worker_task_pause (self->worker_task);
+  else
+    gst_pad_pause_task (GST_AUDIO_ENCODER_SRC_PAD (self));
+}
+
+static void
+gst_omx_audio_enc_stop_loop (GstOMXAudioEnc * self)
+{
+  if (self->worker_task)
+    gst_omx_worker_task_stop (self->worker_task);
+  else
+    gst_pad_stop_task (GST_AUDIO_ENCODER_SRC_PAD (self));
+}
+
 static gboolean
 gst_omx_audio_enc_start (GstAudioEncoder * encoder)
 {
@@ -590,6 +735,16 @@ gst_omx_audio_enc_start (GstAudioEncoder * encoder)
   self->eos = FALSE;
   self->downstream_flow_ret = GST_FLOW_OK;
 
+  /* Only started elements use the worker pool */
+  if (gst_omx_worker_pool_enabled ()) {
+    self->worker_task =
+        gst_omx_worker_task_new (GST_ELEMENT_CAST (self),
+        GST_AUDIO_ENCODER_SRC_PAD (self),
+        (GstTaskFunction) gst_omx_audio_enc_loop, self);
+    if (self->worker_task)
+      gst_omx_worker_task_connect_port (self->worker_task, self->enc_out_port);
+  }
+
   return TRUE;
 }
 
@@ -605,7 +760,12 @@ gst_omx_audio_enc_stop (GstAudioEncoder * encoder)
   gst_omx_port_set_flushing (self->enc_in_port, 5 * GST_SECOND, TRUE);
   gst_omx_port_set_flushing (self->enc_out_port, 5 * GST_SECOND, TRUE);
 
-  gst_pad_stop_task (GST_AUDIO_ENCODER_SRC_PAD (encoder));
+  gst_omx_audio_enc_stop_loop (self);
+
+  if (self->worker_task) {
+    gst_omx_worker_task_free (self->worker_task);
+    self->worker_task = NULL;
+  }
 
   if (gst_omx_component_get_state (self->enc, 0) > OMX_StateIdle)
     gst_omx_component_set_state (self->enc, OMX_StateIdle);
@@ -664,7 +824,7 @@ gst_omx_audio_enc_set_format (GstAudioEncoder * encoder, GstAudioInfo * info)
      * unlock GST_AUDIO_ENCODER_STREAM_LOCK to prevent deadlocks
      * caused by using this lock from inside the loop function */
     GST_AUDIO_ENCODER_STREAM_UNLOCK (self);
-    gst_pad_stop_task (GST_AUDIO_ENCODER_SRC_PAD (encoder));
+    gst_omx_audio_enc_stop_loop (self);
     GST_AUDIO_ENCODER_STREAM_LOCK (self);
 
     if (gst_omx_port_set_enabled (self->enc_in_port, FALSE) != OMX_ErrorNone)
@@ -803,13 +963,12 @@ gst_omx_audio_enc_set_format (GstAudioEncoder * encoder, GstAudioInfo * info)
             GST_CLOCK_TIME_NONE) != OMX_StateIdle)
       return FALSE;
 
+    /* Don't wait for Executing here, handle_frame() only waits
+     * if the state notify func didn't see it yet when the first
+     * buffer arrives */
     if (gst_omx_component_set_state (self->enc,
             OMX_StateExecuting) != OMX_ErrorNone)
       return FALSE;
-
-    if (gst_omx_component_get_state (self->enc,
-            GST_CLOCK_TIME_NONE) != OMX_StateExecuting)
-      return FALSE;
   }
 
   /* Unset flushing to allow ports to accept data again */
@@ -826,8 +985,7 @@ gst_omx_audio_enc_set_format (GstAudioEncoder * encoder, GstAudioInfo * info)
   /* Start the srcpad loop again */
   GST_DEBUG_OBJECT (self, "Starting task again");
   self->downstream_flow_ret = GST_FLOW_OK;
-  gst_pad_start_task (GST_AUDIO_ENCODER_SRC_PAD (self),
-      (GstTaskFunction) gst_omx_audio_enc_loop, encoder, NULL);
+  gst_omx_audio_enc_start_loop (self);
 
   return TRUE;
 }
@@ -860,8 +1018,7 @@ gst_omx_audio_enc_flush (GstAudioEncoder * encoder)
   self->last_upstream_ts = 0;
   self->downstream_flow_ret = GST_FLOW_OK;
   self->eos = FALSE;
-  gst_pad_start_task (GST_AUDIO_ENCODER_SRC_PAD (self),
-      (GstTaskFunction) gst_omx_audio_enc_loop, encoder, NULL);
+  gst_omx_audio_enc_start_loop (self);
 }
 
 static GstFlowReturn
@@ -870,9 +1027,10 @@ gst_omx_audio_enc_handle_frame (GstAudioEncoder * encoder, GstBuffer * inbuf)
   GstOMXAcquireBufferReturn acq_ret = GST_OMX_ACQUIRE_BUFFER_ERROR;
   GstOMXAudioEnc *self;
   GstOMXPort *port;
-  GstOMXBuffer *buf;
+  GstOMXBuffer *bufs[GST_OMX_PORT_MAX_BATCH_SIZE];
+  GstOMXBuffer *buf = NULL;
   gsize size;
-  guint offset = 0;
+  guint offset = 0, chunk_size, n_bufs, i;
   GstClockTime timestamp, duration, timestamp_offset = 0;
   OMX_ERRORTYPE err;
 
@@ -892,6 +1050,11 @@ gst_omx_audio_enc_handle_frame (GstAudioEncoder * encoder, GstBuffer * inbuf)
 
   GST_DEBUG_OBJECT (self, "Handling frame");
 
+  if (!g_atomic_int_get (&self->executing)
+      && gst_omx_component_get_state (self->enc,
+          5 * GST_SECOND) != OMX_StateExecuting)
+    goto state_error;
+
   timestamp = GST_BUFFER_TIMESTAMP (inbuf);
   duration = GST_BUFFER_DURATION (inbuf);
 
@@ -903,7 +1066,13 @@ gst_omx_audio_enc_handle_frame (GstAudioEncoder * encoder, GstBuffer * inbuf)
      * _loop() can't call _finish_frame() and we might block forever
      * because no input buffers are released */
     GST_AUDIO_ENCODER_STREAM_UNLOCK (self);
-    acq_ret = gst_omx_port_acquire_buffer (port, &buf);
+
+    /* Take as many buffers as are ready and needed for the
+     * remaining input, at least one */
+    chunk_size = MAX (port->port_def.nBufferSize, 1);
+    n_bufs = MIN ((size - offset + chunk_size - 1) / chunk_size,
+        GST_OMX_PORT_MAX_BATCH_SIZE);
+    acq_ret = gst_omx_port_acquire_buffers (port, bufs, n_bufs, &n_bufs);
 
     if (acq_ret == GST_OMX_ACQUIRE_BUFFER_ERROR) {
       GST_AUDIO_ENCODER_STREAM_LOCK (self);
@@ -967,49 +1136,62 @@ gst_omx_audio_enc_handle_frame (GstAudioEncoder * encoder, GstBuffer * inbuf)
     }
     GST_AUDIO_ENCODER_STREAM_LOCK (self);
 
-    g_assert (acq_ret == GST_OMX_ACQUIRE_BUFFER_OK && buf != NULL);
+    g_assert (acq_ret == GST_OMX_ACQUIRE_BUFFER_OK && n_bufs > 0);
 
     if (self->downstream_flow_ret != GST_FLOW_OK) {
-      gst_omx_port_release_buffer (port, buf);
+      gst_omx_port_release_buffers (port, bufs, n_bufs);
       return self->downstream_flow_ret;
     }
 
-    if (buf->omx_buf->nAllocLen - buf->omx_buf->nOffset <= 0) {
-      gst_omx_port_release_buffer (port, buf);
-      goto full_buffer;
-    }
+    for (i = 0; i < n_bufs; i++) {
+      buf = bufs[i];
 
-    GST_DEBUG_OBJECT (self, "Handling frame at offset %d", offset);
+      if (buf->omx_buf->nAllocLen - buf->omx_buf->nOffset <= 0) {
+        guint j;
 
-    /* Copy the buffer content in chunks of size as requested
-     * by the port */
-    buf->omx_buf->nFilledLen =
-        MIN (size - offset, buf->omx_buf->nAllocLen - buf->omx_buf->nOffset);
-    gst_buffer_extract (inbuf, offset,
-        buf->omx_buf->pBuffer + buf->omx_buf->nOffset,
-        buf->omx_buf->nFilledLen);
+        /* Nothing of the partially filled batch is passed on */
+        for (j = 0; j < n_bufs; j++) {
+          bufs[j]->omx_buf->nFilledLen = 0;
+          bufs[j]->omx_buf->nFlags = 0;
+        }
+        gst_omx_port_release_buffers (port, bufs, n_bufs);
+        goto full_buffer;
+      }
 
-    /* Interpolate timestamps if we're passing the buffer
-     * in multiple chunks */
-    if (offset != 0 && duration != GST_CLOCK_TIME_NONE) {
-      timestamp_offset = gst_util_uint64_scale (offset, duration, size);
-    }
+      GST_DEBUG_OBJECT (self, "Handling frame at offset %d", offset);
 
-    if (timestamp != GST_CLOCK_TIME_NONE) {
-      buf->omx_buf->nTimeStamp =
-          gst_util_uint64_scale (timestamp + timestamp_offset,
-          OMX_TICKS_PER_SECOND, GST_SECOND);
-      self->last_upstream_ts = timestamp + timestamp_offset;
-    }
-    if (duration != GST_CLOCK_TIME_NONE) {
-      buf->omx_buf->nTickCount =
-          gst_util_uint64_scale (buf->omx_buf->nFilledLen, duration, size);
-      self->last_upstream_ts += duration;
+      /* Copy the buffer content in chunks of size as requested
+       * by the port */
+      buf->omx_buf->nFilledLen =
+          MIN (MIN (size - offset, chunk_size),
+          buf->omx_buf->nAllocLen - buf->omx_buf->nOffset);
+      gst_buffer_extract (inbuf, offset,
+          buf->omx_buf->pBuffer + buf->omx_buf->nOffset,
+          buf->omx_buf->nFilledLen);
+
+      /* Interpolate timestamps if we're passing the buffer
+       * in multiple chunks */
+      if (offset != 0 && duration != GST_CLOCK_TIME_NONE) {
+        timestamp_offset = gst_util_uint64_scale (offset, duration, size);
+      }
+
+      if (timestamp != GST_CLOCK_TIME_NONE) {
+        buf->omx_buf->nTimeStamp =
+            gst_util_uint64_scale (timestamp + timestamp_offset,
+            OMX_TICKS_PER_SECOND, GST_SECOND);
+        self->last_upstream_ts = timestamp + timestamp_offset;
+      }
+      if (duration != GST_CLOCK_TIME_NONE) {
+        buf->omx_buf->nTickCount =
+            gst_util_uint64_scale (buf->omx_buf->nFilledLen, duration, size);
+        self->last_upstream_ts += duration;
+      }
+
+      offset += buf->omx_buf->nFilledLen;
     }
 
-    offset += buf->omx_buf->nFilledLen;
     self->started = TRUE;
-    err = gst_omx_port_release_buffer (port, buf);
+    err = gst_omx_port_release_buffers (port, bufs, n_bufs);
     if (err != OMX_ErrorNone)
       goto release_error;
   }
@@ -1034,6 +1216,15 @@ component_error:
     return GST_FLOW_ERROR;
   }
 
+state_error:
+  {
+    GST_ELEMENT_ERROR (self, LIBRARY, FAILED, (NULL),
+        ("OpenMAX component did not reach Executing state: %s (0x%08x)",
+            gst_omx_component_get_last_error_string (self->enc),
+            gst_omx_component_get_last_error (self->enc)));
+    return GST_FLOW_ERROR;
+  }
+
 flushing:
   {
     GST_DEBUG_OBJECT (self, "Flushing -- returning FLUSHING");
@@ -1080,13 +1271,8 @@ gst_omx_audio_enc_sink_event (GstAudioEncoder * encoder, GstEvent * event)
     if ((klass->cdata.hacks & GST_OMX_HACK_NO_EMPTY_EOS_BUFFER)) {
       GST_WARNING_OBJECT (self, "Component does not support empty EOS buffers");
 
-      /* Insert a NULL into the queue to signal EOS */
-      g_mutex_lock (&self->enc->lock);
-      g_queue_push_tail (&self->enc_out_port->pending_buffers, NULL);
-      g_mutex_unlock (&self->enc->lock);
-      g_mutex_lock (&self->enc->messages_lock);
-      g_cond_broadcast (&self->enc->messages_cond);
-      g_mutex_unlock (&self->enc->messages_lock);
+      /* Mark the output port as EOS after the pending buffers */
+      gst_omx_port_signal_eos (self->enc_out_port);
       return TRUE;
     }
 
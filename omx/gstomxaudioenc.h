@@ -26,6 +26,7 @@
 #include <gst/audio/gstaudioencoder.h>
 
 #include "gstomx.h"
+#include "gstomxworker.h"
 
 G_BEGIN_DECLS
 
@@ -57,12 +58,19 @@ struct _GstOMXAudioEnc
   /* TRUE if the component is configured and saw
    * the first buffer */
   gboolean started;
+  /* TRUE if the component is in Executing state,
+   * set by its state notify func */
+  volatile gint executing;
 
   GstClockTime last_upstream_ts;
 
   /* TRUE if upstream is EOS */
   gboolean eos;
 
+  /* Protects enc against close() while the property getters
+   * and action signals use it from other threads */
+  GMutex comp_lock;
+
   /* Draining state */
   GMutex drain_lock;
   GCond drain_cond;
@@ -70,6 +78,10 @@ struct _GstOMXAudioEnc
   gboolean draining;
 
   GstFlowReturn downstream_flow_ret;
+
+  /* Runs the srcpad loop between start() and stop() if the shared
+   * worker pool is used, NULL if the srcpad has its own task */
+  GstOMXWorkerTask *worker_task;
 };
 
 struct _GstOMXAudioEncClass
@@ -81,6 +93,9 @@ struct _GstOMXAudioEncClass
   gboolean (*set_format)       (GstOMXAudioEnc * self, GstOMXPort * port, GstAudioInfo * info);
   GstCaps *(*get_caps)         (GstOMXAudioEnc * self, GstOMXPort * port, GstAudioInfo * info);
   guint    (*get_num_samples)  (GstOMXAudioEnc * self, GstOMXPort * port, GstAudioInfo * info, GstOMXBuffer * buffer);
+
+  /* actions */
+  gchar *  (*dump_flight_recorder) (GstOMXAudioEnc * self);
 };
 
 GType gst_omx_audio_enc_get_type (void);
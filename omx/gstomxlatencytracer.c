@@ -0,0 +1,536 @@
+/*
+ * Copyright (C) 2026, the gst-omx authors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+/* Tracer that measures where the time of the OMX buffers goes, enabled
+ * with GST_TRACERS=omxlatency or GST_TRACERS="omxlatency(interval=500)"
+ * for a report every 500ms instead of every second.
+ *
+ * For every port it separately measures how long the component takes
+ * to return a buffer, how long returned buffers wait until they're
+ * acquired and how long acquired buffers are held by us and downstream.
+ * For video decoders and encoders the latency from an input frame to
+ * the matching output frame is measured too. Min, average, 99th
+ * percentile and max of every interval are logged with the
+ * "omx-latency" tracer record, e.g. with GST_DEBUG=GST_TRACER:7
+ *
+ * The OMX callbacks only write the samples into a buffer of the
+ * component without taking any lock. They're collected and reported
+ * from the streaming threads when they acquire buffers */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gst/gst.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "gstomxlatencytracer.h"
+
+volatile gint _gst_omx_latency_tracing = 0;
+
+#if GST_CHECK_VERSION(1,8,0)
+
+GST_DEBUG_CATEGORY_STATIC (gst_omx_latency_tracer_debug_category);
+#define GST_CAT_DEFAULT gst_omx_latency_tracer_debug_category
+
+/* Number of samples per interval the percentile is calculated
+ * from, if there are more only the last ones are used */
+#define GST_OMX_LATENCY_WINDOW_SIZE (1024)
+
+#define GST_OMX_LATENCY_DEFAULT_INTERVAL (GST_SECOND)
+
+/* Number of samples per component that can be recorded between two
+ * collections, older ones are overwritten. Must be a power of two */
+#define GST_OMX_LATENCY_BUFFER_SIZE (4096)
+
+typedef struct
+{
+  /* Position + 1 of the sample while it is valid, 0 while it is written */
+  volatile gint seq;
+  gint port;                    /* -1 for the frame latency */
+  GstOMXLatencyKind kind;
+  GstClockTime latency;
+} GstOMXLatencySample;
+
+struct _GstOMXLatencyBuffer
+{
+  GstOMXLatencySample samples[GST_OMX_LATENCY_BUFFER_SIZE];
+  volatile gint write_pos;      /* Next position to write to */
+  guint read_pos;               /* Protected by the tracer lock */
+};
+
+typedef struct
+{
+  guint64 count;
+  GstClockTime min, max, total;
+  GstClockTime window[GST_OMX_LATENCY_WINDOW_SIZE];
+} GstOMXLatencySamples;
+
+typedef struct
+{
+  /* Only compared, the component might already be freed */
+  GstOMXComponent *comp;
+  gint port;                    /* -1 for the frame latency */
+} GstOMXLatencyKey;
+
+typedef struct
+{
+  GstOMXLatencyKey key;
+
+  gchar *element;
+  gchar *component;
+
+  GstOMXLatencySamples samples[GST_OMX_LATENCY_N_KINDS];
+} GstOMXLatencyStats;
+
+typedef struct
+{
+  GstTracer parent;
+
+  GstClockTime interval;
+  GstClockTime last_report;
+
+  /* Set of GstOMXLatencyStats, looked up by their GstOMXLatencyKey */
+  GHashTable *stats;
+} GstOMXLatencyTracer;
+
+typedef struct
+{
+  GstTracerClass parent_class;
+} GstOMXLatencyTracerClass;
+
+static const gchar *kind_names[GST_OMX_LATENCY_N_KINDS] = {
+  "component", "queued", "held", "frame"
+};
+
+/* Protects tracer and everything in it, and the read position of
+ * all sample buffers. Never taken from the OMX callbacks */
+G_LOCK_DEFINE_STATIC (tracer);
+static GstOMXLatencyTracer *tracer = NULL;
+
+static GstTracerRecord *latency_record = NULL;
+
+#define DEBUG_INIT \
+  GST_DEBUG_CATEGORY_INIT (gst_omx_latency_tracer_debug_category, \
+      "omxlatencytracer", 0, "gst-omx buffer latency tracer");
+
+G_DEFINE_TYPE_WITH_CODE (GstOMXLatencyTracer, gst_omx_latency_tracer,
+    GST_TYPE_TRACER, DEBUG_INIT);
+
+static GstOMXLatencyStats *
+gst_omx_latency_stats_new (GstOMXComponent * comp, gint port)
+{
+  GstOMXLatencyStats *stats = g_slice_new0 (GstOMXLatencyStats);
+  gint i;
+
+  stats->key.comp = comp;
+  stats->key.port = port;
+  stats->element =
+      g_strdup (comp->parent ? GST_OBJECT_NAME (comp->parent) : "(pooled)");
+  stats->component = g_strdup (comp->name);
+  for (i = 0; i < GST_OMX_LATENCY_N_KINDS; i++)
+    stats->samples[i].min = GST_CLOCK_TIME_NONE;
+
+  return stats;
+}
+
+static void
+gst_omx_latency_stats_free (GstOMXLatencyStats * stats)
+{
+  g_free (stats->element);
+  g_free (stats->component);
+  g_slice_free (GstOMXLatencyStats, stats);
+}
+
+static guint
+gst_omx_latency_key_hash (gconstpointer key)
+{
+  const GstOMXLatencyKey *k = key;
+
+  return g_direct_hash (k->comp) ^ (guint) k->port;
+}
+
+static gboolean
+gst_omx_latency_key_equal (gconstpointer a, gconstpointer b)
+{
+  const GstOMXLatencyKey *ka = a, *kb = b;
+
+  return ka->comp == kb->comp && ka->port == kb->port;
+}
+
+static gint
+compare_clock_time (gconstpointer a, gconstpointer b)
+{
+  GstClockTime ta = *(const GstClockTime *) a;
+  GstClockTime tb = *(const GstClockTime *) b;
+
+  return (ta > tb) - (ta < tb);
+}
+
+/* NOTE: Must be called with the tracer lock */
+static void
+gst_omx_latency_stats_report (GstOMXLatencyStats * stats)
+{
+  gint i;
+
+  for (i = 0; i < GST_OMX_LATENCY_N_KINDS; i++) {
+    GstOMXLatencySamples *samples = &stats->samples[i];
+    guint n;
+    GstClockTime p99;
+
+    if (samples->count == 0)
+      continue;
+
+    n = MIN (samples->count, GST_OMX_LATENCY_WINDOW_SIZE);
+    qsort (samples->window, n, sizeof (GstClockTime), compare_clock_time);
+    p99 = samples->window[(n * 99 + 99) / 100 - 1];
+
+    gst_tracer_record_log (latency_record, stats->element, stats->component,
+        stats->key.port, kind_names[i], samples->count, samples->min,
+        samples->total / samples->count, p99, samples->max);
+
+    memset (samples, 0, sizeof (GstOMXLatencySamples));
+    samples->min = GST_CLOCK_TIME_NONE;
+  }
+}
+
+/* NOTE: Must be called with the tracer lock */
+static void
+gst_omx_latency_tracer_add_sample (GstOMXComponent * comp, gint port,
+    GstOMXLatencyKind kind, GstClockTime latency)
+{
+  GstOMXLatencyKey key = { comp, port };
+  GstOMXLatencyStats *stats;
+  GstOMXLatencySamples *samples;
+
+  stats = g_hash_table_lookup (tracer->stats, &key);
+  if (!stats) {
+    stats = gst_omx_latency_stats_new (comp, port);
+    g_hash_table_add (tracer->stats, stats);
+  }
+
+  samples = &stats->samples[kind];
+  samples->window[samples->count % GST_OMX_LATENCY_WINDOW_SIZE] = latency;
+  samples->count++;
+  samples->total += latency;
+  samples->min = MIN (samples->min, latency);
+  samples->max = MAX (samples->max, latency);
+}
+
+/* NOTE: Must be called with the tracer lock
+ *
+ * Moves all completely written samples of the component's
+ * buffer to the statistics */
+static void
+gst_omx_latency_tracer_drain (GstOMXComponent * comp)
+{
+  GstOMXLatencyBuffer *buffer = comp->latency_samples;
+  guint end;
+
+  if (!buffer)
+    return;
+
+  end = (guint) g_atomic_int_get (&buffer->write_pos);
+
+  /* Skip samples that were already overwritten */
+  if (end - buffer->read_pos > GST_OMX_LATENCY_BUFFER_SIZE)
+    buffer->read_pos = end - GST_OMX_LATENCY_BUFFER_SIZE;
+
+  while (buffer->read_pos != end) {
+    GstOMXLatencySample *sample =
+        &buffer->samples[buffer->read_pos % GST_OMX_LATENCY_BUFFER_SIZE];
+    gint seq = (gint) (buffer->read_pos + 1);
+    gint port;
+    GstOMXLatencyKind kind;
+    GstClockTime latency;
+
+    /* Stop at a sample that is still written, it's taken next time */
+    if (g_atomic_int_get (&sample->seq) != seq)
+      break;
+    port = sample->port;
+    kind = sample->kind;
+    latency = sample->latency;
+    if (g_atomic_int_get (&sample->seq) != seq)
+      break;
+
+    gst_omx_latency_tracer_add_sample (comp, port, kind, latency);
+    buffer->read_pos++;
+  }
+}
+
+/* NOTE: Does not take any lock, called from the OMX callbacks */
+static void
+gst_omx_latency_buffer_write (GstOMXLatencyBuffer * buffer, gint port,
+    GstOMXLatencyKind kind, GstClockTime latency)
+{
+  GstOMXLatencySample *sample;
+  guint pos;
+
+  if (!buffer)
+    return;
+
+  pos = (guint) g_atomic_int_add (&buffer->write_pos, 1);
+  sample = &buffer->samples[pos % GST_OMX_LATENCY_BUFFER_SIZE];
+
+  g_atomic_int_set (&sample->seq, 0);
+  sample->port = port;
+  sample->kind = kind;
+  sample->latency = latency;
+  g_atomic_int_set (&sample->seq, (gint) (pos + 1));
+}
+
+GstOMXLatencyBuffer *
+gst_omx_latency_buffer_new (void)
+{
+  return g_new0 (GstOMXLatencyBuffer, 1);
+}
+
+void
+gst_omx_latency_buffer_free (GstOMXLatencyBuffer * buffer)
+{
+  g_free (buffer);
+}
+
+void
+gst_omx_latency_tracer_port_sample (GstOMXPort * port, GstOMXLatencyKind kind,
+    GstClockTime latency)
+{
+  gst_omx_latency_buffer_write (port->comp->latency_samples, port->index,
+      kind, latency);
+}
+
+void
+gst_omx_latency_tracer_frame_sample (GstOMXComponent * comp,
+    GstClockTime latency)
+{
+  gst_omx_latency_buffer_write (comp->latency_samples, -1,
+      GST_OMX_LATENCY_FRAME, latency);
+}
+
+/* Takes the new samples of the component and reports the latencies
+ * of all components once per interval */
+void
+gst_omx_latency_tracer_collect (GstOMXComponent * comp)
+{
+  G_LOCK (tracer);
+  if (tracer) {
+    GstClockTime now;
+
+    gst_omx_latency_tracer_drain (comp);
+
+    now = gst_util_get_timestamp ();
+    if (now - tracer->last_report >= tracer->interval) {
+      GHashTableIter iter;
+      gpointer value;
+
+      g_hash_table_iter_init (&iter, tracer->stats);
+      while (g_hash_table_iter_next (&iter, &value, NULL))
+        gst_omx_latency_stats_report (value);
+      tracer->last_report = now;
+    }
+  }
+  G_UNLOCK (tracer);
+}
+
+/* Reports the remaining samples of the component and its ports */
+void
+gst_omx_latency_tracer_component_freed (GstOMXComponent * comp)
+{
+  G_LOCK (tracer);
+  if (tracer) {
+    GHashTableIter iter;
+    gpointer value;
+
+    gst_omx_latency_tracer_drain (comp);
+
+    g_hash_table_iter_init (&iter, tracer->stats);
+    while (g_hash_table_iter_next (&iter, &value, NULL)) {
+      GstOMXLatencyStats *stats = value;
+
+      if (stats->key.comp != comp)
+        continue;
+
+      gst_omx_latency_stats_report (stats);
+      g_hash_table_iter_remove (&iter);
+    }
+  }
+  G_UNLOCK (tracer);
+}
+
+static void
+gst_omx_latency_tracer_constructed (GObject * object)
+{
+  GstOMXLatencyTracer *self = (GstOMXLatencyTracer *) object;
+  gchar *params, *tmp;
+  GstStructure *s;
+  guint interval;
+
+  G_OBJECT_CLASS (gst_omx_latency_tracer_parent_class)->constructed (object);
+
+  g_object_get (self, "params", &params, NULL);
+  if (params) {
+    tmp = g_strdup_printf ("omxlatency,%s", params);
+    s = gst_structure_new_from_string (tmp);
+    g_free (tmp);
+
+    if (s && gst_structure_get_uint (s, "interval", &interval))
+      self->interval = interval * GST_MSECOND;
+    else if (!s)
+      GST_WARNING_OBJECT (self, "Invalid parameters '%s'", params);
+
+    if (s)
+      gst_structure_free (s);
+    g_free (params);
+  }
+
+  G_LOCK (tracer);
+  if (tracer) {
+    GST_WARNING_OBJECT (self, "Only one omxlatency tracer is supported");
+  } else {
+    self->last_report = gst_util_get_timestamp ();
+    tracer = self;
+    g_atomic_int_set (&_gst_omx_latency_tracing, 1);
+  }
+  G_UNLOCK (tracer);
+
+  GST_INFO_OBJECT (self, "Reporting latencies every %" GST_TIME_FORMAT,
+      GST_TIME_ARGS (self->interval));
+}
+
+static void
+gst_omx_latency_tracer_finalize (GObject * object)
+{
+  GstOMXLatencyTracer *self = (GstOMXLatencyTracer *) object;
+
+  G_LOCK (tracer);
+  if (tracer == self) {
+    GHashTableIter iter;
+    gpointer value;
+
+    g_atomic_int_set (&_gst_omx_latency_tracing, 0);
+    g_hash_table_iter_init (&iter, self->stats);
+    while (g_hash_table_iter_next (&iter, &value, NULL))
+      gst_omx_latency_stats_report (value);
+    tracer = NULL;
+  }
+  G_UNLOCK (tracer);
+
+  g_hash_table_unref (self->stats);
+
+  G_OBJECT_CLASS (gst_omx_latency_tracer_parent_class)->finalize (object);
+}
+
+#define LATENCY_RECORD_FIELD(type, desc) \
+    GST_TYPE_STRUCTURE, gst_structure_new ("value", \
+        "type", G_TYPE_GTYPE, type, \
+        "description", G_TYPE_STRING, desc, \
+        NULL)
+
+static void
+gst_omx_latency_tracer_class_init (GstOMXLatencyTracerClass * klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+
+  gobject_class->constructed = gst_omx_latency_tracer_constructed;
+  gobject_class->finalize = gst_omx_latency_tracer_finalize;
+
+  latency_record = gst_tracer_record_new ("omx-latency.class",
+      "element", GST_TYPE_STRUCTURE, gst_structure_new ("value",
+          "type", G_TYPE_GTYPE, G_TYPE_STRING,
+          "related", GST_TYPE_TRACER_VALUE_SCOPE,
+          GST_TRACER_VALUE_SCOPE_ELEMENT, NULL),
+      "component", LATENCY_RECORD_FIELD (G_TYPE_STRING,
+          "name of the OMX component"),
+      "port", LATENCY_RECORD_FIELD (G_TYPE_INT,
+          "index of the port, -1 for frame latencies"),
+      "kind", LATENCY_RECORD_FIELD (G_TYPE_STRING,
+          "component, queued, held or frame"),
+      "count", LATENCY_RECORD_FIELD (G_TYPE_UINT64,
+          "number of samples in this interval"),
+      "min", LATENCY_RECORD_FIELD (G_TYPE_UINT64, "minimum latency in ns"),
+      "avg", LATENCY_RECORD_FIELD (G_TYPE_UINT64, "average latency in ns"),
+      "p99", LATENCY_RECORD_FIELD (G_TYPE_UINT64,
+          "99th percentile of the latency in ns"),
+      "max", LATENCY_RECORD_FIELD (G_TYPE_UINT64, "maximum latency in ns"),
+      NULL);
+}
+
+static void
+gst_omx_latency_tracer_init (GstOMXLatencyTracer * self)
+{
+  self->interval = GST_OMX_LATENCY_DEFAULT_INTERVAL;
+  self->stats =
+      g_hash_table_new_full (gst_omx_latency_key_hash,
+      gst_omx_latency_key_equal, (GDestroyNotify) gst_omx_latency_stats_free,
+      NULL);
+}
+
+gboolean
+gst_omx_latency_tracer_register (GstPlugin * plugin)
+{
+  return gst_tracer_register (plugin, "omxlatency",
+      gst_omx_latency_tracer_get_type ());
+}
+
+#else /* !GST_CHECK_VERSION(1,8,0) */
+
+/* The tracing subsystem only exists since 1.8, the
+ * hooks are never called without a tracer */
+
+gboolean
+gst_omx_latency_tracer_register (GstPlugin * plugin)
+{
+  return TRUE;
+}
+
+GstOMXLatencyBuffer *
+gst_omx_latency_buffer_new (void)
+{
+  return NULL;
+}
+
+void
+gst_omx_latency_buffer_free (GstOMXLatencyBuffer * buffer)
+{
+}
+
+void
+gst_omx_latency_tracer_port_sample (GstOMXPort * port, GstOMXLatencyKind kind,
+    GstClockTime latency)
+{
+}
+
+void
+gst_omx_latency_tracer_frame_sample (GstOMXComponent * comp,
+    GstClockTime latency)
+{
+}
+
+void
+gst_omx_latency_tracer_collect (GstOMXComponent * comp)
+{
+}
+
+void
+gst_omx_latency_tracer_component_freed (GstOMXComponent * comp)
+{
+}
+
+#endif
@@ -0,0 +1,61 @@
+/*
+ * Copyright (C) 2026, the gst-omx authors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+#ifndef __GST_OMX_LATENCY_TRACER_H__
+#define __GST_OMX_LATENCY_TRACER_H__
+
+#include <gst/gst.h>
+
+#include "gstomx.h"
+
+G_BEGIN_DECLS
+
+typedef enum {
+  /* From {Empty,Fill}ThisBuffer until the component returned the buffer */
+  GST_OMX_LATENCY_COMPONENT = 0,
+  /* From the callback until the buffer was acquired again */
+  GST_OMX_LATENCY_QUEUED,
+  /* From acquiring the buffer until it was released to the component,
+   * i.e. our own buffer handling and downstream */
+  GST_OMX_LATENCY_HELD,
+  /* From an input frame until the matching output frame */
+  GST_OMX_LATENCY_FRAME,
+  GST_OMX_LATENCY_N_KINDS
+} GstOMXLatencyKind;
+
+/* Set while an omxlatency tracer exists, the hooks
+ * below must only be called if it is */
+extern volatile gint _gst_omx_latency_tracing;
+
+#define GST_OMX_LATENCY_TRACING() \
+    G_UNLIKELY (g_atomic_int_get (&_gst_omx_latency_tracing))
+
+gboolean gst_omx_latency_tracer_register (GstPlugin *plugin);
+
+GstOMXLatencyBuffer * gst_omx_latency_buffer_new (void);
+void     gst_omx_latency_buffer_free (GstOMXLatencyBuffer *buffer);
+
+void     gst_omx_latency_tracer_port_sample (GstOMXPort *port, GstOMXLatencyKind kind, GstClockTime latency);
+void     gst_omx_latency_tracer_frame_sample (GstOMXComponent *comp, GstClockTime latency);
+void     gst_omx_latency_tracer_collect (GstOMXComponent *comp);
+void     gst_omx_latency_tracer_component_freed (GstOMXComponent *comp);
+
+G_END_DECLS
+
+#endif /* __GST_OMX_LATENCY_TRACER_H__ */
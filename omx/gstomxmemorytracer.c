@@ -0,0 +1,331 @@
+/*
+ * Copyright (C) 2026, the gst-omx authors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+/* Tracer that reports how much memory the components hold, enabled
+ * with GST_TRACERS=omxmemory or GST_TRACERS="omxmemory(interval=500)"
+ * for a report every 500ms instead of every second.
+ *
+ * Reports are only done when the memory usage of any component changes
+ * and at least the interval passed since the last one. For every
+ * component the number of objects, bytes and peak bytes of every kind
+ * of memory (see GstOMXMemoryKind) are logged with the "omx-memory"
+ * tracer record and the same for the whole process with the
+ * "omx-memory-total" record. The last usage of every component is
+ * reported again when it is freed, anything but 0 there is a leak */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gst/gst.h>
+
+#include "gstomxmemorytracer.h"
+
+volatile gint _gst_omx_memory_tracing = 0;
+
+#if GST_CHECK_VERSION(1,8,0)
+
+GST_DEBUG_CATEGORY_STATIC (gst_omx_memory_tracer_debug_category);
+#define GST_CAT_DEFAULT gst_omx_memory_tracer_debug_category
+
+#define GST_OMX_MEMORY_DEFAULT_INTERVAL (GST_SECOND)
+
+typedef struct
+{
+  GstOMXComponent *comp;
+
+  gchar *element;
+  gchar *component;
+} GstOMXMemoryComponent;
+
+typedef struct
+{
+  GstTracer parent;
+
+  GstClockTime interval;
+  GstClockTime last_report;
+
+  /* GstOMXComponent -> GstOMXMemoryComponent */
+  GHashTable *components;
+} GstOMXMemoryTracer;
+
+typedef struct
+{
+  GstTracerClass parent_class;
+} GstOMXMemoryTracerClass;
+
+/* Protects tracer and everything in it */
+G_LOCK_DEFINE_STATIC (tracer);
+static GstOMXMemoryTracer *tracer = NULL;
+
+static GstTracerRecord *memory_record = NULL;
+static GstTracerRecord *memory_total_record = NULL;
+
+#define DEBUG_INIT \
+  GST_DEBUG_CATEGORY_INIT (gst_omx_memory_tracer_debug_category, \
+      "omxmemorytracer", 0, "gst-omx memory tracer");
+
+G_DEFINE_TYPE_WITH_CODE (GstOMXMemoryTracer, gst_omx_memory_tracer,
+    GST_TYPE_TRACER, DEBUG_INIT);
+
+static GstOMXMemoryComponent *
+gst_omx_memory_component_new (GstOMXComponent * comp)
+{
+  GstOMXMemoryComponent *mc = g_slice_new0 (GstOMXMemoryComponent);
+
+  mc->comp = comp;
+  mc->element =
+      g_strdup (comp->parent ? GST_OBJECT_NAME (comp->parent) : "(pooled)");
+  mc->component = g_strdup (comp->name);
+
+  return mc;
+}
+
+static void
+gst_omx_memory_component_free (GstOMXMemoryComponent * mc)
+{
+  g_free (mc->element);
+  g_free (mc->component);
+  g_slice_free (GstOMXMemoryComponent, mc);
+}
+
+/* NOTE: Must be called with the tracer lock */
+static void
+gst_omx_memory_component_report (GstOMXMemoryComponent * mc)
+{
+  GstOMXMemoryUsage usage;
+  gint i;
+
+  gst_omx_component_get_memory_usage (mc->comp, &usage);
+  for (i = 0; i < GST_OMX_MEMORY_N_KINDS; i++) {
+    if (usage.peak[i] == 0)
+      continue;
+
+    gst_tracer_record_log (memory_record, mc->element, mc->component,
+        gst_omx_memory_kind_to_string (i), usage.count[i], usage.bytes[i],
+        usage.peak[i]);
+  }
+}
+
+/* NOTE: Must be called with the tracer lock */
+static void
+gst_omx_memory_tracer_report_total (void)
+{
+  GstOMXMemoryUsage usage;
+  gint i;
+
+  gst_omx_get_memory_usage (&usage);
+  for (i = 0; i < GST_OMX_MEMORY_N_KINDS; i++) {
+    if (usage.peak[i] == 0)
+      continue;
+
+    gst_tracer_record_log (memory_total_record,
+        gst_omx_memory_kind_to_string (i), usage.count[i], usage.bytes[i],
+        usage.peak[i]);
+  }
+}
+
+/* NOTE: Must be called with the tracer lock */
+static void
+gst_omx_memory_tracer_report (void)
+{
+  GHashTableIter iter;
+  gpointer value;
+
+  g_hash_table_iter_init (&iter, tracer->components);
+  while (g_hash_table_iter_next (&iter, NULL, &value))
+    gst_omx_memory_component_report (value);
+  gst_omx_memory_tracer_report_total ();
+
+  tracer->last_report = gst_util_get_timestamp ();
+}
+
+/* NOTE: Must not be called with the memory usage lock of gstomx.c */
+void
+gst_omx_memory_tracer_changed (GstOMXComponent * comp)
+{
+  G_LOCK (tracer);
+  if (tracer) {
+    if (!g_hash_table_contains (tracer->components, comp))
+      g_hash_table_insert (tracer->components, comp,
+          gst_omx_memory_component_new (comp));
+
+    if (gst_util_get_timestamp () - tracer->last_report >= tracer->interval)
+      gst_omx_memory_tracer_report ();
+  }
+  G_UNLOCK (tracer);
+}
+
+/* Reports the last usage of the component */
+void
+gst_omx_memory_tracer_component_freed (GstOMXComponent * comp)
+{
+  G_LOCK (tracer);
+  if (tracer) {
+    GstOMXMemoryComponent *mc;
+
+    mc = g_hash_table_lookup (tracer->components, comp);
+    if (mc) {
+      gst_omx_memory_component_report (mc);
+      gst_omx_memory_tracer_report_total ();
+      g_hash_table_remove (tracer->components, comp);
+    }
+  }
+  G_UNLOCK (tracer);
+}
+
+static void
+gst_omx_memory_tracer_constructed (GObject * object)
+{
+  GstOMXMemoryTracer *self = (GstOMXMemoryTracer *) object;
+  gchar *params, *tmp;
+  GstStructure *s;
+  guint interval;
+
+  G_OBJECT_CLASS (gst_omx_memory_tracer_parent_class)->constructed (object);
+
+  g_object_get (self, "params", &params, NULL);
+  if (params) {
+    tmp = g_strdup_printf ("omxmemory,%s", params);
+    s = gst_structure_new_from_string (tmp);
+    g_free (tmp);
+
+    if (s && gst_structure_get_uint (s, "interval", &interval))
+      self->interval = interval * GST_MSECOND;
+    else if (!s)
+      GST_WARNING_OBJECT (self, "Invalid parameters '%s'", params);
+
+    if (s)
+      gst_structure_free (s);
+    g_free (params);
+  }
+
+  G_LOCK (tracer);
+  if (tracer) {
+    GST_WARNING_OBJECT (self, "Only one omxmemory tracer is supported");
+  } else {
+    self->last_report = gst_util_get_timestamp ();
+    tracer = self;
+    g_atomic_int_set (&_gst_omx_memory_tracing, 1);
+  }
+  G_UNLOCK (tracer);
+
+  GST_INFO_OBJECT (self, "Reporting memory usage every %" GST_TIME_FORMAT,
+      GST_TIME_ARGS (self->interval));
+}
+
+static void
+gst_omx_memory_tracer_finalize (GObject * object)
+{
+  GstOMXMemoryTracer *self = (GstOMXMemoryTracer *) object;
+
+  G_LOCK (tracer);
+  if (tracer == self) {
+    g_atomic_int_set (&_gst_omx_memory_tracing, 0);
+    gst_omx_memory_tracer_report ();
+    tracer = NULL;
+  }
+  G_UNLOCK (tracer);
+
+  g_hash_table_unref (self->components);
+
+  G_OBJECT_CLASS (gst_omx_memory_tracer_parent_class)->finalize (object);
+}
+
+#define MEMORY_RECORD_FIELD(type, desc) \
+    GST_TYPE_STRUCTURE, gst_structure_new ("value", \
+        "type", G_TYPE_GTYPE, type, \
+        "description", G_TYPE_STRING, desc, \
+        NULL)
+
+static void
+gst_omx_memory_tracer_class_init (GstOMXMemoryTracerClass * klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+
+  gobject_class->constructed = gst_omx_memory_tracer_constructed;
+  gobject_class->finalize = gst_omx_memory_tracer_finalize;
+
+  memory_record = gst_tracer_record_new ("omx-memory.class",
+      "element", GST_TYPE_STRUCTURE, gst_structure_new ("value",
+          "type", G_TYPE_GTYPE, G_TYPE_STRING,
+          "related", GST_TYPE_TRACER_VALUE_SCOPE,
+          GST_TRACER_VALUE_SCOPE_ELEMENT, NULL),
+      "component", MEMORY_RECORD_FIELD (G_TYPE_STRING,
+          "name of the OMX component"),
+      "kind", MEMORY_RECORD_FIELD (G_TYPE_STRING,
+          "omx-buffers, wrappers, pool-buffers, codec-data or pending-frames"),
+      "count", MEMORY_RECORD_FIELD (G_TYPE_INT64, "number of objects"),
+      "bytes", MEMORY_RECORD_FIELD (G_TYPE_INT64, "size of all objects"),
+      "peak", MEMORY_RECORD_FIELD (G_TYPE_INT64,
+          "maximum size of all objects so far"), NULL);
+
+  memory_total_record = gst_tracer_record_new ("omx-memory-total.class",
+      "kind", GST_TYPE_STRUCTURE, gst_structure_new ("value",
+          "type", G_TYPE_GTYPE, G_TYPE_STRING,
+          "description", G_TYPE_STRING,
+          "omx-buffers, wrappers, pool-buffers, codec-data or pending-frames",
+          "related", GST_TYPE_TRACER_VALUE_SCOPE,
+          GST_TRACER_VALUE_SCOPE_PROCESS, NULL),
+      "count", MEMORY_RECORD_FIELD (G_TYPE_INT64,
+          "number of objects of all components"),
+      "bytes", MEMORY_RECORD_FIELD (G_TYPE_INT64,
+          "size of all objects of all components"),
+      "peak", MEMORY_RECORD_FIELD (G_TYPE_INT64,
+          "maximum size of all objects of all components so far"), NULL);
+}
+
+static void
+gst_omx_memory_tracer_init (GstOMXMemoryTracer * self)
+{
+  self->interval = GST_OMX_MEMORY_DEFAULT_INTERVAL;
+  self->components =
+      g_hash_table_new_full (NULL, NULL, NULL,
+      (GDestroyNotify) gst_omx_memory_component_free);
+}
+
+gboolean
+gst_omx_memory_tracer_register (GstPlugin * plugin)
+{
+  return gst_tracer_register (plugin, "omxmemory",
+      gst_omx_memory_tracer_get_type ());
+}
+
+#else /* !GST_CHECK_VERSION(1,8,0) */
+
+/* The tracing subsystem only exists since 1.8, the
+ * hooks are never called without a tracer */
+
+gboolean
+gst_omx_memory_tracer_register (GstPlugin * plugin)
+{
+  return TRUE;
+}
+
+void
+gst_omx_memory_tracer_changed (GstOMXComponent * comp)
+{
+}
+
+void
+gst_omx_memory_tracer_component_freed (GstOMXComponent * comp)
+{
+}
+
+#endif
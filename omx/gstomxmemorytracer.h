@@ -0,0 +1,43 @@
+/*
+ * Copyright (C) 2026, the gst-omx authors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+#ifndef __GST_OMX_MEMORY_TRACER_H__
+#define __GST_OMX_MEMORY_TRACER_H__
+
+#include <gst/gst.h>
+
+#include "gstomx.h"
+
+G_BEGIN_DECLS
+
+/* Set while an omxmemory tracer exists, the hooks
+ * below must only be called if it is */
+extern volatile gint _gst_omx_memory_tracing;
+
+#define GST_OMX_MEMORY_TRACING() \
+    G_UNLIKELY (g_atomic_int_get (&_gst_omx_memory_tracing))
+
+gboolean gst_omx_memory_tracer_register (GstPlugin *plugin);
+
+void     gst_omx_memory_tracer_changed (GstOMXComponent *comp);
+void     gst_omx_memory_tracer_component_freed (GstOMXComponent *comp);
+
+G_END_DECLS
+
+#endif /* __GST_OMX_MEMORY_TRACER_H__ */
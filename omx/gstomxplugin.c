@@ -0,0 +1,454 @@
+/*
+ * Copyright (C) 2011, Hewlett-Packard Development Company, L.P.
+ *   Author: Sebastian Dröge <sebastian.droege@collabora.co.uk>, Collabora Ltd.
+ * Copyright (C) 2013, Collabora Ltd.
+ *   Author: Sebastian Dröge <sebastian.droege@collabora.co.uk>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gst/gst.h>
+#include <string.h>
+
+#include "gstomx.h"
+#include "gstomxlatencytracer.h"
+#include "gstomxmemorytracer.h"
+#include "gstomxprobe.h"
+#include "gstomxvideodec.h"
+#include "gstomxvideoenc.h"
+#include "gstomxaudioenc.h"
+#include "gstomxmjpegdec.h"
+#include "gstomxmpeg2videodec.h"
+#include "gstomxmpeg4videodec.h"
+#include "gstomxh264dec.h"
+#include "gstomxh263dec.h"
+#include "gstomxvp8dec.h"
+#include "gstomxtheoradec.h"
+#include "gstomxwmvdec.h"
+#include "gstomxmpeg4videoenc.h"
+#include "gstomxh264enc.h"
+#include "gstomxh263enc.h"
+#include "gstomxaacenc.h"
+
+GST_DEBUG_CATEGORY_EXTERN (gstomx_debug);
+#define GST_CAT_DEFAULT gstomx_debug
+
+typedef GType (*GGetTypeFunction) (void);
+
+static const GGetTypeFunction types[] = {
+  gst_omx_mpeg2_video_dec_get_type, gst_omx_mpeg4_video_dec_get_type,
+  gst_omx_h264_dec_get_type, gst_omx_h263_dec_get_type,
+  gst_omx_wmv_dec_get_type, gst_omx_mpeg4_video_enc_get_type,
+  gst_omx_h264_enc_get_type, gst_omx_h263_enc_get_type,
+  gst_omx_aac_enc_get_type, gst_omx_mjpeg_dec_get_type
+#ifdef HAVE_VP8
+      , gst_omx_vp8_dec_get_type
+#endif
+#ifdef HAVE_THEORA
+      , gst_omx_theora_dec_get_type
+#endif
+};
+
+struct TypeOffest
+{
+  GType (*get_type) (void);
+  glong offset;
+};
+
+static const struct TypeOffest base_types[] = {
+  {gst_omx_video_dec_get_type, G_STRUCT_OFFSET (GstOMXVideoDecClass, cdata)},
+  {gst_omx_video_enc_get_type, G_STRUCT_OFFSET (GstOMXVideoEncClass, cdata)},
+  {gst_omx_audio_enc_get_type, G_STRUCT_OFFSET (GstOMXAudioEncClass, cdata)},
+};
+
+/* Find the GstOMXClassData for this class */
+static GstOMXClassData *
+_get_class_data (gpointer g_class)
+{
+  int i;
+
+  for (i = 0; i < G_N_ELEMENTS (base_types); i++) {
+    GType gtype = base_types[i].get_type ();
+
+    if (G_TYPE_CHECK_CLASS_TYPE (g_class, gtype))
+      return (GstOMXClassData *)
+          (((guint8 *) g_class) + base_types[i].offset);
+  }
+
+  return NULL;
+}
+
+static void
+_class_init (gpointer g_class, gpointer data)
+{
+  GstElementClass *element_class = GST_ELEMENT_CLASS (g_class);
+  GstOMXClassData *class_data;
+  GKeyFile *config;
+  const gchar *element_name = data;
+  GError *err;
+  gchar *core_name, *component_name, *component_role;
+  gint in_port_index, out_port_index;
+  gchar *template_caps;
+  GstPadTemplate *templ;
+  GstCaps *caps, *sink_caps = NULL, *src_caps = NULL;
+  gchar **hacks;
+
+  if (!element_name)
+    return;
+
+  class_data = _get_class_data (g_class);
+  g_assert (class_data != NULL);
+
+  config = gst_omx_get_configuration ();
+
+  /* This will alwaxys succeed, see check in plugin_init */
+  core_name = g_key_file_get_string (config, element_name, "core-name", NULL);
+  g_assert (core_name != NULL);
+  class_data->core_name = core_name;
+  component_name =
+      g_key_file_get_string (config, element_name, "component-name", NULL);
+  g_assert (component_name != NULL);
+  class_data->component_name = component_name;
+
+  /* If this fails we simply don't set a role */
+  if ((component_role =
+          g_key_file_get_string (config, element_name, "component-role",
+              NULL))) {
+    GST_DEBUG ("Using component-role '%s' for element '%s'", component_role,
+        element_name);
+    class_data->component_role = component_role;
+  }
+
+
+  /* Now set the inport/outport indizes and assume sane defaults */
+  err = NULL;
+  in_port_index =
+      g_key_file_get_integer (config, element_name, "in-port-index", &err);
+  if (err != NULL) {
+    GST_DEBUG ("No 'in-port-index' set for element '%s', auto-detecting: %s",
+        element_name, err->message);
+    in_port_index = -1;
+    g_error_free (err);
+  }
+  class_data->in_port_index = in_port_index;
+
+  err = NULL;
+  out_port_index =
+      g_key_file_get_integer (config, element_name, "out-port-index", &err);
+  if (err != NULL) {
+    GST_DEBUG ("No 'out-port-index' set for element '%s', auto-detecting: %s",
+        element_name, err->message);
+    out_port_index = -1;
+    g_error_free (err);
+  }
+  class_data->out_port_index = out_port_index;
+
+  if ((hacks =
+          g_key_file_get_string_list (config, element_name, "hacks", NULL,
+              NULL))) {
+#ifndef GST_DISABLE_GST_DEBUG
+    gchar **walk = hacks;
+
+    while (*walk) {
+      GST_DEBUG ("Using hack: %s", *walk);
+      walk++;
+    }
+#endif
+
+    class_data->hacks = gst_omx_parse_hacks (hacks);
+  }
+
+  /* Add pad templates */
+  err = NULL;
+  if (class_data->type != GST_OMX_COMPONENT_TYPE_SOURCE) {
+    if (!(template_caps =
+            g_key_file_get_string (config, element_name, "sink-template-caps",
+                &err))) {
+      GST_DEBUG
+          ("No sink template caps specified for element '%s', using default '%s'",
+          element_name, class_data->default_sink_template_caps);
+      caps = gst_caps_from_string (class_data->default_sink_template_caps);
+      g_assert (caps != NULL);
+      g_error_free (err);
+    } else {
+      caps = gst_caps_from_string (template_caps);
+      if (!caps) {
+        GST_DEBUG
+            ("Could not parse sink template caps '%s' for element '%s', using default '%s'",
+            template_caps, element_name,
+            class_data->default_sink_template_caps);
+        caps = gst_caps_from_string (class_data->default_sink_template_caps);
+        g_assert (caps != NULL);
+      }
+    }
+    sink_caps = caps;
+    g_free (template_caps);
+  }
+
+  err = NULL;
+  if (class_data->type != GST_OMX_COMPONENT_TYPE_SINK) {
+    if (!(template_caps =
+            g_key_file_get_string (config, element_name, "src-template-caps",
+                &err))) {
+      GST_DEBUG
+          ("No src template caps specified for element '%s', using default '%s'",
+          element_name, class_data->default_src_template_caps);
+      caps = gst_caps_from_string (class_data->default_src_template_caps);
+      g_assert (caps != NULL);
+      g_error_free (err);
+    } else {
+      caps = gst_caps_from_string (template_caps);
+      if (!caps) {
+        GST_DEBUG
+            ("Could not parse src template caps '%s' for element '%s', using default '%s'",
+            template_caps, element_name, class_data->default_src_template_caps);
+        caps = gst_caps_from_string (class_data->default_src_template_caps);
+        g_assert (caps != NULL);
+      }
+    }
+    src_caps = caps;
+    g_free (template_caps);
+  }
+
+  if (sink_caps) {
+    templ =
+        gst_pad_template_new ("sink", GST_PAD_SINK, GST_PAD_ALWAYS, sink_caps);
+    gst_element_class_add_pad_template (element_class, templ);
+  }
+  if (src_caps) {
+    templ = gst_pad_template_new ("src", GST_PAD_SRC, GST_PAD_ALWAYS, src_caps);
+    gst_element_class_add_pad_template (element_class, templ);
+  }
+}
+
+static gboolean
+plugin_init (GstPlugin * plugin)
+{
+  gboolean ret = FALSE;
+  GError *err = NULL;
+  GKeyFile *config;
+  gchar **config_dirs;
+  gchar **elements;
+  gchar *env_config_dir;
+  const gchar *user_config_dir;
+  const gchar *const *system_config_dirs;
+  GstStructure *cache = NULL;
+  gboolean rebuilding;
+  gint i, j;
+  gsize n_elements;
+  static const gchar *config_name[] = { "gstomx.conf", NULL };
+  static const gchar *env_config_name[] = { "GST_OMX_CONFIG_DIR", NULL };
+
+  GST_DEBUG_CATEGORY_INIT (gstomx_debug, "omx", 0, "gst-omx");
+
+  if (!gst_omx_latency_tracer_register (plugin))
+    GST_ERROR ("Failed to register the omxlatency tracer");
+  if (!gst_omx_memory_tracer_register (plugin))
+    GST_ERROR ("Failed to register the omxmemory tracer");
+
+  /* Read configuration file gstomx.conf from the preferred
+   * configuration directories */
+  env_config_dir = g_strdup (g_getenv (*env_config_name));
+  user_config_dir = g_get_user_config_dir ();
+  system_config_dirs = g_get_system_config_dirs ();
+  config_dirs =
+      g_new (gchar *, g_strv_length ((gchar **) system_config_dirs) + 3);
+
+  i = 0;
+  j = 0;
+  if (env_config_dir)
+    config_dirs[i++] = (gchar *) env_config_dir;
+  config_dirs[i++] = (gchar *) user_config_dir;
+  while (system_config_dirs[j])
+    config_dirs[i++] = (gchar *) system_config_dirs[j++];
+  config_dirs[i++] = NULL;
+
+  gst_plugin_add_dependency (plugin, env_config_name,
+      (const gchar **) (config_dirs + (env_config_dir ? 1 : 0)), config_name,
+      GST_PLUGIN_DEPENDENCY_FLAG_NONE);
+
+  config = g_key_file_new ();
+  gst_omx_set_configuration (config);
+  if (!g_key_file_load_from_dirs (config, *config_name,
+          (const gchar **) config_dirs, NULL, G_KEY_FILE_NONE, &err)) {
+    gchar *paths;
+
+    paths = g_strjoinv (":", config_dirs);
+    GST_ERROR ("Failed to load configuration file: %s (searched in: %s as per "
+        "GST_OMX_CONFIG_DIR environment variable, the xdg user config "
+        "directory (or XDG_CONFIG_HOME) and the system config directory "
+        "(or XDG_CONFIG_DIRS)", err->message, paths);
+    g_free (paths);
+    g_error_free (err);
+    goto done;
+  }
+
+  /* Initialize all types */
+  for (i = 0; i < G_N_ELEMENTS (types); i++)
+    types[i] ();
+
+  /* The plugin's cache data is only empty while the registry is
+   * being built, only then the components are probed */
+  rebuilding = gst_plugin_get_cache_data (plugin) == NULL;
+  if (rebuilding)
+    cache = gst_structure_new_empty ("gst-omx");
+  else
+    cache = gst_structure_copy (gst_plugin_get_cache_data (plugin));
+
+  elements = g_key_file_get_groups (config, &n_elements);
+  for (i = 0; i < n_elements; i++) {
+    GTypeQuery type_query;
+    GTypeInfo type_info = { 0, };
+    GType type, subtype;
+    gchar *type_name, *core_name, *component_name;
+    gint rank;
+
+    GST_DEBUG ("Registering element '%s'", elements[i]);
+
+    err = NULL;
+    if (!(type_name =
+            g_key_file_get_string (config, elements[i], "type-name", &err))) {
+      GST_ERROR
+          ("Unable to read 'type-name' configuration for element '%s': %s",
+          elements[i], err->message);
+      g_error_free (err);
+      continue;
+    }
+
+    type = g_type_from_name (type_name);
+    if (type == G_TYPE_INVALID) {
+      GST_ERROR ("Invalid type name '%s' for element '%s'", type_name,
+          elements[i]);
+      g_free (type_name);
+      continue;
+    }
+    if (!g_type_is_a (type, GST_TYPE_ELEMENT)) {
+      GST_ERROR ("Type '%s' is no GstElement subtype for element '%s'",
+          type_name, elements[i]);
+      g_free (type_name);
+      continue;
+    }
+    g_free (type_name);
+
+    /* And now some sanity checking */
+    err = NULL;
+    if (!(core_name =
+            g_key_file_get_string (config, elements[i], "core-name", &err))) {
+      GST_ERROR
+          ("Unable to read 'core-name' configuration for element '%s': %s",
+          elements[i], err->message);
+      g_error_free (err);
+      continue;
+    }
+    if (!g_file_test (core_name, G_FILE_TEST_IS_REGULAR)) {
+      GST_ERROR ("Core '%s' does not exist for element '%s'", core_name,
+          elements[i]);
+      g_free (core_name);
+      continue;
+    }
+
+    /* Probed template caps are only valid for this core */
+    if (g_key_file_get_boolean (config, elements[i], "probe-template-caps",
+            NULL)) {
+      gchar *core_paths[2] = { NULL, NULL };
+      gchar *core_names[2] = { NULL, NULL };
+
+      core_paths[0] = g_path_get_dirname (core_name);
+      core_names[0] = g_path_get_basename (core_name);
+      gst_plugin_add_dependency (plugin, NULL, (const gchar **) core_paths,
+          (const gchar **) core_names, GST_PLUGIN_DEPENDENCY_FLAG_NONE);
+      g_free (core_paths[0]);
+      g_free (core_names[0]);
+    }
+    g_free (core_name);
+
+    err = NULL;
+    if (!(component_name =
+            g_key_file_get_string (config, elements[i], "component-name",
+                &err))) {
+      GST_ERROR
+          ("Unable to read 'component-name' configuration for element '%s': %s",
+          elements[i], err->message);
+      g_error_free (err);
+      continue;
+    }
+    g_free (component_name);
+
+    err = NULL;
+    rank = g_key_file_get_integer (config, elements[i], "rank", &err);
+    if (err != NULL) {
+      GST_ERROR ("No rank set for element '%s': %s", elements[i], err->message);
+      g_error_free (err);
+      continue;
+    }
+
+    /* And now register the type, all other configuration will
+     * be handled by the type itself */
+    g_type_query (type, &type_query);
+    memset (&type_info, 0, sizeof (type_info));
+    type_info.class_size = type_query.class_size;
+    type_info.instance_size = type_query.instance_size;
+    type_info.class_init = _class_init;
+    type_info.class_data = g_strdup (elements[i]);
+    type_name = g_strdup_printf ("%s-%s", g_type_name (type), elements[i]);
+    if (g_type_from_name (type_name) != G_TYPE_INVALID) {
+      GST_ERROR ("Type '%s' already exists for element '%s'", type_name,
+          elements[i]);
+      g_free (type_name);
+      continue;
+    }
+    subtype = g_type_register_static (type, type_name, &type_info, 0);
+    g_free (type_name);
+
+    /* Restrict the templates to what the component really supports
+     * before the factory copies them into the registry */
+    if (g_key_file_get_boolean (config, elements[i], "probe-template-caps",
+            NULL)) {
+      gpointer g_class = g_type_class_ref (subtype);
+
+      gst_omx_probe_element_class (GST_ELEMENT_CLASS (g_class), elements[i],
+          _get_class_data (g_class), cache, rebuilding);
+      g_type_class_unref (g_class);
+    }
+
+    ret |= gst_element_register (plugin, elements[i], rank, subtype);
+  }
+  g_strfreev (elements);
+
+  if (rebuilding) {
+    gst_plugin_set_cache_data (plugin, cache);
+    cache = NULL;
+  }
+
+done:
+  if (cache)
+    gst_structure_free (cache);
+  g_free (env_config_dir);
+  g_free (config_dirs);
+
+  return ret;
+}
+
+GST_PLUGIN_DEFINE (GST_VERSION_MAJOR,
+    GST_VERSION_MINOR,
+    omx,
+    "GStreamer OpenMAX Plug-ins",
+    plugin_init,
+    PACKAGE_VERSION, GST_LICENSE, GST_PACKAGE_NAME, GST_PACKAGE_ORIGIN)
@@ -0,0 +1,526 @@
+/*
+ * Copyright (C) 2026, the gst-omx authors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gst/gst.h>
+
+#include "gstomxprobe.h"
+
+GST_DEBUG_CATEGORY_EXTERN (gstomx_debug);
+#define GST_CAT_DEFAULT gstomx_debug
+
+/* OpenMAX has no query for the maximum frame size, so the sizes are
+ * set on the input port from large to small and the first one that is
+ * neither rejected nor changed by the component is its limit */
+static const gint probe_sizes[] = {
+  8192, 4096, 3840, 2304, 2160, 2048, 1920, 1280, 1088, 1080, 720, 576, 480
+};
+
+/* Upper bound for the profile enumeration, some components
+ * never return OMX_ErrorNoMore */
+#define MAX_PROFILES (64)
+
+static gboolean
+gst_omx_probe_is_system_memory (GstCaps * caps, guint i)
+{
+  GstCapsFeatures *features = gst_caps_get_features (caps, i);
+
+  return features == NULL
+      || gst_caps_features_is_equal (features,
+      GST_CAPS_FEATURES_MEMORY_SYSTEM_MEMORY);
+}
+
+static gboolean
+gst_omx_probe_has_structure (GstCaps * caps, const gchar * name)
+{
+  guint i;
+
+  if (!caps)
+    return FALSE;
+
+  for (i = 0; i < gst_caps_get_size (caps); i++) {
+    if (gst_structure_has_name (gst_caps_get_structure (caps, i), name)
+        && gst_omx_probe_is_system_memory (caps, i))
+      return TRUE;
+  }
+
+  return FALSE;
+}
+
+/* Maximum of all integer ranges of field, 0 if there are none */
+static gint
+gst_omx_probe_get_range_max (GstCaps * caps, const gchar * field)
+{
+  const GValue *value;
+  gint max = 0;
+  guint i;
+
+  if (!caps)
+    return 0;
+
+  for (i = 0; i < gst_caps_get_size (caps); i++) {
+    value = gst_structure_get_value (gst_caps_get_structure (caps, i), field);
+    if (value && GST_VALUE_HOLDS_INT_RANGE (value))
+      max = MAX (max, gst_value_get_int_range_max (value));
+  }
+
+  return max;
+}
+
+static void
+gst_omx_probe_limit_range (GstCaps * caps, const gchar * field, gint limit)
+{
+  GstStructure *s;
+  const GValue *value;
+  gint min;
+  guint i;
+
+  if (!caps)
+    return;
+
+  for (i = 0; i < gst_caps_get_size (caps); i++) {
+    s = gst_caps_get_structure (caps, i);
+    value = gst_structure_get_value (s, field);
+    if (!value || !GST_VALUE_HOLDS_INT_RANGE (value)
+        || gst_value_get_int_range_max (value) <= limit)
+      continue;
+
+    min = gst_value_get_int_range_min (value);
+    if (min <= limit)
+      gst_structure_set (s, field, GST_TYPE_INT_RANGE, min, limit, NULL);
+  }
+}
+
+/* Replaces field of all structures named name by its intersection with
+ * values. Structures where the intersection would be empty are kept as
+ * they are, the component might just not report everything */
+static void
+gst_omx_probe_restrict_field (GstCaps * caps, const gchar * name,
+    const gchar * field, const GValue * values)
+{
+  GstStructure *s;
+  const GValue *value;
+  GValue res = G_VALUE_INIT;
+  guint i;
+
+  for (i = 0; i < gst_caps_get_size (caps); i++) {
+    s = gst_caps_get_structure (caps, i);
+    if (!gst_structure_has_name (s, name)
+        || !gst_omx_probe_is_system_memory (caps, i))
+      continue;
+
+    value = gst_structure_get_value (s, field);
+    if (!value) {
+      gst_structure_set_value (s, field, values);
+    } else if (gst_value_intersect (&res, value, values)) {
+      gst_structure_set_value (s, field, &res);
+      g_value_unset (&res);
+    }
+  }
+}
+
+static void
+gst_omx_probe_list_append_string (GValue * list, const gchar * str)
+{
+  GValue value = G_VALUE_INIT;
+  guint i;
+
+  for (i = 0; i < gst_value_list_get_size (list); i++) {
+    if (g_strcmp0 (g_value_get_string (gst_value_list_get_value (list, i)),
+            str) == 0)
+      return;
+  }
+
+  g_value_init (&value, G_TYPE_STRING);
+  g_value_set_string (&value, str);
+  gst_value_list_append_and_take_value (list, &value);
+}
+
+static gint
+gst_omx_probe_max_dimension (GstOMXPort * port, gboolean height, gint limit)
+{
+  OMX_PARAM_PORTDEFINITIONTYPE port_def;
+  OMX_U32 *dimension;
+  gint size;
+  gint i;
+
+  for (i = -1; i < (gint) G_N_ELEMENTS (probe_sizes); i++) {
+    /* The limit of the template caps is always tried first */
+    size = i < 0 ? limit : probe_sizes[i];
+    if (i >= 0 && size >= limit)
+      continue;
+
+    gst_omx_port_get_port_definition (port, &port_def);
+    dimension = height ? &port_def.format.video.nFrameHeight :
+        &port_def.format.video.nFrameWidth;
+    *dimension = size;
+    if (gst_omx_port_update_port_definition (port, &port_def) != OMX_ErrorNone)
+      continue;
+
+    dimension = height ? &port->port_def.format.video.nFrameHeight :
+        &port->port_def.format.video.nFrameWidth;
+    if (*dimension == size)
+      return size;
+  }
+
+  return 0;
+}
+
+static void
+gst_omx_probe_frame_size (GstOMXPort * port, GstCaps * sink_caps,
+    GstCaps * src_caps)
+{
+  GstOMXComponent *comp = port->comp;
+  OMX_PARAM_PORTDEFINITIONTYPE port_def;
+  gint size[2], limit[2];
+  gint *cached;
+  gchar *key;
+  gsize n;
+
+  limit[0] = MAX (gst_omx_probe_get_range_max (sink_caps, "width"),
+      gst_omx_probe_get_range_max (src_caps, "width"));
+  limit[1] = MAX (gst_omx_probe_get_range_max (sink_caps, "height"),
+      gst_omx_probe_get_range_max (src_caps, "height"));
+  if (limit[0] <= 0 || limit[1] <= 0)
+    return;
+
+  key = g_strdup_printf ("max-frame-size-%u", (guint) port->index);
+  cached = gst_omx_component_get_cached_integers (comp, key, &n);
+  if (cached && n == 2) {
+    size[0] = cached[0];
+    size[1] = cached[1];
+  } else {
+    gst_omx_port_get_port_definition (port, &port_def);
+    size[0] = gst_omx_probe_max_dimension (port, FALSE, limit[0]);
+    size[1] = gst_omx_probe_max_dimension (port, TRUE, limit[1]);
+    gst_omx_port_update_port_definition (port, &port_def);
+
+    gst_omx_component_set_cached_integers (comp, key, size, 2);
+  }
+  g_free (cached);
+  g_free (key);
+
+  GST_DEBUG_OBJECT (comp->parent, "Maximum frame size of %s port %u: %dx%d",
+      comp->name, port->index, size[0], size[1]);
+
+  if (size[0] > 0) {
+    gst_omx_probe_limit_range (sink_caps, "width", size[0]);
+    gst_omx_probe_limit_range (src_caps, "width", size[0]);
+  }
+  if (size[1] > 0) {
+    gst_omx_probe_limit_range (sink_caps, "height", size[1]);
+    gst_omx_probe_limit_range (src_caps, "height", size[1]);
+  }
+}
+
+static void
+gst_omx_probe_color_formats (GstOMXPort * port, GstCaps * caps)
+{
+  GValue formats = G_VALUE_INIT;
+  gint *color_formats;
+  gsize i, n;
+
+  color_formats = gst_omx_port_get_video_color_formats (port, 0, &n);
+
+  g_value_init (&formats, GST_TYPE_LIST);
+  for (i = 0; i < n; i++) {
+    switch (color_formats[i]) {
+      case OMX_COLOR_FormatYUV420Planar:
+      case OMX_COLOR_FormatYUV420PackedPlanar:
+        gst_omx_probe_list_append_string (&formats, "I420");
+        break;
+      case OMX_COLOR_FormatYUV420SemiPlanar:
+        gst_omx_probe_list_append_string (&formats, "NV12");
+        break;
+      default:
+        break;
+    }
+  }
+  g_free (color_formats);
+
+  GST_DEBUG_OBJECT (port->comp->parent, "Supported formats of %s port %u: %"
+      GST_PTR_FORMAT, port->comp->name, port->index, &formats);
+
+  if (gst_value_list_get_size (&formats) > 0)
+    gst_omx_probe_restrict_field (caps, "video/x-raw", "format", &formats);
+  g_value_unset (&formats);
+}
+
+static void
+gst_omx_probe_avc_profiles (GstOMXPort * port, GstCaps * caps)
+{
+  GstOMXComponent *comp = port->comp;
+  OMX_VIDEO_PARAM_PROFILELEVELTYPE param;
+  GValue profiles = G_VALUE_INIT;
+  gboolean implied;
+  GArray *values;
+  gint *cached;
+  gchar *key;
+  gsize i, n;
+
+  key = g_strdup_printf ("avc-profiles-%u", (guint) port->index);
+  cached = gst_omx_component_get_cached_integers (comp, key, &n);
+  if (!cached) {
+    values = g_array_new (FALSE, FALSE, sizeof (gint));
+
+    GST_OMX_INIT_STRUCT (&param);
+    param.nPortIndex = port->index;
+    for (param.nProfileIndex = 0; param.nProfileIndex < MAX_PROFILES;
+        param.nProfileIndex++) {
+      gint profile;
+
+      if (gst_omx_component_get_parameter (comp,
+              OMX_IndexParamVideoProfileLevelQuerySupported,
+              &param) != OMX_ErrorNone)
+        break;
+
+      profile = param.eProfile;
+      g_array_append_val (values, profile);
+    }
+
+    gst_omx_component_set_cached_integers (comp, key,
+        (const gint *) values->data, values->len);
+    n = values->len;
+    cached = (gint *) g_array_free (values, FALSE);
+  }
+  g_free (key);
+
+  /* A decoder for a profile can also decode the profiles it is a
+   * superset of, even if the component only reports the largest */
+  implied = port->port_def.eDir == OMX_DirInput;
+
+  g_value_init (&profiles, GST_TYPE_LIST);
+  for (i = 0; i < n; i++) {
+    switch (cached[i]) {
+      case OMX_VIDEO_AVCProfileHigh:
+        gst_omx_probe_list_append_string (&profiles, "high");
+        if (!implied)
+          break;
+        /* fall through */
+      case OMX_VIDEO_AVCProfileMain:
+        gst_omx_probe_list_append_string (&profiles, "main");
+        if (implied)
+          gst_omx_probe_list_append_string (&profiles,
+              "constrained-baseline");
+        break;
+      case OMX_VIDEO_AVCProfileBaseline:
+        gst_omx_probe_list_append_string (&profiles, "baseline");
+        gst_omx_probe_list_append_string (&profiles, "constrained-baseline");
+        break;
+      case OMX_VIDEO_AVCProfileExtended:
+        gst_omx_probe_list_append_string (&profiles, "extended");
+        break;
+      case OMX_VIDEO_AVCProfileHigh10:
+        gst_omx_probe_list_append_string (&profiles, "high-10");
+        break;
+      case OMX_VIDEO_AVCProfileHigh422:
+        gst_omx_probe_list_append_string (&profiles, "high-4:2:2");
+        break;
+      case OMX_VIDEO_AVCProfileHigh444:
+        gst_omx_probe_list_append_string (&profiles, "high-4:4:4");
+        break;
+      default:
+        break;
+    }
+  }
+  g_free (cached);
+
+  GST_DEBUG_OBJECT (comp->parent, "Supported profiles of %s port %u: %"
+      GST_PTR_FORMAT, comp->name, port->index, &profiles);
+
+  if (gst_value_list_get_size (&profiles) > 0)
+    gst_omx_probe_restrict_field (caps, "video/x-h264", "profile", &profiles);
+  g_value_unset (&profiles);
+}
+
+static void
+gst_omx_probe_port_caps (GstOMXPort * port, GstCaps * caps)
+{
+  if (gst_omx_probe_has_structure (caps, "video/x-raw"))
+    gst_omx_probe_color_formats (port, caps);
+  if (gst_omx_probe_has_structure (caps, "video/x-h264"))
+    gst_omx_probe_avc_profiles (port, caps);
+}
+
+/* Returns FALSE if the component could not be probed */
+static gboolean
+gst_omx_probe_template_caps (const gchar * element_name,
+    const GstOMXClassData * class_data, GstCaps * sink_caps,
+    GstCaps * src_caps)
+{
+  GstObject *parent;
+  GstOMXComponent *comp;
+  GstOMXPort *in_port, *out_port;
+  gint in_port_index, out_port_index;
+  gboolean ret = FALSE;
+
+  /* No element is instantiated for the probe, the component only
+   * needs some object for its debug output */
+  parent = gst_object_ref_sink (gst_bin_new (element_name));
+
+  comp =
+      gst_omx_component_new_unmanaged (parent, class_data->core_name,
+      class_data->component_name, class_data->component_role,
+      class_data->hacks);
+  if (!comp)
+    goto done;
+
+  if (gst_omx_component_get_state (comp,
+          GST_CLOCK_TIME_NONE) != OMX_StateLoaded)
+    goto done;
+
+  in_port_index = class_data->in_port_index;
+  out_port_index = class_data->out_port_index;
+
+  if (in_port_index == -1 || out_port_index == -1) {
+    OMX_PORT_PARAM_TYPE param;
+
+    GST_OMX_INIT_STRUCT (&param);
+
+    if (gst_omx_component_get_parameter (comp, OMX_IndexParamVideoInit,
+            &param) != OMX_ErrorNone) {
+      /* Fallback */
+      in_port_index = 0;
+      out_port_index = 1;
+    } else {
+      in_port_index = param.nStartPortNumber + 0;
+      out_port_index = param.nStartPortNumber + 1;
+    }
+  }
+  in_port = gst_omx_component_add_port (comp, in_port_index);
+  out_port = gst_omx_component_add_port (comp, out_port_index);
+
+  if (!in_port || !out_port)
+    goto done;
+
+  if (in_port->port_def.eDomain != OMX_PortDomainVideo
+      || out_port->port_def.eDomain != OMX_PortDomainVideo) {
+    GST_DEBUG_OBJECT (parent, "Only video components are probed");
+    goto done;
+  }
+
+  gst_omx_probe_frame_size (in_port, sink_caps, src_caps);
+  if (sink_caps)
+    gst_omx_probe_port_caps (in_port, sink_caps);
+  if (src_caps)
+    gst_omx_probe_port_caps (out_port, src_caps);
+
+  GST_INFO_OBJECT (parent, "Probed sink caps %" GST_PTR_FORMAT
+      " and src caps %" GST_PTR_FORMAT, sink_caps, src_caps);
+  ret = TRUE;
+
+done:
+  if (comp)
+    gst_omx_component_free (comp);
+  gst_object_unref (parent);
+
+  return ret;
+}
+
+static GstCaps *
+gst_omx_probe_copy_template_caps (GstElementClass * element_class,
+    const gchar * name)
+{
+  GstPadTemplate *templ;
+
+  templ = gst_element_class_get_pad_template (element_class, name);
+  if (!templ)
+    return NULL;
+
+  return gst_caps_copy (GST_PAD_TEMPLATE_CAPS (templ));
+}
+
+/* Replaces the pad template name by one with caps */
+static void
+gst_omx_probe_set_template_caps (GstElementClass * element_class,
+    const gchar * name, GstCaps * caps)
+{
+  GstPadTemplate *templ;
+
+  templ = gst_element_class_get_pad_template (element_class, name);
+  if (!templ || !caps)
+    return;
+
+  templ = gst_pad_template_new (name, GST_PAD_TEMPLATE_DIRECTION (templ),
+      GST_PAD_TEMPLATE_PRESENCE (templ), caps);
+  gst_element_class_add_pad_template (element_class, templ);
+}
+
+static GstCaps *
+gst_omx_probe_get_cached_caps (const GstStructure * cache,
+    const gchar * element_name, const gchar * name)
+{
+  const gchar *str;
+  gchar *field;
+
+  field = g_strdup_printf ("%s-%s-caps", element_name, name);
+  str = gst_structure_get_string (cache, field);
+  g_free (field);
+
+  return str ? gst_caps_from_string (str) : NULL;
+}
+
+static void
+gst_omx_probe_set_cached_caps (GstStructure * cache,
+    const gchar * element_name, const gchar * name, GstCaps * caps)
+{
+  gchar *field, *str;
+
+  if (!caps)
+    return;
+
+  field = g_strdup_printf ("%s-%s-caps", element_name, name);
+  str = gst_caps_to_string (caps);
+  gst_structure_set (cache, field, G_TYPE_STRING, str, NULL);
+  g_free (str);
+  g_free (field);
+}
+
+void
+gst_omx_probe_element_class (GstElementClass * element_class,
+    const gchar * element_name, const GstOMXClassData * class_data,
+    GstStructure * cache, gboolean rebuilding)
+{
+  GstCaps *sink_caps, *src_caps;
+
+  if (rebuilding) {
+    sink_caps = gst_omx_probe_copy_template_caps (element_class, "sink");
+    src_caps = gst_omx_probe_copy_template_caps (element_class, "src");
+    if (gst_omx_probe_template_caps (element_name, class_data, sink_caps,
+            src_caps)) {
+      gst_omx_probe_set_cached_caps (cache, element_name, "sink", sink_caps);
+      gst_omx_probe_set_cached_caps (cache, element_name, "src", src_caps);
+    }
+  } else {
+    /* Only use what the last registry build stored */
+    sink_caps = gst_omx_probe_get_cached_caps (cache, element_name, "sink");
+    src_caps = gst_omx_probe_get_cached_caps (cache, element_name, "src");
+  }
+
+  gst_omx_probe_set_template_caps (element_class, "sink", sink_caps);
+  gst_omx_probe_set_template_caps (element_class, "src", src_caps);
+
+  if (sink_caps)
+    gst_caps_unref (sink_caps);
+  if (src_caps)
+    gst_caps_unref (src_caps);
+}
@@ -0,0 +1,46 @@
+/*
+ * Copyright (C) 2026, the gst-omx authors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+#ifndef __GST_OMX_PROBE_H__
+#define __GST_OMX_PROBE_H__
+
+#include <gst/gst.h>
+
+#include "gstomx.h"
+
+G_BEGIN_DECLS
+
+/* Restricts the pad templates of a video element class to what its
+ * component reports to support: the raw color formats, the maximum
+ * frame size and the H.264 profiles. Called from plugin_init before
+ * the element is registered, for elements with probe-template-caps=true
+ * in gstomx.conf.
+ *
+ * Only while the registry is being built (rebuilding) the component is
+ * opened, without going through the pool and the admission budget, and
+ * the probed caps are stored in cache, the plugin's registry cache
+ * data. Otherwise the caps from cache are used and the hardware is not
+ * touched. The templates are left unchanged if the component can't be
+ * opened */
+
+void gst_omx_probe_element_class (GstElementClass *element_class, const gchar *element_name, const GstOMXClassData *class_data, GstStructure *cache, gboolean rebuilding);
+
+G_END_DECLS
+
+#endif /* __GST_OMX_PROBE_H__ */
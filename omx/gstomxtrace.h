@@ -0,0 +1,88 @@
+/*
+ * Copyright (C) 2026, the gst-omx authors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+#ifndef __GST_OMX_TRACE_H__
+#define __GST_OMX_TRACE_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Events of the flight recorder and the trace files. Only depends on
+ * GLib so that the fake core in tools/fakecore can replay traces */
+
+typedef enum {
+  /* data1: OMX_COMMANDTYPE, data2: parameter */
+  GST_OMX_FLIGHT_EVENT_COMMAND = 1,
+  /* data1: OMX_EVENTTYPE, data2: nData1, data3: nData2 */
+  GST_OMX_FLIGHT_EVENT_CALLBACK,
+  /* data1: port index, data2: nFlags, data3: nFilledLen, buffer set */
+  GST_OMX_FLIGHT_EVENT_EMPTY_THIS_BUFFER,
+  GST_OMX_FLIGHT_EVENT_FILL_THIS_BUFFER,
+  GST_OMX_FLIGHT_EVENT_EMPTY_BUFFER_DONE,
+  GST_OMX_FLIGHT_EVENT_FILL_BUFFER_DONE,
+  /* data1: GstOMXFlightEventType of the call, data2: OMX_ERRORTYPE,
+   * data3: port index or command parameter */
+  GST_OMX_FLIGHT_EVENT_CALL_FAILED
+} GstOMXFlightEventType;
+
+typedef struct _GstOMXFlightEvent GstOMXFlightEvent;
+typedef struct _GstOMXTraceHeader GstOMXTraceHeader;
+
+/* A single entry of a component's flight recorder. Binary and of
+ * fixed size so that recording is cheap, everything is only turned
+ * into strings when the recorder is dumped */
+struct _GstOMXFlightEvent {
+  guint64 time; /* Monotonic, in ns */
+  guint64 buffer; /* OMX_BUFFERHEADERTYPE, 0 if none */
+  guint32 type; /* GstOMXFlightEventType, 0 for unused entries */
+  guint32 data1, data2, data3;
+};
+
+/* Environment variable with the directory every component writes
+ * a trace of all its OMX calls and callbacks to, unset disables it */
+#define GST_OMX_TRACE_DIR_ENV "GST_OMX_TRACE_DIR"
+
+#define GST_OMX_TRACE_MAGIC "GSTOMXTR"
+#define GST_OMX_TRACE_VERSION (1)
+
+/* A trace file is this header followed by GstOMXFlightEvents, all in
+ * host byte order. Events are queued without locks from all threads
+ * and written by a separate thread, so events from different threads
+ * can be slightly out of order and readers sort them by time. If the
+ * writer can't keep up, events are dropped and a warning is logged.
+ *
+ * Traces are not replayed call by call. The fake core in
+ * tools/fakecore uses a trace to model every output buffer of its
+ * normal per-buffer processing loop after the traced one: service
+ * time, size, flags and port settings changes. This keeps the replay
+ * deterministic without a separate replay core, but the order of
+ * commands and callbacks in the trace is not reproduced */
+struct _GstOMXTraceHeader {
+  gchar magic[8]; /* GST_OMX_TRACE_MAGIC, not 0-terminated */
+  guint32 version; /* GST_OMX_TRACE_VERSION */
+  guint32 event_size; /* sizeof (GstOMXFlightEvent) */
+  guint64 start_time; /* Monotonic, in ns, when the component was created */
+  gchar component_name[128];
+  gchar component_role[128];
+};
+
+G_END_DECLS
+
+#endif /* __GST_OMX_TRACE_H__ */
@@ -0,0 +1,174 @@
+/*
+ * Copyright (C) 2026, the gst-omx authors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+
+#include "gstomxvideocopy.h"
+
+gboolean
+gst_omx_video_copy_supports_format (GstVideoFormat format)
+{
+  return format == GST_VIDEO_FORMAT_I420 || format == GST_VIDEO_FORMAT_NV12;
+}
+
+void
+gst_omx_video_copy_plane (guint8 * dest, gint dest_stride,
+    const guint8 * src, gint src_stride, guint width, guint height)
+{
+  guint i;
+
+  /* Same strides without padding, a single copy */
+  if (dest_stride == src_stride && dest_stride == (gint) width) {
+    memcpy (dest, src, (gsize) width * height);
+    return;
+  }
+
+  for (i = 0; i < height; i++) {
+    memcpy (dest, src, width);
+    src += src_stride;
+    dest += dest_stride;
+  }
+}
+
+/* Offset and stride of a plane inside the OpenMAX buffer,
+ * and the number of bytes per line to copy */
+static void
+gst_omx_video_copy_plane_layout (GstVideoFrame * frame, guint plane,
+    gint stride, guint slice_height, gsize * offset, gint * plane_stride,
+    guint * width, guint * height)
+{
+  *width = GST_VIDEO_FRAME_COMP_WIDTH (frame, plane) *
+      GST_VIDEO_FRAME_COMP_PSTRIDE (frame, plane);
+  *height = GST_VIDEO_FRAME_COMP_HEIGHT (frame, plane);
+
+  if (GST_VIDEO_FRAME_FORMAT (frame) == GST_VIDEO_FORMAT_I420) {
+    *plane_stride = (plane == 0) ? stride : stride / 2;
+    *offset = (plane > 0) ? (gsize) stride * slice_height : 0;
+    if (plane == 2)
+      *offset += (gsize) (stride / 2) * (slice_height / 2);
+  } else {
+    *plane_stride = stride;
+    *offset = (plane > 0) ? (gsize) stride * slice_height : 0;
+  }
+}
+
+static gboolean
+gst_omx_video_copy_resolve (GstVideoFrame * frame, gint * stride,
+    guint * slice_height)
+{
+  if (!gst_omx_video_copy_supports_format (GST_VIDEO_FRAME_FORMAT (frame)))
+    return FALSE;
+
+  if (*stride == 0)
+    *stride = GST_VIDEO_FRAME_PLANE_STRIDE (frame, 0);
+  if (*slice_height == 0)
+    *slice_height = GST_VIDEO_FRAME_HEIGHT (frame);
+
+  return *stride > 0;
+}
+
+/* Copies the OpenMAX buffer content src of size bytes into frame */
+gboolean
+gst_omx_video_copy_to_frame (GstVideoFrame * frame, const guint8 * src,
+    gsize size, gint stride, guint slice_height)
+{
+  guint i;
+
+  g_return_val_if_fail (frame != NULL, FALSE);
+  g_return_val_if_fail (src != NULL, FALSE);
+
+  if (!gst_omx_video_copy_resolve (frame, &stride, &slice_height))
+    return FALSE;
+
+  for (i = 0; i < GST_VIDEO_FRAME_N_PLANES (frame); i++) {
+    gsize offset;
+    gint plane_stride;
+    guint width, height;
+
+    gst_omx_video_copy_plane_layout (frame, i, stride, slice_height, &offset,
+        &plane_stride, &width, &height);
+    if (height > 0
+        && offset + (gsize) plane_stride * (height - 1) + width > size)
+      return FALSE;
+  }
+
+  for (i = 0; i < GST_VIDEO_FRAME_N_PLANES (frame); i++) {
+    gsize offset;
+    gint plane_stride;
+    guint width, height;
+
+    gst_omx_video_copy_plane_layout (frame, i, stride, slice_height, &offset,
+        &plane_stride, &width, &height);
+    gst_omx_video_copy_plane (GST_VIDEO_FRAME_PLANE_DATA (frame, i),
+        GST_VIDEO_FRAME_PLANE_STRIDE (frame, i), src + offset, plane_stride,
+        width, height);
+  }
+
+  return TRUE;
+}
+
+/* Copies frame into the OpenMAX buffer dest of size bytes, filled is
+ * set to the number of bytes to pass as nFilledLen */
+gboolean
+gst_omx_video_copy_from_frame (GstVideoFrame * frame, guint8 * dest,
+    gsize size, gint stride, guint slice_height, gsize * filled)
+{
+  guint i;
+
+  g_return_val_if_fail (frame != NULL, FALSE);
+  g_return_val_if_fail (dest != NULL, FALSE);
+  g_return_val_if_fail (filled != NULL, FALSE);
+
+  if (!gst_omx_video_copy_resolve (frame, &stride, &slice_height))
+    return FALSE;
+
+  *filled = 0;
+  for (i = 0; i < GST_VIDEO_FRAME_N_PLANES (frame); i++) {
+    gsize offset;
+    gint plane_stride;
+    guint width, height;
+
+    gst_omx_video_copy_plane_layout (frame, i, stride, slice_height, &offset,
+        &plane_stride, &width, &height);
+    if (height > 0
+        && offset + (gsize) plane_stride * (height - 1) + width > size)
+      return FALSE;
+    *filled += (gsize) plane_stride * height;
+  }
+
+  for (i = 0; i < GST_VIDEO_FRAME_N_PLANES (frame); i++) {
+    gsize offset;
+    gint plane_stride;
+    guint width, height;
+
+    gst_omx_video_copy_plane_layout (frame, i, stride, slice_height, &offset,
+        &plane_stride, &width, &height);
+    gst_omx_video_copy_plane (dest + offset, plane_stride,
+        GST_VIDEO_FRAME_PLANE_DATA (frame, i),
+        GST_VIDEO_FRAME_PLANE_STRIDE (frame, i), width, height);
+  }
+  /* The padding after the last line might be missing */
+  *filled = MIN (*filled, size);
+
+  return TRUE;
+}
@@ -0,0 +1,46 @@
+/*
+ * Copyright (C) 2026, the gst-omx authors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+#ifndef __GST_OMX_VIDEO_COPY_H__
+#define __GST_OMX_VIDEO_COPY_H__
+
+#include <gst/gst.h>
+#include <gst/video/video.h>
+
+G_BEGIN_DECLS
+
+/* Conversion between mapped video frames and the raw video layout of
+ * OpenMAX buffers, i.e. the planes one after another with nStride and
+ * nSliceHeight of the port definition. Only I420 and NV12 are supported.
+ *
+ * A stride or slice height of 0 means the stride of the frame or the
+ * height of the frame. The functions return FALSE if the OpenMAX buffer
+ * of size bytes is too small or the format is not supported */
+
+gboolean gst_omx_video_copy_supports_format (GstVideoFormat format);
+
+gboolean gst_omx_video_copy_to_frame (GstVideoFrame *frame, const guint8 *src, gsize size, gint stride, guint slice_height);
+gboolean gst_omx_video_copy_from_frame (GstVideoFrame *frame, guint8 *dest, gsize size, gint stride, guint slice_height, gsize *filled);
+
+/* The kernel used for every plane */
+void     gst_omx_video_copy_plane (guint8 *dest, gint dest_stride, const guint8 *src, gint src_stride, guint width, guint height);
+
+G_END_DECLS
+
+#endif /* __GST_OMX_VIDEO_COPY_H__ */
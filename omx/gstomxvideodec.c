@@ -50,6 +50,8 @@
 #include <string.h>
 
 #include "gstomxvideodec.h"
+#include "gstomxvideocopy.h"
+#include "gstomxlatencytracer.h"
 
 GST_DEBUG_CATEGORY_STATIC (gst_omx_video_dec_debug_category);
 #define GST_CAT_DEFAULT gst_omx_video_dec_debug_category
@@ -401,6 +403,8 @@ gst_omx_buffer_pool_alloc_buffer (GstBufferPool * bpool,
     buf = g_ptr_array_index (pool->buffers, pool->current_buffer_index);
     g_assert (pool->other_pool == buf->pool);
     gst_object_replace ((GstObject **) & buf->pool, NULL);
+    gst_omx_component_account_memory (pool->component,
+        GST_OMX_MEMORY_POOL_BUFFERS, 1, gst_buffer_get_size (buf));
 
     n = gst_buffer_n_memory (buf);
     for (i = 0; i < n; i++) {
@@ -432,6 +436,8 @@ gst_omx_buffer_pool_alloc_buffer (GstBufferPool * bpool,
     buf = gst_buffer_new ();
     gst_buffer_append_memory (buf, mem);
     g_ptr_array_add (pool->buffers, buf);
+    gst_omx_component_account_memory (pool->component,
+        GST_OMX_MEMORY_WRAPPERS, 1, sizeof (GstOMXMemory));
 
     if (pool->add_videometa) {
       gsize offset[4] = { 0, };
@@ -489,6 +495,12 @@ gst_omx_buffer_pool_free_buffer (GstBufferPool * bpool, GstBuffer * buffer)
   if (pool->other_pool) {
     gst_object_replace ((GstObject **) & buffer->pool,
         (GstObject *) pool->other_pool);
+    gst_omx_component_account_memory (pool->component,
+        GST_OMX_MEMORY_POOL_BUFFERS, -1,
+        -(gssize) gst_buffer_get_size (buffer));
+  } else {
+    gst_omx_component_account_memory (pool->component,
+        GST_OMX_MEMORY_WRAPPERS, -1, -(gssize) sizeof (GstOMXMemory));
   }
   GST_OBJECT_UNLOCK (pool);
 
@@ -650,6 +662,8 @@ typedef struct _BufferIdentification BufferIdentification;
 struct _BufferIdentification
 {
   guint64 timestamp;
+  /* When the frame arrived, only if the latency tracer is enabled */
+  GstClockTime arrival;
 };
 
 static void
@@ -660,6 +674,13 @@ buffer_identification_free (BufferIdentification * id)
 
 /* prototypes */
 static void gst_omx_video_dec_finalize (GObject * object);
+static gchar *gst_omx_video_dec_dump_flight_recorder (GstOMXVideoDec * self);
+static void gst_omx_video_dec_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec);
+static void gst_omx_video_dec_loop (GstOMXVideoDec * self);
+static void gst_omx_video_dec_start_loop (GstOMXVideoDec * self);
+static void gst_omx_video_dec_pause_loop (GstOMXVideoDec * self);
+static void gst_omx_video_dec_stop_loop (GstOMXVideoDec * self);
 
 static GstStateChangeReturn
 gst_omx_video_dec_change_state (GstElement * element,
@@ -689,9 +710,36 @@ static OMX_ERRORTYPE gst_omx_video_dec_deallocate_output_buffers (GstOMXVideoDec
 
 enum
 {
-  PROP_0
+  PROP_0,
+  PROP_LOCK_STATS,
+  PROP_TIMINGS,
+  PROP_MEMORY_STATS
+};
+
+/* Field names of the timings structure, in the order of
+ * GstOMXVideoDecTiming */
+static const gchar *timing_names[GST_OMX_VIDEO_DEC_TIMING_LAST] = {
+  "component-new",
+  "add-ports",
+  "loaded-to-idle",
+  "allocate-input",
+  "idle-to-executing",
+  "first-reconfigure",
+  "allocate-output",
+  "first-frame",
+  "stop",
+  "shutdown",
+  "free"
+};
+
+enum
+{
+  SIGNAL_DUMP_FLIGHT_RECORDER,
+  LAST_SIGNAL
 };
 
+static guint gst_omx_video_dec_signals[LAST_SIGNAL] = { 0 };
+
 /* class initialization */
 
 #define DEBUG_INIT \
@@ -710,6 +758,37 @@ gst_omx_video_dec_class_init (GstOMXVideoDecClass * klass)
   GstVideoDecoderClass *video_decoder_class = GST_VIDEO_DECODER_CLASS (klass);
 
   gobject_class->finalize = gst_omx_video_dec_finalize;
+  gobject_class->get_property = gst_omx_video_dec_get_property;
+
+  g_object_class_install_property (gobject_class, PROP_LOCK_STATS,
+      g_param_spec_boxed ("lock-stats", "Lock Statistics",
+          "Contention statistics of the component's locks, only "
+          "available if enabled with the " GST_OMX_LOCK_STATS_ENV
+          " environment variable", GST_TYPE_STRUCTURE,
+          G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  /* The same structure is posted as "omx-startup-timings" element
+   * message once the first frame is decoded */
+  g_object_class_install_property (gobject_class, PROP_TIMINGS,
+      g_param_spec_boxed ("timings", "Timings",
+          "Durations in nanoseconds of the startup and teardown phases "
+          "since the component was last opened", GST_TYPE_STRUCTURE,
+          G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_MEMORY_STATS,
+      g_param_spec_boxed ("memory-stats", "Memory Statistics",
+          "Memory held by the component and, with the \"process-\" "
+          "prefix, by all components of the process", GST_TYPE_STRUCTURE,
+          G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  /* Writes the flight recorder of the OMX component to a file and
+   * returns its name, or NULL if the flight recorder is disabled or
+   * the component is not opened */
+  gst_omx_video_dec_signals[SIGNAL_DUMP_FLIGHT_RECORDER] =
+      g_signal_new ("dump-flight-recorder", G_TYPE_FROM_CLASS (klass),
+      G_SIGNAL_RUN_LAST | G_SIGNAL_ACTION,
+      G_STRUCT_OFFSET (GstOMXVideoDecClass, dump_flight_recorder), NULL, NULL,
+      g_cclosure_marshal_generic, G_TYPE_STRING, 0);
 
   element_class->change_state =
       GST_DEBUG_FUNCPTR (gst_omx_video_dec_change_state);
@@ -731,39 +810,172 @@ gst_omx_video_dec_class_init (GstOMXVideoDecClass * klass)
   klass->cdata.default_src_template_caps = "video/x-raw, "
       "width = " GST_VIDEO_SIZE_RANGE ", "
       "height = " GST_VIDEO_SIZE_RANGE ", " "framerate = " GST_VIDEO_FPS_RANGE;
+
+  klass->dump_flight_recorder =
+      GST_DEBUG_FUNCPTR (gst_omx_video_dec_dump_flight_recorder);
+}
+
+static void
+gst_omx_video_dec_reset_timings (GstOMXVideoDec * self)
+{
+  gint i;
+
+  GST_OBJECT_LOCK (self);
+  self->open_start = gst_util_get_timestamp ();
+  for (i = 0; i < GST_OMX_VIDEO_DEC_TIMING_LAST; i++)
+    self->timings[i] = GST_CLOCK_TIME_NONE;
+  GST_OBJECT_UNLOCK (self);
+}
+
+/* Records the time since @start as duration of the phase, only
+ * the first time after the component was opened. Returns TRUE
+ * if it was recorded */
+static gboolean
+gst_omx_video_dec_record_timing (GstOMXVideoDec * self,
+    GstOMXVideoDecTiming timing, GstClockTime start)
+{
+  GstClockTime duration = gst_util_get_timestamp () - start;
+  gboolean recorded = FALSE;
+
+  GST_OBJECT_LOCK (self);
+  if (!GST_CLOCK_TIME_IS_VALID (self->timings[timing])) {
+    self->timings[timing] = duration;
+    recorded = TRUE;
+  }
+  GST_OBJECT_UNLOCK (self);
+
+  if (recorded)
+    GST_INFO_OBJECT (self, "%s took %" GST_TIME_FORMAT, timing_names[timing],
+        GST_TIME_ARGS (duration));
+
+  return recorded;
+}
+
+static GstStructure *
+gst_omx_video_dec_get_timings (GstOMXVideoDec * self, const gchar * name)
+{
+  GstStructure *s = gst_structure_new_empty (name);
+  gint i;
+
+  GST_OBJECT_LOCK (self);
+  for (i = 0; i < GST_OMX_VIDEO_DEC_TIMING_LAST; i++) {
+    if (GST_CLOCK_TIME_IS_VALID (self->timings[i]))
+      gst_structure_set (s, timing_names[i], G_TYPE_UINT64,
+          (guint64) self->timings[i], NULL);
+  }
+  GST_OBJECT_UNLOCK (self);
+
+  return s;
+}
+
+/* Replaces the codec_data that is passed to the component
+ * with the next frame */
+static void
+gst_omx_video_dec_set_codec_data (GstOMXVideoDec * self, GstBuffer * codec_data)
+{
+  gst_buffer_replace (&self->codec_data, codec_data);
+  if (self->dec)
+    gst_omx_component_set_memory (self->dec, GST_OMX_MEMORY_CODEC_DATA,
+        codec_data ? 1 : 0,
+        codec_data ? gst_buffer_get_size (codec_data) : 0);
+}
+
+/* Accounts the frames that wait for their output, including
+ * the input buffers they keep */
+static void
+gst_omx_video_dec_account_pending_frames (GstOMXVideoDec * self)
+{
+  GList *frames, *l;
+  gsize bytes = 0;
+  guint n = 0;
+
+  frames = gst_video_decoder_get_frames (GST_VIDEO_DECODER (self));
+  for (l = frames; l; l = l->next) {
+    GstVideoCodecFrame *frame = l->data;
+
+    bytes += sizeof (GstVideoCodecFrame);
+    if (frame->input_buffer)
+      bytes += gst_buffer_get_size (frame->input_buffer);
+    n++;
+  }
+  g_list_free_full (frames, (GDestroyNotify) gst_video_codec_frame_unref);
+
+  gst_omx_component_set_memory (self->dec, GST_OMX_MEMORY_PENDING_FRAMES, n,
+      bytes);
 }
 
 static void
 gst_omx_video_dec_init (GstOMXVideoDec * self)
 {
+  gint i;
+
   gst_video_decoder_set_packetized (GST_VIDEO_DECODER (self), TRUE);
 
+  self->open_start = GST_CLOCK_TIME_NONE;
+  for (i = 0; i < GST_OMX_VIDEO_DEC_TIMING_LAST; i++)
+    self->timings[i] = GST_CLOCK_TIME_NONE;
+
+  g_mutex_init (&self->comp_lock);
   g_mutex_init (&self->drain_lock);
   g_cond_init (&self->drain_cond);
 }
 
+/* Called with the component's lock */
+static void
+gst_omx_video_dec_state_notify (GstOMXComponent * comp, OMX_STATETYPE state,
+    gpointer user_data)
+{
+  GstOMXVideoDec *self = GST_OMX_VIDEO_DEC (user_data);
+
+  if (state == OMX_StateExecuting
+      && GST_CLOCK_TIME_IS_VALID (self->executing_start)) {
+    gst_omx_video_dec_record_timing (self,
+        GST_OMX_VIDEO_DEC_TIMING_IDLE_TO_EXECUTING, self->executing_start);
+    self->executing_start = GST_CLOCK_TIME_NONE;
+  }
+
+  g_atomic_int_set (&self->executing, state == OMX_StateExecuting);
+}
+
 static gboolean
 gst_omx_video_dec_open (GstVideoDecoder * decoder)
 {
   GstOMXVideoDec *self = GST_OMX_VIDEO_DEC (decoder);
   GstOMXVideoDecClass *klass = GST_OMX_VIDEO_DEC_GET_CLASS (self);
   gint in_port_index, out_port_index;
+  GstClockTime start;
+  GstOMXComponent *comp;
 
   GST_DEBUG_OBJECT (self, "Opening decoder");
 
-  self->dec =
+  gst_omx_video_dec_reset_timings (self);
+
+  start = gst_util_get_timestamp ();
+  comp =
       gst_omx_component_new (GST_OBJECT_CAST (self), klass->cdata.core_name,
       klass->cdata.component_name, klass->cdata.component_role,
       klass->cdata.hacks);
+  g_mutex_lock (&self->comp_lock);
+  self->dec = comp;
+  g_mutex_unlock (&self->comp_lock);
   self->started = FALSE;
 
   if (!self->dec)
     return FALSE;
 
+  gst_omx_video_dec_record_timing (self, GST_OMX_VIDEO_DEC_TIMING_COMPONENT_NEW,
+      start);
+  start = gst_util_get_timestamp ();
+
   if (gst_omx_component_get_state (self->dec,
           GST_CLOCK_TIME_NONE) != OMX_StateLoaded)
     return FALSE;
 
+  g_atomic_int_set (&self->executing, FALSE);
+  self->executing_start = GST_CLOCK_TIME_NONE;
+  gst_omx_component_set_state_notify_func (self->dec,
+      gst_omx_video_dec_state_notify, self);
+
   in_port_index = klass->cdata.in_port_index;
   out_port_index = klass->cdata.out_port_index;
 
@@ -795,6 +1007,9 @@ gst_omx_video_dec_open (GstVideoDecoder * decoder)
   if (!self->dec_in_port || !self->dec_out_port)
     return FALSE;
 
+  gst_omx_video_dec_record_timing (self, GST_OMX_VIDEO_DEC_TIMING_ADD_PORTS,
+      start);
+
   GST_DEBUG_OBJECT (self, "Opened decoder");
 
 #if defined (USE_OMX_TARGET_RPI) && defined (HAVE_GST_EGL)
@@ -857,11 +1072,14 @@ gst_omx_video_dec_shutdown (GstOMXVideoDec * self)
 #if defined (USE_OMX_TARGET_RPI) && defined (HAVE_GST_EGL)
   state = gst_omx_component_get_state (self->egl_render, 0);
   if (state > OMX_StateLoaded || state == OMX_StateInvalid) {
+    GstOMXComponent *comps[] = { self->egl_render, self->dec };
+
+    /* Both components change their state in parallel */
     if (state > OMX_StateIdle) {
       gst_omx_component_set_state (self->egl_render, OMX_StateIdle);
       gst_omx_component_set_state (self->dec, OMX_StateIdle);
-      gst_omx_component_get_state (self->egl_render, 5 * GST_SECOND);
-      gst_omx_component_get_state (self->dec, 1 * GST_SECOND);
+      gst_omx_component_wait_states (comps, G_N_ELEMENTS (comps),
+          5 * GST_SECOND);
     }
     gst_omx_component_set_state (self->egl_render, OMX_StateLoaded);
     gst_omx_component_set_state (self->dec, OMX_StateLoaded);
@@ -870,10 +1088,9 @@ gst_omx_video_dec_shutdown (GstOMXVideoDec * self)
     gst_omx_video_dec_deallocate_output_buffers (self);
     gst_omx_component_close_tunnel (self->dec, self->dec_out_port,
         self->egl_render, self->egl_in_port);
-    if (state > OMX_StateLoaded) {
-      gst_omx_component_get_state (self->egl_render, 5 * GST_SECOND);
-      gst_omx_component_get_state (self->dec, 1 * GST_SECOND);
-    }
+    if (state > OMX_StateLoaded)
+      gst_omx_component_wait_states (comps, G_N_ELEMENTS (comps),
+          5 * GST_SECOND);
   }
 
   /* Otherwise we didn't use EGL and just fall back to 
@@ -900,17 +1117,27 @@ static gboolean
 gst_omx_video_dec_close (GstVideoDecoder * decoder)
 {
   GstOMXVideoDec *self = GST_OMX_VIDEO_DEC (decoder);
+  GstClockTime start;
+  GstOMXComponent *comp;
 
   GST_DEBUG_OBJECT (self, "Closing decoder");
 
+  start = gst_util_get_timestamp ();
   if (!gst_omx_video_dec_shutdown (self))
     return FALSE;
+  gst_omx_video_dec_record_timing (self, GST_OMX_VIDEO_DEC_TIMING_SHUTDOWN,
+      start);
 
   self->dec_in_port = NULL;
   self->dec_out_port = NULL;
-  if (self->dec)
-    gst_omx_component_free (self->dec);
+  start = gst_util_get_timestamp ();
+  g_mutex_lock (&self->comp_lock);
+  comp = self->dec;
   self->dec = NULL;
+  g_mutex_unlock (&self->comp_lock);
+  if (comp)
+    gst_omx_component_free (comp);
+  gst_omx_video_dec_record_timing (self, GST_OMX_VIDEO_DEC_TIMING_FREE, start);
 
 #if defined (USE_OMX_TARGET_RPI) && defined (HAVE_GST_EGL)
   self->egl_in_port = NULL;
@@ -932,12 +1159,58 @@ gst_omx_video_dec_finalize (GObject * object)
 {
   GstOMXVideoDec *self = GST_OMX_VIDEO_DEC (object);
 
+  g_mutex_clear (&self->comp_lock);
   g_mutex_clear (&self->drain_lock);
   g_cond_clear (&self->drain_cond);
 
   G_OBJECT_CLASS (gst_omx_video_dec_parent_class)->finalize (object);
 }
 
+static void
+gst_omx_video_dec_get_property (GObject * object, guint prop_id, GValue * value,
+    GParamSpec * pspec)
+{
+  GstOMXVideoDec *self = GST_OMX_VIDEO_DEC (object);
+
+  switch (prop_id) {
+    case PROP_LOCK_STATS:
+      g_mutex_lock (&self->comp_lock);
+      if (self->dec)
+        g_value_take_boxed (value,
+            gst_omx_component_get_lock_stats (self->dec));
+      g_mutex_unlock (&self->comp_lock);
+      break;
+    case PROP_TIMINGS:
+      g_value_take_boxed (value,
+          gst_omx_video_dec_get_timings (self, "omx-timings"));
+      break;
+    case PROP_MEMORY_STATS:
+      g_mutex_lock (&self->comp_lock);
+      if (self->dec)
+        g_value_take_boxed (value,
+            gst_omx_component_get_memory_stats (self->dec));
+      g_mutex_unlock (&self->comp_lock);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+static gchar *
+gst_omx_video_dec_dump_flight_recorder (GstOMXVideoDec * self)
+{
+  gchar *filename = NULL;
+
+  g_mutex_lock (&self->comp_lock);
+  if (self->dec)
+    filename =
+        gst_omx_component_dump_flight_recorder (self->dec, "action signal");
+  g_mutex_unlock (&self->comp_lock);
+
+  return filename;
+}
+
 static GstStateChangeReturn
 gst_omx_video_dec_change_state (GstElement * element, GstStateChange transition)
 {
@@ -1137,103 +1410,24 @@ gst_omx_video_dec_fill_buffer (GstOMXVideoDec * self,
 
   /* Different strides */
 
-  switch (vinfo->finfo->format) {
-    case GST_VIDEO_FORMAT_I420:{
-      gint i, j, height, width;
-      guint8 *src, *dest;
-      gint src_stride, dest_stride;
-
-      gst_video_frame_map (&frame, vinfo, outbuf, GST_MAP_WRITE);
-      for (i = 0; i < 3; i++) {
-        if (i == 0) {
-          src_stride = port_def->format.video.nStride;
-          dest_stride = GST_VIDEO_FRAME_COMP_STRIDE (&frame, i);
-
-          /* XXX: Try this if no stride was set */
-          if (src_stride == 0)
-            src_stride = dest_stride;
-        } else {
-          src_stride = port_def->format.video.nStride / 2;
-          dest_stride = GST_VIDEO_FRAME_COMP_STRIDE (&frame, i);
-
-          /* XXX: Try this if no stride was set */
-          if (src_stride == 0)
-            src_stride = dest_stride;
-        }
-
-        src = inbuf->omx_buf->pBuffer + inbuf->omx_buf->nOffset;
-        if (i > 0)
-          src +=
-              port_def->format.video.nSliceHeight *
-              port_def->format.video.nStride;
-        if (i == 2)
-          src +=
-              (port_def->format.video.nSliceHeight / 2) *
-              (port_def->format.video.nStride / 2);
-
-        dest = GST_VIDEO_FRAME_COMP_DATA (&frame, i);
-        height = GST_VIDEO_FRAME_COMP_HEIGHT (&frame, i);
-        width = GST_VIDEO_FRAME_COMP_WIDTH (&frame, i);
-
-        for (j = 0; j < height; j++) {
-          memcpy (dest, src, width);
-          src += src_stride;
-          dest += dest_stride;
-        }
-      }
-      gst_video_frame_unmap (&frame);
-      ret = TRUE;
-      break;
-    }
-    case GST_VIDEO_FORMAT_NV12:{
-      gint i, j, height, width;
-      guint8 *src, *dest;
-      gint src_stride, dest_stride;
-
-      gst_video_frame_map (&frame, vinfo, outbuf, GST_MAP_WRITE);
-      for (i = 0; i < 2; i++) {
-        if (i == 0) {
-          src_stride = port_def->format.video.nStride;
-          dest_stride = GST_VIDEO_FRAME_COMP_STRIDE (&frame, i);
-
-          /* XXX: Try this if no stride was set */
-          if (src_stride == 0)
-            src_stride = dest_stride;
-        } else {
-          src_stride = port_def->format.video.nStride;
-          dest_stride = GST_VIDEO_FRAME_COMP_STRIDE (&frame, i);
-
-          /* XXX: Try this if no stride was set */
-          if (src_stride == 0)
-            src_stride = dest_stride;
-        }
-
-        src = inbuf->omx_buf->pBuffer + inbuf->omx_buf->nOffset;
-        if (i == 1)
-          src +=
-              port_def->format.video.nSliceHeight *
-              port_def->format.video.nStride;
-
-        dest = GST_VIDEO_FRAME_COMP_DATA (&frame, i);
-        height = GST_VIDEO_FRAME_COMP_HEIGHT (&frame, i);
-        width = GST_VIDEO_FRAME_COMP_WIDTH (&frame, i) * (i == 0 ? 1 : 2);
+  if (!gst_omx_video_copy_supports_format (vinfo->finfo->format)) {
+    GST_ERROR_OBJECT (self, "Unsupported format");
+    goto done;
+  }
 
-        for (j = 0; j < height; j++) {
-          memcpy (dest, src, width);
-          src += src_stride;
-          dest += dest_stride;
-        }
-      }
-      gst_video_frame_unmap (&frame);
-      ret = TRUE;
-      break;
-    }
-    default:
-      GST_ERROR_OBJECT (self, "Unsupported format");
-      goto done;
-      break;
+  if (!gst_video_frame_map (&frame, vinfo, outbuf, GST_MAP_WRITE)) {
+    GST_ERROR_OBJECT (self, "Invalid output buffer size");
+    goto done;
   }
 
+  ret = gst_omx_video_copy_to_frame (&frame,
+      inbuf->omx_buf->pBuffer + inbuf->omx_buf->nOffset,
+      inbuf->omx_buf->nAllocLen - inbuf->omx_buf->nOffset,
+      port_def->format.video.nStride, port_def->format.video.nSliceHeight);
+  gst_video_frame_unmap (&frame);
+
+  if (!ret)
+    GST_ERROR_OBJECT (self, "Invalid input buffer size");
 
 done:
   if (ret) {
@@ -1263,6 +1457,7 @@ gst_omx_video_dec_allocate_output_buffers (GstOMXVideoDec * self)
   guint min = 0, max = 0;
   GstVideoCodecState *state =
       gst_video_decoder_get_output_state (GST_VIDEO_DECODER (self));
+  GstClockTime start = gst_util_get_timestamp ();
 
 #if defined (USE_OMX_TARGET_RPI) && defined (HAVE_GST_EGL)
   port = self->eglimage ? self->egl_out_port : self->dec_out_port;
@@ -1580,6 +1775,10 @@ done:
     GST_DEBUG_OBJECT (self,
         "Not using our internal pool and copying buffers for downstream");
 
+  if (err == OMX_ErrorNone)
+    gst_omx_video_dec_record_timing (self,
+        GST_OMX_VIDEO_DEC_TIMING_ALLOCATE_OUTPUT, start);
+
   if (caps)
     gst_caps_unref (caps);
   if (pool)
@@ -1875,7 +2074,20 @@ gst_omx_video_dec_loop (GstOMXVideoDec * self)
   port = self->dec_out_port;
 #endif
 
-  acq_return = gst_omx_port_acquire_buffer (port, &buf);
+  if (self->worker_task)
+    acq_return = gst_omx_port_try_acquire_buffer (port, &buf);
+  else
+    acq_return = gst_omx_port_acquire_buffer (port, &buf);
+  if (acq_return == GST_OMX_ACQUIRE_BUFFER_NO_AVAILABLE) {
+    /* Called again once the port is notified */
+    gst_omx_worker_task_wait_notify (self->worker_task);
+    return;
+  }
+
+  /* Everything from here on can block downstream */
+  if (self->worker_task)
+    gst_omx_worker_task_enter_blocking (self->worker_task);
+
   if (acq_return == GST_OMX_ACQUIRE_BUFFER_ERROR) {
     goto component_error;
   } else if (acq_return == GST_OMX_ACQUIRE_BUFFER_FLUSHING) {
@@ -1889,6 +2101,7 @@ gst_omx_video_dec_loop (GstOMXVideoDec * self)
     GstVideoCodecState *state;
     OMX_PARAM_PORTDEFINITIONTYPE port_def;
     GstVideoFormat format;
+    GstClockTime start = gst_util_get_timestamp ();
 
     GST_DEBUG_OBJECT (self, "Port settings have changed, updating caps");
 
@@ -1917,6 +2130,9 @@ gst_omx_video_dec_loop (GstOMXVideoDec * self)
       err = gst_omx_video_dec_reconfigure_output_port (self);
       if (err != OMX_ErrorNone)
         goto reconfigure_error;
+
+      gst_omx_video_dec_record_timing (self,
+          GST_OMX_VIDEO_DEC_TIMING_FIRST_RECONFIGURE, start);
     } else {
       /* Just update caps */
       GST_VIDEO_DECODER_STREAM_LOCK (self);
@@ -1995,6 +2211,14 @@ gst_omx_video_dec_loop (GstOMXVideoDec * self)
   GST_VIDEO_DECODER_STREAM_LOCK (self);
   frame = _find_nearest_frame (self, buf);
 
+  if (frame && GST_OMX_LATENCY_TRACING ()) {
+    BufferIdentification *id = gst_video_codec_frame_get_user_data (frame);
+
+    if (id && GST_CLOCK_TIME_IS_VALID (id->arrival))
+      gst_omx_latency_tracer_frame_sample (self->dec,
+          gst_util_get_timestamp () - id->arrival);
+  }
+
   if (frame
       && (deadline = gst_video_decoder_get_max_decode_time
           (GST_VIDEO_DECODER (self), frame)) < 0) {
@@ -2103,6 +2327,16 @@ gst_omx_video_dec_loop (GstOMXVideoDec * self)
 
   GST_DEBUG_OBJECT (self, "Read frame from component");
 
+  if (flow_ret == GST_FLOW_OK && !GST_CLOCK_TIME_IS_VALID
+      (self->timings[GST_OMX_VIDEO_DEC_TIMING_FIRST_FRAME])
+      && (buf == NULL || buf->omx_buf->nFilledLen > 0)
+      && gst_omx_video_dec_record_timing (self,
+          GST_OMX_VIDEO_DEC_TIMING_FIRST_FRAME, self->open_start)) {
+    gst_element_post_message (GST_ELEMENT_CAST (self),
+        gst_message_new_element (GST_OBJECT_CAST (self),
+            gst_omx_video_dec_get_timings (self, "omx-startup-timings")));
+  }
+
   GST_DEBUG_OBJECT (self, "Finished frame: %s", gst_flow_get_name (flow_ret));
 
   if (buf) {
@@ -2127,7 +2361,7 @@ component_error:
             gst_omx_component_get_last_error_string (self->dec),
             gst_omx_component_get_last_error (self->dec)));
     gst_pad_push_event (GST_VIDEO_DECODER_SRC_PAD (self), gst_event_new_eos ());
-    gst_pad_pause_task (GST_VIDEO_DECODER_SRC_PAD (self));
+    gst_omx_video_dec_pause_loop (self);
     self->downstream_flow_ret = GST_FLOW_ERROR;
     self->started = FALSE;
     return;
@@ -2136,7 +2370,7 @@ component_error:
 flushing:
   {
     GST_DEBUG_OBJECT (self, "Flushing -- stopping task");
-    gst_pad_pause_task (GST_VIDEO_DECODER_SRC_PAD (self));
+    gst_omx_video_dec_pause_loop (self);
     self->downstream_flow_ret = GST_FLOW_FLUSHING;
     self->started = FALSE;
     return;
@@ -2150,7 +2384,7 @@ eos:
       self->draining = FALSE;
       g_cond_broadcast (&self->drain_cond);
       flow_ret = GST_FLOW_OK;
-      gst_pad_pause_task (GST_VIDEO_DECODER_SRC_PAD (self));
+      gst_omx_video_dec_pause_loop (self);
     } else {
       GST_DEBUG_OBJECT (self, "Component signalled EOS");
       flow_ret = GST_FLOW_EOS;
@@ -2176,7 +2410,7 @@ flow_error:
 
       gst_pad_push_event (GST_VIDEO_DECODER_SRC_PAD (self),
           gst_event_new_eos ());
-      gst_pad_pause_task (GST_VIDEO_DECODER_SRC_PAD (self));
+      gst_omx_video_dec_pause_loop (self);
     } else if (flow_ret == GST_FLOW_NOT_LINKED || flow_ret < GST_FLOW_EOS) {
       GST_ELEMENT_ERROR (self, STREAM, FAILED,
           ("Internal data stream error."), ("stream stopped, reason %s",
@@ -2184,7 +2418,7 @@ flow_error:
 
       gst_pad_push_event (GST_VIDEO_DECODER_SRC_PAD (self),
           gst_event_new_eos ());
-      gst_pad_pause_task (GST_VIDEO_DECODER_SRC_PAD (self));
+      gst_omx_video_dec_pause_loop (self);
     }
     self->started = FALSE;
     GST_VIDEO_DECODER_STREAM_UNLOCK (self);
@@ -2196,7 +2430,7 @@ reconfigure_error:
     GST_ELEMENT_ERROR (self, LIBRARY, SETTINGS, (NULL),
         ("Unable to reconfigure output port"));
     gst_pad_push_event (GST_VIDEO_DECODER_SRC_PAD (self), gst_event_new_eos ());
-    gst_pad_pause_task (GST_VIDEO_DECODER_SRC_PAD (self));
+    gst_omx_video_dec_pause_loop (self);
     self->downstream_flow_ret = GST_FLOW_ERROR;
     self->started = FALSE;
     return;
@@ -2207,7 +2441,7 @@ invalid_buffer:
     GST_ELEMENT_ERROR (self, LIBRARY, SETTINGS, (NULL),
         ("Invalid sized input buffer"));
     gst_pad_push_event (GST_VIDEO_DECODER_SRC_PAD (self), gst_event_new_eos ());
-    gst_pad_pause_task (GST_VIDEO_DECODER_SRC_PAD (self));
+    gst_omx_video_dec_pause_loop (self);
     self->downstream_flow_ret = GST_FLOW_NOT_NEGOTIATED;
     self->started = FALSE;
     GST_VIDEO_DECODER_STREAM_UNLOCK (self);
@@ -2218,7 +2452,7 @@ caps_failed:
   {
     GST_ELEMENT_ERROR (self, LIBRARY, SETTINGS, (NULL), ("Failed to set caps"));
     gst_pad_push_event (GST_VIDEO_DECODER_SRC_PAD (self), gst_event_new_eos ());
-    gst_pad_pause_task (GST_VIDEO_DECODER_SRC_PAD (self));
+    gst_omx_video_dec_pause_loop (self);
     GST_VIDEO_DECODER_STREAM_UNLOCK (self);
     self->downstream_flow_ret = GST_FLOW_NOT_NEGOTIATED;
     self->started = FALSE;
@@ -2230,7 +2464,7 @@ release_error:
         ("Failed to relase output buffer to component: %s (0x%08x)",
             gst_omx_error_to_string (err), err));
     gst_pad_push_event (GST_VIDEO_DECODER_SRC_PAD (self), gst_event_new_eos ());
-    gst_pad_pause_task (GST_VIDEO_DECODER_SRC_PAD (self));
+    gst_omx_video_dec_pause_loop (self);
     self->downstream_flow_ret = GST_FLOW_ERROR;
     self->started = FALSE;
     GST_VIDEO_DECODER_STREAM_UNLOCK (self);
@@ -2238,6 +2472,34 @@ release_error:
   }
 }
 
+static void
+gst_omx_video_dec_start_loop (GstOMXVideoDec * self)
+{
+  if (self->worker_task)
+    gst_omx_worker_task_start (self->worker_task);
+  else
+    gst_pad_start_task (GST_VIDEO_DECODER_SRC_PAD (self),
+        (GstTaskFunction) gst_omx_video_dec_loop, self, NULL);
+}
+
+static void
+gst_omx_video_dec_pause_loop (GstOMXVideoDec * self)
+{
+  if (self->worker_task)
+    gst_omx_worker_task_pause (self->worker_task);
+  else
+    gst_pad_pause_task (GST_VIDEO_DECODER_SRC_PAD (self));
+}
+
+static void
+gst_omx_video_dec_stop_loop (GstOMXVideoDec * self)
+{
+  if (self->worker_task)
+    gst_omx_worker_task_stop (self->worker_task);
+  else
+    gst_pad_stop_task (GST_VIDEO_DECODER_SRC_PAD (self));
+}
+
 static gboolean
 gst_omx_video_dec_start (GstVideoDecoder * decoder)
 {
@@ -2249,6 +2511,22 @@ gst_omx_video_dec_start (GstVideoDecoder * decoder)
   self->eos = FALSE;
   self->downstream_flow_ret = GST_FLOW_OK;
 
+  /* Only started elements use the worker pool */
+  if (gst_omx_worker_pool_enabled ()) {
+    self->worker_task =
+        gst_omx_worker_task_new (GST_ELEMENT_CAST (self),
+        GST_VIDEO_DECODER_SRC_PAD (self),
+        (GstTaskFunction) gst_omx_video_dec_loop, self);
+    if (self->worker_task) {
+      gst_omx_worker_task_connect_port (self->worker_task,
+          self->dec_out_port);
+#if defined (USE_OMX_TARGET_RPI) && defined (HAVE_GST_EGL)
+      gst_omx_worker_task_connect_port (self->worker_task,
+          self->egl_out_port);
+#endif
+    }
+  }
+
   return TRUE;
 }
 
@@ -2256,6 +2534,7 @@ static gboolean
 gst_omx_video_dec_stop (GstVideoDecoder * decoder)
 {
   GstOMXVideoDec *self;
+  GstClockTime start = gst_util_get_timestamp ();
 
   self = GST_OMX_VIDEO_DEC (decoder);
 
@@ -2269,7 +2548,12 @@ gst_omx_video_dec_stop (GstVideoDecoder * decoder)
   gst_omx_port_set_flushing (self->egl_out_port, 5 * GST_SECOND, TRUE);
 #endif
 
-  gst_pad_stop_task (GST_VIDEO_DECODER_SRC_PAD (decoder));
+  gst_omx_video_dec_stop_loop (self);
+
+  if (self->worker_task) {
+    gst_omx_worker_task_free (self->worker_task);
+    self->worker_task = NULL;
+  }
 
   if (gst_omx_component_get_state (self->dec, 0) > OMX_StateIdle)
     gst_omx_component_set_state (self->dec, OMX_StateIdle);
@@ -2287,17 +2571,26 @@ gst_omx_video_dec_stop (GstVideoDecoder * decoder)
   g_cond_broadcast (&self->drain_cond);
   g_mutex_unlock (&self->drain_lock);
 
-  gst_omx_component_get_state (self->dec, 5 * GST_SECOND);
 #if defined (USE_OMX_TARGET_RPI) && defined (HAVE_GST_EGL)
-  gst_omx_component_get_state (self->egl_render, 1 * GST_SECOND);
+  {
+    GstOMXComponent *comps[] = { self->dec, self->egl_render };
+
+    gst_omx_component_wait_states (comps, G_N_ELEMENTS (comps),
+        5 * GST_SECOND);
+  }
+#else
+  gst_omx_component_get_state (self->dec, 5 * GST_SECOND);
 #endif
 
-  gst_buffer_replace (&self->codec_data, NULL);
+  gst_omx_video_dec_set_codec_data (self, NULL);
+  gst_omx_component_set_memory (self->dec, GST_OMX_MEMORY_PENDING_FRAMES, 0, 0);
 
   if (self->input_state)
     gst_video_codec_state_unref (self->input_state);
   self->input_state = NULL;
 
+  gst_omx_video_dec_record_timing (self, GST_OMX_VIDEO_DEC_TIMING_STOP, start);
+
   GST_DEBUG_OBJECT (self, "Stopped decoder");
 
   return TRUE;
@@ -2318,67 +2611,47 @@ video_negotiation_map_free (VideoNegotiationMap * m)
 static GList *
 gst_omx_video_dec_get_supported_colorformats (GstOMXVideoDec * self)
 {
-  GstOMXComponent *comp;
-  GstOMXPort *port;
+  GstOMXPort *port = self->dec_out_port;
   GstVideoCodecState *state = self->input_state;
-  OMX_VIDEO_PARAM_PORTFORMATTYPE param;
-  OMX_ERRORTYPE err;
   GList *negotiation_map = NULL;
-  gint old_index;
+  OMX_U32 framerate;
+  gint *formats;
+  gsize i, n_formats;
   VideoNegotiationMap *m;
 
-  port = self->dec_out_port;
-  comp = self->dec;
-
-  GST_OMX_INIT_STRUCT (&param);
-  param.nPortIndex = port->index;
-  param.nIndex = 0;
   if (!state || state->info.fps_n == 0)
-    param.xFramerate = 0;
+    framerate = 0;
   else
-    param.xFramerate = (state->info.fps_n << 16) / (state->info.fps_d);
-
-  old_index = -1;
-  do {
-    err =
-        gst_omx_component_get_parameter (comp,
-        OMX_IndexParamVideoPortFormat, &param);
-
-    /* FIXME: Workaround for Bellagio that simply always
-     * returns the same value regardless of nIndex and
-     * never returns OMX_ErrorNoMore
-     */
-    if (old_index == param.nIndex)
-      break;
-
-    if (err == OMX_ErrorNone || err == OMX_ErrorNoMore) {
-      switch (param.eColorFormat) {
-        case OMX_COLOR_FormatYUV420Planar:
-        case OMX_COLOR_FormatYUV420PackedPlanar:
-          m = g_slice_new (VideoNegotiationMap);
-          m->format = GST_VIDEO_FORMAT_I420;
-          m->type = param.eColorFormat;
-          negotiation_map = g_list_append (negotiation_map, m);
-          GST_DEBUG_OBJECT (self, "Component supports I420 (%d) at index %u",
-              param.eColorFormat, (guint) param.nIndex);
-          break;
-        case OMX_COLOR_FormatYUV420SemiPlanar:
-          m = g_slice_new (VideoNegotiationMap);
-          m->format = GST_VIDEO_FORMAT_NV12;
-          m->type = param.eColorFormat;
-          negotiation_map = g_list_append (negotiation_map, m);
-          GST_DEBUG_OBJECT (self, "Component supports NV12 (%d) at index %u",
-              param.eColorFormat, (guint) param.nIndex);
-          break;
-        default:
-          GST_DEBUG_OBJECT (self,
-              "Component supports unsupported color format %d at index %u",
-              param.eColorFormat, (guint) param.nIndex);
-          break;
-      }
+    framerate = (state->info.fps_n << 16) / (state->info.fps_d);
+
+  formats = gst_omx_port_get_video_color_formats (port, framerate, &n_formats);
+  for (i = 0; i < n_formats; i++) {
+    switch (formats[i]) {
+      case OMX_COLOR_FormatYUV420Planar:
+      case OMX_COLOR_FormatYUV420PackedPlanar:
+        m = g_slice_new (VideoNegotiationMap);
+        m->format = GST_VIDEO_FORMAT_I420;
+        m->type = formats[i];
+        negotiation_map = g_list_append (negotiation_map, m);
+        GST_DEBUG_OBJECT (self, "Component supports I420 (%d) at index %u",
+            formats[i], (guint) i);
+        break;
+      case OMX_COLOR_FormatYUV420SemiPlanar:
+        m = g_slice_new (VideoNegotiationMap);
+        m->format = GST_VIDEO_FORMAT_NV12;
+        m->type = formats[i];
+        negotiation_map = g_list_append (negotiation_map, m);
+        GST_DEBUG_OBJECT (self, "Component supports NV12 (%d) at index %u",
+            formats[i], (guint) i);
+        break;
+      default:
+        GST_DEBUG_OBJECT (self,
+            "Component supports unsupported color format %d at index %u",
+            formats[i], (guint) i);
+        break;
     }
-    old_index = param.nIndex++;
-  } while (err == OMX_ErrorNone);
+  }
+  g_free (formats);
 
   return negotiation_map;
 }
@@ -2489,6 +2762,7 @@ gst_omx_video_dec_set_format (GstVideoDecoder * decoder,
   gboolean is_format_change = FALSE;
   gboolean needs_disable = FALSE;
   OMX_PARAM_PORTDEFINITIONTYPE port_def;
+  GstClockTime start, alloc_start;
 
   self = GST_OMX_VIDEO_DEC (decoder);
   klass = GST_OMX_VIDEO_DEC_GET_CLASS (decoder);
@@ -2544,7 +2818,7 @@ gst_omx_video_dec_set_format (GstVideoDecoder * decoder,
      * unlock GST_VIDEO_DECODER_STREAM_LOCK to prevent deadlocks
      * caused by using this lock from inside the loop function */
     GST_VIDEO_DECODER_STREAM_UNLOCK (self);
-    gst_pad_stop_task (GST_VIDEO_DECODER_SRC_PAD (decoder));
+    gst_omx_video_dec_stop_loop (self);
     GST_VIDEO_DECODER_STREAM_LOCK (self);
 
     if (klass->cdata.hacks & GST_OMX_HACK_NO_COMPONENT_RECONFIGURE) {
@@ -2594,11 +2868,13 @@ gst_omx_video_dec_set_format (GstVideoDecoder * decoder,
         if (egl_state > OMX_StateLoaded || egl_state == OMX_StateInvalid) {
 
           if (egl_state > OMX_StateIdle) {
+            GstOMXComponent *comps[] = { self->egl_render, self->dec };
+
             gst_omx_component_set_state (self->egl_render, OMX_StateIdle);
             gst_omx_component_set_state (self->dec, OMX_StateIdle);
-            egl_state = gst_omx_component_get_state (self->egl_render,
-                5 * GST_SECOND);
-            gst_omx_component_get_state (self->dec, 1 * GST_SECOND);
+            egl_state = gst_omx_component_wait_states (comps,
+                G_N_ELEMENTS (comps), 5 * GST_SECOND) ?
+                OMX_StateIdle : OMX_StateInvalid;
           }
           gst_omx_component_set_state (self->egl_render, OMX_StateLoaded);
           gst_omx_component_set_state (self->dec, OMX_StateLoaded);
@@ -2626,6 +2902,14 @@ gst_omx_video_dec_set_format (GstVideoDecoder * decoder,
     GST_DEBUG_OBJECT (self, "Decoder drained and disabled");
   }
 
+  if (!gst_omx_component_admit_video_load (self->dec, info->width,
+          info->height, info->fps_n, info->fps_d)) {
+    GST_ELEMENT_ERROR (self, RESOURCE, BUSY, (NULL),
+        ("No decoder capacity left for %dx%d at %d/%d fps", info->width,
+            info->height, info->fps_n, info->fps_d));
+    return FALSE;
+  }
+
   port_def.format.video.nFrameWidth = info->width;
   port_def.format.video.nFrameHeight = info->height;
   if (info->fps_n == 0)
@@ -2651,7 +2935,7 @@ gst_omx_video_dec_set_format (GstVideoDecoder * decoder,
           NULL) != OMX_ErrorNone)
     return FALSE;
 
-  gst_buffer_replace (&self->codec_data, state->codec_data);
+  gst_omx_video_dec_set_codec_data (self, state->codec_data);
   self->input_state = gst_video_codec_state_ref (state);
 
   GST_DEBUG_OBJECT (self, "Enabling component");
@@ -2678,24 +2962,30 @@ gst_omx_video_dec_set_format (GstVideoDecoder * decoder,
             1 * GST_SECOND) != OMX_ErrorNone)
       return FALSE;
 
+    start = gst_util_get_timestamp ();
     if (gst_omx_component_set_state (self->dec, OMX_StateIdle) != OMX_ErrorNone)
       return FALSE;
 
     /* Need to allocate buffers to reach Idle state */
+    alloc_start = gst_util_get_timestamp ();
     if (gst_omx_port_allocate_buffers (self->dec_in_port) != OMX_ErrorNone)
       return FALSE;
+    gst_omx_video_dec_record_timing (self,
+        GST_OMX_VIDEO_DEC_TIMING_ALLOCATE_INPUT, alloc_start);
 
     if (gst_omx_component_get_state (self->dec,
             GST_CLOCK_TIME_NONE) != OMX_StateIdle)
       return FALSE;
+    gst_omx_video_dec_record_timing (self,
+        GST_OMX_VIDEO_DEC_TIMING_LOADED_TO_IDLE, start);
 
+    /* Don't wait for Executing here, handle_frame() only waits
+     * if the state notify func didn't see it yet when the first
+     * frame arrives */
+    self->executing_start = gst_util_get_timestamp ();
     if (gst_omx_component_set_state (self->dec,
             OMX_StateExecuting) != OMX_ErrorNone)
       return FALSE;
-
-    if (gst_omx_component_get_state (self->dec,
-            GST_CLOCK_TIME_NONE) != OMX_StateExecuting)
-      return FALSE;
   }
 
   /* Unset flushing to allow ports to accept data again */
@@ -2713,8 +3003,7 @@ gst_omx_video_dec_set_format (GstVideoDecoder * decoder,
   GST_DEBUG_OBJECT (self, "Starting task again");
 
   self->downstream_flow_ret = GST_FLOW_OK;
-  gst_pad_start_task (GST_VIDEO_DECODER_SRC_PAD (self),
-      (GstTaskFunction) gst_omx_video_dec_loop, decoder, NULL);
+  gst_omx_video_dec_start_loop (self);
 
   return TRUE;
 }
@@ -2759,14 +3048,28 @@ gst_omx_video_dec_reset (GstVideoDecoder * decoder, gboolean hard)
   self->last_upstream_ts = 0;
   self->eos = FALSE;
   self->downstream_flow_ret = GST_FLOW_OK;
-  gst_pad_start_task (GST_VIDEO_DECODER_SRC_PAD (self),
-      (GstTaskFunction) gst_omx_video_dec_loop, decoder, NULL);
+  gst_omx_video_dec_start_loop (self);
 
   GST_DEBUG_OBJECT (self, "Reset decoder");
 
   return TRUE;
 }
 
+/* Releases acquired input buffers without passing anything to the
+ * component, e.g. if a batch was only partially filled on errors */
+static void
+gst_omx_video_dec_return_buffers (GstOMXPort * port, GstOMXBuffer ** bufs,
+    guint n_bufs)
+{
+  guint i;
+
+  for (i = 0; i < n_bufs; i++) {
+    bufs[i]->omx_buf->nFilledLen = 0;
+    bufs[i]->omx_buf->nFlags = 0;
+  }
+  gst_omx_port_release_buffers (port, bufs, n_bufs);
+}
+
 static GstFlowReturn
 gst_omx_video_dec_handle_frame (GstVideoDecoder * decoder,
     GstVideoCodecFrame * frame)
@@ -2775,10 +3078,13 @@ gst_omx_video_dec_handle_frame (GstVideoDecoder * decoder,
   GstOMXVideoDec *self;
   GstOMXVideoDecClass *klass;
   GstOMXPort *port;
-  GstOMXBuffer *buf;
+  GstOMXBuffer *bufs[GST_OMX_PORT_MAX_BATCH_SIZE];
+  GstOMXBuffer *buf = NULL;
   GstBuffer *codec_data = NULL;
-  guint offset = 0, size;
+  gboolean codec_data_sent;
+  guint offset = 0, size, chunk_size, n_bufs, i;
   GstClockTime timestamp, duration;
+  GstClockTime arrival = GST_CLOCK_TIME_NONE;
   OMX_ERRORTYPE err;
 
   self = GST_OMX_VIDEO_DEC (decoder);
@@ -2786,6 +3092,9 @@ gst_omx_video_dec_handle_frame (GstVideoDecoder * decoder,
 
   GST_DEBUG_OBJECT (self, "Handling frame");
 
+  if (GST_OMX_LATENCY_TRACING ())
+    arrival = gst_util_get_timestamp ();
+
   if (self->eos) {
     GST_WARNING_OBJECT (self, "Got frame after EOS");
     gst_video_codec_frame_unref (frame);
@@ -2797,6 +3106,8 @@ gst_omx_video_dec_handle_frame (GstVideoDecoder * decoder,
     return GST_FLOW_OK;
   }
 
+  gst_omx_video_dec_account_pending_frames (self);
+
   timestamp = frame->pts;
   duration = frame->duration;
 
@@ -2817,6 +3128,11 @@ gst_omx_video_dec_handle_frame (GstVideoDecoder * decoder,
     }
   }
 
+  if (!g_atomic_int_get (&self->executing)
+      && gst_omx_component_get_state (self->dec,
+          5 * GST_SECOND) != OMX_StateExecuting)
+    goto state_error;
+
   port = self->dec_in_port;
 
   size = gst_buffer_get_size (frame->input_buffer);
@@ -2825,7 +3141,13 @@ gst_omx_video_dec_handle_frame (GstVideoDecoder * decoder,
      * _loop() can't call _finish_frame() and we might block forever
      * because no input buffers are released */
     GST_VIDEO_DECODER_STREAM_UNLOCK (self);
-    acq_ret = gst_omx_port_acquire_buffer (port, &buf);
+
+    /* Take as many buffers as are ready and needed for the codec
+     * data and the remaining frame, at least one */
+    chunk_size = MAX (port->port_def.nBufferSize, 1);
+    n_bufs = MIN ((size - offset + chunk_size - 1) / chunk_size +
+        (self->codec_data ? 1 : 0), GST_OMX_PORT_MAX_BATCH_SIZE);
+    acq_ret = gst_omx_port_acquire_buffers (port, bufs, n_bufs, &n_bufs);
 
     if (acq_ret == GST_OMX_ACQUIRE_BUFFER_ERROR) {
       GST_VIDEO_DECODER_STREAM_LOCK (self);
@@ -2889,104 +3211,114 @@ gst_omx_video_dec_handle_frame (GstVideoDecoder * decoder,
     }
     GST_VIDEO_DECODER_STREAM_LOCK (self);
 
-    g_assert (acq_ret == GST_OMX_ACQUIRE_BUFFER_OK && buf != NULL);
+    g_assert (acq_ret == GST_OMX_ACQUIRE_BUFFER_OK && n_bufs > 0);
 
-    if (buf->omx_buf->nAllocLen - buf->omx_buf->nOffset <= 0) {
-      gst_omx_port_release_buffer (port, buf);
-      goto full_buffer;
-    }
+    codec_data_sent = FALSE;
+    for (i = 0; i < n_bufs; i++) {
+      buf = bufs[i];
 
-    if (self->downstream_flow_ret != GST_FLOW_OK) {
-      gst_omx_port_release_buffer (port, buf);
-      goto flow_error;
-    }
+      if (buf->omx_buf->nAllocLen - buf->omx_buf->nOffset <= 0) {
+        gst_omx_video_dec_return_buffers (port, bufs, n_bufs);
+        goto full_buffer;
+      }
+
+      if (self->downstream_flow_ret != GST_FLOW_OK) {
+        gst_omx_video_dec_return_buffers (port, bufs, n_bufs);
+        goto flow_error;
+      }
 
-    if (self->codec_data) {
-      GST_DEBUG_OBJECT (self, "Passing codec data to the component");
+      if (self->codec_data && !codec_data_sent) {
+        GST_DEBUG_OBJECT (self, "Passing codec data to the component");
 
-      codec_data = self->codec_data;
+        codec_data = self->codec_data;
 
-      if (buf->omx_buf->nAllocLen - buf->omx_buf->nOffset <
-          gst_buffer_get_size (codec_data)) {
-        gst_omx_port_release_buffer (port, buf);
-        goto too_large_codec_data;
+        if (buf->omx_buf->nAllocLen - buf->omx_buf->nOffset <
+            gst_buffer_get_size (codec_data)) {
+          gst_omx_video_dec_return_buffers (port, bufs, n_bufs);
+          goto too_large_codec_data;
+        }
+
+        buf->omx_buf->nFlags |= OMX_BUFFERFLAG_CODECCONFIG;
+        buf->omx_buf->nFlags |= OMX_BUFFERFLAG_ENDOFFRAME;
+        buf->omx_buf->nFilledLen = gst_buffer_get_size (codec_data);;
+        gst_buffer_extract (codec_data, 0,
+            buf->omx_buf->pBuffer + buf->omx_buf->nOffset,
+            buf->omx_buf->nFilledLen);
+
+        if (GST_CLOCK_TIME_IS_VALID (timestamp))
+          buf->omx_buf->nTimeStamp =
+              gst_util_uint64_scale (timestamp, OMX_TICKS_PER_SECOND,
+              GST_SECOND);
+        else
+          buf->omx_buf->nTimeStamp = 0;
+        buf->omx_buf->nTickCount = 0;
+
+        /* Only dropped once the batch was released, otherwise the
+         * next frame needs it again */
+        codec_data_sent = TRUE;
+        /* Use the next buffer for the actual frame */
+        continue;
       }
 
-      buf->omx_buf->nFlags |= OMX_BUFFERFLAG_CODECCONFIG;
-      buf->omx_buf->nFlags |= OMX_BUFFERFLAG_ENDOFFRAME;
-      buf->omx_buf->nFilledLen = gst_buffer_get_size (codec_data);;
-      gst_buffer_extract (codec_data, 0,
+      /* Now handle the frame */
+      GST_DEBUG_OBJECT (self, "Passing frame offset %d to the component",
+          offset);
+
+      /* Copy the buffer content in chunks of size as requested
+       * by the port */
+      buf->omx_buf->nFilledLen =
+          MIN (MIN (size - offset, chunk_size),
+          buf->omx_buf->nAllocLen - buf->omx_buf->nOffset);
+      gst_buffer_extract (frame->input_buffer, offset,
           buf->omx_buf->pBuffer + buf->omx_buf->nOffset,
           buf->omx_buf->nFilledLen);
 
-      if (GST_CLOCK_TIME_IS_VALID (timestamp))
+      if (timestamp != GST_CLOCK_TIME_NONE) {
         buf->omx_buf->nTimeStamp =
-            gst_util_uint64_scale (timestamp, OMX_TICKS_PER_SECOND, GST_SECOND);
-      else
+            gst_util_uint64_scale (timestamp, OMX_TICKS_PER_SECOND,
+            GST_SECOND);
+        self->last_upstream_ts = timestamp;
+      } else {
         buf->omx_buf->nTimeStamp = 0;
-      buf->omx_buf->nTickCount = 0;
-
-      self->started = TRUE;
-      err = gst_omx_port_release_buffer (port, buf);
-      gst_buffer_replace (&self->codec_data, NULL);
-      if (err != OMX_ErrorNone)
-        goto release_error;
-      /* Acquire new buffer for the actual frame */
-      continue;
-    }
-
-    /* Now handle the frame */
-    GST_DEBUG_OBJECT (self, "Passing frame offset %d to the component", offset);
-
-    /* Copy the buffer content in chunks of size as requested
-     * by the port */
-    buf->omx_buf->nFilledLen =
-        MIN (size - offset, buf->omx_buf->nAllocLen - buf->omx_buf->nOffset);
-    gst_buffer_extract (frame->input_buffer, offset,
-        buf->omx_buf->pBuffer + buf->omx_buf->nOffset,
-        buf->omx_buf->nFilledLen);
-
-    if (timestamp != GST_CLOCK_TIME_NONE) {
-      buf->omx_buf->nTimeStamp =
-          gst_util_uint64_scale (timestamp, OMX_TICKS_PER_SECOND, GST_SECOND);
-      self->last_upstream_ts = timestamp;
-    } else {
-      buf->omx_buf->nTimeStamp = 0;
-    }
+      }
 
-    if (duration != GST_CLOCK_TIME_NONE && offset == 0) {
-      buf->omx_buf->nTickCount =
-          gst_util_uint64_scale (buf->omx_buf->nFilledLen, duration, size);
-      self->last_upstream_ts += duration;
-    } else {
-      buf->omx_buf->nTickCount = 0;
-    }
+      if (duration != GST_CLOCK_TIME_NONE && offset == 0) {
+        buf->omx_buf->nTickCount =
+            gst_util_uint64_scale (buf->omx_buf->nFilledLen, duration, size);
+        self->last_upstream_ts += duration;
+      } else {
+        buf->omx_buf->nTickCount = 0;
+      }
 
-    if (offset == 0) {
-      BufferIdentification *id = g_slice_new0 (BufferIdentification);
+      if (offset == 0) {
+        BufferIdentification *id = g_slice_new0 (BufferIdentification);
 
-      if (GST_VIDEO_CODEC_FRAME_IS_SYNC_POINT (frame))
-        buf->omx_buf->nFlags |= OMX_BUFFERFLAG_SYNCFRAME;
+        if (GST_VIDEO_CODEC_FRAME_IS_SYNC_POINT (frame))
+          buf->omx_buf->nFlags |= OMX_BUFFERFLAG_SYNCFRAME;
 
-      id->timestamp = buf->omx_buf->nTimeStamp;
-      gst_video_codec_frame_set_user_data (frame, id,
-          (GDestroyNotify) buffer_identification_free);
-    }
+        id->timestamp = buf->omx_buf->nTimeStamp;
+        id->arrival = arrival;
+        gst_video_codec_frame_set_user_data (frame, id,
+            (GDestroyNotify) buffer_identification_free);
+      }
 
-    /* TODO: Set flags
-     *   - OMX_BUFFERFLAG_DECODEONLY for buffers that are outside
-     *     the segment
-     */
+      /* TODO: Set flags
+       *   - OMX_BUFFERFLAG_DECODEONLY for buffers that are outside
+       *     the segment
+       */
 
-    offset += buf->omx_buf->nFilledLen;
+      offset += buf->omx_buf->nFilledLen;
 
-    if (offset == size)
-      buf->omx_buf->nFlags |= OMX_BUFFERFLAG_ENDOFFRAME;
+      if (offset == size)
+        buf->omx_buf->nFlags |= OMX_BUFFERFLAG_ENDOFFRAME;
+    }
 
     self->started = TRUE;
-    err = gst_omx_port_release_buffer (port, buf);
+    err = gst_omx_port_release_buffers (port, bufs, n_bufs);
     if (err != OMX_ErrorNone)
       goto release_error;
+    if (codec_data_sent)
+      gst_omx_video_dec_set_codec_data (self, NULL);
   }
 
   gst_video_codec_frame_unref (frame);
@@ -3031,6 +3363,16 @@ component_error:
     return GST_FLOW_ERROR;
   }
 
+state_error:
+  {
+    gst_video_codec_frame_unref (frame);
+    GST_ELEMENT_ERROR (self, LIBRARY, FAILED, (NULL),
+        ("OpenMAX component did not reach Executing state: %s (0x%08x)",
+            gst_omx_component_get_last_error_string (self->dec),
+            gst_omx_component_get_last_error (self->dec)));
+    return GST_FLOW_ERROR;
+  }
+
 flushing:
   {
     gst_video_codec_frame_unref (frame);
@@ -30,6 +30,7 @@
 #include <gst/video/gstvideodecoder.h>
 
 #include "gstomx.h"
+#include "gstomxworker.h"
 
 G_BEGIN_DECLS
 
@@ -49,6 +50,26 @@ G_BEGIN_DECLS
 typedef struct _GstOMXVideoDec GstOMXVideoDec;
 typedef struct _GstOMXVideoDecClass GstOMXVideoDecClass;
 
+/* Startup and teardown phases whose durations are recorded,
+ * see the "timings" property */
+typedef enum {
+  GST_OMX_VIDEO_DEC_TIMING_COMPONENT_NEW,
+  GST_OMX_VIDEO_DEC_TIMING_ADD_PORTS,
+  /* Includes the input port buffer allocation */
+  GST_OMX_VIDEO_DEC_TIMING_LOADED_TO_IDLE,
+  GST_OMX_VIDEO_DEC_TIMING_ALLOCATE_INPUT,
+  GST_OMX_VIDEO_DEC_TIMING_IDLE_TO_EXECUTING,
+  /* Includes the output port buffer allocation */
+  GST_OMX_VIDEO_DEC_TIMING_FIRST_RECONFIGURE,
+  GST_OMX_VIDEO_DEC_TIMING_ALLOCATE_OUTPUT,
+  /* From the start of opening the component */
+  GST_OMX_VIDEO_DEC_TIMING_FIRST_FRAME,
+  GST_OMX_VIDEO_DEC_TIMING_STOP,
+  GST_OMX_VIDEO_DEC_TIMING_SHUTDOWN,
+  GST_OMX_VIDEO_DEC_TIMING_FREE,
+  GST_OMX_VIDEO_DEC_TIMING_LAST
+} GstOMXVideoDecTiming;
+
 struct _GstOMXVideoDec
 {
   GstVideoDecoder parent;
@@ -65,9 +86,19 @@ struct _GstOMXVideoDec
   /* TRUE if the component is configured and saw
    * the first buffer */
   gboolean started;
+  /* TRUE if the component is in Executing state,
+   * set by its state notify func */
+  volatile gint executing;
+  /* When Executing was requested, protected by the
+   * component's lock */
+  GstClockTime executing_start;
 
   GstClockTime last_upstream_ts;
 
+  /* Protects dec against close() while the property getters
+   * and action signals use it from other threads */
+  GMutex comp_lock;
+
   /* Draining state */
   GMutex drain_lock;
   GCond drain_cond;
@@ -78,6 +109,16 @@ struct _GstOMXVideoDec
   gboolean eos;
 
   GstFlowReturn downstream_flow_ret;
+
+  /* Phase durations since the component was last opened,
+   * GST_CLOCK_TIME_NONE if not reached yet. Protected by the
+   * object lock */
+  GstClockTime open_start;
+  GstClockTime timings[GST_OMX_VIDEO_DEC_TIMING_LAST];
+
+  /* Runs the srcpad loop between start() and stop() if the shared
+   * worker pool is used, NULL if the srcpad has its own task */
+  GstOMXWorkerTask *worker_task;
 #ifdef USE_OMX_TARGET_RPI
   GstOMXComponent *egl_render;
   GstOMXPort *egl_in_port, *egl_out_port;
@@ -94,6 +135,9 @@ struct _GstOMXVideoDecClass
   gboolean (*is_format_change) (GstOMXVideoDec * self, GstOMXPort * port, GstVideoCodecState * state);
   gboolean (*set_format)       (GstOMXVideoDec * self, GstOMXPort * port, GstVideoCodecState * state);
   GstFlowReturn (*prepare_frame)   (GstOMXVideoDec * self, GstVideoCodecFrame *frame);
+
+  /* actions */
+  gchar *  (*dump_flight_recorder) (GstOMXVideoDec * self);
 };
 
 GType gst_omx_video_dec_get_type (void);
@@ -27,6 +27,8 @@
 #include <string.h>
 
 #include "gstomxvideoenc.h"
+#include "gstomxvideocopy.h"
+#include "gstomxlatencytracer.h"
 
 GST_DEBUG_CATEGORY_STATIC (gst_omx_video_enc_debug_category);
 #define GST_CAT_DEFAULT gst_omx_video_enc_debug_category
@@ -59,6 +61,8 @@ typedef struct _BufferIdentification BufferIdentification;
 struct _BufferIdentification
 {
   guint64 timestamp;
+  /* When the frame arrived, only if the latency tracer is enabled */
+  GstClockTime arrival;
 };
 
 static void
@@ -69,6 +73,11 @@ buffer_identification_free (BufferIdentification * id)
 
 /* prototypes */
 static void gst_omx_video_enc_finalize (GObject * object);
+static gchar *gst_omx_video_enc_dump_flight_recorder (GstOMXVideoEnc * self);
+static void gst_omx_video_enc_loop (GstOMXVideoEnc * self);
+static void gst_omx_video_enc_start_loop (GstOMXVideoEnc * self);
+static void gst_omx_video_enc_pause_loop (GstOMXVideoEnc * self);
+static void gst_omx_video_enc_stop_loop (GstOMXVideoEnc * self);
 static void gst_omx_video_enc_set_property (GObject * object, guint prop_id,
     const GValue * value, GParamSpec * pspec);
 static void gst_omx_video_enc_get_property (GObject * object, guint prop_id,
@@ -108,9 +117,19 @@ enum
   PROP_TARGET_BITRATE,
   PROP_QUANT_I_FRAMES,
   PROP_QUANT_P_FRAMES,
-  PROP_QUANT_B_FRAMES
+  PROP_QUANT_B_FRAMES,
+  PROP_LOCK_STATS,
+  PROP_MEMORY_STATS
 };
 
+enum
+{
+  SIGNAL_DUMP_FLIGHT_RECORDER,
+  LAST_SIGNAL
+};
+
+static guint gst_omx_video_enc_signals[LAST_SIGNAL] = { 0 };
+
 /* FIXME: Better defaults */
 #define GST_OMX_VIDEO_ENC_CONTROL_RATE_DEFAULT (0xffffffff)
 #define GST_OMX_VIDEO_ENC_TARGET_BITRATE_DEFAULT (0xffffffff)
@@ -175,6 +194,28 @@ gst_omx_video_enc_class_init (GstOMXVideoEncClass * klass)
           G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
           GST_PARAM_MUTABLE_READY));
 
+  g_object_class_install_property (gobject_class, PROP_LOCK_STATS,
+      g_param_spec_boxed ("lock-stats", "Lock Statistics",
+          "Contention statistics of the component's locks, only "
+          "available if enabled with the " GST_OMX_LOCK_STATS_ENV
+          " environment variable", GST_TYPE_STRUCTURE,
+          G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_MEMORY_STATS,
+      g_param_spec_boxed ("memory-stats", "Memory Statistics",
+          "Memory held by the component and, with the \"process-\" "
+          "prefix, by all components of the process", GST_TYPE_STRUCTURE,
+          G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  /* Writes the flight recorder of the OMX component to a file and
+   * returns its name, or NULL if the flight recorder is disabled or
+   * the component is not opened */
+  gst_omx_video_enc_signals[SIGNAL_DUMP_FLIGHT_RECORDER] =
+      g_signal_new ("dump-flight-recorder", G_TYPE_FROM_CLASS (klass),
+      G_SIGNAL_RUN_LAST | G_SIGNAL_ACTION,
+      G_STRUCT_OFFSET (GstOMXVideoEncClass, dump_flight_recorder), NULL, NULL,
+      g_cclosure_marshal_generic, G_TYPE_STRING, 0);
+
   element_class->change_state =
       GST_DEBUG_FUNCPTR (gst_omx_video_enc_change_state);
 
@@ -199,6 +240,9 @@ gst_omx_video_enc_class_init (GstOMXVideoEncClass * klass)
 
   klass->handle_output_frame =
       GST_DEBUG_FUNCPTR (gst_omx_video_enc_handle_output_frame);
+
+  klass->dump_flight_recorder =
+      GST_DEBUG_FUNCPTR (gst_omx_video_enc_dump_flight_recorder);
 }
 
 static void
@@ -210,21 +254,36 @@ gst_omx_video_enc_init (GstOMXVideoEnc * self)
   self->quant_p_frames = GST_OMX_VIDEO_ENC_QUANT_P_FRAMES_DEFAULT;
   self->quant_b_frames = GST_OMX_VIDEO_ENC_QUANT_B_FRAMES_DEFAULT;
 
+  g_mutex_init (&self->comp_lock);
   g_mutex_init (&self->drain_lock);
   g_cond_init (&self->drain_cond);
 }
 
+/* Called with the component's lock */
+static void
+gst_omx_video_enc_state_notify (GstOMXComponent * comp, OMX_STATETYPE state,
+    gpointer user_data)
+{
+  GstOMXVideoEnc *self = GST_OMX_VIDEO_ENC (user_data);
+
+  g_atomic_int_set (&self->executing, state == OMX_StateExecuting);
+}
+
 static gboolean
 gst_omx_video_enc_open (GstVideoEncoder * encoder)
 {
   GstOMXVideoEnc *self = GST_OMX_VIDEO_ENC (encoder);
   GstOMXVideoEncClass *klass = GST_OMX_VIDEO_ENC_GET_CLASS (self);
   gint in_port_index, out_port_index;
+  GstOMXComponent *comp;
 
-  self->enc =
+  comp =
       gst_omx_component_new (GST_OBJECT_CAST (self), klass->cdata.core_name,
       klass->cdata.component_name, klass->cdata.component_role,
       klass->cdata.hacks);
+  g_mutex_lock (&self->comp_lock);
+  self->enc = comp;
+  g_mutex_unlock (&self->comp_lock);
   self->started = FALSE;
 
   if (!self->enc)
@@ -234,6 +293,10 @@ gst_omx_video_enc_open (GstVideoEncoder * encoder)
           GST_CLOCK_TIME_NONE) != OMX_StateLoaded)
     return FALSE;
 
+  g_atomic_int_set (&self->executing, FALSE);
+  gst_omx_component_set_state_notify_func (self->enc,
+      gst_omx_video_enc_state_notify, self);
+
   in_port_index = klass->cdata.in_port_index;
   out_port_index = klass->cdata.out_port_index;
 
@@ -389,17 +452,21 @@ static gboolean
 gst_omx_video_enc_close (GstVideoEncoder * encoder)
 {
   GstOMXVideoEnc *self = GST_OMX_VIDEO_ENC (encoder);
+  GstOMXComponent *comp;
 
   GST_DEBUG_OBJECT (self, "Closing encoder");
 
   if (!gst_omx_video_enc_shutdown (self))
     return FALSE;
 
+  g_mutex_lock (&self->comp_lock);
   self->enc_in_port = NULL;
   self->enc_out_port = NULL;
-  if (self->enc)
-    gst_omx_component_free (self->enc);
+  comp = self->enc;
   self->enc = NULL;
+  g_mutex_unlock (&self->comp_lock);
+  if (comp)
+    gst_omx_component_free (comp);
 
   return TRUE;
 }
@@ -409,6 +476,7 @@ gst_omx_video_enc_finalize (GObject * object)
 {
   GstOMXVideoEnc *self = GST_OMX_VIDEO_ENC (object);
 
+  g_mutex_clear (&self->comp_lock);
   g_mutex_clear (&self->drain_lock);
   g_cond_clear (&self->drain_cond);
 
@@ -427,7 +495,8 @@ gst_omx_video_enc_set_property (GObject * object, guint prop_id,
       break;
     case PROP_TARGET_BITRATE:
       self->target_bitrate = g_value_get_uint (value);
-      if (self->enc) {
+      g_mutex_lock (&self->comp_lock);
+      if (self->enc && self->enc_out_port) {
         OMX_VIDEO_CONFIG_BITRATETYPE config;
         OMX_ERRORTYPE err;
 
@@ -442,6 +511,7 @@ gst_omx_video_enc_set_property (GObject * object, guint prop_id,
               "Failed to set bitrate parameter: %s (0x%08x)",
               gst_omx_error_to_string (err), err);
       }
+      g_mutex_unlock (&self->comp_lock);
       break;
     case PROP_QUANT_I_FRAMES:
       self->quant_i_frames = g_value_get_uint (value);
@@ -480,12 +550,40 @@ gst_omx_video_enc_get_property (GObject * object, guint prop_id, GValue * value,
     case PROP_QUANT_B_FRAMES:
       g_value_set_uint (value, self->quant_b_frames);
       break;
+    case PROP_LOCK_STATS:
+      g_mutex_lock (&self->comp_lock);
+      if (self->enc)
+        g_value_take_boxed (value,
+            gst_omx_component_get_lock_stats (self->enc));
+      g_mutex_unlock (&self->comp_lock);
+      break;
+    case PROP_MEMORY_STATS:
+      g_mutex_lock (&self->comp_lock);
+      if (self->enc)
+        g_value_take_boxed (value,
+            gst_omx_component_get_memory_stats (self->enc));
+      g_mutex_unlock (&self->comp_lock);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
   }
 }
 
+static gchar *
+gst_omx_video_enc_dump_flight_recorder (GstOMXVideoEnc * self)
+{
+  gchar *filename = NULL;
+
+  g_mutex_lock (&self->comp_lock);
+  if (self->enc)
+    filename =
+        gst_omx_component_dump_flight_recorder (self->enc, "action signal");
+  g_mutex_unlock (&self->comp_lock);
+
+  return filename;
+}
+
 static GstStateChangeReturn
 gst_omx_video_enc_change_state (GstElement * element, GstStateChange transition)
 {
@@ -745,7 +843,20 @@ gst_omx_video_enc_loop (GstOMXVideoEnc * self)
 
   klass = GST_OMX_VIDEO_ENC_GET_CLASS (self);
 
-  acq_return = gst_omx_port_acquire_buffer (port, &buf);
+  if (self->worker_task)
+    acq_return = gst_omx_port_try_acquire_buffer (port, &buf);
+  else
+    acq_return = gst_omx_port_acquire_buffer (port, &buf);
+  if (acq_return == GST_OMX_ACQUIRE_BUFFER_NO_AVAILABLE) {
+    /* Called again once the port is notified */
+    gst_omx_worker_task_wait_notify (self->worker_task);
+    return;
+  }
+
+  /* Everything from here on can block downstream */
+  if (self->worker_task)
+    gst_omx_worker_task_enter_blocking (self->worker_task);
+
   if (acq_return == GST_OMX_ACQUIRE_BUFFER_ERROR) {
     goto component_error;
   } else if (acq_return == GST_OMX_ACQUIRE_BUFFER_FLUSHING) {
@@ -853,6 +964,14 @@ gst_omx_video_enc_loop (GstOMXVideoEnc * self)
   GST_VIDEO_ENCODER_STREAM_LOCK (self);
   frame = _find_nearest_frame (self, buf);
 
+  if (frame && GST_OMX_LATENCY_TRACING ()) {
+    BufferIdentification *id = gst_video_codec_frame_get_user_data (frame);
+
+    if (id && GST_CLOCK_TIME_IS_VALID (id->arrival))
+      gst_omx_latency_tracer_frame_sample (self->enc,
+          gst_util_get_timestamp () - id->arrival);
+  }
+
   g_assert (klass->handle_output_frame);
   flow_ret = klass->handle_output_frame (self, self->enc_out_port, buf, frame);
 
@@ -880,7 +999,7 @@ component_error:
             gst_omx_component_get_last_error_string (self->enc),
             gst_omx_component_get_last_error (self->enc)));
     gst_pad_push_event (GST_VIDEO_ENCODER_SRC_PAD (self), gst_event_new_eos ());
-    gst_pad_pause_task (GST_VIDEO_ENCODER_SRC_PAD (self));
+    gst_omx_video_enc_pause_loop (self);
     self->downstream_flow_ret = GST_FLOW_ERROR;
     self->started = FALSE;
     return;
@@ -888,7 +1007,7 @@ component_error:
 flushing:
   {
     GST_DEBUG_OBJECT (self, "Flushing -- stopping task");
-    gst_pad_pause_task (GST_VIDEO_ENCODER_SRC_PAD (self));
+    gst_omx_video_enc_pause_loop (self);
     self->downstream_flow_ret = GST_FLOW_FLUSHING;
     self->started = FALSE;
     return;
@@ -902,7 +1021,7 @@ eos:
       self->draining = FALSE;
       g_cond_broadcast (&self->drain_cond);
       flow_ret = GST_FLOW_OK;
-      gst_pad_pause_task (GST_VIDEO_ENCODER_SRC_PAD (self));
+      gst_omx_video_enc_pause_loop (self);
     } else {
       GST_DEBUG_OBJECT (self, "Component signalled EOS");
       flow_ret = GST_FLOW_EOS;
@@ -927,14 +1046,14 @@ flow_error:
 
       gst_pad_push_event (GST_VIDEO_ENCODER_SRC_PAD (self),
           gst_event_new_eos ());
-      gst_pad_pause_task (GST_VIDEO_ENCODER_SRC_PAD (self));
+      gst_omx_video_enc_pause_loop (self);
     } else if (flow_ret == GST_FLOW_NOT_LINKED || flow_ret < GST_FLOW_EOS) {
       GST_ELEMENT_ERROR (self, STREAM, FAILED, ("Internal data stream error."),
           ("stream stopped, reason %s", gst_flow_get_name (flow_ret)));
 
       gst_pad_push_event (GST_VIDEO_ENCODER_SRC_PAD (self),
           gst_event_new_eos ());
-      gst_pad_pause_task (GST_VIDEO_ENCODER_SRC_PAD (self));
+      gst_omx_video_enc_pause_loop (self);
     }
     self->started = FALSE;
     GST_VIDEO_ENCODER_STREAM_UNLOCK (self);
@@ -945,7 +1064,7 @@ reconfigure_error:
     GST_ELEMENT_ERROR (self, LIBRARY, SETTINGS, (NULL),
         ("Unable to reconfigure output port"));
     gst_pad_push_event (GST_VIDEO_ENCODER_SRC_PAD (self), gst_event_new_eos ());
-    gst_pad_pause_task (GST_VIDEO_ENCODER_SRC_PAD (self));
+    gst_omx_video_enc_pause_loop (self);
     self->downstream_flow_ret = GST_FLOW_NOT_NEGOTIATED;
     self->started = FALSE;
     return;
@@ -954,7 +1073,7 @@ caps_failed:
   {
     GST_ELEMENT_ERROR (self, LIBRARY, SETTINGS, (NULL), ("Failed to set caps"));
     gst_pad_push_event (GST_VIDEO_ENCODER_SRC_PAD (self), gst_event_new_eos ());
-    gst_pad_pause_task (GST_VIDEO_ENCODER_SRC_PAD (self));
+    gst_omx_video_enc_pause_loop (self);
     self->downstream_flow_ret = GST_FLOW_NOT_NEGOTIATED;
     self->started = FALSE;
     return;
@@ -965,7 +1084,7 @@ release_error:
         ("Failed to relase output buffer to component: %s (0x%08x)",
             gst_omx_error_to_string (err), err));
     gst_pad_push_event (GST_VIDEO_ENCODER_SRC_PAD (self), gst_event_new_eos ());
-    gst_pad_pause_task (GST_VIDEO_ENCODER_SRC_PAD (self));
+    gst_omx_video_enc_pause_loop (self);
     self->downstream_flow_ret = GST_FLOW_ERROR;
     self->started = FALSE;
     GST_VIDEO_ENCODER_STREAM_UNLOCK (self);
@@ -973,6 +1092,34 @@ release_error:
   }
 }
 
+static void
+gst_omx_video_enc_start_loop (GstOMXVideoEnc * self)
+{
+  if (self->worker_task)
+    gst_omx_worker_task_start (self->worker_task);
+  else
+    gst_pad_start_task (GST_VIDEO_ENCODER_SRC_PAD (self),
+        (GstTaskFunction) gst_omx_video_enc_loop, self, NULL);
+}
+
+static void
+gst_omx_video_enc_pause_loop (GstOMXVideoEnc * self)
+{
+  if (self->worker_task)
+    gst_omx_worker_task_pause (self->worker_task);
+  else
+    gst_pad_pause_task (GST_VIDEO_ENCODER_SRC_PAD (self));
+}
+
+static void
+gst_omx_video_enc_stop_loop (GstOMXVideoEnc * self)
+{
+  if (self->worker_task)
+    gst_omx_worker_task_stop (self->worker_task);
+  else
+    gst_pad_stop_task (GST_VIDEO_ENCODER_SRC_PAD (self));
+}
+
 static gboolean
 gst_omx_video_enc_start (GstVideoEncoder * encoder)
 {
@@ -984,6 +1131,16 @@ gst_omx_video_enc_start (GstVideoEncoder * encoder)
   self->eos = FALSE;
   self->downstream_flow_ret = GST_FLOW_OK;
 
+  /* Only started elements use the worker pool */
+  if (gst_omx_worker_pool_enabled ()) {
+    self->worker_task =
+        gst_omx_worker_task_new (GST_ELEMENT_CAST (self),
+        GST_VIDEO_ENCODER_SRC_PAD (self),
+        (GstTaskFunction) gst_omx_video_enc_loop, self);
+    if (self->worker_task)
+      gst_omx_worker_task_connect_port (self->worker_task, self->enc_out_port);
+  }
+
   return TRUE;
 }
 
@@ -999,7 +1156,12 @@ gst_omx_video_enc_stop (GstVideoEncoder * encoder)
   gst_omx_port_set_flushing (self->enc_in_port, 5 * GST_SECOND, TRUE);
   gst_omx_port_set_flushing (self->enc_out_port, 5 * GST_SECOND, TRUE);
 
-  gst_pad_stop_task (GST_VIDEO_ENCODER_SRC_PAD (encoder));
+  gst_omx_video_enc_stop_loop (self);
+
+  if (self->worker_task) {
+    gst_omx_worker_task_free (self->worker_task);
+    self->worker_task = NULL;
+  }
 
   if (gst_omx_component_get_state (self->enc, 0) > OMX_StateIdle)
     gst_omx_component_set_state (self->enc, OMX_StateIdle);
@@ -1019,6 +1181,8 @@ gst_omx_video_enc_stop (GstVideoEncoder * encoder)
 
   gst_omx_component_get_state (self->enc, 5 * GST_SECOND);
 
+  gst_omx_component_set_memory (self->enc, GST_OMX_MEMORY_PENDING_FRAMES, 0, 0);
+
   return TRUE;
 }
 
@@ -1039,62 +1203,45 @@ gst_omx_video_enc_get_supported_colorformats (GstOMXVideoEnc * self)
 {
   GstOMXPort *port = self->enc_in_port;
   GstVideoCodecState *state = self->input_state;
-  OMX_VIDEO_PARAM_PORTFORMATTYPE param;
-  OMX_ERRORTYPE err;
   GList *negotiation_map = NULL;
-  gint old_index;
+  OMX_U32 framerate;
+  gint *formats;
+  gsize i, n_formats;
+  VideoNegotiationMap *m;
 
-  GST_OMX_INIT_STRUCT (&param);
-  param.nPortIndex = port->index;
-  param.nIndex = 0;
   if (!state || state->info.fps_n == 0)
-    param.xFramerate = 0;
+    framerate = 0;
   else
-    param.xFramerate = (state->info.fps_n << 16) / (state->info.fps_d);
-
-  old_index = -1;
-  do {
-    VideoNegotiationMap *m;
-
-    err =
-        gst_omx_component_get_parameter (self->enc,
-        OMX_IndexParamVideoPortFormat, &param);
-
-    /* FIXME: Workaround for Bellagio that simply always
-     * returns the same value regardless of nIndex and
-     * never returns OMX_ErrorNoMore
-     */
-    if (old_index == param.nIndex)
-      break;
-
-    if (err == OMX_ErrorNone || err == OMX_ErrorNoMore) {
-      switch (param.eColorFormat) {
-        case OMX_COLOR_FormatYUV420Planar:
-        case OMX_COLOR_FormatYUV420PackedPlanar:
-          m = g_slice_new (VideoNegotiationMap);
-          m->format = GST_VIDEO_FORMAT_I420;
-          m->type = param.eColorFormat;
-          negotiation_map = g_list_append (negotiation_map, m);
-          GST_DEBUG_OBJECT (self, "Component supports I420 (%d) at index %u",
-              param.eColorFormat, (guint) param.nIndex);
-          break;
-        case OMX_COLOR_FormatYUV420SemiPlanar:
-          m = g_slice_new (VideoNegotiationMap);
-          m->format = GST_VIDEO_FORMAT_NV12;
-          m->type = param.eColorFormat;
-          negotiation_map = g_list_append (negotiation_map, m);
-          GST_DEBUG_OBJECT (self, "Component supports NV12 (%d) at index %u",
-              param.eColorFormat, (guint) param.nIndex);
-          break;
-        default:
-          GST_DEBUG_OBJECT (self,
-              "Component supports unsupported color format %d at index %u",
-              param.eColorFormat, (guint) param.nIndex);
-          break;
-      }
+    framerate = (state->info.fps_n << 16) / (state->info.fps_d);
+
+  formats = gst_omx_port_get_video_color_formats (port, framerate, &n_formats);
+  for (i = 0; i < n_formats; i++) {
+    switch (formats[i]) {
+      case OMX_COLOR_FormatYUV420Planar:
+      case OMX_COLOR_FormatYUV420PackedPlanar:
+        m = g_slice_new (VideoNegotiationMap);
+        m->format = GST_VIDEO_FORMAT_I420;
+        m->type = formats[i];
+        negotiation_map = g_list_append (negotiation_map, m);
+        GST_DEBUG_OBJECT (self, "Component supports I420 (%d) at index %u",
+            formats[i], (guint) i);
+        break;
+      case OMX_COLOR_FormatYUV420SemiPlanar:
+        m = g_slice_new (VideoNegotiationMap);
+        m->format = GST_VIDEO_FORMAT_NV12;
+        m->type = formats[i];
+        negotiation_map = g_list_append (negotiation_map, m);
+        GST_DEBUG_OBJECT (self, "Component supports NV12 (%d) at index %u",
+            formats[i], (guint) i);
+        break;
+      default:
+        GST_DEBUG_OBJECT (self,
+            "Component supports unsupported color format %d at index %u",
+            formats[i], (guint) i);
+        break;
     }
-    old_index = param.nIndex++;
-  } while (err == OMX_ErrorNone);
+  }
+  g_free (formats);
 
   return negotiation_map;
 }
@@ -1134,7 +1281,7 @@ gst_omx_video_enc_set_format (GstVideoEncoder * encoder,
      * unlock GST_VIDEO_ENCODER_STREAM_LOCK to prevent deadlocks
      * caused by using this lock from inside the loop function */
     GST_VIDEO_ENCODER_STREAM_UNLOCK (self);
-    gst_pad_stop_task (GST_VIDEO_ENCODER_SRC_PAD (encoder));
+    gst_omx_video_enc_stop_loop (self);
     GST_VIDEO_ENCODER_STREAM_LOCK (self);
 
     if (gst_omx_port_set_enabled (self->enc_in_port, FALSE) != OMX_ErrorNone)
@@ -1161,6 +1308,14 @@ gst_omx_video_enc_set_format (GstVideoEncoder * encoder,
     GST_DEBUG_OBJECT (self, "Encoder drained and disabled");
   }
 
+  if (!gst_omx_component_admit_video_load (self->enc, info->width,
+          info->height, info->fps_n, info->fps_d)) {
+    GST_ELEMENT_ERROR (self, RESOURCE, BUSY, (NULL),
+        ("No encoder capacity left for %dx%d at %d/%d fps", info->width,
+            info->height, info->fps_n, info->fps_d));
+    return FALSE;
+  }
+
   negotiation_map = gst_omx_video_enc_get_supported_colorformats (self);
   if (!negotiation_map) {
     /* Fallback */
@@ -1293,13 +1448,12 @@ gst_omx_video_enc_set_format (GstVideoEncoder * encoder,
             GST_CLOCK_TIME_NONE) != OMX_StateIdle)
       return FALSE;
 
+    /* Don't wait for Executing here, handle_frame() only waits
+     * if the state notify func didn't see it yet when the first
+     * frame arrives */
     if (gst_omx_component_set_state (self->enc,
             OMX_StateExecuting) != OMX_ErrorNone)
       return FALSE;
-
-    if (gst_omx_component_get_state (self->enc,
-            GST_CLOCK_TIME_NONE) != OMX_StateExecuting)
-      return FALSE;
   }
 
   /* Unset flushing to allow ports to accept data again */
@@ -1320,8 +1474,7 @@ gst_omx_video_enc_set_format (GstVideoEncoder * encoder,
   /* Start the srcpad loop again */
   GST_DEBUG_OBJECT (self, "Starting task again");
   self->downstream_flow_ret = GST_FLOW_OK;
-  gst_pad_start_task (GST_VIDEO_ENCODER_SRC_PAD (self),
-      (GstTaskFunction) gst_omx_video_enc_loop, encoder, NULL);
+  gst_omx_video_enc_start_loop (self);
 
   return TRUE;
 }
@@ -1354,8 +1507,7 @@ gst_omx_video_enc_reset (GstVideoEncoder * encoder, gboolean hard)
   self->last_upstream_ts = 0;
   self->eos = FALSE;
   self->downstream_flow_ret = GST_FLOW_OK;
-  gst_pad_start_task (GST_VIDEO_ENCODER_SRC_PAD (self),
-      (GstTaskFunction) gst_omx_video_enc_loop, encoder, NULL);
+  gst_omx_video_enc_start_loop (self);
 
   return TRUE;
 }
@@ -1369,6 +1521,7 @@ gst_omx_video_enc_fill_buffer (GstOMXVideoEnc * self, GstBuffer * inbuf,
   OMX_PARAM_PORTDEFINITIONTYPE *port_def = &self->enc_in_port->port_def;
   gboolean ret = FALSE;
   GstVideoFrame frame;
+  gsize filled;
 
   if (info->width != port_def->format.video.nFrameWidth ||
       info->height != port_def->format.video.nFrameHeight) {
@@ -1390,140 +1543,57 @@ gst_omx_video_enc_fill_buffer (GstOMXVideoEnc * self, GstBuffer * inbuf,
 
   /* Different strides */
 
-  switch (info->finfo->format) {
-    case GST_VIDEO_FORMAT_I420:{
-      gint i, j, height, width;
-      guint8 *src, *dest;
-      gint src_stride, dest_stride;
-
-      outbuf->omx_buf->nFilledLen = 0;
-
-      if (!gst_video_frame_map (&frame, info, inbuf, GST_MAP_READ)) {
-        GST_ERROR_OBJECT (self, "Invalid input buffer size");
-        ret = FALSE;
-        break;
-      }
+  if (!gst_omx_video_copy_supports_format (info->finfo->format)) {
+    GST_ERROR_OBJECT (self, "Unsupported format");
+    goto done;
+  }
 
-      for (i = 0; i < 3; i++) {
-        if (i == 0) {
-          dest_stride = port_def->format.video.nStride;
-          src_stride = GST_VIDEO_FRAME_COMP_STRIDE (&frame, 0);
-
-          /* XXX: Try this if no stride was set */
-          if (dest_stride == 0)
-            dest_stride = src_stride;
-        } else {
-          dest_stride = port_def->format.video.nStride / 2;
-          src_stride = GST_VIDEO_FRAME_COMP_STRIDE (&frame, 1);
-
-          /* XXX: Try this if no stride was set */
-          if (dest_stride == 0)
-            dest_stride = src_stride;
-        }
+  if (!gst_video_frame_map (&frame, info, inbuf, GST_MAP_READ)) {
+    GST_ERROR_OBJECT (self, "Invalid input buffer size");
+    goto done;
+  }
 
-        dest = outbuf->omx_buf->pBuffer + outbuf->omx_buf->nOffset;
-        if (i > 0)
-          dest +=
-              port_def->format.video.nSliceHeight *
-              port_def->format.video.nStride;
-        if (i == 2)
-          dest +=
-              (port_def->format.video.nSliceHeight / 2) *
-              (port_def->format.video.nStride / 2);
-
-        src = GST_VIDEO_FRAME_COMP_DATA (&frame, i);
-        height = GST_VIDEO_FRAME_COMP_HEIGHT (&frame, i);
-        width = GST_VIDEO_FRAME_COMP_WIDTH (&frame, i);
-
-        if (dest + dest_stride * height >
-            outbuf->omx_buf->pBuffer + outbuf->omx_buf->nAllocLen) {
-          gst_video_frame_unmap (&frame);
-          GST_ERROR_OBJECT (self, "Invalid output buffer size");
-          ret = FALSE;
-          break;
-        }
+  ret = gst_omx_video_copy_from_frame (&frame,
+      outbuf->omx_buf->pBuffer + outbuf->omx_buf->nOffset,
+      outbuf->omx_buf->nAllocLen - outbuf->omx_buf->nOffset,
+      port_def->format.video.nStride, port_def->format.video.nSliceHeight,
+      &filled);
+  gst_video_frame_unmap (&frame);
 
-        for (j = 0; j < height; j++) {
-          memcpy (dest, src, width);
-          outbuf->omx_buf->nFilledLen += dest_stride;
-          src += src_stride;
-          dest += dest_stride;
-        }
-      }
-      gst_video_frame_unmap (&frame);
-      ret = TRUE;
-      break;
-    }
-    case GST_VIDEO_FORMAT_NV12:{
-      gint i, j, height, width;
-      guint8 *src, *dest;
-      gint src_stride, dest_stride;
+  if (ret)
+    outbuf->omx_buf->nFilledLen = filled;
+  else
+    GST_ERROR_OBJECT (self, "Invalid output buffer size");
 
-      outbuf->omx_buf->nFilledLen = 0;
+done:
 
-      if (!gst_video_frame_map (&frame, info, inbuf, GST_MAP_READ)) {
-        GST_ERROR_OBJECT (self, "Invalid input buffer size");
-        ret = FALSE;
-        break;
-      }
+  gst_video_codec_state_unref (state);
 
-      for (i = 0; i < 2; i++) {
-        if (i == 0) {
-          dest_stride = port_def->format.video.nStride;
-          src_stride = GST_VIDEO_FRAME_COMP_STRIDE (&frame, 0);
-          /* XXX: Try this if no stride was set */
-          if (dest_stride == 0)
-            dest_stride = src_stride;
-        } else {
-          dest_stride = port_def->format.video.nStride;
-          src_stride = GST_VIDEO_FRAME_COMP_STRIDE (&frame, 1);
-
-          /* XXX: Try this if no stride was set */
-          if (dest_stride == 0)
-            dest_stride = src_stride;
-        }
+  return ret;
+}
 
-        dest = outbuf->omx_buf->pBuffer + outbuf->omx_buf->nOffset;
-        if (i == 1)
-          dest +=
-              port_def->format.video.nSliceHeight *
-              port_def->format.video.nStride;
-
-        src = GST_VIDEO_FRAME_COMP_DATA (&frame, i);
-        height = GST_VIDEO_FRAME_COMP_HEIGHT (&frame, i);
-        width = GST_VIDEO_FRAME_COMP_WIDTH (&frame, i) * (i == 0 ? 1 : 2);
-
-        if (dest + dest_stride * height >
-            outbuf->omx_buf->pBuffer + outbuf->omx_buf->nAllocLen) {
-          gst_video_frame_unmap (&frame);
-          GST_ERROR_OBJECT (self, "Invalid output buffer size");
-          ret = FALSE;
-          break;
-        }
+/* Accounts the frames that wait for their output, including
+ * the input buffers they keep */
+static void
+gst_omx_video_enc_account_pending_frames (GstOMXVideoEnc * self)
+{
+  GList *frames, *l;
+  gsize bytes = 0;
+  guint n = 0;
 
-        for (j = 0; j < height; j++) {
-          memcpy (dest, src, width);
-          outbuf->omx_buf->nFilledLen += dest_stride;
-          src += src_stride;
-          dest += dest_stride;
-        }
+  frames = gst_video_encoder_get_frames (GST_VIDEO_ENCODER (self));
+  for (l = frames; l; l = l->next) {
+    GstVideoCodecFrame *frame = l->data;
 
-      }
-      gst_video_frame_unmap (&frame);
-      ret = TRUE;
-      break;
-    }
-    default:
-      GST_ERROR_OBJECT (self, "Unsupported format");
-      goto done;
-      break;
+    bytes += sizeof (GstVideoCodecFrame);
+    if (frame->input_buffer)
+      bytes += gst_buffer_get_size (frame->input_buffer);
+    n++;
   }
+  g_list_free_full (frames, (GDestroyNotify) gst_video_codec_frame_unref);
 
-done:
-
-  gst_video_codec_state_unref (state);
-
-  return ret;
+  gst_omx_component_set_memory (self->enc, GST_OMX_MEMORY_PENDING_FRAMES, n,
+      bytes);
 }
 
 static GstFlowReturn
@@ -1534,12 +1604,16 @@ gst_omx_video_enc_handle_frame (GstVideoEncoder * encoder,
   GstOMXVideoEnc *self;
   GstOMXPort *port;
   GstOMXBuffer *buf;
+  GstClockTime arrival = GST_CLOCK_TIME_NONE;
   OMX_ERRORTYPE err;
 
   self = GST_OMX_VIDEO_ENC (encoder);
 
   GST_DEBUG_OBJECT (self, "Handling frame");
 
+  if (GST_OMX_LATENCY_TRACING ())
+    arrival = gst_util_get_timestamp ();
+
   if (self->eos) {
     GST_WARNING_OBJECT (self, "Got frame after EOS");
     gst_video_codec_frame_unref (frame);
@@ -1551,6 +1625,13 @@ gst_omx_video_enc_handle_frame (GstVideoEncoder * encoder,
     return self->downstream_flow_ret;
   }
 
+  gst_omx_video_enc_account_pending_frames (self);
+
+  if (!g_atomic_int_get (&self->executing)
+      && gst_omx_component_get_state (self->enc,
+          5 * GST_SECOND) != OMX_StateExecuting)
+    goto state_error;
+
   port = self->enc_in_port;
 
   while (acq_ret != GST_OMX_ACQUIRE_BUFFER_OK) {
@@ -1680,6 +1761,7 @@ gst_omx_video_enc_handle_frame (GstVideoEncoder * encoder,
 
     id = g_slice_new0 (BufferIdentification);
     id->timestamp = buf->omx_buf->nTimeStamp;
+    id->arrival = arrival;
     gst_video_codec_frame_set_user_data (frame, id,
         (GDestroyNotify) buffer_identification_free);
 
@@ -1720,6 +1802,16 @@ component_error:
     return GST_FLOW_ERROR;
   }
 
+state_error:
+  {
+    GST_ELEMENT_ERROR (self, LIBRARY, FAILED, (NULL),
+        ("OpenMAX component did not reach Executing state: %s (0x%08x)",
+            gst_omx_component_get_last_error_string (self->enc),
+            gst_omx_component_get_last_error (self->enc)));
+    gst_video_codec_frame_unref (frame);
+    return GST_FLOW_ERROR;
+  }
+
 flushing:
   {
     GST_DEBUG_OBJECT (self, "Flushing -- returning FLUSHING");
@@ -26,6 +26,7 @@
 #include <gst/video/gstvideoencoder.h>
 
 #include "gstomx.h"
+#include "gstomxworker.h"
 
 G_BEGIN_DECLS
 
@@ -58,9 +59,16 @@ struct _GstOMXVideoEnc
   /* TRUE if the component is configured and saw
    * the first buffer */
   gboolean started;
+  /* TRUE if the component is in Executing state,
+   * set by its state notify func */
+  volatile gint executing;
 
   GstClockTime last_upstream_ts;
 
+  /* Protects enc against close() while the property getters
+   * and action signals use it from other threads */
+  GMutex comp_lock;
+
   /* Draining state */
   GMutex drain_lock;
   GCond drain_cond;
@@ -78,6 +86,10 @@ struct _GstOMXVideoEnc
   guint32 quant_b_frames;
 
   GstFlowReturn downstream_flow_ret;
+
+  /* Runs the srcpad loop between start() and stop() if the shared
+   * worker pool is used, NULL if the srcpad has its own task */
+  GstOMXWorkerTask *worker_task;
 };
 
 struct _GstOMXVideoEncClass
@@ -89,6 +101,9 @@ struct _GstOMXVideoEncClass
   gboolean            (*set_format)          (GstOMXVideoEnc * self, GstOMXPort * port, GstVideoCodecState * state);
   GstCaps            *(*get_caps)           (GstOMXVideoEnc * self, GstOMXPort * port, GstVideoCodecState * state);
   GstFlowReturn       (*handle_output_frame) (GstOMXVideoEnc * self, GstOMXPort * port, GstOMXBuffer * buffer, GstVideoCodecFrame * frame);
+
+  /* actions */
+  gchar *  (*dump_flight_recorder) (GstOMXVideoEnc * self);
 };
 
 GType gst_omx_video_enc_get_type (void);
@@ -0,0 +1,448 @@
+/*
+ * Copyright (C) 2026, the gst-omx authors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gst/gst.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "gstomxworker.h"
+
+GST_DEBUG_CATEGORY_STATIC (gst_omx_worker_debug_category);
+#define GST_CAT_DEFAULT gst_omx_worker_debug_category
+
+typedef enum
+{
+  /* Not queued and not running */
+  GST_OMX_WORKER_SCHED_IDLE = 0,
+  /* Queued on the pool, will run soon */
+  GST_OMX_WORKER_SCHED_QUEUED,
+  /* Running right now */
+  GST_OMX_WORKER_SCHED_RUNNING,
+  /* Running and notified in the meantime, runs again afterwards */
+  GST_OMX_WORKER_SCHED_RUNNING_NOTIFIED
+} GstOMXWorkerSchedState;
+
+/* Maximum number of tasks that use the pool at the same time, further
+ * elements use their own pad task */
+#define GST_OMX_WORKER_MAX_TASKS (1024)
+
+/* Tasks that have to run. They are queued from the OMX callbacks, so
+ * queueing must not take any lock: the task goes into a lock-free ring
+ * and one byte is written to the pipe, which wakes up exactly one of
+ * the threads blocked reading it. Every task is queued at most once at
+ * a time and there are never more than GST_OMX_WORKER_MAX_TASKS tasks,
+ * so the ring can't overflow */
+static GstOMXRing worker_queue;
+static gint worker_pipe[2] = { -1, -1 };
+static gint worker_threads = 0;
+/* Number of tasks that use the pool */
+static volatile gint worker_tasks = 0;
+
+/* Threads that are neither parked nor inside a blocking section. A
+ * thread that enters a blocking section is replaced by a parked or
+ * new one if this drops below worker_threads, and threads park again
+ * once it is above twice that. So tasks blocked downstream never take
+ * the threads away from the others, and threads are only added for
+ * tasks that are blocked at the same time */
+static volatile gint worker_active = 0;
+/* Parked threads and how many of them were told to resume, protected
+ * by worker_lock */
+static GMutex worker_lock;
+static GCond worker_cond;
+static gint worker_parked = 0;
+static gint worker_resume = 0;
+
+static void gst_omx_worker_task_run (GstOMXWorkerTask * task);
+static gpointer gst_omx_worker_thread (gpointer data);
+
+/* Counts the thread as active and resumes a parked thread,
+ * or creates a new one */
+static void
+gst_omx_worker_add_thread (void)
+{
+  GError *err = NULL;
+  GThread *thread;
+
+  g_atomic_int_inc (&worker_active);
+
+  g_mutex_lock (&worker_lock);
+  if (worker_parked > worker_resume) {
+    worker_resume++;
+    g_cond_signal (&worker_cond);
+    g_mutex_unlock (&worker_lock);
+    return;
+  }
+  g_mutex_unlock (&worker_lock);
+
+  thread = g_thread_try_new ("omxworker", gst_omx_worker_thread, NULL, &err);
+  if (!thread) {
+    GST_ERROR ("Failed to create worker thread: %s", err->message);
+    g_clear_error (&err);
+    g_atomic_int_add (&worker_active, -1);
+    return;
+  }
+  g_thread_unref (thread);
+}
+
+/* Parks the thread if there are too many active ones.
+ * Returns FALSE if the thread has to exit instead */
+static gboolean
+gst_omx_worker_maybe_park (void)
+{
+  gint n;
+
+  do {
+    n = g_atomic_int_get (&worker_active);
+    if (n <= 2 * worker_threads)
+      return TRUE;
+  } while (!g_atomic_int_compare_and_exchange (&worker_active, n, n - 1));
+
+  g_mutex_lock (&worker_lock);
+  if (worker_parked >= worker_threads) {
+    g_mutex_unlock (&worker_lock);
+    return FALSE;
+  }
+  worker_parked++;
+  while (worker_resume == 0)
+    g_cond_wait (&worker_cond, &worker_lock);
+  worker_resume--;
+  worker_parked--;
+  g_mutex_unlock (&worker_lock);
+
+  /* Counted as active again by gst_omx_worker_add_thread() */
+  return TRUE;
+}
+
+static gpointer
+gst_omx_worker_thread (gpointer data)
+{
+  GstOMXWorkerTask *task;
+  gchar c;
+  gssize n;
+
+  while (gst_omx_worker_maybe_park ()) {
+    n = read (worker_pipe[0], &c, 1);
+    if (n == -1 && errno == EINTR)
+      continue;
+    if (n != 1) {
+      GST_ERROR ("Failed to read from the worker pipe: %s",
+          n == 0 ? "EOF" : g_strerror (errno));
+      break;
+    }
+
+    /* A task queued after this one might have woken us up while
+     * this one is not published yet, that's only a few instructions */
+    while (!(task = gst_omx_ring_pop (&worker_queue)))
+      g_thread_yield ();
+
+    gst_omx_worker_task_run (task);
+  }
+
+  return NULL;
+}
+
+static gpointer
+gst_omx_worker_pool_init (gpointer data)
+{
+  const gchar *env;
+  gint n_threads = 0, i;
+  GError *err = NULL;
+  GThread *thread;
+
+  GST_DEBUG_CATEGORY_INIT (gst_omx_worker_debug_category, "omxworker", 0,
+      "gst-omx shared worker pool");
+
+  env = g_getenv (GST_OMX_WORKER_THREADS_ENV);
+  if (!env || *env == '\0')
+    return NULL;
+
+  if (g_ascii_strcasecmp (env, "auto") == 0)
+    n_threads = g_get_num_processors ();
+  else
+    n_threads = atoi (env);
+
+  if (n_threads <= 0)
+    return NULL;
+
+  if (pipe (worker_pipe) == -1) {
+    GST_ERROR ("Failed to create worker pipe: %s", g_strerror (errno));
+    return NULL;
+  }
+  gst_omx_ring_init (&worker_queue, GST_OMX_WORKER_MAX_TASKS);
+
+  /* Threads are never stopped, like the core handles they
+   * live as long as the process */
+  worker_threads = n_threads;
+  g_atomic_int_set (&worker_active, n_threads);
+  for (i = 0; i < n_threads; i++) {
+    thread = g_thread_try_new ("omxworker", gst_omx_worker_thread, NULL, &err);
+    if (!thread) {
+      GST_ERROR ("Failed to create worker thread: %s", err->message);
+      g_clear_error (&err);
+      break;
+    }
+    g_thread_unref (thread);
+  }
+
+  if (i == 0) {
+    close (worker_pipe[0]);
+    close (worker_pipe[1]);
+    gst_omx_ring_clear (&worker_queue);
+    worker_threads = 0;
+    return NULL;
+  }
+  worker_threads = i;
+  g_atomic_int_set (&worker_active, i);
+
+  GST_INFO ("Created worker pool with %d threads", worker_threads);
+
+  return GINT_TO_POINTER (1);
+}
+
+/* TRUE if the output loops of all elements should run on the
+ * shared worker pool, decided once per process */
+gboolean
+gst_omx_worker_pool_enabled (void)
+{
+  static GOnce once = G_ONCE_INIT;
+
+  return g_once (&once, gst_omx_worker_pool_init, NULL) != NULL;
+}
+
+/* NOTE: Called from the OMX callbacks, does not take any lock */
+static void
+gst_omx_worker_task_queue (GstOMXWorkerTask * task)
+{
+  const gchar c = 0;
+
+  gst_object_ref (task->element);
+  if (!gst_omx_ring_push (&worker_queue, task))
+    g_assert_not_reached ();
+  while (write (worker_pipe[1], &c, 1) == -1 && errno == EINTR);
+}
+
+static void
+gst_omx_worker_task_notify (GstOMXPort * port, gpointer user_data)
+{
+  GstOMXWorkerTask *task = user_data;
+
+  if (g_atomic_int_get (&task->state) != GST_TASK_STARTED)
+    return;
+
+  while (TRUE) {
+    gint sched = g_atomic_int_get (&task->sched);
+
+    if (sched == GST_OMX_WORKER_SCHED_IDLE) {
+      if (g_atomic_int_compare_and_exchange (&task->sched, sched,
+              GST_OMX_WORKER_SCHED_QUEUED)) {
+        gst_omx_worker_task_queue (task);
+        return;
+      }
+    } else if (sched == GST_OMX_WORKER_SCHED_RUNNING) {
+      if (g_atomic_int_compare_and_exchange (&task->sched, sched,
+              GST_OMX_WORKER_SCHED_RUNNING_NOTIFIED))
+        return;
+    } else {
+      /* Will run again anyway */
+      return;
+    }
+  }
+}
+
+static void
+gst_omx_worker_task_run (GstOMXWorkerTask * task)
+{
+  GstElement *element = task->element;
+  gboolean again;
+
+  GST_PAD_STREAM_LOCK (task->pad);
+  /* Notifications from here on make it run again */
+  g_atomic_int_set (&task->sched, GST_OMX_WORKER_SCHED_RUNNING);
+  task->wait_notify = FALSE;
+  if (g_atomic_int_get (&task->state) == GST_TASK_STARTED)
+    task->func (task->user_data);
+  again = (g_atomic_int_get (&task->state) == GST_TASK_STARTED
+      && !task->wait_notify);
+  if (task->blocking) {
+    task->blocking = FALSE;
+    g_atomic_int_inc (&worker_active);
+  }
+  GST_PAD_STREAM_UNLOCK (task->pad);
+
+  if (again) {
+    g_atomic_int_set (&task->sched, GST_OMX_WORKER_SCHED_QUEUED);
+    gst_omx_worker_task_queue (task);
+  } else if (!g_atomic_int_compare_and_exchange (&task->sched,
+          GST_OMX_WORKER_SCHED_RUNNING, GST_OMX_WORKER_SCHED_IDLE)) {
+    /* Notified while running */
+    g_atomic_int_set (&task->sched, GST_OMX_WORKER_SCHED_QUEUED);
+    gst_omx_worker_task_queue (task);
+  }
+
+  /* Might free the task */
+  gst_object_unref (element);
+}
+
+/* Elements create the task when they start and free it when they
+ * stop, the element is kept alive while the task is queued or running.
+ *
+ * Returns NULL if the pool already has GST_OMX_WORKER_MAX_TASKS tasks,
+ * the element has to use its own pad task then */
+GstOMXWorkerTask *
+gst_omx_worker_task_new (GstElement * element, GstPad * pad,
+    GstTaskFunction func, gpointer user_data)
+{
+  GstOMXWorkerTask *task;
+  gint n;
+
+  g_return_val_if_fail (gst_omx_worker_pool_enabled (), NULL);
+
+  do {
+    n = g_atomic_int_get (&worker_tasks);
+    if (n >= GST_OMX_WORKER_MAX_TASKS) {
+      GST_WARNING_OBJECT (element, "%d elements use the worker pool already, "
+          "using a pad task", n);
+      return NULL;
+    }
+  } while (!g_atomic_int_compare_and_exchange (&worker_tasks, n, n + 1));
+
+  task = g_slice_new0 (GstOMXWorkerTask);
+  task->element = element;
+  task->pad = pad;
+  task->func = func;
+  task->user_data = user_data;
+  task->state = GST_TASK_STOPPED;
+  task->sched = GST_OMX_WORKER_SCHED_IDLE;
+
+  return task;
+}
+
+/* NOTE: Uses comp->lock of the connected ports
+ *
+ * The task must be stopped. Disconnects it from its ports and waits
+ * until it is not queued anymore */
+void
+gst_omx_worker_task_free (GstOMXWorkerTask * task)
+{
+  GSList *l;
+
+  g_return_if_fail (task != NULL);
+  g_return_if_fail (g_atomic_int_get (&task->state) == GST_TASK_STOPPED);
+
+  for (l = task->ports; l; l = l->next)
+    gst_omx_port_set_notify_func (l->data, NULL, NULL);
+  g_slist_free (task->ports);
+
+  /* A queued run only finds it stopped */
+  while (g_atomic_int_get (&task->sched) != GST_OMX_WORKER_SCHED_IDLE)
+    g_usleep (1000);
+
+  g_slice_free (GstOMXWorkerTask, task);
+  g_atomic_int_add (&worker_tasks, -1);
+}
+
+/* NOTE: Uses comp->lock
+ *
+ * Every wakeup of the port, e.g. for a returned buffer, an error
+ * or flushing, makes the task run again. The port must stay alive
+ * until the task is freed */
+void
+gst_omx_worker_task_connect_port (GstOMXWorkerTask * task, GstOMXPort * port)
+{
+  g_return_if_fail (task != NULL);
+  g_return_if_fail (port != NULL);
+
+  gst_omx_port_set_notify_func (port, gst_omx_worker_task_notify, task);
+  task->ports = g_slist_prepend (task->ports, port);
+}
+
+void
+gst_omx_worker_task_start (GstOMXWorkerTask * task)
+{
+  g_return_if_fail (task != NULL);
+
+  GST_DEBUG_OBJECT (task->pad, "Starting worker task");
+  g_atomic_int_set (&task->state, GST_TASK_STARTED);
+
+  /* Buffers might be pending already */
+  gst_omx_worker_task_notify (NULL, task);
+}
+
+/* Like gst_pad_pause_task(), can be called from the task function */
+void
+gst_omx_worker_task_pause (GstOMXWorkerTask * task)
+{
+  g_return_if_fail (task != NULL);
+
+  GST_DEBUG_OBJECT (task->pad, "Pausing worker task");
+  g_atomic_int_set (&task->state, GST_TASK_PAUSED);
+
+  /* Wait until the function is not running anymore */
+  GST_PAD_STREAM_LOCK (task->pad);
+  GST_PAD_STREAM_UNLOCK (task->pad);
+}
+
+/* Like gst_pad_stop_task(), the function is not running
+ * anymore when this returns */
+void
+gst_omx_worker_task_stop (GstOMXWorkerTask * task)
+{
+  g_return_if_fail (task != NULL);
+
+  GST_DEBUG_OBJECT (task->pad, "Stopping worker task");
+  g_atomic_int_set (&task->state, GST_TASK_STOPPED);
+
+  GST_PAD_STREAM_LOCK (task->pad);
+  GST_PAD_STREAM_UNLOCK (task->pad);
+}
+
+/* Must be called from the task function. It is not called again
+ * before the next notification of one of the connected ports */
+void
+gst_omx_worker_task_wait_notify (GstOMXWorkerTask * task)
+{
+  g_return_if_fail (task != NULL);
+
+  task->wait_notify = TRUE;
+}
+
+/* NOTE: Uses worker_lock
+ *
+ * Must be called from the task function before anything that can
+ * block, like pushing downstream or waiting for the component. The
+ * thread doesn't count as a worker until the function returns, a
+ * parked or new thread takes over the other tasks meanwhile */
+void
+gst_omx_worker_task_enter_blocking (GstOMXWorkerTask * task)
+{
+  g_return_if_fail (task != NULL);
+
+  if (task->blocking)
+    return;
+  task->blocking = TRUE;
+
+  if (g_atomic_int_add (&worker_active, -1) - 1 < worker_threads)
+    gst_omx_worker_add_thread ();
+}
@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) 2026, the gst-omx authors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+#ifndef __GST_OMX_WORKER_H__
+#define __GST_OMX_WORKER_H__
+
+#include <gst/gst.h>
+
+#include "gstomx.h"
+
+G_BEGIN_DECLS
+
+/* Environment variable with the number of threads of the shared
+ * worker pool, or "auto" for one per CPU. Unset or 0 disables it and
+ * every element uses its own pad task. Any number of elements share
+ * these threads, only elements blocked downstream get another one */
+#define GST_OMX_WORKER_THREADS_ENV "GST_OMX_WORKER_THREADS"
+
+typedef struct _GstOMXWorkerTask GstOMXWorkerTask;
+
+/* Runs a pad loop function on the shared worker pool instead of a
+ * dedicated GstTask. The function is called with the pad's stream lock
+ * like a pad task, and called again until it either pauses the task or
+ * calls gst_omx_worker_task_wait_notify() because no buffer is
+ * available. Then it's only called again after the next notification
+ * of one of the ports it was connected to. Between two calls the other
+ * tasks run, and the function calls gst_omx_worker_task_enter_blocking()
+ * before it does anything that can block */
+struct _GstOMXWorkerTask {
+  GstElement *element;
+  GstPad *pad;
+  GstTaskFunction func;
+  gpointer user_data;
+
+  /* GstTaskState */
+  volatile gint state;
+  /* GstOMXWorkerSchedState */
+  volatile gint sched;
+  /* Set by the function if it has to wait for the next
+   * notification, protected by the pad's stream lock */
+  gboolean wait_notify;
+  /* Set while the function is inside a blocking section,
+   * protected by the pad's stream lock */
+  gboolean blocking;
+
+  /* GstOMXPort, the task is their notify func */
+  GSList *ports;
+};
+
+gboolean           gst_omx_worker_pool_enabled (void);
+
+GstOMXWorkerTask * gst_omx_worker_task_new (GstElement *element, GstPad *pad, GstTaskFunction func, gpointer user_data);
+void               gst_omx_worker_task_free (GstOMXWorkerTask *task);
+
+void               gst_omx_worker_task_connect_port (GstOMXWorkerTask *task, GstOMXPort *port);
+
+void               gst_omx_worker_task_start (GstOMXWorkerTask *task);
+void               gst_omx_worker_task_pause (GstOMXWorkerTask *task);
+void               gst_omx_worker_task_stop (GstOMXWorkerTask *task);
+
+void               gst_omx_worker_task_wait_notify (GstOMXWorkerTask *task);
+void               gst_omx_worker_task_enter_blocking (GstOMXWorkerTask *task);
+
+G_END_DECLS
+
+#endif /* __GST_OMX_WORKER_H__ */
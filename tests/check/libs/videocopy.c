@@ -0,0 +1,320 @@
+/*
+ * Copyright (C) 2026, the gst-omx authors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+#include <gst/check/gstcheck.h>
+#include <gst/video/video.h>
+
+#include "gstomxvideocopy.h"
+
+static const GstVideoFormat formats[] = {
+  GST_VIDEO_FORMAT_I420, GST_VIDEO_FORMAT_NV12
+};
+
+/* Odd widths and heights make the chroma planes round up */
+static const guint widths[] = { 1, 2, 3, 7, 16, 33, 176 };
+static const guint heights[] = { 1, 2, 5, 16, 17 };
+
+/* Added to the even width, 0 uses the stride of the frame */
+static const gint stride_paddings[] = { -1, 0, 2, 30 };
+/* Added to the even height, slice heights are always even */
+static const gint slice_paddings[] = { -1, 0, 2 };
+
+#define SENTINEL (0xa5)
+
+/* The layout of the OpenMAX buffer as the OpenMAX IL specification
+ * describes it, independent of gstomxvideocopy.c */
+static void
+omx_plane_layout (GstVideoFormat format, guint plane, gint stride,
+    guint slice_height, gsize * offset, gint * plane_stride)
+{
+  if (format == GST_VIDEO_FORMAT_I420) {
+    *plane_stride = plane == 0 ? stride : stride / 2;
+    *offset = plane == 0 ? 0 : (gsize) stride * slice_height;
+    if (plane == 2)
+      *offset += (gsize) (stride / 2) * (slice_height / 2);
+  } else {
+    *plane_stride = stride;
+    *offset = plane == 0 ? 0 : (gsize) stride * slice_height;
+  }
+}
+
+static guint
+row_size (GstVideoFrame * frame, guint plane)
+{
+  return GST_VIDEO_FRAME_COMP_WIDTH (frame, plane) *
+      GST_VIDEO_FRAME_COMP_PSTRIDE (frame, plane);
+}
+
+static void
+fill_pattern (guint8 * data, gsize size, guint seed)
+{
+  gsize i;
+
+  for (i = 0; i < size; i++)
+    data[i] = (guint8) ((i * 31 + seed * 7 + 1) % 251);
+}
+
+/* Calls func for every covered format, size, stride and slice height
+ * with a mapped frame and a matching OpenMAX buffer of size bytes */
+typedef void (*CheckFunc) (GstVideoFrame * frame, guint8 * omx, gsize size,
+    gint stride, guint slice_height);
+
+static void
+run_all (CheckFunc func, GstMapFlags flags)
+{
+  guint f, w, h, s, l;
+
+  for (f = 0; f < G_N_ELEMENTS (formats); f++) {
+    for (w = 0; w < G_N_ELEMENTS (widths); w++) {
+      for (h = 0; h < G_N_ELEMENTS (heights); h++) {
+        for (s = 0; s < G_N_ELEMENTS (stride_paddings); s++) {
+          for (l = 0; l < G_N_ELEMENTS (slice_paddings); l++) {
+            GstVideoInfo info;
+            GstVideoFrame frame;
+            GstBuffer *buffer;
+            gint stride, omx_stride;
+            guint slice_height, omx_slice_height;
+            gsize size;
+            guint8 *omx;
+
+            /* The defaults of the frame are only even for even heights */
+            if (slice_paddings[l] < 0 && heights[h] % 2 != 0)
+              continue;
+
+            gst_video_info_set_format (&info, formats[f], widths[w],
+                heights[h]);
+            buffer = gst_buffer_new_allocate (NULL, GST_VIDEO_INFO_SIZE (&info),
+                NULL);
+            fail_unless (gst_video_frame_map (&frame, &info, buffer,
+                    flags | GST_MAP_READ));
+
+            stride = stride_paddings[s] < 0 ? 0 :
+                GST_ROUND_UP_2 (widths[w]) + stride_paddings[s];
+            slice_height = slice_paddings[l] < 0 ? 0 :
+                GST_ROUND_UP_2 (heights[h]) + slice_paddings[l];
+            omx_stride = stride ? stride : GST_VIDEO_FRAME_PLANE_STRIDE (&frame,
+                0);
+            omx_slice_height = slice_height ? slice_height : heights[h];
+
+            size = (gsize) omx_stride * omx_slice_height * 3 / 2;
+            omx = g_malloc (size);
+
+            func (&frame, omx, size, stride, slice_height);
+
+            g_free (omx);
+            gst_video_frame_unmap (&frame);
+            gst_buffer_unref (buffer);
+          }
+        }
+      }
+    }
+  }
+}
+
+static void
+check_to_frame (GstVideoFrame * frame, guint8 * omx, gsize size, gint stride,
+    guint slice_height)
+{
+  GstVideoFormat format = GST_VIDEO_FRAME_FORMAT (frame);
+  gint omx_stride = stride ? stride : GST_VIDEO_FRAME_PLANE_STRIDE (frame, 0);
+  guint omx_slice_height =
+      slice_height ? slice_height : GST_VIDEO_FRAME_HEIGHT (frame);
+  guint i, y;
+
+  fill_pattern (omx, size, omx_stride + omx_slice_height);
+  for (i = 0; i < GST_VIDEO_FRAME_N_PLANES (frame); i++)
+    memset (GST_VIDEO_FRAME_PLANE_DATA (frame, i), SENTINEL,
+        GST_VIDEO_FRAME_PLANE_STRIDE (frame, i) *
+        GST_VIDEO_FRAME_COMP_HEIGHT (frame, i));
+
+  fail_unless (gst_omx_video_copy_to_frame (frame, omx, size, stride,
+          slice_height));
+
+  for (i = 0; i < GST_VIDEO_FRAME_N_PLANES (frame); i++) {
+    guint8 *data = GST_VIDEO_FRAME_PLANE_DATA (frame, i);
+    guint frame_stride = GST_VIDEO_FRAME_PLANE_STRIDE (frame, i);
+    guint width = row_size (frame, i);
+    gsize offset;
+    gint plane_stride;
+
+    omx_plane_layout (format, i, omx_stride, omx_slice_height, &offset,
+        &plane_stride);
+    for (y = 0; y < GST_VIDEO_FRAME_COMP_HEIGHT (frame, i); y++) {
+      guint8 *row = data + y * frame_stride;
+      guint x;
+
+      fail_unless (memcmp (row, omx + offset + (gsize) y * plane_stride,
+              width) == 0, "%s %ux%u stride %d slice height %u: plane %u "
+          "row %u differs", gst_video_format_to_string (format),
+          GST_VIDEO_FRAME_WIDTH (frame), GST_VIDEO_FRAME_HEIGHT (frame),
+          stride, slice_height, i, y);
+      /* The padding of the frame is not touched */
+      for (x = width; x < frame_stride; x++)
+        fail_unless_equals_int (row[x], SENTINEL);
+    }
+  }
+}
+
+static void
+check_from_frame (GstVideoFrame * frame, guint8 * omx, gsize size, gint stride,
+    guint slice_height)
+{
+  GstVideoFormat format = GST_VIDEO_FRAME_FORMAT (frame);
+  gint omx_stride = stride ? stride : GST_VIDEO_FRAME_PLANE_STRIDE (frame, 0);
+  guint omx_slice_height =
+      slice_height ? slice_height : GST_VIDEO_FRAME_HEIGHT (frame);
+  gsize filled, expected = 0, offset;
+  gint plane_stride;
+  guint8 *ref;
+  guint i, y;
+
+  for (i = 0; i < GST_VIDEO_FRAME_N_PLANES (frame); i++)
+    fill_pattern (GST_VIDEO_FRAME_PLANE_DATA (frame, i),
+        GST_VIDEO_FRAME_PLANE_STRIDE (frame, i) *
+        GST_VIDEO_FRAME_COMP_HEIGHT (frame, i), i);
+
+  /* Plain row by row copy into a buffer with the same padding */
+  ref = g_malloc (size);
+  memset (ref, SENTINEL, size);
+  for (i = 0; i < GST_VIDEO_FRAME_N_PLANES (frame); i++) {
+    const guint8 *data = GST_VIDEO_FRAME_PLANE_DATA (frame, i);
+
+    omx_plane_layout (format, i, omx_stride, omx_slice_height, &offset,
+        &plane_stride);
+    for (y = 0; y < GST_VIDEO_FRAME_COMP_HEIGHT (frame, i); y++)
+      memcpy (ref + offset + (gsize) y * plane_stride,
+          data + y * GST_VIDEO_FRAME_PLANE_STRIDE (frame, i),
+          row_size (frame, i));
+    expected += (gsize) plane_stride * GST_VIDEO_FRAME_COMP_HEIGHT (frame, i);
+  }
+  expected = MIN (expected, size);
+
+  memset (omx, SENTINEL, size);
+  fail_unless (gst_omx_video_copy_from_frame (frame, omx, size, stride,
+          slice_height, &filled));
+
+  /* Also checks that the padding between the lines is not touched */
+  fail_unless (memcmp (omx, ref, size) == 0,
+      "%s %ux%u stride %d slice height %u differs",
+      gst_video_format_to_string (format), GST_VIDEO_FRAME_WIDTH (frame),
+      GST_VIDEO_FRAME_HEIGHT (frame), stride, slice_height);
+  fail_unless_equals_uint64 (filled, expected);
+
+  g_free (ref);
+}
+
+static void
+check_too_small (GstVideoFrame * frame, guint8 * omx, gsize size, gint stride,
+    guint slice_height)
+{
+  GstVideoFormat format = GST_VIDEO_FRAME_FORMAT (frame);
+  gint omx_stride = stride ? stride : GST_VIDEO_FRAME_PLANE_STRIDE (frame, 0);
+  guint omx_slice_height =
+      slice_height ? slice_height : GST_VIDEO_FRAME_HEIGHT (frame);
+  gsize needed = 0, offset, filled;
+  gint plane_stride;
+  guint i;
+
+  /* Up to the end of the last line of the last plane */
+  for (i = 0; i < GST_VIDEO_FRAME_N_PLANES (frame); i++) {
+    omx_plane_layout (format, i, omx_stride, omx_slice_height, &offset,
+        &plane_stride);
+    needed = MAX (needed, offset + (gsize) plane_stride *
+        (GST_VIDEO_FRAME_COMP_HEIGHT (frame, i) - 1) + row_size (frame, i));
+  }
+  fail_unless (needed <= size);
+
+  memset (omx, 0, size);
+  fail_unless (gst_omx_video_copy_to_frame (frame, omx, needed, stride,
+          slice_height));
+  fail_if (gst_omx_video_copy_to_frame (frame, omx, needed - 1, stride,
+          slice_height));
+  fail_unless (gst_omx_video_copy_from_frame (frame, omx, needed, stride,
+          slice_height, &filled));
+  fail_unless (filled <= needed);
+  fail_if (gst_omx_video_copy_from_frame (frame, omx, needed - 1, stride,
+          slice_height, &filled));
+}
+
+GST_START_TEST (test_video_copy_to_frame)
+{
+  run_all (check_to_frame, GST_MAP_WRITE);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_video_copy_from_frame)
+{
+  run_all (check_from_frame, GST_MAP_WRITE);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_video_copy_too_small)
+{
+  run_all (check_too_small, GST_MAP_WRITE);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_video_copy_unsupported_format)
+{
+  GstVideoInfo info;
+  GstVideoFrame frame;
+  GstBuffer *buffer;
+  guint8 omx[64 * 16 * 4];
+  gsize filled;
+
+  fail_if (gst_omx_video_copy_supports_format (GST_VIDEO_FORMAT_RGBA));
+
+  gst_video_info_set_format (&info, GST_VIDEO_FORMAT_RGBA, 16, 16);
+  buffer = gst_buffer_new_allocate (NULL, GST_VIDEO_INFO_SIZE (&info), NULL);
+  fail_unless (gst_video_frame_map (&frame, &info, buffer, GST_MAP_READWRITE));
+
+  fail_if (gst_omx_video_copy_to_frame (&frame, omx, sizeof (omx), 64, 16));
+  fail_if (gst_omx_video_copy_from_frame (&frame, omx, sizeof (omx), 64, 16,
+          &filled));
+
+  gst_video_frame_unmap (&frame);
+  gst_buffer_unref (buffer);
+}
+
+GST_END_TEST;
+
+static Suite *
+videocopy_suite (void)
+{
+  Suite *s = suite_create ("videocopy");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_video_copy_to_frame);
+  tcase_add_test (tc_chain, test_video_copy_from_frame);
+  tcase_add_test (tc_chain, test_video_copy_too_small);
+  tcase_add_test (tc_chain, test_video_copy_unsupported_format);
+
+  return s;
+}
+
+GST_CHECK_MAIN (videocopy);
@@ -0,0 +1,1702 @@
+/*
+ * Copyright (C) 2026, the gst-omx authors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+/* A software OpenMAX IL core with fake decoder and encoder components.
+ *
+ * The components don't decode or encode anything, they only behave like
+ * a hardware codec would from the point of view of the IL client: the
+ * state machine, port enabling/disabling, flushing, buffer counts,
+ * padded strides and slice heights, port settings changes and a
+ * processing latency per buffer. This allows to benchmark and debug
+ * the buffer handling of the elements on any machine.
+ *
+ * The behaviour is configured by a key file given in the
+ * GST_OMX_FAKE_CORE_CONFIG environment variable. Every component reads
+ * its keys from the group with its name without the "OMX.fake." prefix,
+ * e.g. "video_decoder", and falls back to the "default" group:
+ *
+ *   latency                          processing time per buffer (us)
+ *   jitter                           random +/- variation of the latency (us)
+ *   in-buffers, out-buffers          minimum number of buffers per port
+ *   width, height                    decoder output size, 0 for the input size
+ *   stride-align                     alignment of the raw video stride
+ *   slice-height-align               alignment of the raw video slice height
+ *   port-settings-changed-interval   decoders signal new output settings
+ *                                    every this many frames, 0 for only once
+ *   compression-ratio                encoder output size is input size / ratio
+ *   gop                              encoders mark every gop-th frame as sync frame
+ *   trace                            trace file to replay, see below
+ *
+ * Buffers are processed one at a time by a thread per component, the
+ * payload of the output buffers is not written.
+ *
+ * A trace written by gst-omx with GST_OMX_TRACE_DIR set can be replayed
+ * to reproduce the timing of a real component: the k-th output buffer
+ * then takes as long to produce as it took the traced component after
+ * it had both the k-th input buffer and finished the previous output,
+ * and gets the traced size and flags. Port settings changes happen
+ * before the same output buffers as in the trace. This replaces
+ * latency, jitter, port-settings-changed-interval, compression-ratio
+ * and gop, and starts from the beginning again once the trace is used
+ * up. The replay is the same every time as long as the input arrives
+ * at the same times.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <glib.h>
+
+#ifdef GST_OMX_STRUCT_PACKING
+# if GST_OMX_STRUCT_PACKING == 1
+#  pragma pack(1)
+# elif GST_OMX_STRUCT_PACKING == 2
+#  pragma pack(2)
+# elif GST_OMX_STRUCT_PACKING == 4
+#  pragma pack(4)
+# elif GST_OMX_STRUCT_PACKING == 8
+#  pragma pack(8)
+# else
+#  error "Unsupported struct packing value"
+# endif
+#endif
+
+#include <OMX_Core.h>
+#include <OMX_Component.h>
+
+#ifdef GST_OMX_STRUCT_PACKING
+#pragma pack()
+#endif
+
+#include "gstomxtrace.h"
+
+#if !GLIB_CHECK_VERSION(2,68,0)
+#define g_memdup2(mem, size) g_memdup ((mem), (size))
+#endif
+
+#define FAKE_CORE_CONFIG_ENV "GST_OMX_FAKE_CORE_CONFIG"
+#define FAKE_COMPONENT_PREFIX "OMX.fake."
+
+#define FAKE_IN_PORT 0
+#define FAKE_OUT_PORT 1
+#define FAKE_N_PORTS 2
+
+#define FAKE_INIT_STRUCT(st) G_STMT_START { \
+  memset ((st), 0, sizeof (*(st))); \
+  (st)->nSize = sizeof (*(st)); \
+  (st)->nVersion.s.nVersionMajor = OMX_VERSION_MAJOR; \
+  (st)->nVersion.s.nVersionMinor = OMX_VERSION_MINOR; \
+  (st)->nVersion.s.nRevision = OMX_VERSION_REVISION; \
+  (st)->nVersion.s.nStep = OMX_VERSION_STEP; \
+} G_STMT_END
+
+typedef enum
+{
+  FAKE_VIDEO_DECODER,
+  FAKE_VIDEO_ENCODER,
+  FAKE_AUDIO_ENCODER
+} FakeComponentKind;
+
+typedef struct
+{
+  const gchar *role;
+  OMX_VIDEO_CODINGTYPE video_coding;
+  OMX_AUDIO_CODINGTYPE audio_coding;
+} FakeRole;
+
+typedef struct
+{
+  const gchar *name;
+  FakeComponentKind kind;
+  const FakeRole *roles;
+  guint n_roles;
+} FakeComponentInfo;
+
+static const FakeRole video_decoder_roles[] = {
+  {"video_decoder.avc", OMX_VIDEO_CodingAVC, OMX_AUDIO_CodingUnused},
+  {"video_decoder.mpeg4", OMX_VIDEO_CodingMPEG4, OMX_AUDIO_CodingUnused},
+  {"video_decoder.mpeg2", OMX_VIDEO_CodingMPEG2, OMX_AUDIO_CodingUnused},
+  {"video_decoder.h263", OMX_VIDEO_CodingH263, OMX_AUDIO_CodingUnused},
+  {"video_decoder.wmv", OMX_VIDEO_CodingWMV, OMX_AUDIO_CodingUnused},
+  {"video_decoder.mjpeg", OMX_VIDEO_CodingMJPEG, OMX_AUDIO_CodingUnused}
+};
+
+static const FakeRole video_encoder_roles[] = {
+  {"video_encoder.avc", OMX_VIDEO_CodingAVC, OMX_AUDIO_CodingUnused},
+  {"video_encoder.mpeg4", OMX_VIDEO_CodingMPEG4, OMX_AUDIO_CodingUnused},
+  {"video_encoder.h263", OMX_VIDEO_CodingH263, OMX_AUDIO_CodingUnused}
+};
+
+static const FakeRole audio_encoder_roles[] = {
+  {"audio_encoder.aac", OMX_VIDEO_CodingUnused, OMX_AUDIO_CodingAAC}
+};
+
+static const FakeComponentInfo fake_components[] = {
+  {FAKE_COMPONENT_PREFIX "video_decoder", FAKE_VIDEO_DECODER,
+      video_decoder_roles, G_N_ELEMENTS (video_decoder_roles)},
+  {FAKE_COMPONENT_PREFIX "video_encoder", FAKE_VIDEO_ENCODER,
+      video_encoder_roles, G_N_ELEMENTS (video_encoder_roles)},
+  {FAKE_COMPONENT_PREFIX "audio_encoder", FAKE_AUDIO_ENCODER,
+      audio_encoder_roles, G_N_ELEMENTS (audio_encoder_roles)}
+};
+
+/* One output buffer of a replayed trace */
+typedef struct
+{
+  guint32 service_time; /* us */
+  guint32 filled_len;
+  guint32 flags;
+  /* Output settings changed before this buffer */
+  gboolean settings_changed;
+} FakeTraceFrame;
+
+typedef struct
+{
+  gint latency;
+  gint jitter;
+  gint in_buffers;
+  gint out_buffers;
+  gint width;
+  gint height;
+  gint stride_align;
+  gint slice_height_align;
+  gint port_settings_changed_interval;
+  gint compression_ratio;
+  gint gop;
+  /* FakeTraceFrames, NULL if no trace is replayed */
+  GArray *trace;
+} FakeConfig;
+
+typedef struct
+{
+  OMX_PARAM_PORTDEFINITIONTYPE def;
+
+  /* All buffer headers of the port */
+  GList *headers;
+  guint n_headers;
+  /* Buffers currently owned by the component */
+  GQueue queue;
+
+  /* Port enable/disable commands waiting for the buffers */
+  gboolean enabling, disabling;
+} FakePort;
+
+typedef struct
+{
+  OMX_COMMANDTYPE cmd;
+  OMX_U32 param;
+} FakeCommand;
+
+typedef struct
+{
+  OMX_COMPONENTTYPE *handle;
+  const FakeComponentInfo *info;
+  const FakeRole *role;
+  FakeConfig config;
+
+  OMX_CALLBACKTYPE callbacks;
+  OMX_PTR app_data;
+
+  GMutex lock;
+  GCond cond;
+  GThread *thread;
+  gboolean quit;
+
+  /* FakeCommands, run by the thread */
+  GQueue commands;
+
+  OMX_STATETYPE state;
+  /* Target of the current state transition if in_transition */
+  OMX_STATETYPE target_state;
+  gboolean in_transition;
+
+  FakePort ports[FAKE_N_PORTS];
+
+  /* Parameters and configs that are only stored, OMX_INDEXTYPE
+   * and port index to a copy of the structure */
+  GHashTable *params;
+
+  guint64 frames;
+  /* Output port has to be reconfigured before going on */
+  gboolean settings_changed;
+  guint64 settings_changed_frame;
+} FakeComponent;
+
+G_LOCK_DEFINE_STATIC (core);
+static gint core_refcount = 0;
+static GKeyFile *core_config = NULL;
+
+static gint
+fake_config_get (const gchar * group, const gchar * key, gint def)
+{
+  GError *err = NULL;
+  gint val;
+
+  if (!core_config)
+    return def;
+
+  val = g_key_file_get_integer (core_config, group, key, &err);
+  if (!err)
+    return val;
+  g_clear_error (&err);
+
+  val = g_key_file_get_integer (core_config, "default", key, &err);
+  if (!err)
+    return val;
+  g_clear_error (&err);
+
+  return def;
+}
+
+static gchar *
+fake_config_get_string (const gchar * group, const gchar * key)
+{
+  gchar *val;
+
+  if (!core_config)
+    return NULL;
+
+  if ((val = g_key_file_get_string (core_config, group, key, NULL)))
+    return val;
+
+  return g_key_file_get_string (core_config, "default", key, NULL);
+}
+
+static gint
+fake_trace_event_compare (gconstpointer a, gconstpointer b)
+{
+  const GstOMXFlightEvent *ev_a = a, *ev_b = b;
+
+  if (ev_a->time < ev_b->time)
+    return -1;
+  else if (ev_a->time > ev_b->time)
+    return 1;
+  return 0;
+}
+
+/* Turns the events of a trace file into the service time of every
+ * output buffer, assuming that the component processes one buffer
+ * at a time in order. Output buffer k then finishes at
+ * MAX (input k arrived, output k-1 finished) + service time k */
+static GArray *
+fake_trace_load (const gchar * filename)
+{
+  GstOMXTraceHeader header;
+  GstOMXFlightEvent *events;
+  GArray *inputs, *frames;
+  gchar *contents;
+  gsize length, n_events, i, next_input = 0;
+  guint64 last_done = 0;
+  gboolean settings_changed = FALSE;
+  GError *err = NULL;
+
+  if (!g_file_get_contents (filename, &contents, &length, &err)) {
+    g_printerr ("omxfakecore: Failed to load trace '%s': %s\n", filename,
+        err->message);
+    g_clear_error (&err);
+    return NULL;
+  }
+
+  if (length < sizeof (header)) {
+    g_printerr ("omxfakecore: '%s' is not a trace\n", filename);
+    g_free (contents);
+    return NULL;
+  }
+  memcpy (&header, contents, sizeof (header));
+  if (memcmp (header.magic, GST_OMX_TRACE_MAGIC, sizeof (header.magic)) != 0
+      || header.version != GST_OMX_TRACE_VERSION
+      || header.event_size != sizeof (GstOMXFlightEvent)) {
+    g_printerr ("omxfakecore: '%s' is not a trace or has an unsupported "
+        "version\n", filename);
+    g_free (contents);
+    return NULL;
+  }
+
+  /* Copied for the alignment */
+  n_events = (length - sizeof (header)) / sizeof (GstOMXFlightEvent);
+  events = g_new (GstOMXFlightEvent, MAX (n_events, 1));
+  memcpy (events, contents + sizeof (header),
+      n_events * sizeof (GstOMXFlightEvent));
+  g_free (contents);
+
+  /* Events are written in call order, which can differ slightly
+   * from the order of their timestamps */
+  qsort (events, n_events, sizeof (GstOMXFlightEvent),
+      fake_trace_event_compare);
+
+  inputs = g_array_new (FALSE, FALSE, sizeof (guint64));
+  for (i = 0; i < n_events; i++) {
+    if (events[i].type == GST_OMX_FLIGHT_EVENT_EMPTY_THIS_BUFFER
+        && events[i].data3 > 0
+        && !(events[i].data2 & OMX_BUFFERFLAG_CODECCONFIG))
+      g_array_append_val (inputs, events[i].time);
+  }
+
+  frames = g_array_new (FALSE, TRUE, sizeof (FakeTraceFrame));
+  for (i = 0; i < n_events; i++) {
+    const GstOMXFlightEvent *ev = &events[i];
+    FakeTraceFrame frame;
+    guint64 start;
+
+    if (ev->type == GST_OMX_FLIGHT_EVENT_CALLBACK
+        && ev->data1 == OMX_EventPortSettingsChanged) {
+      settings_changed = TRUE;
+      continue;
+    }
+
+    if (ev->type != GST_OMX_FLIGHT_EVENT_FILL_BUFFER_DONE || ev->data3 == 0)
+      continue;
+
+    start = last_done;
+    if (next_input < inputs->len)
+      start = MAX (start, g_array_index (inputs, guint64, next_input));
+    next_input++;
+
+    frame.service_time = ev->time > start ? (ev->time - start) / 1000 : 0;
+    frame.filled_len = ev->data3;
+    frame.flags = ev->data2 & ~OMX_BUFFERFLAG_EOS;
+    frame.settings_changed = settings_changed;
+    g_array_append_val (frames, frame);
+
+    settings_changed = FALSE;
+    last_done = ev->time;
+  }
+
+  g_array_unref (inputs);
+  g_free (events);
+
+  if (frames->len == 0) {
+    g_printerr ("omxfakecore: Trace '%s' contains no output buffers\n",
+        filename);
+    g_array_unref (frames);
+    return NULL;
+  }
+
+  return frames;
+}
+
+static void
+fake_config_load (FakeConfig * config, const FakeComponentInfo * info)
+{
+  gchar *trace;
+  const gchar *group = info->name + strlen (FAKE_COMPONENT_PREFIX);
+  gboolean video = (info->kind != FAKE_AUDIO_ENCODER);
+
+  G_LOCK (core);
+  config->latency = MAX (fake_config_get (group, "latency", 0), 0);
+  config->jitter = MAX (fake_config_get (group, "jitter", 0), 0);
+  config->in_buffers = CLAMP (fake_config_get (group, "in-buffers",
+          video ? 4 : 2), 1, 64);
+  config->out_buffers = CLAMP (fake_config_get (group, "out-buffers",
+          video ? 4 : 2), 1, 64);
+  config->width = MAX (fake_config_get (group, "width", 0), 0);
+  config->height = MAX (fake_config_get (group, "height", 0), 0);
+  config->stride_align = MAX (fake_config_get (group, "stride-align", 16), 1);
+  config->slice_height_align =
+      MAX (fake_config_get (group, "slice-height-align", 16), 1);
+  config->port_settings_changed_interval =
+      MAX (fake_config_get (group, "port-settings-changed-interval", 0), 0);
+  config->compression_ratio =
+      MAX (fake_config_get (group, "compression-ratio", 10), 1);
+  config->gop = MAX (fake_config_get (group, "gop", 30), 1);
+  trace = fake_config_get_string (group, "trace");
+  G_UNLOCK (core);
+
+  config->trace = trace && *trace ? fake_trace_load (trace) : NULL;
+  g_free (trace);
+}
+
+static OMX_U32
+fake_round_up (OMX_U32 val, OMX_U32 align)
+{
+  return ((val + align - 1) / align) * align;
+}
+
+static gboolean
+fake_port_is_raw (FakeComponent * comp, FakePort * port)
+{
+  if (comp->info->kind == FAKE_VIDEO_DECODER)
+    return port->def.nPortIndex == FAKE_OUT_PORT;
+  else
+    return port->def.nPortIndex == FAKE_IN_PORT;
+}
+
+/* Pads stride and slice height like a hardware codec would and
+ * updates the buffer size accordingly */
+static void
+fake_port_update_size (FakeComponent * comp, FakePort * port)
+{
+  OMX_VIDEO_PORTDEFINITIONTYPE *video = &port->def.format.video;
+
+  if (comp->info->kind == FAKE_AUDIO_ENCODER)
+    return;
+
+  if (fake_port_is_raw (comp, port)) {
+    video->nStride =
+        fake_round_up (MAX ((OMX_S32) video->nFrameWidth, video->nStride),
+        comp->config.stride_align);
+    video->nSliceHeight =
+        fake_round_up (MAX (video->nFrameHeight, video->nSliceHeight),
+        comp->config.slice_height_align);
+    port->def.nBufferSize =
+        MAX (video->nStride * video->nSliceHeight * 3 / 2, 1);
+  } else {
+    port->def.nBufferSize = MAX (port->def.nBufferSize, 1);
+  }
+}
+
+static void
+fake_port_init (FakeComponent * comp, FakePort * port, OMX_U32 index)
+{
+  FAKE_INIT_STRUCT (&port->def);
+  port->def.nPortIndex = index;
+  port->def.eDir = (index == FAKE_IN_PORT) ? OMX_DirInput : OMX_DirOutput;
+  port->def.nBufferCountMin = (index == FAKE_IN_PORT) ?
+      comp->config.in_buffers : comp->config.out_buffers;
+  port->def.nBufferCountActual = port->def.nBufferCountMin;
+  port->def.bEnabled = OMX_TRUE;
+  port->def.bPopulated = OMX_FALSE;
+
+  if (comp->info->kind == FAKE_AUDIO_ENCODER) {
+    port->def.eDomain = OMX_PortDomainAudio;
+    port->def.format.audio.eEncoding =
+        (index == FAKE_IN_PORT) ? OMX_AUDIO_CodingPCM : OMX_AUDIO_CodingAAC;
+    port->def.nBufferSize = 8192;
+  } else {
+    OMX_VIDEO_PORTDEFINITIONTYPE *video = &port->def.format.video;
+
+    port->def.eDomain = OMX_PortDomainVideo;
+    video->nFrameWidth = comp->config.width ? comp->config.width : 176;
+    video->nFrameHeight = comp->config.height ? comp->config.height : 144;
+    video->xFramerate = 30 << 16;
+    if (fake_port_is_raw (comp, port)) {
+      video->eCompressionFormat = OMX_VIDEO_CodingUnused;
+      video->eColorFormat = OMX_COLOR_FormatYUV420PackedPlanar;
+    } else {
+      video->eCompressionFormat = OMX_VIDEO_CodingAVC;
+      video->eColorFormat = OMX_COLOR_FormatUnused;
+      port->def.nBufferSize = 512 * 1024;
+    }
+    fake_port_update_size (comp, port);
+  }
+
+  g_queue_init (&port->queue);
+}
+
+static FakePort *
+fake_component_get_port (FakeComponent * comp, OMX_U32 index)
+{
+  if (index >= FAKE_N_PORTS)
+    return NULL;
+
+  return &comp->ports[index];
+}
+
+static void
+fake_component_set_role (FakeComponent * comp, const FakeRole * role)
+{
+  comp->role = role;
+
+  if (comp->info->kind == FAKE_VIDEO_DECODER)
+    comp->ports[FAKE_IN_PORT].def.format.video.eCompressionFormat =
+        role->video_coding;
+  else if (comp->info->kind == FAKE_VIDEO_ENCODER)
+    comp->ports[FAKE_OUT_PORT].def.format.video.eCompressionFormat =
+        role->video_coding;
+}
+
+/* NOTE: Must be called with comp->lock, releases it while
+ * the client handles the callback */
+static void
+fake_component_event (FakeComponent * comp, OMX_EVENTTYPE event,
+    OMX_U32 data1, OMX_U32 data2)
+{
+  if (!comp->callbacks.EventHandler)
+    return;
+
+  g_mutex_unlock (&comp->lock);
+  comp->callbacks.EventHandler (comp->handle, comp->app_data, event, data1,
+      data2, NULL);
+  g_mutex_lock (&comp->lock);
+}
+
+/* NOTE: Must be called with comp->lock, releases it while
+ * the client handles the callback */
+static void
+fake_component_return_buffer (FakeComponent * comp, FakePort * port,
+    OMX_BUFFERHEADERTYPE * buf)
+{
+  g_mutex_unlock (&comp->lock);
+  if (port->def.eDir == OMX_DirInput) {
+    if (comp->callbacks.EmptyBufferDone)
+      comp->callbacks.EmptyBufferDone (comp->handle, comp->app_data, buf);
+  } else {
+    if (comp->callbacks.FillBufferDone)
+      comp->callbacks.FillBufferDone (comp->handle, comp->app_data, buf);
+  }
+  g_mutex_lock (&comp->lock);
+}
+
+/* NOTE: Must be called with comp->lock */
+static void
+fake_port_return_all (FakeComponent * comp, FakePort * port)
+{
+  OMX_BUFFERHEADERTYPE *buf;
+
+  while ((buf = g_queue_pop_head (&port->queue))) {
+    if (port->def.eDir == OMX_DirOutput)
+      buf->nFilledLen = 0;
+    fake_component_return_buffer (comp, port, buf);
+  }
+}
+
+/* NOTE: Must be called with comp->lock */
+static void
+fake_component_start_command (FakeComponent * comp, FakeCommand * cmd)
+{
+  guint i;
+
+  switch (cmd->cmd) {
+    case OMX_CommandStateSet:{
+      OMX_STATETYPE target = cmd->param;
+      OMX_STATETYPE state = comp->state;
+      gboolean valid;
+
+      if (target == state) {
+        fake_component_event (comp, OMX_EventError, OMX_ErrorSameState, 0);
+        break;
+      }
+
+      switch (target) {
+        case OMX_StateLoaded:
+          valid = (state == OMX_StateIdle);
+          break;
+        case OMX_StateIdle:
+          valid = (state == OMX_StateLoaded || state == OMX_StateExecuting
+              || state == OMX_StatePause);
+          break;
+        case OMX_StateExecuting:
+        case OMX_StatePause:
+          valid = (state == OMX_StateIdle || state == OMX_StateExecuting
+              || state == OMX_StatePause);
+          break;
+        default:
+          valid = FALSE;
+          break;
+      }
+
+      if (!valid) {
+        fake_component_event (comp, OMX_EventError,
+            OMX_ErrorIncorrectStateTransition, 0);
+        break;
+      }
+
+      if (target == OMX_StateIdle && state != OMX_StateLoaded) {
+        /* Return all buffers before going to Idle */
+        for (i = 0; i < FAKE_N_PORTS; i++)
+          fake_port_return_all (comp, &comp->ports[i]);
+        comp->settings_changed = FALSE;
+      }
+
+      if (target == OMX_StateLoaded || target == OMX_StateIdle) {
+        /* Completed once the buffers are (de)allocated */
+        comp->target_state = target;
+        comp->in_transition = (target == OMX_StateLoaded
+            || state == OMX_StateLoaded);
+        if (comp->in_transition)
+          break;
+      }
+
+      comp->state = target;
+      fake_component_event (comp, OMX_EventCmdComplete, OMX_CommandStateSet,
+          target);
+      break;
+    }
+    case OMX_CommandFlush:
+      for (i = 0; i < FAKE_N_PORTS; i++) {
+        if (cmd->param != OMX_ALL && cmd->param != i)
+          continue;
+
+        fake_port_return_all (comp, &comp->ports[i]);
+        fake_component_event (comp, OMX_EventCmdComplete, OMX_CommandFlush, i);
+      }
+      break;
+    case OMX_CommandPortDisable:
+      for (i = 0; i < FAKE_N_PORTS; i++) {
+        FakePort *port = &comp->ports[i];
+
+        if (cmd->param != OMX_ALL && cmd->param != i)
+          continue;
+
+        port->def.bEnabled = OMX_FALSE;
+        port->enabling = FALSE;
+        port->disabling = TRUE;
+        fake_port_return_all (comp, port);
+      }
+      break;
+    case OMX_CommandPortEnable:
+      for (i = 0; i < FAKE_N_PORTS; i++) {
+        FakePort *port = &comp->ports[i];
+
+        if (cmd->param != OMX_ALL && cmd->param != i)
+          continue;
+
+        port->def.bEnabled = OMX_TRUE;
+        port->disabling = FALSE;
+        port->enabling = TRUE;
+      }
+      break;
+    default:
+      fake_component_event (comp, OMX_EventError, OMX_ErrorUnsupportedSetting,
+          0);
+      break;
+  }
+}
+
+/* NOTE: Must be called with comp->lock
+ *
+ * Completes state transitions and port enabling/disabling
+ * once all buffers were allocated or freed */
+static gboolean
+fake_component_check_pending (FakeComponent * comp)
+{
+  guint i;
+
+  if (comp->in_transition) {
+    gboolean done = TRUE;
+
+    for (i = 0; i < FAKE_N_PORTS; i++) {
+      FakePort *port = &comp->ports[i];
+
+      if (comp->target_state == OMX_StateIdle && port->def.bEnabled
+          && !port->def.bPopulated)
+        done = FALSE;
+      else if (comp->target_state == OMX_StateLoaded && port->n_headers > 0)
+        done = FALSE;
+    }
+
+    if (done) {
+      comp->state = comp->target_state;
+      comp->in_transition = FALSE;
+      fake_component_event (comp, OMX_EventCmdComplete, OMX_CommandStateSet,
+          comp->state);
+      return TRUE;
+    }
+  }
+
+  for (i = 0; i < FAKE_N_PORTS; i++) {
+    FakePort *port = &comp->ports[i];
+
+    if (port->enabling && (comp->state == OMX_StateLoaded
+            || port->def.bPopulated)) {
+      port->enabling = FALSE;
+      if (i == FAKE_OUT_PORT)
+        comp->settings_changed = FALSE;
+      fake_component_event (comp, OMX_EventCmdComplete, OMX_CommandPortEnable,
+          i);
+      return TRUE;
+    } else if (port->disabling && port->n_headers == 0) {
+      port->disabling = FALSE;
+      fake_component_event (comp, OMX_EventCmdComplete,
+          OMX_CommandPortDisable, i);
+      return TRUE;
+    }
+  }
+
+  return FALSE;
+}
+
+/* NOTE: Must be called with comp->lock
+ *
+ * Returns the traced output buffer the next output buffer is
+ * modelled after, NULL if no trace is replayed */
+static const FakeTraceFrame *
+fake_component_trace_frame (FakeComponent * comp)
+{
+  GArray *trace = comp->config.trace;
+
+  if (!trace)
+    return NULL;
+
+  return &g_array_index (trace, FakeTraceFrame, comp->frames % trace->len);
+}
+
+/* NOTE: Must be called with comp->lock
+ *
+ * Signals new output settings if the output port does not match the
+ * input yet, or every port-settings-changed-interval frames or where
+ * the replayed trace had them. Nothing is processed anymore until the
+ * client reconfigured the output port */
+static gboolean
+fake_decoder_check_settings (FakeComponent * comp)
+{
+  FakePort *out = &comp->ports[FAKE_OUT_PORT];
+  OMX_VIDEO_PORTDEFINITIONTYPE *in_video =
+      &comp->ports[FAKE_IN_PORT].def.format.video;
+  OMX_VIDEO_PORTDEFINITIONTYPE *out_video = &out->def.format.video;
+  OMX_U32 width, height;
+  const FakeTraceFrame *frame = fake_component_trace_frame (comp);
+  guint interval = comp->config.port_settings_changed_interval;
+  gboolean due;
+
+  width = comp->config.width ? comp->config.width : in_video->nFrameWidth;
+  height = comp->config.height ? comp->config.height : in_video->nFrameHeight;
+  if (width == 0 || height == 0)
+    return FALSE;
+
+  if (frame)
+    due = frame->settings_changed;
+  else
+    due = interval != 0 && comp->frames != 0 && comp->frames % interval == 0;
+
+  if (out_video->nFrameWidth == width && out_video->nFrameHeight == height
+      && (!due || comp->frames == comp->settings_changed_frame))
+    return FALSE;
+
+  out_video->nFrameWidth = width;
+  out_video->nFrameHeight = height;
+  out_video->nStride = 0;
+  out_video->nSliceHeight = 0;
+  fake_port_update_size (comp, out);
+
+  comp->settings_changed = TRUE;
+  comp->settings_changed_frame = comp->frames;
+  fake_component_event (comp, OMX_EventPortSettingsChanged, FAKE_OUT_PORT,
+      OMX_IndexParamPortDefinition);
+
+  return TRUE;
+}
+
+static gboolean
+fake_port_is_usable (FakePort * port)
+{
+  return port->def.bEnabled && !port->enabling && !port->disabling;
+}
+
+/* NOTE: Must be called with comp->lock
+ *
+ * Handles the next input buffer if possible */
+static gboolean
+fake_component_process (FakeComponent * comp)
+{
+  FakePort *in = &comp->ports[FAKE_IN_PORT];
+  FakePort *out = &comp->ports[FAKE_OUT_PORT];
+  OMX_BUFFERHEADERTYPE *inbuf, *outbuf;
+  const FakeTraceFrame *frame;
+  gint latency;
+  gboolean eos;
+
+  if (comp->state != OMX_StateExecuting || comp->in_transition)
+    return FALSE;
+
+  if (!fake_port_is_usable (in) || !(inbuf = g_queue_peek_head (&in->queue)))
+    return FALSE;
+
+  eos = (inbuf->nFlags & OMX_BUFFERFLAG_EOS) != 0;
+
+  /* Codec data and empty buffers don't produce any output */
+  if (!eos && (inbuf->nFilledLen == 0
+          || (inbuf->nFlags & OMX_BUFFERFLAG_CODECCONFIG))) {
+    g_queue_pop_head (&in->queue);
+    inbuf->nFilledLen = 0;
+    inbuf->nOffset = 0;
+    fake_component_return_buffer (comp, in, inbuf);
+    return TRUE;
+  }
+
+  if (comp->settings_changed || !fake_port_is_usable (out))
+    return FALSE;
+
+  if (comp->info->kind == FAKE_VIDEO_DECODER
+      && fake_decoder_check_settings (comp))
+    return TRUE;
+
+  if (!(outbuf = g_queue_peek_head (&out->queue)))
+    return FALSE;
+
+  g_queue_pop_head (&in->queue);
+  g_queue_pop_head (&out->queue);
+
+  frame = fake_component_trace_frame (comp);
+  if (frame) {
+    latency = frame->service_time;
+  } else {
+    latency = comp->config.latency;
+    if (comp->config.jitter > 0)
+      latency += g_random_int_range (-comp->config.jitter,
+          comp->config.jitter + 1);
+  }
+
+  if (latency > 0) {
+    g_mutex_unlock (&comp->lock);
+    g_usleep (latency);
+    g_mutex_lock (&comp->lock);
+  }
+
+  outbuf->nOffset = 0;
+  outbuf->nFlags = inbuf->nFlags & OMX_BUFFERFLAG_EOS;
+  outbuf->nTimeStamp = inbuf->nTimeStamp;
+  outbuf->nTickCount = inbuf->nTickCount;
+
+  if (inbuf->nFilledLen == 0) {
+    outbuf->nFilledLen = 0;
+  } else if (frame) {
+    outbuf->nFilledLen = frame->filled_len;
+    outbuf->nFlags |= frame->flags;
+  } else if (comp->info->kind == FAKE_VIDEO_DECODER) {
+    outbuf->nFilledLen = out->def.nBufferSize;
+    outbuf->nFlags |= OMX_BUFFERFLAG_ENDOFFRAME;
+  } else {
+    outbuf->nFilledLen =
+        MAX (inbuf->nFilledLen / comp->config.compression_ratio, 1);
+    if (comp->frames % comp->config.gop == 0)
+      outbuf->nFlags |= OMX_BUFFERFLAG_SYNCFRAME;
+    outbuf->nFlags |= OMX_BUFFERFLAG_ENDOFFRAME;
+  }
+  outbuf->nFilledLen = MIN (outbuf->nFilledLen, outbuf->nAllocLen);
+
+  if (inbuf->nFilledLen > 0)
+    comp->frames++;
+
+  inbuf->nFilledLen = 0;
+  inbuf->nOffset = 0;
+
+  fake_component_return_buffer (comp, in, inbuf);
+  fake_component_return_buffer (comp, out, outbuf);
+
+  if (eos)
+    fake_component_event (comp, OMX_EventBufferFlag, FAKE_OUT_PORT,
+        OMX_BUFFERFLAG_EOS);
+
+  return TRUE;
+}
+
+static gpointer
+fake_component_thread (gpointer data)
+{
+  FakeComponent *comp = data;
+
+  g_mutex_lock (&comp->lock);
+  while (!comp->quit) {
+    FakeCommand *cmd;
+
+    if ((cmd = g_queue_pop_head (&comp->commands))) {
+      fake_component_start_command (comp, cmd);
+      g_slice_free (FakeCommand, cmd);
+      continue;
+    }
+
+    if (fake_component_check_pending (comp))
+      continue;
+
+    if (fake_component_process (comp))
+      continue;
+
+    g_cond_wait (&comp->cond, &comp->lock);
+  }
+  g_mutex_unlock (&comp->lock);
+
+  return NULL;
+}
+
+#define FAKE_COMPONENT(handle) \
+    ((FakeComponent *) ((OMX_COMPONENTTYPE *) (handle))->pComponentPrivate)
+
+static OMX_ERRORTYPE
+fake_get_component_version (OMX_HANDLETYPE handle, OMX_STRING name,
+    OMX_VERSIONTYPE * comp_version, OMX_VERSIONTYPE * spec_version,
+    OMX_UUIDTYPE * uuid)
+{
+  FakeComponent *comp = FAKE_COMPONENT (handle);
+
+  if (name)
+    g_strlcpy (name, comp->info->name, OMX_MAX_STRINGNAME_SIZE);
+  if (comp_version)
+    comp_version->nVersion = 0;
+  if (spec_version) {
+    spec_version->s.nVersionMajor = OMX_VERSION_MAJOR;
+    spec_version->s.nVersionMinor = OMX_VERSION_MINOR;
+    spec_version->s.nRevision = OMX_VERSION_REVISION;
+    spec_version->s.nStep = OMX_VERSION_STEP;
+  }
+  if (uuid)
+    memset (uuid, 0, sizeof (OMX_UUIDTYPE));
+
+  return OMX_ErrorNone;
+}
+
+static OMX_ERRORTYPE
+fake_send_command (OMX_HANDLETYPE handle, OMX_COMMANDTYPE cmd,
+    OMX_U32 param, OMX_PTR cmd_data)
+{
+  FakeComponent *comp = FAKE_COMPONENT (handle);
+  FakeCommand *command;
+
+  if ((cmd == OMX_CommandFlush || cmd == OMX_CommandPortDisable
+          || cmd == OMX_CommandPortEnable) && param != OMX_ALL
+      && param >= FAKE_N_PORTS)
+    return OMX_ErrorBadPortIndex;
+
+  command = g_slice_new (FakeCommand);
+  command->cmd = cmd;
+  command->param = param;
+
+  g_mutex_lock (&comp->lock);
+  g_queue_push_tail (&comp->commands, command);
+  g_cond_signal (&comp->cond);
+  g_mutex_unlock (&comp->lock);
+
+  return OMX_ErrorNone;
+}
+
+static guint
+fake_param_key (OMX_INDEXTYPE index, OMX_U32 port)
+{
+  return (((guint) index) << 1) | (port & 1);
+}
+
+/* NOTE: Must be called with comp->lock */
+static void
+fake_component_store (FakeComponent * comp, OMX_INDEXTYPE index,
+    OMX_PTR param)
+{
+  /* nSize, nVersion, nPortIndex */
+  OMX_U32 size = *(OMX_U32 *) param;
+  OMX_U32 port = ((OMX_U32 *) param)[2];
+
+  g_hash_table_insert (comp->params,
+      GUINT_TO_POINTER (fake_param_key (index, port)), g_memdup2 (param, size));
+}
+
+/* NOTE: Must be called with comp->lock
+ *
+ * Parameters that were never set are all zero */
+static void
+fake_component_lookup (FakeComponent * comp, OMX_INDEXTYPE index,
+    OMX_PTR param)
+{
+  OMX_U32 size = *(OMX_U32 *) param;
+  OMX_U32 port = ((OMX_U32 *) param)[2];
+  gpointer stored;
+
+  stored = g_hash_table_lookup (comp->params,
+      GUINT_TO_POINTER (fake_param_key (index, port)));
+  if (stored) {
+    memcpy (param, stored, MIN (size, *(OMX_U32 *) stored));
+    *(OMX_U32 *) param = size;
+  } else if (size > 3 * sizeof (OMX_U32)) {
+    memset (((OMX_U32 *) param) + 3, 0, size - 3 * sizeof (OMX_U32));
+  }
+}
+
+static OMX_ERRORTYPE
+fake_get_parameter (OMX_HANDLETYPE handle, OMX_INDEXTYPE index,
+    OMX_PTR param)
+{
+  FakeComponent *comp = FAKE_COMPONENT (handle);
+  OMX_ERRORTYPE err = OMX_ErrorNone;
+
+  if (!param)
+    return OMX_ErrorBadParameter;
+
+  g_mutex_lock (&comp->lock);
+  switch (index) {
+    case OMX_IndexParamPortDefinition:{
+      OMX_PARAM_PORTDEFINITIONTYPE *def = param;
+      FakePort *port = fake_component_get_port (comp, def->nPortIndex);
+
+      if (!port) {
+        err = OMX_ErrorBadPortIndex;
+        break;
+      }
+      memcpy (def, &port->def, MIN (def->nSize, sizeof (*def)));
+      break;
+    }
+    case OMX_IndexParamVideoPortFormat:{
+      OMX_VIDEO_PARAM_PORTFORMATTYPE *format = param;
+      FakePort *port = fake_component_get_port (comp, format->nPortIndex);
+
+      if (!port || comp->info->kind == FAKE_AUDIO_ENCODER) {
+        err = OMX_ErrorBadPortIndex;
+        break;
+      }
+
+      format->xFramerate = port->def.format.video.xFramerate;
+      if (fake_port_is_raw (comp, port)) {
+        static const OMX_COLOR_FORMATTYPE formats[] = {
+          OMX_COLOR_FormatYUV420PackedPlanar, OMX_COLOR_FormatYUV420SemiPlanar
+        };
+
+        if (format->nIndex >= G_N_ELEMENTS (formats)) {
+          err = OMX_ErrorNoMore;
+          break;
+        }
+        format->eCompressionFormat = OMX_VIDEO_CodingUnused;
+        format->eColorFormat = formats[format->nIndex];
+      } else {
+        if (format->nIndex > 0) {
+          err = OMX_ErrorNoMore;
+          break;
+        }
+        format->eCompressionFormat = port->def.format.video.eCompressionFormat;
+        format->eColorFormat = OMX_COLOR_FormatUnused;
+      }
+      break;
+    }
+    case OMX_IndexParamStandardComponentRole:{
+      OMX_PARAM_COMPONENTROLETYPE *role = param;
+
+      g_strlcpy ((gchar *) role->cRole, comp->role->role,
+          OMX_MAX_STRINGNAME_SIZE);
+      break;
+    }
+    case OMX_IndexParamVideoInit:
+    case OMX_IndexParamAudioInit:{
+      OMX_PORT_PARAM_TYPE *ports = param;
+
+      if ((index == OMX_IndexParamAudioInit) ==
+          (comp->info->kind == FAKE_AUDIO_ENCODER)) {
+        ports->nPorts = FAKE_N_PORTS;
+        ports->nStartPortNumber = 0;
+      } else {
+        ports->nPorts = 0;
+        ports->nStartPortNumber = 0;
+      }
+      break;
+    }
+    case OMX_IndexParamAudioAac:
+    case OMX_IndexParamAudioPcm:
+    case OMX_IndexParamVideoAvc:
+    case OMX_IndexParamVideoMpeg4:
+    case OMX_IndexParamVideoH263:
+    case OMX_IndexParamVideoProfileLevelCurrent:
+    case OMX_IndexParamVideoBitrate:
+    case OMX_IndexParamVideoQuantization:
+      fake_component_lookup (comp, index, param);
+      break;
+    default:
+      err = OMX_ErrorUnsupportedIndex;
+      break;
+  }
+  g_mutex_unlock (&comp->lock);
+
+  return err;
+}
+
+static OMX_ERRORTYPE
+fake_set_parameter (OMX_HANDLETYPE handle, OMX_INDEXTYPE index,
+    OMX_PTR param)
+{
+  FakeComponent *comp = FAKE_COMPONENT (handle);
+  OMX_ERRORTYPE err = OMX_ErrorNone;
+
+  if (!param)
+    return OMX_ErrorBadParameter;
+
+  g_mutex_lock (&comp->lock);
+  switch (index) {
+    case OMX_IndexParamPortDefinition:{
+      OMX_PARAM_PORTDEFINITIONTYPE *def = param;
+      FakePort *port = fake_component_get_port (comp, def->nPortIndex);
+
+      if (!port) {
+        err = OMX_ErrorBadPortIndex;
+        break;
+      }
+      if (def->nBufferCountActual < port->def.nBufferCountMin) {
+        err = OMX_ErrorBadParameter;
+        break;
+      }
+
+      /* Only the fields a client is allowed to change */
+      port->def.nBufferCountActual = def->nBufferCountActual;
+      port->def.nBufferSize = def->nBufferSize;
+      if (port->def.eDomain == OMX_PortDomainVideo) {
+        OMX_VIDEO_PORTDEFINITIONTYPE *video = &port->def.format.video;
+
+        video->nFrameWidth = def->format.video.nFrameWidth;
+        video->nFrameHeight = def->format.video.nFrameHeight;
+        video->nStride = def->format.video.nStride;
+        video->nSliceHeight = def->format.video.nSliceHeight;
+        video->nBitrate = def->format.video.nBitrate;
+        video->xFramerate = def->format.video.xFramerate;
+        video->eCompressionFormat = def->format.video.eCompressionFormat;
+        video->eColorFormat = def->format.video.eColorFormat;
+        fake_port_update_size (comp, port);
+      } else {
+        port->def.format.audio.eEncoding = def->format.audio.eEncoding;
+        port->def.nBufferSize = MAX (port->def.nBufferSize, 1);
+      }
+      break;
+    }
+    case OMX_IndexParamVideoPortFormat:{
+      OMX_VIDEO_PARAM_PORTFORMATTYPE *format = param;
+      FakePort *port = fake_component_get_port (comp, format->nPortIndex);
+
+      if (!port || comp->info->kind == FAKE_AUDIO_ENCODER) {
+        err = OMX_ErrorBadPortIndex;
+        break;
+      }
+
+      port->def.format.video.eCompressionFormat = format->eCompressionFormat;
+      port->def.format.video.eColorFormat = format->eColorFormat;
+      if (format->xFramerate)
+        port->def.format.video.xFramerate = format->xFramerate;
+      break;
+    }
+    case OMX_IndexParamStandardComponentRole:{
+      OMX_PARAM_COMPONENTROLETYPE *role = param;
+      guint i;
+
+      err = OMX_ErrorBadParameter;
+      for (i = 0; i < comp->info->n_roles; i++) {
+        if (strcmp ((const gchar *) role->cRole, comp->info->roles[i].role)
+            == 0) {
+          fake_component_set_role (comp, &comp->info->roles[i]);
+          err = OMX_ErrorNone;
+          break;
+        }
+      }
+      break;
+    }
+    case OMX_IndexParamAudioAac:
+    case OMX_IndexParamAudioPcm:
+    case OMX_IndexParamVideoAvc:
+    case OMX_IndexParamVideoMpeg4:
+    case OMX_IndexParamVideoH263:
+    case OMX_IndexParamVideoProfileLevelCurrent:
+    case OMX_IndexParamVideoBitrate:
+    case OMX_IndexParamVideoQuantization:
+      fake_component_store (comp, index, param);
+      break;
+    default:
+      err = OMX_ErrorUnsupportedIndex;
+      break;
+  }
+  g_mutex_unlock (&comp->lock);
+
+  return err;
+}
+
+/* Configs are only stored */
+static OMX_ERRORTYPE
+fake_get_config (OMX_HANDLETYPE handle, OMX_INDEXTYPE index, OMX_PTR config)
+{
+  FakeComponent *comp = FAKE_COMPONENT (handle);
+
+  if (!config)
+    return OMX_ErrorBadParameter;
+
+  g_mutex_lock (&comp->lock);
+  fake_component_lookup (comp, index, config);
+  g_mutex_unlock (&comp->lock);
+
+  return OMX_ErrorNone;
+}
+
+static OMX_ERRORTYPE
+fake_set_config (OMX_HANDLETYPE handle, OMX_INDEXTYPE index, OMX_PTR config)
+{
+  FakeComponent *comp = FAKE_COMPONENT (handle);
+
+  if (!config)
+    return OMX_ErrorBadParameter;
+
+  g_mutex_lock (&comp->lock);
+  fake_component_store (comp, index, config);
+  g_mutex_unlock (&comp->lock);
+
+  return OMX_ErrorNone;
+}
+
+static OMX_ERRORTYPE
+fake_get_extension_index (OMX_HANDLETYPE handle, OMX_STRING name,
+    OMX_INDEXTYPE * index)
+{
+  return OMX_ErrorUnsupportedIndex;
+}
+
+static OMX_ERRORTYPE
+fake_get_state (OMX_HANDLETYPE handle, OMX_STATETYPE * state)
+{
+  FakeComponent *comp = FAKE_COMPONENT (handle);
+
+  g_mutex_lock (&comp->lock);
+  *state = comp->state;
+  g_mutex_unlock (&comp->lock);
+
+  return OMX_ErrorNone;
+}
+
+static OMX_ERRORTYPE
+fake_component_tunnel_request (OMX_HANDLETYPE handle, OMX_U32 port,
+    OMX_HANDLETYPE tunneled_comp, OMX_U32 tunneled_port,
+    OMX_TUNNELSETUPTYPE * setup)
+{
+  return OMX_ErrorNotImplemented;
+}
+
+static OMX_ERRORTYPE
+fake_add_buffer (OMX_HANDLETYPE handle, OMX_BUFFERHEADERTYPE ** buf_hdr,
+    OMX_U32 port_index, OMX_PTR app_private, OMX_U32 size, OMX_U8 * data)
+{
+  FakeComponent *comp = FAKE_COMPONENT (handle);
+  FakePort *port;
+  OMX_BUFFERHEADERTYPE *buf;
+  OMX_ERRORTYPE err = OMX_ErrorNone;
+
+  if (!buf_hdr)
+    return OMX_ErrorBadParameter;
+
+  g_mutex_lock (&comp->lock);
+  port = fake_component_get_port (comp, port_index);
+  if (!port) {
+    err = OMX_ErrorBadPortIndex;
+    goto done;
+  }
+  if (port->n_headers >= port->def.nBufferCountActual) {
+    err = OMX_ErrorInsufficientResources;
+    goto done;
+  }
+  if (size < port->def.nBufferSize) {
+    err = OMX_ErrorBadParameter;
+    goto done;
+  }
+
+  buf = g_new0 (OMX_BUFFERHEADERTYPE, 1);
+  FAKE_INIT_STRUCT (buf);
+  if (data) {
+    buf->pBuffer = data;
+  } else {
+    buf->pBuffer = g_malloc0 (size);
+    /* Marks the memory as ours */
+    buf->pPlatformPrivate = comp;
+  }
+  buf->nAllocLen = size;
+  buf->pAppPrivate = app_private;
+  if (port->def.eDir == OMX_DirInput) {
+    buf->nInputPortIndex = port_index;
+    buf->nOutputPortIndex = OMX_ALL;
+  } else {
+    buf->nInputPortIndex = OMX_ALL;
+    buf->nOutputPortIndex = port_index;
+  }
+
+  port->headers = g_list_prepend (port->headers, buf);
+  port->n_headers++;
+  if (port->n_headers == port->def.nBufferCountActual) {
+    port->def.bPopulated = OMX_TRUE;
+    g_cond_signal (&comp->cond);
+  }
+  *buf_hdr = buf;
+
+done:
+  g_mutex_unlock (&comp->lock);
+
+  return err;
+}
+
+static OMX_ERRORTYPE
+fake_use_buffer (OMX_HANDLETYPE handle, OMX_BUFFERHEADERTYPE ** buf_hdr,
+    OMX_U32 port_index, OMX_PTR app_private, OMX_U32 size, OMX_U8 * data)
+{
+  if (!data)
+    return OMX_ErrorBadParameter;
+
+  return fake_add_buffer (handle, buf_hdr, port_index, app_private, size,
+      data);
+}
+
+static OMX_ERRORTYPE
+fake_allocate_buffer (OMX_HANDLETYPE handle, OMX_BUFFERHEADERTYPE ** buf_hdr,
+    OMX_U32 port_index, OMX_PTR app_private, OMX_U32 size)
+{
+  return fake_add_buffer (handle, buf_hdr, port_index, app_private, size,
+      NULL);
+}
+
+static void
+fake_buffer_free (FakeComponent * comp, OMX_BUFFERHEADERTYPE * buf)
+{
+  if (buf->pPlatformPrivate == comp)
+    g_free (buf->pBuffer);
+  g_free (buf);
+}
+
+static OMX_ERRORTYPE
+fake_free_buffer (OMX_HANDLETYPE handle, OMX_U32 port_index,
+    OMX_BUFFERHEADERTYPE * buf)
+{
+  FakeComponent *comp = FAKE_COMPONENT (handle);
+  FakePort *port;
+  OMX_ERRORTYPE err = OMX_ErrorNone;
+
+  g_mutex_lock (&comp->lock);
+  port = fake_component_get_port (comp, port_index);
+  if (!port) {
+    err = OMX_ErrorBadPortIndex;
+    goto done;
+  }
+  if (!buf || !g_list_find (port->headers, buf)) {
+    err = OMX_ErrorBadParameter;
+    goto done;
+  }
+
+  g_queue_remove (&port->queue, buf);
+  port->headers = g_list_remove (port->headers, buf);
+  port->n_headers--;
+  port->def.bPopulated = OMX_FALSE;
+  fake_buffer_free (comp, buf);
+  g_cond_signal (&comp->cond);
+
+done:
+  g_mutex_unlock (&comp->lock);
+
+  return err;
+}
+
+static OMX_ERRORTYPE
+fake_queue_buffer (FakeComponent * comp, OMX_BUFFERHEADERTYPE * buf,
+    OMX_U32 port_index)
+{
+  FakePort *port;
+  OMX_ERRORTYPE err = OMX_ErrorNone;
+
+  if (!buf)
+    return OMX_ErrorBadParameter;
+
+  g_mutex_lock (&comp->lock);
+  port = fake_component_get_port (comp, port_index);
+  if (!port) {
+    err = OMX_ErrorBadPortIndex;
+    goto done;
+  }
+  if (comp->state != OMX_StateIdle && comp->state != OMX_StateExecuting
+      && comp->state != OMX_StatePause) {
+    err = OMX_ErrorIncorrectStateOperation;
+    goto done;
+  }
+  if (!port->def.bEnabled) {
+    err = OMX_ErrorIncorrectStateOperation;
+    goto done;
+  }
+
+  g_queue_push_tail (&port->queue, buf);
+  g_cond_signal (&comp->cond);
+
+done:
+  g_mutex_unlock (&comp->lock);
+
+  return err;
+}
+
+static OMX_ERRORTYPE
+fake_empty_this_buffer (OMX_HANDLETYPE handle, OMX_BUFFERHEADERTYPE * buf)
+{
+  return fake_queue_buffer (FAKE_COMPONENT (handle), buf,
+      buf ? buf->nInputPortIndex : FAKE_IN_PORT);
+}
+
+static OMX_ERRORTYPE
+fake_fill_this_buffer (OMX_HANDLETYPE handle, OMX_BUFFERHEADERTYPE * buf)
+{
+  return fake_queue_buffer (FAKE_COMPONENT (handle), buf,
+      buf ? buf->nOutputPortIndex : FAKE_OUT_PORT);
+}
+
+static OMX_ERRORTYPE
+fake_set_callbacks (OMX_HANDLETYPE handle, OMX_CALLBACKTYPE * callbacks,
+    OMX_PTR app_data)
+{
+  FakeComponent *comp = FAKE_COMPONENT (handle);
+
+  if (!callbacks)
+    return OMX_ErrorBadParameter;
+
+  g_mutex_lock (&comp->lock);
+  comp->callbacks = *callbacks;
+  comp->app_data = app_data;
+  g_mutex_unlock (&comp->lock);
+
+  return OMX_ErrorNone;
+}
+
+static OMX_ERRORTYPE
+fake_component_deinit (OMX_HANDLETYPE handle)
+{
+  FakeComponent *comp = FAKE_COMPONENT (handle);
+  FakeCommand *cmd;
+  guint i;
+
+  g_mutex_lock (&comp->lock);
+  comp->quit = TRUE;
+  g_cond_signal (&comp->cond);
+  g_mutex_unlock (&comp->lock);
+
+  g_thread_join (comp->thread);
+
+  while ((cmd = g_queue_pop_head (&comp->commands)))
+    g_slice_free (FakeCommand, cmd);
+
+  for (i = 0; i < FAKE_N_PORTS; i++) {
+    FakePort *port = &comp->ports[i];
+    GList *l;
+
+    g_queue_clear (&port->queue);
+    for (l = port->headers; l; l = l->next)
+      fake_buffer_free (comp, l->data);
+    g_list_free (port->headers);
+  }
+
+  g_hash_table_unref (comp->params);
+  if (comp->config.trace)
+    g_array_unref (comp->config.trace);
+  g_cond_clear (&comp->cond);
+  g_mutex_clear (&comp->lock);
+  g_slice_free (FakeComponent, comp);
+
+  return OMX_ErrorNone;
+}
+
+static OMX_ERRORTYPE
+fake_use_egl_image (OMX_HANDLETYPE handle, OMX_BUFFERHEADERTYPE ** buf_hdr,
+    OMX_U32 port_index, OMX_PTR app_private, void *egl_image)
+{
+  return OMX_ErrorNotImplemented;
+}
+
+static OMX_ERRORTYPE
+fake_component_role_enum (OMX_HANDLETYPE handle, OMX_U8 * role,
+    OMX_U32 index)
+{
+  FakeComponent *comp = FAKE_COMPONENT (handle);
+
+  if (index >= comp->info->n_roles)
+    return OMX_ErrorNoMore;
+
+  g_strlcpy ((gchar *) role, comp->info->roles[index].role,
+      OMX_MAX_STRINGNAME_SIZE);
+
+  return OMX_ErrorNone;
+}
+
+static const FakeComponentInfo *
+fake_component_info_find (const gchar * name)
+{
+  guint i;
+
+  for (i = 0; i < G_N_ELEMENTS (fake_components); i++) {
+    if (strcmp (name, fake_components[i].name) == 0)
+      return &fake_components[i];
+  }
+
+  return NULL;
+}
+
+OMX_API OMX_ERRORTYPE OMX_APIENTRY
+OMX_Init (void)
+{
+  G_LOCK (core);
+  if (core_refcount++ == 0) {
+    const gchar *filename = g_getenv (FAKE_CORE_CONFIG_ENV);
+
+    if (filename && *filename) {
+      GError *err = NULL;
+
+      core_config = g_key_file_new ();
+      if (!g_key_file_load_from_file (core_config, filename, G_KEY_FILE_NONE,
+              &err)) {
+        g_printerr ("omxfakecore: Failed to load '%s': %s\n", filename,
+            err->message);
+        g_clear_error (&err);
+        g_key_file_free (core_config);
+        core_config = NULL;
+      }
+    }
+  }
+  G_UNLOCK (core);
+
+  return OMX_ErrorNone;
+}
+
+OMX_API OMX_ERRORTYPE OMX_APIENTRY
+OMX_Deinit (void)
+{
+  G_LOCK (core);
+  if (core_refcount > 0 && --core_refcount == 0 && core_config) {
+    g_key_file_free (core_config);
+    core_config = NULL;
+  }
+  G_UNLOCK (core);
+
+  return OMX_ErrorNone;
+}
+
+OMX_API OMX_ERRORTYPE OMX_APIENTRY
+OMX_ComponentNameEnum (OMX_STRING name, OMX_U32 length, OMX_U32 index)
+{
+  if (!name || length == 0)
+    return OMX_ErrorBadParameter;
+
+  if (index >= G_N_ELEMENTS (fake_components))
+    return OMX_ErrorNoMore;
+
+  g_strlcpy (name, fake_components[index].name, length);
+
+  return OMX_ErrorNone;
+}
+
+OMX_API OMX_ERRORTYPE OMX_APIENTRY
+OMX_GetHandle (OMX_HANDLETYPE * handle, OMX_STRING name, OMX_PTR app_data,
+    OMX_CALLBACKTYPE * callbacks)
+{
+  const FakeComponentInfo *info;
+  OMX_COMPONENTTYPE *omx;
+  FakeComponent *comp;
+  guint i;
+
+  if (!handle || !name || !callbacks)
+    return OMX_ErrorBadParameter;
+
+  if (!(info = fake_component_info_find (name)))
+    return OMX_ErrorComponentNotFound;
+
+  comp = g_slice_new0 (FakeComponent);
+  comp->info = info;
+  fake_config_load (&comp->config, info);
+  comp->callbacks = *callbacks;
+  comp->app_data = app_data;
+  comp->state = OMX_StateLoaded;
+  g_mutex_init (&comp->lock);
+  g_cond_init (&comp->cond);
+  g_queue_init (&comp->commands);
+  comp->params = g_hash_table_new_full (NULL, NULL, NULL, g_free);
+  for (i = 0; i < FAKE_N_PORTS; i++)
+    fake_port_init (comp, &comp->ports[i], i);
+  fake_component_set_role (comp, &info->roles[0]);
+
+  omx = g_new0 (OMX_COMPONENTTYPE, 1);
+  FAKE_INIT_STRUCT (omx);
+  omx->pComponentPrivate = comp;
+  omx->pApplicationPrivate = app_data;
+  omx->GetComponentVersion = fake_get_component_version;
+  omx->SendCommand = fake_send_command;
+  omx->GetParameter = fake_get_parameter;
+  omx->SetParameter = fake_set_parameter;
+  omx->GetConfig = fake_get_config;
+  omx->SetConfig = fake_set_config;
+  omx->GetExtensionIndex = fake_get_extension_index;
+  omx->GetState = fake_get_state;
+  omx->ComponentTunnelRequest = fake_component_tunnel_request;
+  omx->UseBuffer = fake_use_buffer;
+  omx->AllocateBuffer = fake_allocate_buffer;
+  omx->FreeBuffer = fake_free_buffer;
+  omx->EmptyThisBuffer = fake_empty_this_buffer;
+  omx->FillThisBuffer = fake_fill_this_buffer;
+  omx->SetCallbacks = fake_set_callbacks;
+  omx->ComponentDeInit = fake_component_deinit;
+  omx->UseEGLImage = fake_use_egl_image;
+  omx->ComponentRoleEnum = fake_component_role_enum;
+  comp->handle = omx;
+
+  comp->thread = g_thread_new ("omxfakecore", fake_component_thread, comp);
+
+  *handle = omx;
+
+  return OMX_ErrorNone;
+}
+
+OMX_API OMX_ERRORTYPE OMX_APIENTRY
+OMX_FreeHandle (OMX_HANDLETYPE handle)
+{
+  OMX_COMPONENTTYPE *omx = handle;
+
+  if (!omx)
+    return OMX_ErrorBadParameter;
+
+  fake_component_deinit (omx);
+  g_free (omx);
+
+  return OMX_ErrorNone;
+}
+
+/* Tunneling between the fake components is not supported, the elements
+ * don't use it either */
+OMX_API OMX_ERRORTYPE OMX_APIENTRY
+OMX_SetupTunnel (OMX_HANDLETYPE output, OMX_U32 port_output,
+    OMX_HANDLETYPE input, OMX_U32 port_input)
+{
+  return OMX_ErrorNotImplemented;
+}
+
+OMX_API OMX_ERRORTYPE
+OMX_GetContentPipe (OMX_HANDLETYPE * pipe, OMX_STRING uri)
+{
+  return OMX_ErrorNotImplemented;
+}
+
+OMX_API OMX_ERRORTYPE
+OMX_GetComponentsOfRole (OMX_STRING role, OMX_U32 * n_comps,
+    OMX_U8 ** comp_names)
+{
+  guint i, j, n = 0;
+
+  if (!role || !n_comps)
+    return OMX_ErrorBadParameter;
+
+  for (i = 0; i < G_N_ELEMENTS (fake_components); i++) {
+    for (j = 0; j < fake_components[i].n_roles; j++) {
+      if (strcmp (role, fake_components[i].roles[j].role) != 0)
+        continue;
+
+      if (comp_names && n < *n_comps)
+        g_strlcpy ((gchar *) comp_names[n], fake_components[i].name,
+            OMX_MAX_STRINGNAME_SIZE);
+      n++;
+    }
+  }
+  *n_comps = n;
+
+  return OMX_ErrorNone;
+}
+
+OMX_API OMX_ERRORTYPE
+OMX_GetRolesOfComponent (OMX_STRING name, OMX_U32 * n_roles, OMX_U8 ** roles)
+{
+  const FakeComponentInfo *info;
+  guint i;
+
+  if (!name || !n_roles)
+    return OMX_ErrorBadParameter;
+
+  if (!(info = fake_component_info_find (name)))
+    return OMX_ErrorComponentNotFound;
+
+  if (roles) {
+    for (i = 0; i < MIN (*n_roles, info->n_roles); i++)
+      g_strlcpy ((gchar *) roles[i], info->roles[i].role,
+          OMX_MAX_STRINGNAME_SIZE);
+  }
+  *n_roles = info->n_roles;
+
+  return OMX_ErrorNone;
+}
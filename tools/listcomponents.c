@@ -1,6 +1,7 @@
 /*
  * Copyright (C) 2012 Collabora Ltd.
  *   Author: Sebastian Dröge <sebastian.droege@collabora.co.uk>
+ * Copyright (C) 2026, the gst-omx authors
  *
  * This library is free software; you can redistribute it and/or
  * modify it under the terms of the GNU Lesser General Public
@@ -18,49 +19,793 @@
  *
  */
 
+/* Lists the components of an OpenMAX IL core and their roles.
+ *
+ * With --probe every component is additionally instantiated once per
+ * role: the port definitions, the supported video port formats and
+ * profile/levels are printed and a short throughput test is run.
+ * Encoders get zero-filled raw input, decoders the bitstream passed
+ * with --input for their role, e.g.
+ * --input video_decoder.avc=/path/to/sample.h264. It is fed in chunks
+ * of the input buffer size and repeated for the duration of the test.
+ * Decoders without input are not tested.
+ *
+ * With --conf a gstomx.conf section is written to stdout for every
+ * role that gst-omx has an element for, with template caps restricted
+ * to what the component reported. Components that were measured to be
+ * fast enough get a rank above the default, slower ones are demoted.
+ * All others keep the default rank. Everything else then goes to
+ * stderr.
+ */
+
 #ifdef HAVE_CONFIG_H
 #include "config.h"
 #endif
 
-#include <glib.h>
-#include <gmodule.h>
-
-#ifdef GST_OMX_STRUCT_PACKING
-# if GST_OMX_STRUCT_PACKING == 1
-#  pragma pack(1)
-# elif GST_OMX_STRUCT_PACKING == 2
-#  pragma pack(2)
-# elif GST_OMX_STRUCT_PACKING == 4
-#  pragma pack(4)
-# elif GST_OMX_STRUCT_PACKING == 8
-#  pragma pack(8)
-# else
-#  error "Unsupported struct packing value"
-# endif
-#endif
+#include <stdio.h>
+#include <string.h>
+#include <gst/gst.h>
 
-#include <OMX_Core.h>
-#include <OMX_Component.h>
+#include "gstomx.h"
 
-#ifdef GST_OMX_STRUCT_PACKING
-#pragma pack()
-#endif
+GST_DEBUG_CATEGORY_EXTERN (gstomx_debug);
+
+/* Upper bounds for the enumerations, some components never
+ * return OMX_ErrorNoMore */
+#define PROBE_MAX_FORMATS (64)
+#define PROBE_MAX_PROFILES (64)
+
+typedef enum
+{
+  PROBE_KIND_VIDEO_DECODER,
+  PROBE_KIND_VIDEO_ENCODER,
+  PROBE_KIND_AUDIO_ENCODER
+} ProbeKind;
+
+typedef struct
+{
+  const gchar *role;
+  ProbeKind kind;
+  const gchar *element_name;
+  const gchar *type_name;
+  /* Caps of the compressed side, same as the element's defaults */
+  const gchar *caps;
+} ProbeRoleInfo;
+
+static const ProbeRoleInfo role_infos[] = {
+  {"video_decoder.avc", PROBE_KIND_VIDEO_DECODER, "omxh264dec",
+        "GstOMXH264Dec",
+        "video/x-h264, parsed=(boolean) true, alignment=(string) au, "
+      "stream-format=(string) byte-stream, width=(int) [1,MAX], "
+      "height=(int) [1,MAX]"},
+  {"video_decoder.mpeg4", PROBE_KIND_VIDEO_DECODER, "omxmpeg4videodec",
+        "GstOMXMPEG4VideoDec",
+        "video/mpeg, mpegversion=(int) 4, systemstream=(boolean) false, "
+      "parsed=(boolean) true, width=(int) [1,MAX], height=(int) [1,MAX]"},
+  {"video_decoder.mpeg2", PROBE_KIND_VIDEO_DECODER, "omxmpeg2videodec",
+        "GstOMXMPEG2VideoDec",
+        "video/mpeg, mpegversion=(int) [1, 2], systemstream=(boolean) false, "
+      "parsed=(boolean) true, width=(int) [1,MAX], height=(int) [1,MAX]"},
+  {"video_decoder.h263", PROBE_KIND_VIDEO_DECODER, "omxh263dec",
+        "GstOMXH263Dec",
+        "video/x-h263, variant=(string) itu, parsed=(boolean) true, "
+      "width=(int) [1,MAX], height=(int) [1,MAX]"},
+  {"video_decoder.wmv", PROBE_KIND_VIDEO_DECODER, "omxwmvdec",
+        "GstOMXWMVDec",
+      "video/x-wmv, width=(int) [1,MAX], height=(int) [1,MAX]"},
+  {"video_decoder.mjpeg", PROBE_KIND_VIDEO_DECODER, "omxmjpegdec",
+        "GstOMXMJPEGDec",
+      "image/jpeg, width=(int) [1,MAX], height=(int) [1,MAX]"},
+  {"video_decoder.vp8", PROBE_KIND_VIDEO_DECODER, "omxvp8dec",
+        "GstOMXVP8Dec",
+      "video/x-vp8, width=(int) [1,MAX], height=(int) [1,MAX]"},
+  {"video_decoder.theora", PROBE_KIND_VIDEO_DECODER, "omxtheoradec",
+        "GstOMXTheoraDec",
+      "video/x-theora, width=(int) [1,MAX], height=(int) [1,MAX]"},
+  {"video_encoder.avc", PROBE_KIND_VIDEO_ENCODER, "omxh264enc",
+        "GstOMXH264Enc",
+      "video/x-h264, width=(int) [ 16, 4096 ], height=(int) [ 16, 4096 ]"},
+  {"video_encoder.mpeg4", PROBE_KIND_VIDEO_ENCODER, "omxmpeg4videoenc",
+        "GstOMXMPEG4VideoEnc",
+        "video/mpeg, mpegversion=(int) 4, systemstream=(boolean) false, "
+      "width=(int) [ 16, 4096 ], height=(int) [ 16, 4096 ]"},
+  {"video_encoder.h263", PROBE_KIND_VIDEO_ENCODER, "omxh263enc",
+        "GstOMXH263Enc",
+      "video/x-h263, width=(int) [ 16, 4096 ], height=(int) [ 16, 4096 ]"},
+  {"audio_encoder.aac", PROBE_KIND_AUDIO_ENCODER, "omxaacenc",
+        "GstOMXAACEnc",
+        "audio/mpeg, mpegversion=(int){2, 4}, "
+      "stream-format=(string){raw, adts, adif, loas, latm}"},
+};
+
+typedef struct
+{
+  GstOMXComponent *comp;
+  GstOMXPort *in_port, *out_port;
+
+  /* Raw video formats and profile names the component reported */
+  GPtrArray *formats;
+  GPtrArray *profiles;
+
+  /* Bitstream for decoders, NULL for zero-filled input */
+  GMappedFile *input;
+  gsize input_pos;
+
+  guint n_inputs, n_outputs;
+  gint64 deadline;
+  gboolean eos;
+  gboolean failed;
+  /* Only set if the throughput test ran and succeeded */
+  gboolean measured;
+  gdouble fps;
+} Probe;
+
+static gboolean probe = FALSE;
+static gboolean conf = FALSE;
+static gchar **inputs = NULL;
+static gchar *hacks_string = NULL;
+static gint duration = 1000;
+static gdouble min_fps = 30.0;
+
+static GOptionEntry entries[] = {
+  {"probe", 'p', 0, G_OPTION_ARG_NONE, &probe,
+      "Query the capabilities and measure the throughput", NULL},
+  {"conf", 'C', 0, G_OPTION_ARG_NONE, &conf,
+      "Write gstomx.conf sections to stdout (implies --probe)", NULL},
+  {"input", 'i', 0, G_OPTION_ARG_FILENAME_ARRAY, &inputs,
+      "Bitstream for the throughput test of a decoder role, can be "
+      "repeated", "ROLE=FILE"},
+  {"hacks", 0, 0, G_OPTION_ARG_STRING, &hacks_string,
+      "Hacks like in gstomx.conf, separated by ';'", "HACKS"},
+  {"duration", 'd', 0, G_OPTION_ARG_INT, &duration,
+      "Duration of the throughput test in ms (default: 1000)", "MS"},
+  {"min-fps", 0, 0, G_OPTION_ARG_DOUBLE, &min_fps,
+        "Output buffers per second a component needs for a primary rank "
+      "(default: 30)", "FPS"},
+  {NULL}
+};
+
+/* The report goes to stderr if stdout is used for the configuration */
+static void
+report (const gchar * format, ...)
+{
+  va_list args;
+  gchar *s;
+
+  va_start (args, format);
+  s = g_strdup_vprintf (format, args);
+  va_end (args);
+
+  fputs (s, conf ? stderr : stdout);
+  g_free (s);
+}
+
+static const ProbeRoleInfo *
+probe_lookup_role (const gchar * role)
+{
+  guint i;
+
+  for (i = 0; i < G_N_ELEMENTS (role_infos); i++) {
+    if (strcmp (role_infos[i].role, role) == 0)
+      return &role_infos[i];
+  }
+
+  return NULL;
+}
+
+static const gchar *
+probe_color_format_to_string (OMX_COLOR_FORMATTYPE format)
+{
+  switch (format) {
+    case OMX_COLOR_FormatYUV420Planar:
+    case OMX_COLOR_FormatYUV420PackedPlanar:
+      return "I420";
+    case OMX_COLOR_FormatYUV420SemiPlanar:
+      return "NV12";
+    default:
+      return NULL;
+  }
+}
+
+static const gchar *
+probe_profile_to_string (OMX_VIDEO_CODINGTYPE coding, OMX_U32 profile)
+{
+  if (coding == OMX_VIDEO_CodingAVC) {
+    switch (profile) {
+      case OMX_VIDEO_AVCProfileBaseline:
+        return "baseline";
+      case OMX_VIDEO_AVCProfileMain:
+        return "main";
+      case OMX_VIDEO_AVCProfileExtended:
+        return "extended";
+      case OMX_VIDEO_AVCProfileHigh:
+        return "high";
+      case OMX_VIDEO_AVCProfileHigh10:
+        return "high-10";
+      case OMX_VIDEO_AVCProfileHigh422:
+        return "high-4:2:2";
+      case OMX_VIDEO_AVCProfileHigh444:
+        return "high-4:4:4";
+      default:
+        break;
+    }
+  } else if (coding == OMX_VIDEO_CodingMPEG4) {
+    switch (profile) {
+      case OMX_VIDEO_MPEG4ProfileSimple:
+        return "simple";
+      case OMX_VIDEO_MPEG4ProfileSimpleScalable:
+        return "simple-scalable";
+      case OMX_VIDEO_MPEG4ProfileCore:
+        return "core";
+      case OMX_VIDEO_MPEG4ProfileMain:
+        return "main";
+      case OMX_VIDEO_MPEG4ProfileAdvancedSimple:
+        return "advanced-simple";
+      default:
+        break;
+    }
+  }
+
+  return NULL;
+}
+
+static void
+probe_add_unique (GPtrArray * array, const gchar * s)
+{
+  guint i;
+
+  for (i = 0; i < array->len; i++) {
+    if (strcmp (g_ptr_array_index (array, i), s) == 0)
+      return;
+  }
+  g_ptr_array_add (array, (gpointer) s);
+}
+
+static void
+probe_video_port (Probe * p, GstOMXPort * port,
+    OMX_PARAM_PORTDEFINITIONTYPE * port_def)
+{
+  OMX_VIDEO_PARAM_PORTFORMATTYPE format;
+  OMX_VIDEO_PARAM_PROFILELEVELTYPE profile;
+  guint i;
+
+  report ("    video %ux%u, stride %d, slice height %u, "
+      "compression 0x%08x, color format 0x%08x\n",
+      (guint) port_def->format.video.nFrameWidth,
+      (guint) port_def->format.video.nFrameHeight,
+      (gint) port_def->format.video.nStride,
+      (guint) port_def->format.video.nSliceHeight,
+      (guint) port_def->format.video.eCompressionFormat,
+      (guint) port_def->format.video.eColorFormat);
+
+  for (i = 0; i < PROBE_MAX_FORMATS; i++) {
+    const gchar *name;
+
+    GST_OMX_INIT_STRUCT (&format);
+    format.nPortIndex = port->index;
+    format.nIndex = i;
+    if (gst_omx_component_get_parameter (p->comp,
+            OMX_IndexParamVideoPortFormat, &format) != OMX_ErrorNone)
+      break;
+
+    name = probe_color_format_to_string (format.eColorFormat);
+    report ("    format %u: compression 0x%08x, color format 0x%08x (%s)\n",
+        i, (guint) format.eCompressionFormat, (guint) format.eColorFormat,
+        name ? name : "unsupported");
+    if (format.eCompressionFormat == OMX_VIDEO_CodingUnused && name)
+      probe_add_unique (p->formats, name);
+  }
+
+  if (port_def->format.video.eCompressionFormat == OMX_VIDEO_CodingUnused)
+    return;
+
+  for (i = 0; i < PROBE_MAX_PROFILES; i++) {
+    const gchar *name;
+
+    GST_OMX_INIT_STRUCT (&profile);
+    profile.nPortIndex = port->index;
+    profile.nProfileIndex = i;
+    if (gst_omx_component_get_parameter (p->comp,
+            OMX_IndexParamVideoProfileLevelQuerySupported,
+            &profile) != OMX_ErrorNone)
+      break;
+
+    name = probe_profile_to_string (port_def->format.video.eCompressionFormat,
+        profile.eProfile);
+    report ("    profile %u: profile 0x%08x (%s), level 0x%08x\n", i,
+        (guint) profile.eProfile, name ? name : "unknown",
+        (guint) profile.eLevel);
+    if (name)
+      probe_add_unique (p->profiles, name);
+  }
+}
+
+/* Adds all ports of the component and remembers the first input and
+ * output port for the throughput test */
+static void
+probe_ports (Probe * p)
+{
+  static const OMX_INDEXTYPE init_indices[] = {
+    OMX_IndexParamVideoInit, OMX_IndexParamAudioInit
+  };
+  guint i, j;
+
+  for (i = 0; i < G_N_ELEMENTS (init_indices); i++) {
+    OMX_PORT_PARAM_TYPE param;
+
+    GST_OMX_INIT_STRUCT (&param);
+    if (gst_omx_component_get_parameter (p->comp, init_indices[i],
+            &param) != OMX_ErrorNone)
+      continue;
+
+    for (j = 0; j < param.nPorts; j++) {
+      OMX_PARAM_PORTDEFINITIONTYPE port_def;
+      GstOMXPort *port;
+
+      port = gst_omx_component_add_port (p->comp, param.nStartPortNumber + j);
+      if (!port)
+        continue;
+
+      gst_omx_port_get_port_definition (port, &port_def);
+      report ("  Port %u: %s, %s, buffers %u (min %u), size %u, "
+          "alignment %u\n", port->index,
+          port_def.eDir == OMX_DirInput ? "input" : "output",
+          port_def.bEnabled ? "enabled" : "disabled",
+          (guint) port_def.nBufferCountActual,
+          (guint) port_def.nBufferCountMin, (guint) port_def.nBufferSize,
+          (guint) port_def.nBufferAlignment);
+
+      if (port_def.eDomain == OMX_PortDomainVideo)
+        probe_video_port (p, port, &port_def);
+
+      if (port_def.eDir == OMX_DirInput && !p->in_port)
+        p->in_port = port;
+      else if (port_def.eDir == OMX_DirOutput && !p->out_port)
+        p->out_port = port;
+    }
+  }
+}
+
+/* Same as the elements do if the output port settings changed */
+static gboolean
+probe_reconfigure_output (Probe * p)
+{
+  GstOMXPort *port = p->out_port;
+
+  if (gst_omx_port_is_enabled (port)) {
+    if (gst_omx_port_set_enabled (port, FALSE) != OMX_ErrorNone)
+      return FALSE;
+    if (gst_omx_port_wait_buffers_released (port,
+            5 * GST_SECOND) != OMX_ErrorNone)
+      return FALSE;
+    if (gst_omx_port_deallocate_buffers (port) != OMX_ErrorNone)
+      return FALSE;
+    if (gst_omx_port_wait_enabled (port, 1 * GST_SECOND) != OMX_ErrorNone)
+      return FALSE;
+  }
+
+  if (gst_omx_port_set_enabled (port, TRUE) != OMX_ErrorNone)
+    return FALSE;
+  if (gst_omx_port_allocate_buffers (port) != OMX_ErrorNone)
+    return FALSE;
+  if (gst_omx_port_wait_enabled (port, 5 * GST_SECOND) != OMX_ErrorNone)
+    return FALSE;
+  if (gst_omx_port_populate (port) != OMX_ErrorNone)
+    return FALSE;
+  if (gst_omx_port_mark_reconfigured (port) != OMX_ErrorNone)
+    return FALSE;
+
+  return TRUE;
+}
+
+static gpointer
+probe_output_thread (gpointer data)
+{
+  Probe *p = data;
+
+  while (TRUE) {
+    GstOMXAcquireBufferReturn ret;
+    GstOMXBuffer *buf = NULL;
+    gboolean eos;
+
+    ret = gst_omx_port_acquire_buffer_until (p->out_port, &buf, p->deadline);
+    if (ret == GST_OMX_ACQUIRE_BUFFER_RECONFIGURE) {
+      if (!probe_reconfigure_output (p))
+        goto error;
+      continue;
+    } else if (ret == GST_OMX_ACQUIRE_BUFFER_EOS) {
+      p->eos = TRUE;
+      break;
+    } else if (ret != GST_OMX_ACQUIRE_BUFFER_OK) {
+      goto error;
+    }
+
+    eos = (buf->omx_buf->nFlags & OMX_BUFFERFLAG_EOS) != 0;
+    if (buf->omx_buf->nFilledLen > 0)
+      p->n_outputs++;
+
+    if (gst_omx_port_release_buffer (p->out_port, buf) != OMX_ErrorNone)
+      goto error;
+
+    if (eos) {
+      p->eos = TRUE;
+      break;
+    }
+  }
+
+  return NULL;
+
+error:
+  p->failed = TRUE;
+  gst_omx_port_set_flushing (p->in_port, 5 * GST_SECOND, TRUE);
+
+  return NULL;
+}
+
+/* Returns the file passed with --input for the role, or NULL */
+static const gchar *
+probe_lookup_input (const gchar * role)
+{
+  gsize len = strlen (role);
+  guint i;
+
+  for (i = 0; inputs && inputs[i]; i++) {
+    if (strncmp (inputs[i], role, len) == 0 && inputs[i][len] == '=')
+      return inputs[i] + len + 1;
+  }
+
+  return NULL;
+}
+
+/* Fills the buffer with the next chunk of the input, starting
+ * again from the beginning at the end of the file */
+static void
+probe_fill_input (Probe * p, OMX_BUFFERHEADERTYPE * omx_buf)
+{
+  const gchar *data = g_mapped_file_get_contents (p->input);
+  gsize size = g_mapped_file_get_length (p->input);
+  gsize n;
+
+  if (p->input_pos >= size)
+    p->input_pos = 0;
+  n = MIN (size - p->input_pos, omx_buf->nAllocLen);
+
+  memcpy (omx_buf->pBuffer, data + p->input_pos, n);
+  omx_buf->nFilledLen = n;
+  p->input_pos += n;
+}
+
+/* Feeds the input or zero-filled buffers for the duration of the
+ * test, the last one with the EOS flag */
+static gboolean
+probe_input (Probe * p, GstClockTime start)
+{
+  gboolean last = FALSE;
+
+  while (!last) {
+    GstOMXBuffer *buf = NULL;
+    OMX_BUFFERHEADERTYPE *omx_buf;
+
+    if (gst_omx_port_acquire_buffer_until (p->in_port, &buf,
+            p->deadline) != GST_OMX_ACQUIRE_BUFFER_OK)
+      return FALSE;
+
+    last = gst_util_get_timestamp () - start >= duration * GST_MSECOND;
+
+    omx_buf = buf->omx_buf;
+    omx_buf->nOffset = 0;
+    if (p->input) {
+      /* The chunks are not aligned to frames */
+      probe_fill_input (p, omx_buf);
+      omx_buf->nFlags = 0;
+    } else {
+      memset (omx_buf->pBuffer, 0, omx_buf->nAllocLen);
+      omx_buf->nFilledLen = omx_buf->nAllocLen;
+      omx_buf->nFlags = OMX_BUFFERFLAG_ENDOFFRAME;
+    }
+    if (last)
+      omx_buf->nFlags |= OMX_BUFFERFLAG_EOS;
+    omx_buf->nTimeStamp =
+        gst_util_uint64_scale (p->n_inputs, OMX_TICKS_PER_SECOND, 30);
+    p->n_inputs++;
+
+    if (gst_omx_port_release_buffer (p->in_port, buf) != OMX_ErrorNone)
+      return FALSE;
+  }
+
+  return TRUE;
+}
+
+static gboolean
+probe_start (Probe * p)
+{
+  GstOMXComponent *comp = p->comp;
+
+  if (gst_omx_component_set_state (comp, OMX_StateIdle) != OMX_ErrorNone)
+    return FALSE;
+  if (gst_omx_port_allocate_buffers (p->in_port) != OMX_ErrorNone)
+    return FALSE;
+  if (gst_omx_port_allocate_buffers (p->out_port) != OMX_ErrorNone)
+    return FALSE;
+  if (gst_omx_component_get_state (comp, 5 * GST_SECOND) != OMX_StateIdle)
+    return FALSE;
+
+  if (gst_omx_component_set_state (comp, OMX_StateExecuting) != OMX_ErrorNone)
+    return FALSE;
+  if (gst_omx_component_get_state (comp,
+          5 * GST_SECOND) != OMX_StateExecuting)
+    return FALSE;
+
+  gst_omx_port_set_flushing (p->in_port, 5 * GST_SECOND, FALSE);
+  gst_omx_port_set_flushing (p->out_port, 5 * GST_SECOND, FALSE);
+
+  if (gst_omx_port_populate (p->out_port) != OMX_ErrorNone)
+    return FALSE;
+
+  return TRUE;
+}
+
+static void
+probe_stop (Probe * p)
+{
+  GstOMXComponent *comp = p->comp;
+  OMX_STATETYPE state;
+
+  gst_omx_port_set_flushing (p->in_port, 5 * GST_SECOND, TRUE);
+  gst_omx_port_set_flushing (p->out_port, 5 * GST_SECOND, TRUE);
+
+  state = gst_omx_component_get_state (comp, 0);
+  if (state > OMX_StateLoaded || state == OMX_StateInvalid) {
+    if (state > OMX_StateIdle) {
+      gst_omx_component_set_state (comp, OMX_StateIdle);
+      gst_omx_component_get_state (comp, 5 * GST_SECOND);
+    }
+    gst_omx_component_set_state (comp, OMX_StateLoaded);
+    gst_omx_port_deallocate_buffers (p->in_port);
+    gst_omx_port_deallocate_buffers (p->out_port);
+    if (state > OMX_StateLoaded)
+      gst_omx_component_get_state (comp, 5 * GST_SECOND);
+  }
+}
+
+static void
+probe_throughput (Probe * p)
+{
+  GThread *output_thread;
+  GstClockTime start, elapsed;
+
+  if (!p->in_port || !p->out_port) {
+    report ("  No input and output port, skipping throughput test\n");
+    p->failed = TRUE;
+    return;
+  }
+
+  /* Leave some time to drain after the last input */
+  p->deadline = g_get_monotonic_time () +
+      (duration + 5000) * G_TIME_SPAN_MILLISECOND;
+
+  if (!probe_start (p)) {
+    p->failed = TRUE;
+    goto done;
+  }
+
+  start = gst_util_get_timestamp ();
+  output_thread = g_thread_new ("listcomponents-output", probe_output_thread,
+      p);
+  if (!probe_input (p, start) && !p->failed) {
+    gst_omx_port_set_flushing (p->out_port, 5 * GST_SECOND, TRUE);
+    p->failed = TRUE;
+  }
+  g_thread_join (output_thread);
+  elapsed = gst_util_get_timestamp () - start;
+
+  if (!p->eos)
+    p->failed = TRUE;
+  if (elapsed > 0)
+    p->fps = (gdouble) p->n_outputs * GST_SECOND / elapsed;
+
+done:
+  probe_stop (p);
+
+  if (p->failed) {
+    report ("  Throughput test failed: %s\n",
+        gst_omx_component_get_last_error_string (p->comp));
+  } else {
+    report ("  Throughput: %u input buffers, %u output buffers, "
+        "%.1f output buffers/s\n", p->n_inputs, p->n_outputs, p->fps);
+    p->measured = TRUE;
+  }
+}
+
+/* Returns the caps with the given field set to the string or list of
+ * strings, or the caps unchanged if there is none */
+static gchar *
+probe_caps_with_list (const gchar * caps_string, const gchar * field,
+    GPtrArray * values)
+{
+  GstCaps *caps;
+  GValue list = G_VALUE_INIT;
+  GValue item = G_VALUE_INIT;
+  gchar *ret;
+  guint i;
+
+  caps = gst_caps_from_string (caps_string);
+  if (values->len == 1) {
+    gst_caps_set_simple (caps, field, G_TYPE_STRING,
+        g_ptr_array_index (values, 0), NULL);
+  } else if (values->len > 1) {
+    g_value_init (&list, GST_TYPE_LIST);
+    g_value_init (&item, G_TYPE_STRING);
+    for (i = 0; i < values->len; i++) {
+      g_value_set_string (&item, g_ptr_array_index (values, i));
+      gst_value_list_append_value (&list, &item);
+    }
+    gst_caps_set_value (caps, field, &list);
+    g_value_unset (&item);
+    g_value_unset (&list);
+  }
+
+  ret = gst_caps_to_string (caps);
+  gst_caps_unref (caps);
+
+  return ret;
+}
+
+static void
+probe_write_conf (Probe * p, const ProbeRoleInfo * info,
+    const gchar * core_name, const gchar * component_name,
+    const gchar * component_role, GHashTable * element_names)
+{
+  static const gchar *raw_caps = "video/x-raw, "
+      "width = (int) [ 1, MAX ], height = (int) [ 1, MAX ], "
+      "framerate = (fraction) [ 0, MAX ]";
+  gchar *element_name, *compressed_caps = NULL, *raw = NULL;
+  guint n, rank;
+
+  /* Every element needs its own group */
+  n = GPOINTER_TO_UINT (g_hash_table_lookup (element_names,
+          info->element_name));
+  g_hash_table_insert (element_names, (gpointer) info->element_name,
+      GUINT_TO_POINTER (n + 1));
+  if (n == 0)
+    element_name = g_strdup (info->element_name);
+  else
+    element_name = g_strdup_printf ("%s%u", info->element_name, n);
+
+  /* Only demote components that were measured to be too slow */
+  if (!p->measured)
+    rank = GST_RANK_PRIMARY;
+  else if (p->fps >= min_fps)
+    rank = GST_RANK_PRIMARY + 1;
+  else
+    rank = GST_RANK_MARGINAL;
+
+  if (info->kind != PROBE_KIND_AUDIO_ENCODER) {
+    compressed_caps = probe_caps_with_list (info->caps, "profile",
+        p->profiles);
+    if (p->formats->len > 0)
+      raw = probe_caps_with_list (raw_caps, "format", p->formats);
+  }
+
+  g_print ("[%s]\n", element_name);
+  g_print ("type-name=%s\n", info->type_name);
+  g_print ("core-name=%s\n", core_name);
+  g_print ("component-name=%s\n", component_name);
+  g_print ("component-role=%s\n", component_role);
+  g_print ("rank=%u\n", rank);
+  g_print ("in-port-index=%d\n", p->in_port ? (gint) p->in_port->index : -1);
+  g_print ("out-port-index=%d\n",
+      p->out_port ? (gint) p->out_port->index : -1);
+  if (info->kind == PROBE_KIND_VIDEO_DECODER) {
+    g_print ("sink-template-caps=%s\n", compressed_caps);
+    if (raw)
+      g_print ("src-template-caps=%s\n", raw);
+  } else if (info->kind == PROBE_KIND_VIDEO_ENCODER) {
+    if (raw)
+      g_print ("sink-template-caps=%s\n", raw);
+    g_print ("src-template-caps=%s\n", compressed_caps);
+  }
+  if (hacks_string)
+    g_print ("hacks=%s\n", hacks_string);
+  g_print ("\n");
+
+  g_free (element_name);
+  g_free (compressed_caps);
+  g_free (raw);
+}
+
+static void
+probe_component (const gchar * core_name, const gchar * component_name,
+    const gchar * component_role, guint64 hacks, GHashTable * element_names)
+{
+  const ProbeRoleInfo *info = probe_lookup_role (component_role);
+  GstElement *parent;
+  Probe p;
+
+  memset (&p, 0, sizeof (p));
+  p.formats = g_ptr_array_new ();
+  p.profiles = g_ptr_array_new ();
+
+  /* Only used as debug object */
+  parent = gst_bin_new ("listcomponents");
+  gst_object_ref_sink (parent);
+
+  p.comp = gst_omx_component_new (GST_OBJECT (parent), core_name,
+      component_name, component_role, hacks);
+  if (!p.comp) {
+    report ("  Failed to create component with role %s\n", component_role);
+    goto done;
+  }
+
+  probe_ports (&p);
+
+  if (strstr (component_role, "_decoder.")) {
+    const gchar *input = probe_lookup_input (component_role);
+    GError *err = NULL;
+
+    if (!input) {
+      report ("  No --input for role %s, skipping throughput test\n",
+          component_role);
+    } else if (!(p.input = g_mapped_file_new (input, FALSE, &err))) {
+      report ("  Failed to open input '%s': %s\n", input, err->message);
+      g_clear_error (&err);
+    } else if (g_mapped_file_get_length (p.input) == 0) {
+      report ("  Input '%s' is empty, skipping throughput test\n", input);
+    } else {
+      probe_throughput (&p);
+    }
+  } else {
+    probe_throughput (&p);
+  }
+
+  if (conf) {
+    if (info)
+      probe_write_conf (&p, info, core_name, component_name, component_role,
+          element_names);
+    else
+      report ("  No element for role %s\n", component_role);
+  }
+
+  gst_omx_component_free (p.comp);
+
+done:
+  if (p.input)
+    g_mapped_file_unref (p.input);
+  gst_object_unref (parent);
+  g_ptr_array_free (p.formats, TRUE);
+  g_ptr_array_free (p.profiles, TRUE);
+}
 
 gint
 main (gint argc, gchar ** argv)
 {
+  GOptionContext *ctx;
+  GError *error = NULL;
   gchar *filename;
-  GModule *core_module;
+  GstOMXCore *core;
+  GHashTable *element_names;
+  guint64 hacks = 0;
   OMX_ERRORTYPE err;
-  OMX_ERRORTYPE (*omx_init) (void);
   OMX_ERRORTYPE (*omx_component_name_enum) (OMX_STRING cComponentName,
       OMX_U32 nNameLength, OMX_U32 nIndex);
   OMX_ERRORTYPE (*omx_get_roles_of_component) (OMX_STRING compName,
       OMX_U32 * pNumRoles, OMX_U8 ** roles);
   guint32 i;
 
+  ctx = g_option_context_new ("/path/to/libopenmaxil.so - list and probe "
+      "the components of an OpenMAX IL core");
+  g_option_context_add_main_entries (ctx, entries, NULL);
+  g_option_context_add_group (ctx, gst_init_get_option_group ());
+  if (!g_option_context_parse (ctx, &argc, &argv, &error)) {
+    g_printerr ("Failed to parse options: %s\n", error->message);
+    g_clear_error (&error);
+    g_option_context_free (ctx);
+    return -1;
+  }
+  g_option_context_free (ctx);
+
   if (argc != 2) {
-    g_printerr ("Usage: %s /path/to/libopenmaxil.so\n", argv[0]);
+    g_printerr ("Usage: %s [OPTION...] /path/to/libopenmaxil.so\n", argv[0]);
     return -1;
   }
 
@@ -71,68 +816,43 @@ main (gint argc, gchar ** argv)
     return -1;
   }
 
-  /* Hack for the Broadcom OpenMAX IL implementation */
-  if (g_str_has_suffix (filename, "vc/lib/libopenmaxil.so")) {
-    gchar *bcm_host_filename;
-    gchar *bcm_host_path;
-    GModule *bcm_host_module;
-    void (*bcm_host_init) (void);
+  if (conf)
+    probe = TRUE;
 
-    bcm_host_path = g_path_get_dirname (filename);
-    bcm_host_filename =
-        g_build_filename (bcm_host_path, "libbcm_host.so", NULL);
+  GST_DEBUG_CATEGORY_INIT (gstomx_debug, "omx", 0, "gst-omx");
 
-    bcm_host_module = g_module_open (bcm_host_filename, G_MODULE_BIND_LAZY);
+  if (hacks_string) {
+    gchar **hacks_v = g_strsplit (hacks_string, ";", -1);
 
-    g_free (bcm_host_filename);
-    g_free (bcm_host_path);
-
-    if (!bcm_host_module) {
-      g_printerr ("Failed to load 'libbcm_host.so'\n");
-      return -1;
-    }
-
-    if (!g_module_symbol (bcm_host_module, "bcm_host_init",
-            (gpointer *) & bcm_host_init)) {
-      g_printerr ("Failed to find 'bcm_host_init' in 'libbcm_host.so'\n");
-      return -1;
-    }
-
-    bcm_host_init ();
-  }
-
-  core_module = g_module_open (filename, G_MODULE_BIND_LAZY);
-  if (!core_module) {
-    g_printerr ("Failed to load '%s'\n", filename);
-    return -1;
+    hacks = gst_omx_parse_hacks (hacks_v);
+    g_strfreev (hacks_v);
   }
 
-  if (!g_module_symbol (core_module, "OMX_Init", (gpointer *) & omx_init)) {
-    g_printerr ("Failed to find '%s' in '%s'\n", "OMX_Init", filename);
+  /* Loads and initializes the core, including the Broadcom hack */
+  core = gst_omx_core_acquire (filename);
+  if (!core) {
+    g_printerr ("Failed to load and initialize '%s'\n", filename);
     return -1;
   }
 
-  if (!g_module_symbol (core_module, "OMX_ComponentNameEnum",
+  if (!g_module_symbol (core->module, "OMX_ComponentNameEnum",
           (gpointer *) & omx_component_name_enum)) {
     g_printerr ("Failed to find '%s' in '%s'\n", "OMX_ComponentNameEnum",
         filename);
     return -1;
   }
 
-  if (!g_module_symbol (core_module, "OMX_GetRolesOfComponent",
+  if (!g_module_symbol (core->module, "OMX_GetRolesOfComponent",
           (gpointer *) & omx_get_roles_of_component)) {
     g_printerr ("Failed to find '%s' in '%s'\n", "OMX_GetRolesOfComponent",
         filename);
     return -1;
   }
 
-
-  if ((err = omx_init ()) != OMX_ErrorNone) {
-    g_printerr ("Failed to initialize core: %d\n", err);
-    return -1;
-  }
+  element_names = g_hash_table_new (g_str_hash, g_str_equal);
 
   i = 0;
+  err = OMX_ErrorNone;
   while (err == OMX_ErrorNone) {
     gchar component_name[1024];
 
@@ -140,7 +860,7 @@ main (gint argc, gchar ** argv)
     if (err == OMX_ErrorNone || err == OMX_ErrorNoMore) {
       guint32 nroles;
 
-      g_print ("Component %d: %s\n", i, component_name);
+      report ("Component %d: %s\n", i, component_name);
 
       if (omx_get_roles_of_component (component_name, (OMX_U32 *) & nroles,
               NULL) == OMX_ErrorNone && nroles > 0) {
@@ -155,7 +875,10 @@ main (gint argc, gchar ** argv)
         if (omx_get_roles_of_component (component_name, (OMX_U32 *) & nroles,
                 (OMX_U8 **) roles) == OMX_ErrorNone) {
           for (j = 0; j < nroles; j++) {
-            g_print ("  Role %d: %s\n", j, roles[j]);
+            report ("  Role %d: %s\n", j, roles[j]);
+            if (probe)
+              probe_component (filename, component_name, roles[j], hacks,
+                  element_names);
           }
         }
         g_free (roles[0]);
@@ -165,5 +888,9 @@ main (gint argc, gchar ** argv)
     i++;
   }
 
+  g_hash_table_unref (element_names);
+  gst_omx_core_release (core);
+  g_free (hacks_string);
+
   return 0;
 }
@@ -0,0 +1,507 @@
+/*
+ * Copyright (C) 2026, the gst-omx authors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+/* Measures the buffer handling of GstOMXComponent and GstOMXPort without
+ * any GStreamer elements: buffers are allocated on both ports of a
+ * component and then acquired and released as fast as possible, the
+ * input from the main thread and the output from a second thread.
+ *
+ * The payload of the input buffers is all zeros, so this is mostly
+ * useful with encoders or the fake core in tools/fakecore.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+#include <gst/gst.h>
+
+#include "gstomx.h"
+
+GST_DEBUG_CATEGORY_EXTERN (gstomx_debug);
+
+/* Number of callback timestamps remembered per port */
+#define BENCH_NOTIFY_RING_SIZE (256)
+
+typedef struct
+{
+  guint64 count;
+  GstClockTime total, min, max;
+} BenchCallStats;
+
+typedef struct
+{
+  GstOMXPort *port;
+
+  /* Time of the callbacks that did not lead to an acquired
+   * buffer yet, written from the OMX callbacks */
+  GMutex notify_lock;
+  GstClockTime notify_ring[BENCH_NOTIFY_RING_SIZE];
+  guint notify_head, notify_len;
+
+  BenchCallStats acquire_no_wait;
+  BenchCallStats acquire_wait;
+  BenchCallStats release;
+  BenchCallStats callback_to_acquire;
+} BenchPort;
+
+typedef struct
+{
+  GstOMXComponent *comp;
+  BenchPort in, out;
+
+  guint n_buffers;
+  guint filled_len;
+  guint n_outputs;
+  gboolean eos;
+  gboolean failed;
+} Bench;
+
+static gchar *core_name = NULL;
+static gchar *component_name = NULL;
+static gchar *component_role = NULL;
+static gchar *hacks_string = NULL;
+static gint in_port_index = 0;
+static gint out_port_index = 1;
+static gint n_buffers = 1000;
+static gint filled_len = 4096;
+
+static GOptionEntry entries[] = {
+  {"core", 'c', 0, G_OPTION_ARG_FILENAME, &core_name,
+      "OpenMAX IL core library", "FILE"},
+  {"component", 'n', 0, G_OPTION_ARG_STRING, &component_name,
+      "Component name", "NAME"},
+  {"role", 'r', 0, G_OPTION_ARG_STRING, &component_role,
+      "Component role", "ROLE"},
+  {"hacks", 0, 0, G_OPTION_ARG_STRING, &hacks_string,
+      "Hacks like in gstomx.conf, separated by ';'", "HACKS"},
+  {"in-port", 0, 0, G_OPTION_ARG_INT, &in_port_index,
+      "Input port index (default: 0)", "INDEX"},
+  {"out-port", 0, 0, G_OPTION_ARG_INT, &out_port_index,
+      "Output port index (default: 1)", "INDEX"},
+  {"buffers", 'b', 0, G_OPTION_ARG_INT, &n_buffers,
+      "Number of input buffers (default: 1000)", "N"},
+  {"size", 's', 0, G_OPTION_ARG_INT, &filled_len,
+      "Filled length of the input buffers (default: 4096)", "BYTES"},
+  {NULL}
+};
+
+static void
+bench_call_stats_add (BenchCallStats * stats, GstClockTime t)
+{
+  if (stats->count == 0 || t < stats->min)
+    stats->min = t;
+  if (t > stats->max)
+    stats->max = t;
+  stats->total += t;
+  stats->count++;
+}
+
+static void
+bench_call_stats_print (const gchar * what, guint index,
+    BenchCallStats * stats)
+{
+  if (stats->count == 0) {
+    g_print ("  port %u %-20s: -\n", index, what);
+    return;
+  }
+
+  g_print ("  port %u %-20s: %8" G_GUINT64_FORMAT " calls, mean %8.2f us, "
+      "min %8.2f us, max %8.2f us\n", index, what, stats->count,
+      (gdouble) stats->total / stats->count / 1000.0,
+      (gdouble) stats->min / 1000.0, (gdouble) stats->max / 1000.0);
+}
+
+/* Called from the OMX callbacks whenever a buffer was returned,
+ * and rarely for other events */
+static void
+bench_port_notify (GstOMXPort * port, gpointer user_data)
+{
+  BenchPort *bport = user_data;
+  GstClockTime now = gst_util_get_timestamp ();
+
+  g_mutex_lock (&bport->notify_lock);
+  if (bport->notify_len < BENCH_NOTIFY_RING_SIZE) {
+    bport->notify_ring[(bport->notify_head +
+            bport->notify_len) % BENCH_NOTIFY_RING_SIZE] = now;
+    bport->notify_len++;
+  }
+  g_mutex_unlock (&bport->notify_lock);
+}
+
+static void
+bench_port_init (BenchPort * bport, GstOMXPort * port)
+{
+  memset (bport, 0, sizeof (*bport));
+  bport->port = port;
+  g_mutex_init (&bport->notify_lock);
+  gst_omx_port_set_notify_func (port, bench_port_notify, bport);
+}
+
+static void
+bench_port_clear (BenchPort * bport)
+{
+  g_mutex_clear (&bport->notify_lock);
+}
+
+/* Acquires a buffer and records how long it took, separately for
+ * the calls that had to wait for the component */
+static GstOMXAcquireBufferReturn
+bench_port_acquire (BenchPort * bport, GstOMXBuffer ** buf)
+{
+  GstOMXAcquireBufferReturn ret;
+  GstClockTime start, end;
+
+  start = gst_util_get_timestamp ();
+  ret = gst_omx_port_try_acquire_buffer (bport->port, buf);
+  end = gst_util_get_timestamp ();
+
+  if (ret == GST_OMX_ACQUIRE_BUFFER_NO_AVAILABLE) {
+    start = gst_util_get_timestamp ();
+    ret = gst_omx_port_acquire_buffer_until (bport->port, buf,
+        g_get_monotonic_time () + 5 * G_TIME_SPAN_SECOND);
+    end = gst_util_get_timestamp ();
+    if (ret == GST_OMX_ACQUIRE_BUFFER_OK)
+      bench_call_stats_add (&bport->acquire_wait, end - start);
+  } else if (ret == GST_OMX_ACQUIRE_BUFFER_OK) {
+    bench_call_stats_add (&bport->acquire_no_wait, end - start);
+  }
+
+  if (ret == GST_OMX_ACQUIRE_BUFFER_OK) {
+    g_mutex_lock (&bport->notify_lock);
+    if (bport->notify_len > 0) {
+      GstClockTime notified = bport->notify_ring[bport->notify_head];
+
+      bport->notify_head = (bport->notify_head + 1) % BENCH_NOTIFY_RING_SIZE;
+      bport->notify_len--;
+      if (end > notified)
+        bench_call_stats_add (&bport->callback_to_acquire, end - notified);
+    }
+    g_mutex_unlock (&bport->notify_lock);
+  }
+
+  return ret;
+}
+
+static OMX_ERRORTYPE
+bench_port_release (BenchPort * bport, GstOMXBuffer * buf)
+{
+  OMX_ERRORTYPE err;
+  GstClockTime start;
+
+  start = gst_util_get_timestamp ();
+  err = gst_omx_port_release_buffer (bport->port, buf);
+  bench_call_stats_add (&bport->release, gst_util_get_timestamp () - start);
+
+  return err;
+}
+
+/* Same as the elements do if the output port settings changed */
+static gboolean
+bench_reconfigure_output (Bench * bench)
+{
+  GstOMXPort *port = bench->out.port;
+
+  g_print ("Reconfiguring output port\n");
+
+  if (gst_omx_port_is_enabled (port)) {
+    if (gst_omx_port_set_enabled (port, FALSE) != OMX_ErrorNone)
+      return FALSE;
+    if (gst_omx_port_wait_buffers_released (port,
+            5 * GST_SECOND) != OMX_ErrorNone)
+      return FALSE;
+    if (gst_omx_port_deallocate_buffers (port) != OMX_ErrorNone)
+      return FALSE;
+    if (gst_omx_port_wait_enabled (port, 1 * GST_SECOND) != OMX_ErrorNone)
+      return FALSE;
+  }
+
+  if (gst_omx_port_set_enabled (port, TRUE) != OMX_ErrorNone)
+    return FALSE;
+  if (gst_omx_port_allocate_buffers (port) != OMX_ErrorNone)
+    return FALSE;
+  if (gst_omx_port_wait_enabled (port, 5 * GST_SECOND) != OMX_ErrorNone)
+    return FALSE;
+  if (gst_omx_port_populate (port) != OMX_ErrorNone)
+    return FALSE;
+  if (gst_omx_port_mark_reconfigured (port) != OMX_ErrorNone)
+    return FALSE;
+
+  return TRUE;
+}
+
+static gpointer
+bench_output_thread (gpointer data)
+{
+  Bench *bench = data;
+
+  while (TRUE) {
+    GstOMXAcquireBufferReturn ret;
+    GstOMXBuffer *buf = NULL;
+    gboolean eos;
+
+    ret = bench_port_acquire (&bench->out, &buf);
+    if (ret == GST_OMX_ACQUIRE_BUFFER_RECONFIGURE) {
+      if (!bench_reconfigure_output (bench))
+        goto error;
+      continue;
+    } else if (ret == GST_OMX_ACQUIRE_BUFFER_EOS) {
+      bench->eos = TRUE;
+      break;
+    } else if (ret != GST_OMX_ACQUIRE_BUFFER_OK) {
+      goto error;
+    }
+
+    eos = (buf->omx_buf->nFlags & OMX_BUFFERFLAG_EOS) != 0;
+    if (buf->omx_buf->nFilledLen > 0)
+      bench->n_outputs++;
+
+    if (bench_port_release (&bench->out, buf) != OMX_ErrorNone)
+      goto error;
+
+    if (eos) {
+      bench->eos = TRUE;
+      break;
+    }
+  }
+
+  return NULL;
+
+error:
+  g_printerr ("Output failed: %s\n",
+      gst_omx_component_get_last_error_string (bench->comp));
+  bench->failed = TRUE;
+  gst_omx_port_set_flushing (bench->in.port, 5 * GST_SECOND, TRUE);
+
+  return NULL;
+}
+
+static gboolean
+bench_input (Bench * bench)
+{
+  guint i;
+
+  for (i = 0; i < bench->n_buffers; i++) {
+    GstOMXAcquireBufferReturn ret;
+    GstOMXBuffer *buf = NULL;
+    OMX_BUFFERHEADERTYPE *omx_buf;
+
+    ret = bench_port_acquire (&bench->in, &buf);
+    if (ret != GST_OMX_ACQUIRE_BUFFER_OK)
+      return FALSE;
+
+    omx_buf = buf->omx_buf;
+    omx_buf->nOffset = 0;
+    omx_buf->nFilledLen = MIN (bench->filled_len, omx_buf->nAllocLen);
+    omx_buf->nFlags = OMX_BUFFERFLAG_ENDOFFRAME;
+    if (i == bench->n_buffers - 1)
+      omx_buf->nFlags |= OMX_BUFFERFLAG_EOS;
+    omx_buf->nTimeStamp = gst_util_uint64_scale (i, OMX_TICKS_PER_SECOND, 30);
+
+    if (bench_port_release (&bench->in, buf) != OMX_ErrorNone)
+      return FALSE;
+  }
+
+  return TRUE;
+}
+
+static gboolean
+bench_start (Bench * bench)
+{
+  GstOMXComponent *comp = bench->comp;
+
+  if (gst_omx_component_set_state (comp, OMX_StateIdle) != OMX_ErrorNone)
+    return FALSE;
+  if (gst_omx_port_allocate_buffers (bench->in.port) != OMX_ErrorNone)
+    return FALSE;
+  if (gst_omx_port_allocate_buffers (bench->out.port) != OMX_ErrorNone)
+    return FALSE;
+  if (gst_omx_component_get_state (comp, 5 * GST_SECOND) != OMX_StateIdle)
+    return FALSE;
+
+  if (gst_omx_component_set_state (comp, OMX_StateExecuting) != OMX_ErrorNone)
+    return FALSE;
+  if (gst_omx_component_get_state (comp,
+          5 * GST_SECOND) != OMX_StateExecuting)
+    return FALSE;
+
+  gst_omx_port_set_flushing (bench->in.port, 5 * GST_SECOND, FALSE);
+  gst_omx_port_set_flushing (bench->out.port, 5 * GST_SECOND, FALSE);
+
+  if (gst_omx_port_populate (bench->out.port) != OMX_ErrorNone)
+    return FALSE;
+
+  return TRUE;
+}
+
+static void
+bench_stop (Bench * bench)
+{
+  GstOMXComponent *comp = bench->comp;
+  OMX_STATETYPE state;
+
+  gst_omx_port_set_flushing (bench->in.port, 5 * GST_SECOND, TRUE);
+  gst_omx_port_set_flushing (bench->out.port, 5 * GST_SECOND, TRUE);
+
+  state = gst_omx_component_get_state (comp, 0);
+  if (state > OMX_StateLoaded || state == OMX_StateInvalid) {
+    if (state > OMX_StateIdle) {
+      gst_omx_component_set_state (comp, OMX_StateIdle);
+      gst_omx_component_get_state (comp, 5 * GST_SECOND);
+    }
+    gst_omx_component_set_state (comp, OMX_StateLoaded);
+    gst_omx_port_deallocate_buffers (bench->in.port);
+    gst_omx_port_deallocate_buffers (bench->out.port);
+    if (state > OMX_StateLoaded)
+      gst_omx_component_get_state (comp, 5 * GST_SECOND);
+  }
+}
+
+static void
+bench_report (Bench * bench, GstClockTime elapsed)
+{
+  gdouble secs = (gdouble) elapsed / GST_SECOND;
+
+  g_print ("%u input buffers, %u output buffers in %.3f s\n",
+      bench->n_buffers, bench->n_outputs, secs);
+  if (secs > 0)
+    g_print ("  %.1f input buffers/s, %.1f output buffers/s\n",
+        bench->n_buffers / secs, bench->n_outputs / secs);
+
+  bench_call_stats_print ("acquire (no wait)", bench->in.port->index,
+      &bench->in.acquire_no_wait);
+  bench_call_stats_print ("acquire (waited)", bench->in.port->index,
+      &bench->in.acquire_wait);
+  bench_call_stats_print ("release", bench->in.port->index,
+      &bench->in.release);
+  bench_call_stats_print ("callback to acquire", bench->in.port->index,
+      &bench->in.callback_to_acquire);
+  bench_call_stats_print ("acquire (no wait)", bench->out.port->index,
+      &bench->out.acquire_no_wait);
+  bench_call_stats_print ("acquire (waited)", bench->out.port->index,
+      &bench->out.acquire_wait);
+  bench_call_stats_print ("release", bench->out.port->index,
+      &bench->out.release);
+  bench_call_stats_print ("callback to acquire", bench->out.port->index,
+      &bench->out.callback_to_acquire);
+}
+
+int
+main (int argc, char **argv)
+{
+  GOptionContext *ctx;
+  GError *err = NULL;
+  GstElement *parent;
+  GstOMXPort *in_port, *out_port;
+  GThread *output_thread;
+  GstClockTime start;
+  guint64 hacks = 0;
+  Bench bench;
+  gint ret = 1;
+
+  ctx = g_option_context_new ("- benchmark an OpenMAX IL component");
+  g_option_context_add_main_entries (ctx, entries, NULL);
+  g_option_context_add_group (ctx, gst_init_get_option_group ());
+  if (!g_option_context_parse (ctx, &argc, &argv, &err)) {
+    g_printerr ("Failed to parse options: %s\n", err->message);
+    g_clear_error (&err);
+    g_option_context_free (ctx);
+    return 1;
+  }
+  g_option_context_free (ctx);
+
+  if (!core_name || !component_name || n_buffers <= 0 || filled_len < 0) {
+    g_printerr ("Usage: %s -c CORE -n COMPONENT [-r ROLE] [OPTION...]\n",
+        argv[0]);
+    return 1;
+  }
+
+  GST_DEBUG_CATEGORY_INIT (gstomx_debug, "omx", 0, "gst-omx");
+
+  if (hacks_string) {
+    gchar **hacks_v = g_strsplit (hacks_string, ";", -1);
+
+    hacks = gst_omx_parse_hacks (hacks_v);
+    g_strfreev (hacks_v);
+  }
+
+  memset (&bench, 0, sizeof (bench));
+  bench.n_buffers = n_buffers;
+  bench.filled_len = filled_len;
+
+  /* Only used as debug object */
+  parent = gst_bin_new ("omxbench");
+  gst_object_ref_sink (parent);
+
+  bench.comp = gst_omx_component_new (GST_OBJECT (parent), core_name,
+      component_name, component_role, hacks);
+  if (!bench.comp) {
+    g_printerr ("Failed to create component '%s' from core '%s'\n",
+        component_name, core_name);
+    goto done;
+  }
+
+  in_port = gst_omx_component_add_port (bench.comp, in_port_index);
+  out_port = gst_omx_component_add_port (bench.comp, out_port_index);
+  if (!in_port || !out_port) {
+    g_printerr ("Failed to add ports %d and %d\n", in_port_index,
+        out_port_index);
+    gst_omx_component_free (bench.comp);
+    goto done;
+  }
+  bench_port_init (&bench.in, in_port);
+  bench_port_init (&bench.out, out_port);
+
+  if (!bench_start (&bench)) {
+    g_printerr ("Failed to start component: %s\n",
+        gst_omx_component_get_last_error_string (bench.comp));
+    goto stop;
+  }
+
+  start = gst_util_get_timestamp ();
+  output_thread = g_thread_new ("omxbench-output", bench_output_thread,
+      &bench);
+  if (!bench_input (&bench) && !bench.failed) {
+    g_printerr ("Input failed: %s\n",
+        gst_omx_component_get_last_error_string (bench.comp));
+    gst_omx_port_set_flushing (bench.out.port, 5 * GST_SECOND, TRUE);
+    bench.failed = TRUE;
+  }
+  g_thread_join (output_thread);
+
+  bench_report (&bench, gst_util_get_timestamp () - start);
+  if (!bench.failed && bench.eos)
+    ret = 0;
+
+stop:
+  bench_stop (&bench);
+  bench_port_clear (&bench.in);
+  bench_port_clear (&bench.out);
+  gst_omx_component_free (bench.comp);
+
+done:
+  gst_object_unref (parent);
+  g_free (core_name);
+  g_free (component_name);
+  g_free (component_role);
+  g_free (hacks_string);
+
+  return ret;
+}
@@ -0,0 +1,705 @@
+/*
+ * Copyright (C) 2026, the gst-omx authors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+/* Runs the pipelines of a suite file, see omxbenchsuite.conf, at all
+ * configured resolutions and writes one CSV line per run with:
+ *
+ *   fps            frames at the element named "sink" per second,
+ *                  from the first to the last frame
+ *   latency        time from a buffer entering the element named "omx"
+ *                  until the buffer with the same timestamp leaves it
+ *   cpu per frame  user and system CPU time of the whole process
+ *   peak rss       peak resident set size during the run
+ *
+ * A case can have a setup pipeline that is run once per resolution
+ * before the measured one, e.g. to encode the input of a decoder so
+ * that only the decoder is measured. It is not measured itself and
+ * {input} is replaced with the same temporary file in both.
+ *
+ * With --baseline the results are compared to an earlier CSV file and
+ * the exit code is non-zero if fps dropped or the CPU time per frame
+ * increased by more than the given percentage.
+ *
+ * The cores are selected as usual by the gstomx.conf file, e.g. with
+ * --config-dir pointing to the build directory of tools/fakecore.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <glib/gstdio.h>
+#include <gst/gst.h>
+
+typedef struct
+{
+  const gchar *name;
+  gint width, height;
+  gint frames;
+  gchar *input;                 /* Written by the setup pipeline */
+
+  GMutex lock;
+  /* Buffer timestamp to the time it entered the element */
+  GHashTable *pending;
+  guint64 n_latency;
+  GstClockTime latency_total, latency_max;
+
+  guint64 n_frames;
+  GstClockTime first_frame, last_frame;
+} BenchRun;
+
+typedef struct
+{
+  gdouble fps;
+  gdouble latency_mean_ms, latency_max_ms;
+  gdouble cpu_ms_per_frame;
+  guint64 peak_rss_kb;
+} BenchResult;
+
+static gchar *suite_file = NULL;
+static gchar *config_dir = NULL;
+static gchar *output_file = NULL;
+static gchar *baseline_file = NULL;
+static gchar *only_case = NULL;
+static gdouble max_fps_drop = 5.0;
+static gdouble max_cpu_increase = 5.0;
+static gint timeout = 300;
+
+static GOptionEntry entries[] = {
+  {"suite", 's', 0, G_OPTION_ARG_FILENAME, &suite_file,
+      "Suite file", "FILE"},
+  {"config-dir", 'c', 0, G_OPTION_ARG_FILENAME, &config_dir,
+      "Directory with the gstomx.conf to use", "DIR"},
+  {"output", 'o', 0, G_OPTION_ARG_FILENAME, &output_file,
+      "CSV output file (default: stdout)", "FILE"},
+  {"case", 0, 0, G_OPTION_ARG_STRING, &only_case,
+      "Only run this case", "NAME"},
+  {"baseline", 'b', 0, G_OPTION_ARG_FILENAME, &baseline_file,
+      "CSV file of an earlier run to compare with", "FILE"},
+  {"max-fps-drop", 0, 0, G_OPTION_ARG_DOUBLE, &max_fps_drop,
+      "Maximum fps regression in percent (default: 5)", "PERCENT"},
+  {"max-cpu-increase", 0, 0, G_OPTION_ARG_DOUBLE, &max_cpu_increase,
+      "Maximum CPU time per frame regression in percent (default: 5)",
+      "PERCENT"},
+  {"timeout", 't', 0, G_OPTION_ARG_INT, &timeout,
+      "Timeout per run in seconds (default: 300)", "SECONDS"},
+  {NULL}
+};
+
+#define BENCH_CSV_HEADER \
+    "case,width,height,frames,fps,latency_mean_ms,latency_max_ms," \
+    "cpu_ms_per_frame,peak_rss_kb"
+
+static GstClockTime
+bench_cpu_time (void)
+{
+  struct rusage usage;
+
+  if (getrusage (RUSAGE_SELF, &usage) != 0)
+    return 0;
+
+  return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * GST_SECOND +
+      (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * GST_USECOND;
+}
+
+/* Resets the peak RSS of the process, only works on Linux */
+static gboolean
+bench_reset_peak_rss (void)
+{
+  FILE *f = fopen ("/proc/self/clear_refs", "w");
+  gboolean ret;
+
+  if (!f)
+    return FALSE;
+  ret = (fputs ("5", f) >= 0);
+  ret &= (fclose (f) == 0);
+
+  return ret;
+}
+
+static guint64
+bench_peak_rss_kb (void)
+{
+  gchar *status = NULL, *line;
+  struct rusage usage;
+  guint64 kb = 0;
+
+  if (g_file_get_contents ("/proc/self/status", &status, NULL, NULL)) {
+    if ((line = strstr (status, "VmHWM:")))
+      kb = g_ascii_strtoull (line + strlen ("VmHWM:"), NULL, 10);
+    g_free (status);
+  }
+
+  if (kb == 0 && getrusage (RUSAGE_SELF, &usage) == 0)
+    kb = usage.ru_maxrss;
+
+  return kb;
+}
+
+static GstPadProbeReturn
+bench_omx_sink_probe (GstPad * pad, GstPadProbeInfo * info, gpointer user_data)
+{
+  BenchRun *run = user_data;
+  GstBuffer *buf = GST_PAD_PROBE_INFO_BUFFER (info);
+  GstClockTime *now;
+
+  if (!GST_BUFFER_PTS_IS_VALID (buf))
+    return GST_PAD_PROBE_OK;
+
+  now = g_slice_new (GstClockTime);
+  *now = gst_util_get_timestamp ();
+
+  g_mutex_lock (&run->lock);
+  g_hash_table_insert (run->pending,
+      g_slice_dup (GstClockTime, &GST_BUFFER_PTS (buf)), now);
+  g_mutex_unlock (&run->lock);
+
+  return GST_PAD_PROBE_OK;
+}
+
+static GstPadProbeReturn
+bench_omx_src_probe (GstPad * pad, GstPadProbeInfo * info, gpointer user_data)
+{
+  BenchRun *run = user_data;
+  GstBuffer *buf = GST_PAD_PROBE_INFO_BUFFER (info);
+  GstClockTime now = gst_util_get_timestamp ();
+  GstClockTime *arrival;
+
+  if (!GST_BUFFER_PTS_IS_VALID (buf))
+    return GST_PAD_PROBE_OK;
+
+  g_mutex_lock (&run->lock);
+  arrival = g_hash_table_lookup (run->pending, &GST_BUFFER_PTS (buf));
+  if (arrival) {
+    GstClockTime latency = now - *arrival;
+
+    run->n_latency++;
+    run->latency_total += latency;
+    run->latency_max = MAX (run->latency_max, latency);
+    g_hash_table_remove (run->pending, &GST_BUFFER_PTS (buf));
+  }
+  g_mutex_unlock (&run->lock);
+
+  return GST_PAD_PROBE_OK;
+}
+
+static GstPadProbeReturn
+bench_sink_probe (GstPad * pad, GstPadProbeInfo * info, gpointer user_data)
+{
+  BenchRun *run = user_data;
+  GstClockTime now = gst_util_get_timestamp ();
+
+  /* Only the streaming thread of the sink writes these */
+  if (run->n_frames == 0)
+    run->first_frame = now;
+  run->last_frame = now;
+  run->n_frames++;
+
+  return GST_PAD_PROBE_OK;
+}
+
+static void
+bench_slice_free_time (gpointer data)
+{
+  g_slice_free (GstClockTime, data);
+}
+
+static gboolean
+bench_add_probe (GstElement * pipeline, const gchar * element_name,
+    const gchar * pad_name, GstPadProbeCallback callback, BenchRun * run)
+{
+  GstElement *element;
+  GstPad *pad;
+
+  element = gst_bin_get_by_name (GST_BIN (pipeline), element_name);
+  if (!element)
+    return FALSE;
+
+  pad = gst_element_get_static_pad (element, pad_name);
+  gst_object_unref (element);
+  if (!pad)
+    return FALSE;
+
+  gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_BUFFER, callback, run, NULL);
+  gst_object_unref (pad);
+
+  return TRUE;
+}
+
+/* Replaces {width}, {height}, {frames} and {input} in the
+ * pipeline description */
+static gchar *
+bench_expand_pipeline (const gchar * desc, BenchRun * run)
+{
+  GString *s = g_string_new (NULL);
+  const gchar *p = desc;
+
+  while (*p) {
+    if (g_str_has_prefix (p, "{width}")) {
+      g_string_append_printf (s, "%d", run->width);
+      p += strlen ("{width}");
+    } else if (g_str_has_prefix (p, "{height}")) {
+      g_string_append_printf (s, "%d", run->height);
+      p += strlen ("{height}");
+    } else if (g_str_has_prefix (p, "{frames}")) {
+      g_string_append_printf (s, "%d", run->frames);
+      p += strlen ("{frames}");
+    } else if (g_str_has_prefix (p, "{input}")) {
+      g_string_append (s, run->input ? run->input : "");
+      p += strlen ("{input}");
+    } else {
+      g_string_append_c (s, *p++);
+    }
+  }
+
+  return g_string_free (s, FALSE);
+}
+
+static gboolean
+bench_run_pipeline (const gchar * desc, BenchRun * run, BenchResult * result)
+{
+  GstElement *pipeline;
+  GstBus *bus;
+  GstMessage *msg;
+  GError *err = NULL;
+  GstClockTime cpu_start, cpu;
+  gchar *expanded;
+  gboolean ret = FALSE;
+
+  expanded = bench_expand_pipeline (desc, run);
+  pipeline = gst_parse_launch (expanded, &err);
+  if (!pipeline || err) {
+    g_printerr ("%s: Failed to create pipeline '%s': %s\n", run->name,
+        expanded, err ? err->message : "unknown error");
+    g_clear_error (&err);
+    if (pipeline)
+      gst_object_unref (pipeline);
+    g_free (expanded);
+    return FALSE;
+  }
+  g_free (expanded);
+
+  if (!bench_add_probe (pipeline, "sink", "sink", bench_sink_probe, run)) {
+    g_printerr ("%s: Pipeline needs an element named 'sink'\n", run->name);
+    goto done;
+  }
+  if (bench_add_probe (pipeline, "omx", "sink", bench_omx_sink_probe, run))
+    bench_add_probe (pipeline, "omx", "src", bench_omx_src_probe, run);
+
+  if (!bench_reset_peak_rss ())
+    g_printerr ("%s: Can't reset the peak RSS, reporting the process peak\n",
+        run->name);
+  cpu_start = bench_cpu_time ();
+
+  if (gst_element_set_state (pipeline,
+          GST_STATE_PLAYING) == GST_STATE_CHANGE_FAILURE) {
+    g_printerr ("%s: Failed to start pipeline\n", run->name);
+    goto done;
+  }
+
+  bus = gst_element_get_bus (pipeline);
+  msg = gst_bus_timed_pop_filtered (bus, timeout * GST_SECOND,
+      GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+  gst_object_unref (bus);
+
+  cpu = bench_cpu_time () - cpu_start;
+  result->peak_rss_kb = bench_peak_rss_kb ();
+
+  if (!msg) {
+    g_printerr ("%s: Timeout after %d seconds\n", run->name, timeout);
+  } else if (GST_MESSAGE_TYPE (msg) == GST_MESSAGE_ERROR) {
+    gchar *debug = NULL;
+
+    gst_message_parse_error (msg, &err, &debug);
+    g_printerr ("%s: Error from %s: %s (%s)\n", run->name,
+        GST_OBJECT_NAME (GST_MESSAGE_SRC (msg)), err->message,
+        GST_STR_NULL (debug));
+    g_clear_error (&err);
+    g_free (debug);
+  } else if (run->n_frames == 0) {
+    g_printerr ("%s: No frames arrived at the sink\n", run->name);
+  } else {
+    GstClockTime duration = run->last_frame - run->first_frame;
+
+    if (run->n_frames > 1 && duration > 0)
+      result->fps = (gdouble) (run->n_frames - 1) * GST_SECOND / duration;
+    else
+      result->fps = 0;
+    result->latency_mean_ms = run->n_latency ?
+        (gdouble) run->latency_total / run->n_latency / GST_MSECOND : 0;
+    result->latency_max_ms = (gdouble) run->latency_max / GST_MSECOND;
+    result->cpu_ms_per_frame = (gdouble) cpu / run->n_frames / GST_MSECOND;
+    ret = TRUE;
+  }
+  if (msg)
+    gst_message_unref (msg);
+
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+
+done:
+  gst_object_unref (pipeline);
+
+  return ret;
+}
+
+/* Runs the setup pipeline of a case until EOS, without measuring it */
+static gboolean
+bench_run_setup (const gchar * desc, BenchRun * run)
+{
+  GstElement *pipeline;
+  GstBus *bus;
+  GstMessage *msg;
+  GError *err = NULL;
+  gchar *expanded;
+  gboolean ret = FALSE;
+
+  expanded = bench_expand_pipeline (desc, run);
+  pipeline = gst_parse_launch (expanded, &err);
+  if (!pipeline || err) {
+    g_printerr ("%s: Failed to create setup pipeline '%s': %s\n", run->name,
+        expanded, err ? err->message : "unknown error");
+    g_clear_error (&err);
+    if (pipeline)
+      gst_object_unref (pipeline);
+    g_free (expanded);
+    return FALSE;
+  }
+  g_free (expanded);
+
+  if (gst_element_set_state (pipeline,
+          GST_STATE_PLAYING) == GST_STATE_CHANGE_FAILURE) {
+    g_printerr ("%s: Failed to start setup pipeline\n", run->name);
+    goto done;
+  }
+
+  bus = gst_element_get_bus (pipeline);
+  msg = gst_bus_timed_pop_filtered (bus, timeout * GST_SECOND,
+      GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+  gst_object_unref (bus);
+
+  if (!msg) {
+    g_printerr ("%s: Setup timeout after %d seconds\n", run->name, timeout);
+  } else if (GST_MESSAGE_TYPE (msg) == GST_MESSAGE_ERROR) {
+    gchar *debug = NULL;
+
+    gst_message_parse_error (msg, &err, &debug);
+    g_printerr ("%s: Setup error from %s: %s (%s)\n", run->name,
+        GST_OBJECT_NAME (GST_MESSAGE_SRC (msg)), err->message,
+        GST_STR_NULL (debug));
+    g_clear_error (&err);
+    g_free (debug);
+  } else {
+    ret = TRUE;
+  }
+  if (msg)
+    gst_message_unref (msg);
+
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+
+done:
+  gst_object_unref (pipeline);
+
+  return ret;
+}
+
+/* Key of a result, also used for the baseline */
+static gchar *
+bench_result_key (const gchar * name, gint width, gint height)
+{
+  return g_strdup_printf ("%s,%d,%d", name, width, height);
+}
+
+/* Reads the fps and CPU time per frame columns of a CSV file
+ * written before, keyed by case and resolution */
+static GHashTable *
+bench_load_baseline (const gchar * filename)
+{
+  GHashTable *baseline;
+  gchar *contents = NULL;
+  gchar **lines;
+  gint i;
+
+  if (!g_file_get_contents (filename, &contents, NULL, NULL))
+    return NULL;
+
+  baseline = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+  lines = g_strsplit (contents, "\n", -1);
+  for (i = 0; lines[i]; i++) {
+    gchar **fields = g_strsplit (lines[i], ",", -1);
+
+    if (g_strv_length (fields) == 9 && strcmp (fields[0], "case") != 0) {
+      BenchResult *result = g_new0 (BenchResult, 1);
+
+      result->fps = g_ascii_strtod (fields[4], NULL);
+      result->cpu_ms_per_frame = g_ascii_strtod (fields[7], NULL);
+      g_hash_table_insert (baseline, bench_result_key (fields[0],
+              atoi (fields[1]), atoi (fields[2])), result);
+    }
+    g_strfreev (fields);
+  }
+  g_strfreev (lines);
+  g_free (contents);
+
+  return baseline;
+}
+
+/* TRUE if the result is within the thresholds of the baseline */
+static gboolean
+bench_check_baseline (GHashTable * baseline, BenchRun * run,
+    BenchResult * result)
+{
+  BenchResult *base;
+  gchar *key;
+  gboolean ret = TRUE;
+
+  key = bench_result_key (run->name, run->width, run->height);
+  base = g_hash_table_lookup (baseline, key);
+  g_free (key);
+  if (!base)
+    return TRUE;
+
+  if (base->fps > 0
+      && result->fps < base->fps * (1.0 - max_fps_drop / 100.0)) {
+    g_printerr ("%s %dx%d: fps regressed from %.2f to %.2f\n", run->name,
+        run->width, run->height, base->fps, result->fps);
+    ret = FALSE;
+  }
+  if (base->cpu_ms_per_frame > 0
+      && result->cpu_ms_per_frame >
+      base->cpu_ms_per_frame * (1.0 + max_cpu_increase / 100.0)) {
+    g_printerr ("%s %dx%d: CPU time per frame regressed from %.3f ms to "
+        "%.3f ms\n", run->name, run->width, run->height,
+        base->cpu_ms_per_frame, result->cpu_ms_per_frame);
+    ret = FALSE;
+  }
+
+  return ret;
+}
+
+static void
+bench_write_result (FILE * out, BenchRun * run, BenchResult * result)
+{
+  gchar fps[G_ASCII_DTOSTR_BUF_SIZE];
+  gchar latency_mean[G_ASCII_DTOSTR_BUF_SIZE];
+  gchar latency_max[G_ASCII_DTOSTR_BUF_SIZE];
+  gchar cpu[G_ASCII_DTOSTR_BUF_SIZE];
+
+  /* Always with a '.' as decimal point */
+  g_ascii_formatd (fps, sizeof (fps), "%.2f", result->fps);
+  g_ascii_formatd (latency_mean, sizeof (latency_mean), "%.3f",
+      result->latency_mean_ms);
+  g_ascii_formatd (latency_max, sizeof (latency_max), "%.3f",
+      result->latency_max_ms);
+  g_ascii_formatd (cpu, sizeof (cpu), "%.3f", result->cpu_ms_per_frame);
+
+  fprintf (out, "%s,%d,%d,%" G_GUINT64_FORMAT ",%s,%s,%s,%s,%"
+      G_GUINT64_FORMAT "\n", run->name, run->width, run->height,
+      run->n_frames, fps, latency_mean, latency_max, cpu,
+      result->peak_rss_kb);
+  fflush (out);
+}
+
+/* Runs one case of the suite at all its resolutions, returns
+ * FALSE if a run failed or regressed */
+static gboolean
+bench_run_case (GKeyFile * suite, const gchar * name, FILE * out,
+    GHashTable * baseline)
+{
+  gchar *desc, *setup;
+  gchar *input_dir = NULL;
+  gchar **resolutions;
+  gint frames;
+  gint i;
+  gboolean ret = TRUE;
+
+  desc = g_key_file_get_string (suite, name, "pipeline", NULL);
+  if (!desc) {
+    g_printerr ("%s: No pipeline\n", name);
+    return FALSE;
+  }
+  setup = g_key_file_get_string (suite, name, "setup", NULL);
+  if (setup) {
+    GError *err = NULL;
+
+    if (!(input_dir = g_dir_make_tmp ("omxbenchsuite-XXXXXX", &err))) {
+      g_printerr ("%s: Failed to create input directory: %s\n", name,
+          err->message);
+      g_clear_error (&err);
+      g_free (setup);
+      g_free (desc);
+      return FALSE;
+    }
+  }
+  frames = g_key_file_get_integer (suite, name, "frames", NULL);
+  if (frames <= 0)
+    frames = 300;
+
+  resolutions = g_key_file_get_string_list (suite, name, "resolutions", NULL,
+      NULL);
+  /* Run once without a resolution otherwise, e.g. for audio */
+  if (!resolutions || !resolutions[0]) {
+    g_strfreev (resolutions);
+    resolutions = g_new0 (gchar *, 2);
+    resolutions[0] = g_strdup ("0x0");
+  }
+
+  for (i = 0; resolutions[i]; i++) {
+    BenchRun run;
+    BenchResult result;
+
+    memset (&run, 0, sizeof (run));
+    memset (&result, 0, sizeof (result));
+    run.name = name;
+    run.frames = frames;
+    if (sscanf (resolutions[i], "%dx%d", &run.width, &run.height) != 2) {
+      g_printerr ("%s: Invalid resolution '%s'\n", name, resolutions[i]);
+      ret = FALSE;
+      continue;
+    }
+    if (setup) {
+      gchar *basename;
+
+      basename = g_strdup_printf ("%s-%dx%d", name, run.width, run.height);
+      run.input = g_build_filename (input_dir, basename, NULL);
+      g_free (basename);
+
+      g_printerr ("Setting up %s at %dx%d\n", name, run.width, run.height);
+      if (!bench_run_setup (setup, &run)) {
+        g_unlink (run.input);
+        g_free (run.input);
+        ret = FALSE;
+        continue;
+      }
+    }
+
+    g_mutex_init (&run.lock);
+    run.pending = g_hash_table_new_full (g_int64_hash, g_int64_equal,
+        bench_slice_free_time, bench_slice_free_time);
+
+    g_printerr ("Running %s at %dx%d\n", name, run.width, run.height);
+    if (bench_run_pipeline (desc, &run, &result)) {
+      bench_write_result (out, &run, &result);
+      if (baseline && !bench_check_baseline (baseline, &run, &result))
+        ret = FALSE;
+    } else {
+      ret = FALSE;
+    }
+
+    g_hash_table_unref (run.pending);
+    g_mutex_clear (&run.lock);
+
+    if (run.input) {
+      g_unlink (run.input);
+      g_free (run.input);
+    }
+  }
+
+  if (input_dir) {
+    g_rmdir (input_dir);
+    g_free (input_dir);
+  }
+
+  g_strfreev (resolutions);
+  g_free (setup);
+  g_free (desc);
+
+  return ret;
+}
+
+int
+main (int argc, char **argv)
+{
+  GOptionContext *ctx;
+  GError *err = NULL;
+  GKeyFile *suite;
+  GHashTable *baseline = NULL;
+  gchar **cases;
+  FILE *out = stdout;
+  gint i, ret = 0;
+
+  ctx = g_option_context_new ("- run a pipeline benchmark suite");
+  g_option_context_add_main_entries (ctx, entries, NULL);
+  g_option_context_add_group (ctx, gst_init_get_option_group ());
+
+  /* Must be set before the plugin is loaded */
+  for (i = 1; i < argc - 1; i++) {
+    if (strcmp (argv[i], "--config-dir") == 0 || strcmp (argv[i], "-c") == 0)
+      g_setenv ("GST_OMX_CONFIG_DIR", argv[i + 1], TRUE);
+    else if (g_str_has_prefix (argv[i], "--config-dir="))
+      g_setenv ("GST_OMX_CONFIG_DIR", argv[i] + strlen ("--config-dir="),
+          TRUE);
+  }
+
+  if (!g_option_context_parse (ctx, &argc, &argv, &err)) {
+    g_printerr ("Failed to parse options: %s\n", err->message);
+    g_clear_error (&err);
+    g_option_context_free (ctx);
+    return 1;
+  }
+  g_option_context_free (ctx);
+
+  if (!suite_file) {
+    g_printerr ("Usage: %s -s SUITE [OPTION...]\n", argv[0]);
+    return 1;
+  }
+
+  suite = g_key_file_new ();
+  if (!g_key_file_load_from_file (suite, suite_file, G_KEY_FILE_NONE, &err)) {
+    g_printerr ("Failed to load suite '%s': %s\n", suite_file, err->message);
+    g_clear_error (&err);
+    g_key_file_free (suite);
+    return 1;
+  }
+
+  if (baseline_file && !(baseline = bench_load_baseline (baseline_file))) {
+    g_printerr ("Failed to load baseline '%s'\n", baseline_file);
+    g_key_file_free (suite);
+    return 1;
+  }
+
+  if (output_file && !(out = fopen (output_file, "w"))) {
+    g_printerr ("Failed to open '%s'\n", output_file);
+    g_key_file_free (suite);
+    return 1;
+  }
+
+  fprintf (out, "%s\n", BENCH_CSV_HEADER);
+
+  cases = g_key_file_get_groups (suite, NULL);
+  for (i = 0; cases[i]; i++) {
+    if (only_case && strcmp (only_case, cases[i]) != 0)
+      continue;
+    if (!bench_run_case (suite, cases[i], out, baseline))
+      ret = 1;
+  }
+  g_strfreev (cases);
+
+  if (out != stdout)
+    fclose (out);
+  if (baseline)
+    g_hash_table_unref (baseline);
+  g_key_file_free (suite);
+
+  return ret;
+}
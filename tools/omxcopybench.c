@@ -0,0 +1,361 @@
+/*
+ * Copyright (C) 2026, the gst-omx authors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+/* Measures the frame copies between OpenMAX buffers and video frames
+ * that the decoders and encoders do if the strides differ, see
+ * gstomxvideocopy.c. All combinations of the given resolutions, stride
+ * and slice height alignments and buffer offsets are run for I420 and
+ * NV12 in both directions and the throughput of the visible frame
+ * data is printed in GB/s.
+ *
+ * Before it is measured, every combination is checked against a plain
+ * row by row copy. Mismatches are reported and make the benchmark
+ * exit with an error.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <gst/gst.h>
+#include <gst/video/video.h>
+
+#include "gstomxvideocopy.h"
+
+static gchar *resolutions_string = NULL;
+static gchar *stride_aligns_string = NULL;
+static gchar *slice_aligns_string = NULL;
+static gchar *offsets_string = NULL;
+static gdouble min_duration = 0.2;
+
+static GOptionEntry entries[] = {
+  {"resolutions", 'r', 0, G_OPTION_ARG_STRING, &resolutions_string,
+      "Resolutions (default: 352x288,1280x720,1920x1080,3840x2160)",
+      "WxH,..."},
+  {"stride-aligns", 's', 0, G_OPTION_ARG_STRING, &stride_aligns_string,
+      "Alignments of the OpenMAX stride (default: 1,16,32,64,128)", "N,..."},
+  {"slice-height-aligns", 'l', 0, G_OPTION_ARG_STRING, &slice_aligns_string,
+      "Alignments of the OpenMAX slice height (default: 1,16,32)", "N,..."},
+  {"offsets", 'o', 0, G_OPTION_ARG_STRING, &offsets_string,
+      "Offsets of the data inside the OpenMAX buffer (default: 0,1,8)",
+      "N,..."},
+  {"duration", 'd', 0, G_OPTION_ARG_DOUBLE, &min_duration,
+      "Minimum duration per measurement in seconds (default: 0.2)", "SECS"},
+  {NULL}
+};
+
+static guint *
+parse_list (const gchar * s, const gchar * def, guint * n)
+{
+  gchar **items = g_strsplit (s ? s : def, ",", -1);
+  guint *values;
+  guint i;
+
+  *n = g_strv_length (items);
+  values = g_new (guint, *n);
+  for (i = 0; i < *n; i++)
+    values[i] = g_ascii_strtoull (items[i], NULL, 10);
+  g_strfreev (items);
+
+  return values;
+}
+
+static guint
+round_up (guint val, guint align)
+{
+  if (align <= 1)
+    return val;
+  return ((val + align - 1) / align) * align;
+}
+
+/* Layout of a plane inside the OpenMAX buffer as the OpenMAX IL
+ * specification describes it, kept separate from gstomxvideocopy.c */
+static void
+reference_plane_layout (GstVideoFormat format, guint plane, guint stride,
+    guint slice_height, gsize * offset, guint * plane_stride)
+{
+  if (format == GST_VIDEO_FORMAT_I420) {
+    *plane_stride = plane == 0 ? stride : stride / 2;
+    *offset = plane == 0 ? 0 : (gsize) stride * slice_height;
+    if (plane == 2)
+      *offset += (gsize) (stride / 2) * (slice_height / 2);
+  } else {
+    *plane_stride = stride;
+    *offset = plane == 0 ? 0 : (gsize) stride * slice_height;
+  }
+}
+
+/* Plain row by row copy between frame and the OpenMAX buffer */
+static void
+reference_copy (GstVideoFrame * frame, guint8 * omx_data, guint stride,
+    guint slice_height, gboolean to_frame)
+{
+  gsize plane_offset;
+  guint plane_stride, row_size, p, y;
+
+  for (p = 0; p < GST_VIDEO_FRAME_N_PLANES (frame); p++) {
+    guint8 *data = GST_VIDEO_FRAME_PLANE_DATA (frame, p);
+    gint frame_stride = GST_VIDEO_FRAME_PLANE_STRIDE (frame, p);
+
+    reference_plane_layout (GST_VIDEO_FRAME_FORMAT (frame), p, stride,
+        slice_height, &plane_offset, &plane_stride);
+    row_size = GST_VIDEO_FRAME_COMP_WIDTH (frame, p) *
+        GST_VIDEO_FRAME_COMP_PSTRIDE (frame, p);
+
+    for (y = 0; y < GST_VIDEO_FRAME_COMP_HEIGHT (frame, p); y++) {
+      guint8 *omx_row = omx_data + plane_offset + (gsize) y * plane_stride;
+      guint8 *frame_row = data + (gsize) y * frame_stride;
+
+      if (to_frame)
+        memcpy (frame_row, omx_row, row_size);
+      else
+        memcpy (omx_row, frame_row, row_size);
+    }
+  }
+}
+
+/* Returns FALSE if a single copy doesn't give the same
+ * result as a plain row by row copy */
+static gboolean
+verify_one (GstVideoFormat format, guint width, guint height, guint stride,
+    guint slice_height, guint offset, gboolean to_frame)
+{
+  GstVideoInfo info;
+  GstVideoFrame frame, ref_frame;
+  GstBuffer *buffer, *ref_buffer;
+  guint8 *omx_mem, *ref_mem;
+  gsize omx_size, size, filled, i;
+  guint8 *data, *ref_data;
+  gboolean ok;
+
+  gst_video_info_set_format (&info, format, width, height);
+  size = GST_VIDEO_INFO_SIZE (&info);
+  buffer = gst_buffer_new_allocate (NULL, size, NULL);
+  ref_buffer = gst_buffer_new_allocate (NULL, size, NULL);
+  gst_buffer_memset (buffer, 0, 0, size);
+  gst_buffer_memset (ref_buffer, 0, 0, size);
+  if (!gst_video_frame_map (&frame, &info, buffer, GST_MAP_READWRITE)) {
+    gst_buffer_unref (buffer);
+    gst_buffer_unref (ref_buffer);
+    return FALSE;
+  }
+  if (!gst_video_frame_map (&ref_frame, &info, ref_buffer, GST_MAP_READWRITE)) {
+    gst_video_frame_unmap (&frame);
+    gst_buffer_unref (buffer);
+    gst_buffer_unref (ref_buffer);
+    return FALSE;
+  }
+
+  omx_size = (gsize) stride * slice_height * 3 / 2;
+  omx_mem = g_malloc0 (omx_size + offset);
+  ref_mem = g_malloc0 (omx_size);
+
+  /* The source gets a pattern, the destinations start out equal */
+  if (to_frame) {
+    for (i = 0; i < omx_size; i++)
+      omx_mem[offset + i] = (guint8) (i * 31 + 7);
+    ok = gst_omx_video_copy_to_frame (&frame, omx_mem + offset, omx_size,
+        stride, slice_height);
+    reference_copy (&ref_frame, omx_mem + offset, stride, slice_height, TRUE);
+  } else {
+    data = GST_VIDEO_FRAME_PLANE_DATA (&frame, 0);
+    ref_data = GST_VIDEO_FRAME_PLANE_DATA (&ref_frame, 0);
+    for (i = 0; i < size; i++)
+      data[i] = ref_data[i] = (guint8) (i * 13 + 3);
+    ok = gst_omx_video_copy_from_frame (&frame, omx_mem + offset, omx_size,
+        stride, slice_height, &filled);
+    reference_copy (&ref_frame, ref_mem, stride, slice_height, FALSE);
+  }
+
+  /* Everything, including the padding that must not be touched */
+  if (ok && to_frame)
+    ok = memcmp (GST_VIDEO_FRAME_PLANE_DATA (&frame, 0),
+        GST_VIDEO_FRAME_PLANE_DATA (&ref_frame, 0), size) == 0;
+  else if (ok)
+    ok = memcmp (omx_mem + offset, ref_mem, omx_size) == 0;
+
+  gst_video_frame_unmap (&frame);
+  gst_video_frame_unmap (&ref_frame);
+  gst_buffer_unref (buffer);
+  gst_buffer_unref (ref_buffer);
+  g_free (omx_mem);
+  g_free (ref_mem);
+
+  return ok;
+}
+
+/* Returns the throughput in GB/s of the visible frame data or
+ * a negative number if the copy failed */
+static gdouble
+run_one (GstVideoFormat format, guint width, guint height, guint stride,
+    guint slice_height, guint offset, gboolean to_frame)
+{
+  GstVideoInfo info;
+  GstVideoFrame frame;
+  GstBuffer *buffer;
+  guint8 *omx_mem;
+  gsize omx_size, payload = 0, filled;
+  GstClockTime start, elapsed;
+  guint64 iterations = 0;
+  gboolean ok = TRUE;
+  guint i;
+
+  gst_video_info_set_format (&info, format, width, height);
+  buffer = gst_buffer_new_allocate (NULL, GST_VIDEO_INFO_SIZE (&info), NULL);
+  if (!gst_video_frame_map (&frame, &info, buffer,
+          to_frame ? GST_MAP_WRITE : GST_MAP_READ)) {
+    gst_buffer_unref (buffer);
+    return -1.0;
+  }
+
+  for (i = 0; i < GST_VIDEO_FRAME_N_PLANES (&frame); i++)
+    payload += (gsize) GST_VIDEO_FRAME_COMP_WIDTH (&frame, i) *
+        GST_VIDEO_FRAME_COMP_PSTRIDE (&frame, i) *
+        GST_VIDEO_FRAME_COMP_HEIGHT (&frame, i);
+
+  omx_size = (gsize) stride * slice_height * 3 / 2;
+  omx_mem = g_malloc0 (omx_size + offset);
+
+  start = gst_util_get_timestamp ();
+  do {
+    /* Check the time only every few copies */
+    for (i = 0; i < 8 && ok; i++) {
+      if (to_frame)
+        ok = gst_omx_video_copy_to_frame (&frame, omx_mem + offset, omx_size,
+            stride, slice_height);
+      else
+        ok = gst_omx_video_copy_from_frame (&frame, omx_mem + offset,
+            omx_size, stride, slice_height, &filled);
+      iterations++;
+    }
+    elapsed = gst_util_get_timestamp () - start;
+  } while (ok && elapsed < min_duration * GST_SECOND);
+
+  gst_video_frame_unmap (&frame);
+  gst_buffer_unref (buffer);
+  g_free (omx_mem);
+
+  if (!ok || elapsed == 0)
+    return -1.0;
+
+  return (gdouble) payload * iterations / ((gdouble) elapsed / GST_SECOND) /
+      1e9;
+}
+
+int
+main (int argc, char **argv)
+{
+  static const GstVideoFormat formats[] = {
+    GST_VIDEO_FORMAT_I420, GST_VIDEO_FORMAT_NV12
+  };
+  GOptionContext *ctx;
+  GError *err = NULL;
+  gchar **resolutions;
+  guint *stride_aligns, *slice_aligns, *offsets;
+  guint n_stride_aligns, n_slice_aligns, n_offsets;
+  guint f, r, s, l, o, d;
+  guint n_mismatches = 0;
+
+  ctx = g_option_context_new ("- benchmark the video frame copies");
+  g_option_context_add_main_entries (ctx, entries, NULL);
+  g_option_context_add_group (ctx, gst_init_get_option_group ());
+  if (!g_option_context_parse (ctx, &argc, &argv, &err)) {
+    g_printerr ("Failed to parse options: %s\n", err->message);
+    g_clear_error (&err);
+    g_option_context_free (ctx);
+    return 1;
+  }
+  g_option_context_free (ctx);
+
+  resolutions = g_strsplit (resolutions_string ? resolutions_string :
+      "352x288,1280x720,1920x1080,3840x2160", ",", -1);
+  stride_aligns = parse_list (stride_aligns_string, "1,16,32,64,128",
+      &n_stride_aligns);
+  slice_aligns = parse_list (slice_aligns_string, "1,16,32", &n_slice_aligns);
+  offsets = parse_list (offsets_string, "0,1,8", &n_offsets);
+
+  g_print ("%-6s %-10s %6s %6s %6s %-9s %8s\n", "format", "size", "stride",
+      "slice", "offset", "direction", "GB/s");
+
+  for (f = 0; f < G_N_ELEMENTS (formats); f++) {
+    for (r = 0; resolutions[r]; r++) {
+      guint width, height;
+
+      if (sscanf (resolutions[r], "%ux%u", &width, &height) != 2
+          || width == 0 || height == 0) {
+        g_printerr ("Invalid resolution '%s'\n", resolutions[r]);
+        continue;
+      }
+
+      for (s = 0; s < n_stride_aligns; s++) {
+        /* Even for the chroma planes */
+        guint stride = round_up (round_up (width, 2), stride_aligns[s]);
+
+        for (l = 0; l < n_slice_aligns; l++) {
+          guint slice_height =
+              round_up (round_up (height, 2), slice_aligns[l]);
+
+          for (o = 0; o < n_offsets; o++) {
+            for (d = 0; d < 2; d++) {
+              gboolean correct = verify_one (formats[f], width, height,
+                  stride, slice_height, offsets[o], d == 0);
+              gdouble gbps = -1.0;
+
+              if (correct)
+                gbps = run_one (formats[f], width, height, stride,
+                    slice_height, offsets[o], d == 0);
+              else
+                n_mismatches++;
+
+              g_print ("%-6s %4ux%-5u %6u %6u %6u %-9s ",
+                  gst_video_format_to_string (formats[f]), width, height,
+                  stride, slice_height, offsets[o],
+                  d == 0 ? "to-frame" : "from-frame");
+              if (!correct)
+                g_print ("%8s\n", "mismatch");
+              else if (gbps < 0)
+                g_print ("%8s\n", "failed");
+              else
+                g_print ("%8.3f\n", gbps);
+            }
+          }
+        }
+      }
+    }
+  }
+
+  g_strfreev (resolutions);
+  g_free (stride_aligns);
+  g_free (slice_aligns);
+  g_free (offsets);
+  g_free (resolutions_string);
+  g_free (stride_aligns_string);
+  g_free (slice_aligns_string);
+  g_free (offsets_string);
+
+  if (n_mismatches > 0) {
+    g_printerr ("%u copies differ from a plain row by row copy\n",
+        n_mismatches);
+    return 1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,493 @@
+/*
+ * Copyright (C) 2026, the gst-omx authors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation
+ * version 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ *
+ */
+
+/* Runs N copies of a pipeline concurrently in one process, for every N
+ * of a list, and reports for each N:
+ *
+ *   fps          frames per second at the elements named "sink",
+ *                summed over all pipelines
+ *   latency      mean and worst per-pipeline mean latency through
+ *                the elements named "omx"
+ *   threads      peak number of threads of the process
+ *   cores        CPU time of the process divided by the wall time
+ *   efficiency   fps per core relative to fps per core with the first N
+ *
+ * The results are written as CSV to stdout, followed by a plot of the
+ * efficiency on stderr. The default pipeline encodes and decodes again,
+ * so it contains two components per instance.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <gst/gst.h>
+
+#define DEFAULT_PIPELINE \
+    "videotestsrc num-buffers={frames} ! " \
+    "video/x-raw,format=I420,width={width},height={height},framerate=30/1 ! " \
+    "omxh264enc ! omxh264dec name=omx ! fakesink name=sink sync=false"
+
+typedef struct
+{
+  GstElement *pipeline;
+
+  GMutex lock;
+  /* Buffer timestamp to the time it entered the element */
+  GHashTable *pending;
+  guint64 n_latency;
+  GstClockTime latency_total;
+
+  guint64 n_frames;
+  gboolean done;
+} StressInstance;
+
+typedef struct
+{
+  guint n;
+  gdouble fps;
+  gdouble latency_mean_ms, latency_worst_ms;
+  guint peak_threads;
+  gdouble cores;
+  gdouble efficiency;
+} StressResult;
+
+static gchar *pipeline_desc = NULL;
+static gchar *instances_string = NULL;
+static gchar *config_dir = NULL;
+static gint width = 352;
+static gint height = 288;
+static gint frames = 300;
+static gint timeout = 600;
+
+static GOptionEntry entries[] = {
+  {"pipeline", 'p', 0, G_OPTION_ARG_STRING, &pipeline_desc,
+      "Pipeline with elements named 'sink' and 'omx'", "PIPELINE"},
+  {"instances", 'n', 0, G_OPTION_ARG_STRING, &instances_string,
+      "Numbers of concurrent pipelines (default: 1,2,4,8,16,32,64,128,256)",
+      "N,..."},
+  {"config-dir", 'c', 0, G_OPTION_ARG_FILENAME, &config_dir,
+      "Directory with the gstomx.conf to use", "DIR"},
+  {"width", 'W', 0, G_OPTION_ARG_INT, &width,
+      "Width (default: 352)", "WIDTH"},
+  {"height", 'H', 0, G_OPTION_ARG_INT, &height,
+      "Height (default: 288)", "HEIGHT"},
+  {"frames", 'f', 0, G_OPTION_ARG_INT, &frames,
+      "Frames per pipeline (default: 300)", "N"},
+  {"timeout", 't', 0, G_OPTION_ARG_INT, &timeout,
+      "Timeout per step in seconds (default: 600)", "SECONDS"},
+  {NULL}
+};
+
+static volatile gint sampler_running = 0;
+static volatile gint peak_threads = 0;
+
+static GstClockTime
+stress_cpu_time (void)
+{
+  struct rusage usage;
+
+  if (getrusage (RUSAGE_SELF, &usage) != 0)
+    return 0;
+
+  return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * GST_SECOND +
+      (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * GST_USECOND;
+}
+
+static gint
+stress_count_threads (void)
+{
+  GDir *dir = g_dir_open ("/proc/self/task", 0, NULL);
+  gint n = 0;
+
+  if (!dir)
+    return 0;
+  while (g_dir_read_name (dir))
+    n++;
+  g_dir_close (dir);
+
+  return n;
+}
+
+static gpointer
+stress_sampler_thread (gpointer data)
+{
+  while (g_atomic_int_get (&sampler_running)) {
+    gint n = stress_count_threads ();
+
+    if (n > g_atomic_int_get (&peak_threads))
+      g_atomic_int_set (&peak_threads, n);
+    g_usleep (50 * G_TIME_SPAN_MILLISECOND);
+  }
+
+  return NULL;
+}
+
+static void
+stress_slice_free_time (gpointer data)
+{
+  g_slice_free (GstClockTime, data);
+}
+
+static GstPadProbeReturn
+stress_omx_sink_probe (GstPad * pad, GstPadProbeInfo * info,
+    gpointer user_data)
+{
+  StressInstance *inst = user_data;
+  GstBuffer *buf = GST_PAD_PROBE_INFO_BUFFER (info);
+  GstClockTime *now;
+
+  if (!GST_BUFFER_PTS_IS_VALID (buf))
+    return GST_PAD_PROBE_OK;
+
+  now = g_slice_new (GstClockTime);
+  *now = gst_util_get_timestamp ();
+
+  g_mutex_lock (&inst->lock);
+  g_hash_table_insert (inst->pending,
+      g_slice_dup (GstClockTime, &GST_BUFFER_PTS (buf)), now);
+  g_mutex_unlock (&inst->lock);
+
+  return GST_PAD_PROBE_OK;
+}
+
+static GstPadProbeReturn
+stress_omx_src_probe (GstPad * pad, GstPadProbeInfo * info,
+    gpointer user_data)
+{
+  StressInstance *inst = user_data;
+  GstBuffer *buf = GST_PAD_PROBE_INFO_BUFFER (info);
+  GstClockTime now = gst_util_get_timestamp ();
+  GstClockTime *arrival;
+
+  if (!GST_BUFFER_PTS_IS_VALID (buf))
+    return GST_PAD_PROBE_OK;
+
+  g_mutex_lock (&inst->lock);
+  arrival = g_hash_table_lookup (inst->pending, &GST_BUFFER_PTS (buf));
+  if (arrival) {
+    inst->n_latency++;
+    inst->latency_total += now - *arrival;
+    g_hash_table_remove (inst->pending, &GST_BUFFER_PTS (buf));
+  }
+  g_mutex_unlock (&inst->lock);
+
+  return GST_PAD_PROBE_OK;
+}
+
+static GstPadProbeReturn
+stress_sink_probe (GstPad * pad, GstPadProbeInfo * info, gpointer user_data)
+{
+  StressInstance *inst = user_data;
+
+  /* Only the streaming thread of the sink writes this */
+  inst->n_frames++;
+
+  return GST_PAD_PROBE_OK;
+}
+
+static gboolean
+stress_add_probe (GstElement * pipeline, const gchar * element_name,
+    const gchar * pad_name, GstPadProbeCallback callback,
+    StressInstance * inst)
+{
+  GstElement *element;
+  GstPad *pad;
+
+  element = gst_bin_get_by_name (GST_BIN (pipeline), element_name);
+  if (!element)
+    return FALSE;
+
+  pad = gst_element_get_static_pad (element, pad_name);
+  gst_object_unref (element);
+  if (!pad)
+    return FALSE;
+
+  gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_BUFFER, callback, inst, NULL);
+  gst_object_unref (pad);
+
+  return TRUE;
+}
+
+static gchar *
+stress_expand_pipeline (const gchar * desc)
+{
+  GString *s = g_string_new (NULL);
+  const gchar *p = desc;
+
+  while (*p) {
+    if (g_str_has_prefix (p, "{width}")) {
+      g_string_append_printf (s, "%d", width);
+      p += strlen ("{width}");
+    } else if (g_str_has_prefix (p, "{height}")) {
+      g_string_append_printf (s, "%d", height);
+      p += strlen ("{height}");
+    } else if (g_str_has_prefix (p, "{frames}")) {
+      g_string_append_printf (s, "%d", frames);
+      p += strlen ("{frames}");
+    } else {
+      g_string_append_c (s, *p++);
+    }
+  }
+
+  return g_string_free (s, FALSE);
+}
+
+static gboolean
+stress_instance_init (StressInstance * inst, const gchar * desc)
+{
+  GError *err = NULL;
+
+  memset (inst, 0, sizeof (*inst));
+  g_mutex_init (&inst->lock);
+  inst->pending = g_hash_table_new_full (g_int64_hash, g_int64_equal,
+      stress_slice_free_time, stress_slice_free_time);
+
+  inst->pipeline = gst_parse_launch (desc, &err);
+  if (!inst->pipeline || err) {
+    g_printerr ("Failed to create pipeline: %s\n",
+        err ? err->message : "unknown error");
+    g_clear_error (&err);
+    return FALSE;
+  }
+
+  if (!stress_add_probe (inst->pipeline, "sink", "sink", stress_sink_probe,
+          inst)) {
+    g_printerr ("Pipeline needs an element named 'sink'\n");
+    return FALSE;
+  }
+  if (stress_add_probe (inst->pipeline, "omx", "sink", stress_omx_sink_probe,
+          inst))
+    stress_add_probe (inst->pipeline, "omx", "src", stress_omx_src_probe,
+        inst);
+
+  return TRUE;
+}
+
+static void
+stress_instance_clear (StressInstance * inst)
+{
+  if (inst->pipeline) {
+    gst_element_set_state (inst->pipeline, GST_STATE_NULL);
+    gst_object_unref (inst->pipeline);
+  }
+  g_hash_table_unref (inst->pending);
+  g_mutex_clear (&inst->lock);
+}
+
+/* Waits until all pipelines are done, FALSE on errors or timeout */
+static gboolean
+stress_wait (StressInstance * insts, guint n)
+{
+  gint64 deadline = g_get_monotonic_time () + timeout * G_TIME_SPAN_SECOND;
+  gboolean ret = TRUE;
+  guint i;
+
+  for (i = 0; i < n; i++) {
+    GstBus *bus = gst_element_get_bus (insts[i].pipeline);
+    gint64 remaining = deadline - g_get_monotonic_time ();
+    GstMessage *msg;
+
+    msg = gst_bus_timed_pop_filtered (bus,
+        MAX (remaining, 0) * GST_USECOND, GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+    gst_object_unref (bus);
+
+    if (!msg) {
+      g_printerr ("Pipeline %u: timeout\n", i);
+      ret = FALSE;
+    } else if (GST_MESSAGE_TYPE (msg) == GST_MESSAGE_ERROR) {
+      GError *err = NULL;
+
+      gst_message_parse_error (msg, &err, NULL);
+      g_printerr ("Pipeline %u: error from %s: %s\n", i,
+          GST_OBJECT_NAME (GST_MESSAGE_SRC (msg)), err->message);
+      g_clear_error (&err);
+      ret = FALSE;
+    } else {
+      insts[i].done = TRUE;
+    }
+    if (msg)
+      gst_message_unref (msg);
+  }
+
+  return ret;
+}
+
+static gboolean
+stress_run (const gchar * desc, guint n, StressResult * result)
+{
+  StressInstance *insts = g_new0 (StressInstance, n);
+  GThread *sampler;
+  GstClockTime start, wall, cpu_start, cpu;
+  guint64 total_frames = 0;
+  gdouble latency_sum = 0;
+  guint i, n_init, n_latency = 0;
+  gboolean ret = TRUE;
+
+  for (n_init = 0; n_init < n && ret; n_init++)
+    ret = stress_instance_init (&insts[n_init], desc);
+
+  if (ret) {
+    g_atomic_int_set (&peak_threads, stress_count_threads ());
+    g_atomic_int_set (&sampler_running, 1);
+    sampler = g_thread_new ("omxstress-sampler", stress_sampler_thread, NULL);
+
+    cpu_start = stress_cpu_time ();
+    start = gst_util_get_timestamp ();
+    for (i = 0; i < n && ret; i++) {
+      if (gst_element_set_state (insts[i].pipeline,
+              GST_STATE_PLAYING) == GST_STATE_CHANGE_FAILURE) {
+        g_printerr ("Pipeline %u: failed to start\n", i);
+        ret = FALSE;
+      }
+    }
+    if (ret)
+      ret = stress_wait (insts, n);
+    wall = gst_util_get_timestamp () - start;
+    cpu = stress_cpu_time () - cpu_start;
+
+    g_atomic_int_set (&sampler_running, 0);
+    g_thread_join (sampler);
+
+    memset (result, 0, sizeof (*result));
+    result->n = n;
+    for (i = 0; i < n; i++) {
+      total_frames += insts[i].n_frames;
+      if (insts[i].n_latency > 0) {
+        gdouble mean = (gdouble) insts[i].latency_total /
+            insts[i].n_latency / GST_MSECOND;
+
+        latency_sum += mean;
+        n_latency++;
+        result->latency_worst_ms = MAX (result->latency_worst_ms, mean);
+      }
+    }
+    result->fps = wall > 0 ? (gdouble) total_frames * GST_SECOND / wall : 0;
+    result->latency_mean_ms = n_latency ? latency_sum / n_latency : 0;
+    result->peak_threads = g_atomic_int_get (&peak_threads);
+    result->cores = wall > 0 ? (gdouble) cpu / wall : 0;
+  }
+
+  for (i = 0; i < n_init; i++)
+    stress_instance_clear (&insts[i]);
+  g_free (insts);
+
+  return ret;
+}
+
+static void
+stress_plot (StressResult * results, guint n_results)
+{
+  guint i, j;
+
+  g_printerr ("\nScaling efficiency (fps per core relative to %u "
+      "instance(s)):\n", results[0].n);
+  for (i = 0; i < n_results; i++) {
+    guint bar = (guint) (CLAMP (results[i].efficiency, 0.0, 2.0) * 25);
+
+    g_printerr ("%5u |", results[i].n);
+    for (j = 0; j < bar; j++)
+      g_printerr ("#");
+    g_printerr (" %.2f\n", results[i].efficiency);
+  }
+}
+
+int
+main (int argc, char **argv)
+{
+  GOptionContext *ctx;
+  GError *err = NULL;
+  StressResult *results;
+  gchar **instances;
+  gchar *desc;
+  guint i, n_results = 0;
+  gint ret = 0;
+
+  ctx = g_option_context_new ("- run many pipelines concurrently");
+  g_option_context_add_main_entries (ctx, entries, NULL);
+  g_option_context_add_group (ctx, gst_init_get_option_group ());
+
+  /* Must be set before the plugin is loaded */
+  for (i = 1; i < argc - 1; i++) {
+    if (strcmp (argv[i], "--config-dir") == 0 || strcmp (argv[i], "-c") == 0)
+      g_setenv ("GST_OMX_CONFIG_DIR", argv[i + 1], TRUE);
+    else if (g_str_has_prefix (argv[i], "--config-dir="))
+      g_setenv ("GST_OMX_CONFIG_DIR", argv[i] + strlen ("--config-dir="),
+          TRUE);
+  }
+
+  if (!g_option_context_parse (ctx, &argc, &argv, &err)) {
+    g_printerr ("Failed to parse options: %s\n", err->message);
+    g_clear_error (&err);
+    g_option_context_free (ctx);
+    return 1;
+  }
+  g_option_context_free (ctx);
+
+  desc = stress_expand_pipeline (pipeline_desc ? pipeline_desc :
+      DEFAULT_PIPELINE);
+  instances = g_strsplit (instances_string ? instances_string :
+      "1,2,4,8,16,32,64,128,256", ",", -1);
+  results = g_new0 (StressResult, g_strv_length (instances));
+
+  g_print ("instances,fps,latency_mean_ms,latency_worst_ms,peak_threads,"
+      "cores,efficiency\n");
+
+  for (i = 0; instances[i]; i++) {
+    StressResult *result = &results[n_results];
+    guint n = g_ascii_strtoull (instances[i], NULL, 10);
+
+    if (n == 0 || n > 256) {
+      g_printerr ("Invalid number of instances '%s'\n", instances[i]);
+      ret = 1;
+      continue;
+    }
+
+    g_printerr ("Running %u instance(s)\n", n);
+    if (!stress_run (desc, n, result)) {
+      ret = 1;
+      break;
+    }
+
+    if (result->cores > 0 && results[0].cores > 0 && results[0].fps > 0)
+      result->efficiency = (result->fps / result->cores) /
+          (results[0].fps / results[0].cores);
+    n_results++;
+
+    g_print ("%u,%.2f,%.3f,%.3f,%u,%.2f,%.3f\n", result->n, result->fps,
+        result->latency_mean_ms, result->latency_worst_ms,
+        result->peak_threads, result->cores, result->efficiency);
+  }
+
+  if (n_results > 0)
+    stress_plot (results, n_results);
+
+  g_free (results);
+  g_strfreev (instances);
+  g_free (desc);
+  g_free (pipeline_desc);
+  g_free (instances_string);
+  g_free (config_dir);
+
+  return ret;
+}